@@ -0,0 +1,55 @@
+#include "block_view.h"
+#include "../merkle/merkle.h"
+#include <cstring>
+#include <stdexcept>
+
+BlockView::BlockView(ByteSpan payload)
+{
+    if (payload.size() < sizeof(BlockHeader) + sizeof(uint32_t)) throw std::runtime_error("block too small");
+    std::size_t offset = 0;
+    std::memcpy(&m_header, payload.data(), sizeof(BlockHeader));
+    offset += sizeof(BlockHeader);
+    uint32_t txCount = 0;
+    std::memcpy(&txCount, payload.data() + offset, sizeof(txCount));
+    offset += sizeof(txCount);
+
+    // Validate transaction count to prevent memory exhaustion
+    if (txCount > kMaxTransactions || txCount > (payload.size() - offset) / sizeof(uint32_t)) {
+        throw std::runtime_error("transaction count exceeds maximum");
+    }
+
+    m_txs.reserve(txCount);
+    for (uint32_t i = 0; i < txCount; ++i) {
+        if (offset + sizeof(uint32_t) > payload.size()) throw std::runtime_error("truncated transaction size");
+        uint32_t txSize = 0;
+        std::memcpy(&txSize, payload.data() + offset, sizeof(txSize));
+        offset += sizeof(txSize);
+
+        if (txSize == 0 || txSize > kMaxTransactionSize) {
+            throw std::runtime_error("invalid transaction size");
+        }
+
+        if (txSize > payload.size() - offset) throw std::runtime_error("truncated transaction data");
+        m_txs.emplace_back(payload.subspan(offset, txSize));
+        offset += txSize;
+    }
+}
+
+uint256 BlockView::ComputeMerkleRoot() const
+{
+    std::vector<uint256> hashes;
+    hashes.reserve(m_txs.size());
+    for (const auto& tx : m_txs)
+        hashes.push_back(tx.GetHash());
+    return ComputeMerkleRootFromHashes(std::move(hashes));
+}
+
+Block BlockView::ToBlock() const
+{
+    Block block{};
+    block.header = m_header;
+    block.transactions.reserve(m_txs.size());
+    for (const auto& tx : m_txs)
+        block.transactions.push_back(tx.ToTransaction());
+    return block;
+}
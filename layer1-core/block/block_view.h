@@ -0,0 +1,32 @@
+#pragma once
+
+#include "../tx/transaction_view.h"
+#include "block.h"
+#include <cstddef>
+#include <vector>
+
+// A stored block payload, [header][u32 tx count]([u32 size][tx])*, parsed
+// in place: the header is copied out and every transaction is a
+// TransactionView into the caller's buffer, which must outlive the view.
+class BlockView {
+public:
+    static constexpr uint32_t kMaxTransactions = 100000;
+    static constexpr uint32_t kMaxTransactionSize = 10 * 1024 * 1024;
+
+    // Throws std::runtime_error on a malformed payload.
+    explicit BlockView(ByteSpan payload);
+
+    const BlockHeader& Header() const { return m_header; }
+    std::size_t TransactionCount() const { return m_txs.size(); }
+    const TransactionView& Tx(std::size_t i) const { return m_txs.at(i); }
+    const std::vector<TransactionView>& Transactions() const { return m_txs; }
+
+    // Merkle root over the transaction bytes as they are, equal to
+    // ComputeMerkleRoot(ToBlock().transactions).
+    uint256 ComputeMerkleRoot() const;
+    Block ToBlock() const;
+
+private:
+    BlockHeader m_header{};
+    std::vector<TransactionView> m_txs;
+};
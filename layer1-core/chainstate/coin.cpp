@@ -0,0 +1,178 @@
+#include "coin.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+constexpr uint8_t kScriptTemplateKey32 = 0x00;
+
+void WriteVarInt(std::string& out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+bool ReadVarInt(const uint8_t*& p, const uint8_t* end, uint64_t& v)
+{
+    v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (p == end)
+            return false;
+        const uint8_t b = *p++;
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+} // namespace
+
+static_assert(sizeof(Coin) <= 48, "Coin should stay compact");
+
+Coin::Coin()
+    : height(0), coinbase(0), scriptSize(0), assetId(static_cast<uint8_t>(AssetId::DRACHMA))
+{
+}
+
+Coin::Coin(const TxOut& out, uint32_t height_, bool coinbase_)
+    : Coin(out.value, out.assetId, out.scriptPubKey.data(), out.scriptPubKey.size(), height_, coinbase_)
+{
+}
+
+Coin::Coin(uint64_t value_, uint8_t assetId_, const uint8_t* data, std::size_t size,
+           uint32_t height_, bool coinbase_)
+    : value(value_), height(0), coinbase(coinbase_ ? 1 : 0), scriptSize(0), assetId(assetId_)
+{
+    if (height_ > kMaxHeight)
+        throw std::out_of_range("coin height out of range");
+    height = height_;
+    AssignScript(data, size);
+}
+
+Coin::Coin(const Coin& other)
+    : value(other.value), height(other.height), coinbase(other.coinbase), scriptSize(0), assetId(other.assetId)
+{
+    AssignScript(other.ScriptData(), other.scriptSize);
+}
+
+Coin::Coin(Coin&& other) noexcept
+    : script(other.script), value(other.value), height(other.height), coinbase(other.coinbase),
+      scriptSize(other.scriptSize), assetId(other.assetId)
+{
+    // The heap buffer (if any) now belongs to us.
+    other.scriptSize = 0;
+}
+
+Coin& Coin::operator=(const Coin& other)
+{
+    if (this != &other) {
+        ReleaseScript();
+        value = other.value;
+        height = other.height;
+        coinbase = other.coinbase;
+        assetId = other.assetId;
+        AssignScript(other.ScriptData(), other.scriptSize);
+    }
+    return *this;
+}
+
+Coin& Coin::operator=(Coin&& other) noexcept
+{
+    if (this != &other) {
+        ReleaseScript();
+        script = other.script;
+        value = other.value;
+        height = other.height;
+        coinbase = other.coinbase;
+        scriptSize = other.scriptSize;
+        assetId = other.assetId;
+        other.scriptSize = 0;
+    }
+    return *this;
+}
+
+Coin::~Coin()
+{
+    ReleaseScript();
+}
+
+void Coin::AssignScript(const uint8_t* data, std::size_t size)
+{
+    if (size > kMaxScriptSize)
+        throw std::length_error("script too large for coin");
+    scriptSize = static_cast<uint32_t>(size);
+    if (size <= kInlineScriptSize) {
+        if (size > 0)
+            std::memcpy(script.inlined, data, size);
+        return;
+    }
+    script.heap = new uint8_t[size];
+    std::memcpy(script.heap, data, size);
+}
+
+void Coin::ReleaseScript()
+{
+    if (!IsInline())
+        delete[] script.heap;
+    scriptSize = 0;
+}
+
+TxOut Coin::ToTxOut() const
+{
+    TxOut out{};
+    out.value = value;
+    out.assetId = Asset();
+    out.scriptPubKey.assign(ScriptData(), ScriptData() + scriptSize);
+    return out;
+}
+
+void EncodeCoin(const Coin& coin, std::string& out)
+{
+    WriteVarInt(out, (static_cast<uint64_t>(coin.Height()) << 1) | (coin.IsCoinBase() ? 1 : 0));
+    WriteVarInt(out, coin.Value());
+    out.push_back(static_cast<char>(coin.Asset()));
+    if (coin.ScriptSize() == Coin::kInlineScriptSize) {
+        out.push_back(static_cast<char>(kScriptTemplateKey32));
+    } else {
+        WriteVarInt(out, static_cast<uint64_t>(coin.ScriptSize()) + 1);
+    }
+    out.append(reinterpret_cast<const char*>(coin.ScriptData()), coin.ScriptSize());
+}
+
+bool DecodeCoin(const uint8_t* data, std::size_t size, Coin& coin)
+{
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    uint64_t code = 0;
+    uint64_t value = 0;
+    if (!ReadVarInt(p, end, code) || !ReadVarInt(p, end, value) || p == end)
+        return false;
+    if ((code >> 1) > Coin::kMaxHeight)
+        return false;
+    const uint8_t assetId = *p++;
+    uint64_t scriptSize = 0;
+    if (p != end && *p == kScriptTemplateKey32) {
+        ++p;
+        scriptSize = Coin::kInlineScriptSize;
+    } else if (!ReadVarInt(p, end, scriptSize) || scriptSize-- == 0) {
+        return false;
+    }
+    if (scriptSize != static_cast<std::size_t>(end - p))
+        return false;
+    coin = Coin(value, assetId, p, scriptSize, static_cast<uint32_t>(code >> 1), code & 1);
+    return true;
+}
+
+bool DecodeLegacyCoin(const uint8_t* data, std::size_t size, Coin& coin)
+{
+    constexpr std::size_t kHeaderSize = sizeof(uint8_t) + sizeof(uint64_t);
+    if (size < kHeaderSize)
+        return false;
+    uint64_t value = 0;
+    std::memcpy(&value, data + 1, sizeof(value));
+    // Height and coinbase were never recorded.
+    coin = Coin(value, data[0], data + kHeaderSize, size - kHeaderSize, 0, false);
+    return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../tx/transaction.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Compact representation of an unspent output, used by the coins cache and
+// as the on-disk value layout. Consensus scripts are 32-byte x-only keys, so
+// scripts of up to 32 bytes are stored inline and a cached coin needs no
+// heap allocation; longer scripts fall back to an owned buffer.
+class Coin {
+public:
+    static constexpr std::size_t kInlineScriptSize = 32;
+    static constexpr uint32_t kMaxScriptSize = (1u << 24) - 1;
+    static constexpr uint32_t kMaxHeight = (1u << 31) - 1;
+
+    Coin();
+    Coin(const TxOut& out, uint32_t height, bool coinbase);
+    Coin(uint64_t value, uint8_t assetId, const uint8_t* script, std::size_t scriptSize,
+         uint32_t height, bool coinbase);
+    Coin(const Coin& other);
+    Coin(Coin&& other) noexcept;
+    Coin& operator=(const Coin& other);
+    Coin& operator=(Coin&& other) noexcept;
+    ~Coin();
+
+    uint64_t Value() const { return value; }
+    uint8_t Asset() const { return static_cast<uint8_t>(assetId); }
+    uint32_t Height() const { return height; }
+    bool IsCoinBase() const { return coinbase != 0; }
+
+    const uint8_t* ScriptData() const { return IsInline() ? script.inlined : script.heap; }
+    std::size_t ScriptSize() const { return scriptSize; }
+
+    TxOut ToTxOut() const;
+    // Heap bytes owned beyond sizeof(Coin).
+    std::size_t DynamicUsage() const { return IsInline() ? 0 : scriptSize; }
+
+private:
+    union {
+        uint8_t inlined[kInlineScriptSize];
+        uint8_t* heap;
+    } script;
+    uint64_t value{0};
+    uint32_t height : 31;
+    uint32_t coinbase : 1;
+    uint32_t scriptSize : 24;
+    uint32_t assetId : 8;
+
+    bool IsInline() const { return scriptSize <= kInlineScriptSize; }
+    void AssignScript(const uint8_t* data, std::size_t size);
+    void ReleaseScript();
+};
+
+// Value layout:
+//   [varint(height << 1 | coinbase)][varint(value)][asset(1)][script]
+// where script is [0x00][32-byte key] for the standard template and
+// [varint(size + 1)][bytes] for anything else. Varints are LEB128.
+void EncodeCoin(const Coin& coin, std::string& out);
+bool DecodeCoin(const uint8_t* data, std::size_t size, Coin& coin);
+
+// Pre-compaction layout: [asset(1)][value(8, host order)][script].
+bool DecodeLegacyCoin(const uint8_t* data, std::size_t size, Coin& coin);
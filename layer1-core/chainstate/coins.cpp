@@ -1,70 +1,147 @@
 #include "coins.h"
-#include <fstream>
-#include <stdexcept>
+#include "../consensus/params.h"
 #include <algorithm>
-#include <cstring>
+#include <stdexcept>
+
+// Base view of every shard cache. Reads go straight to the backend, while
+// flushed entries are collected so all shards reach the backend together in
+// one batch with the best block.
+class Chainstate::FlushCollector : public CoinsView {
+public:
+    explicit FlushCollector(CoinsView* backend_) : backend(backend_) {}
+
+    std::optional<Coin> GetCoin(const OutPoint& out) const override { return backend->GetCoin(out); }
+    bool HaveCoin(const OutPoint& out) const override { return backend->HaveCoin(out); }
+    uint256 GetBestBlock() const override { return backend->GetBestBlock(); }
+    void BatchWrite(const CoinsMap& changes, const uint256&) override
+    {
+        for (const auto& entry : changes) {
+            if (entry.second.flags & CoinsCacheEntry::DIRTY)
+                pending[entry.first] = entry.second;
+        }
+    }
+
+    CoinsMap pending;
+    uint256 flushedBest{};
+
+private:
+    CoinsView* backend;
+};
 
+Chainstate::Chainstate(const std::string& path, std::size_t cacheBytes_, ChainstateFlushPolicy policy_)
+    : storagePath(path), cacheBytes(cacheBytes_), policy(policy_)
+{
 #ifdef DRACHMA_HAVE_LEVELDB
-#include <leveldb/db.h>
-#include <leveldb/write_batch.h>
+    auto dbView = std::make_unique<CoinsViewDB>(storagePath + ".ldb");
+    if (dbView->IsOpen()) {
+        pendingReplay = dbView->GetHeadBlocks();
+        backend = std::move(dbView);
+    }
 #endif
+    if (!backend)
+        backend = std::make_unique<CoinsViewFile>(storagePath);
+    replaying = pendingReplay.has_value();
+    collector = std::make_unique<FlushCollector>(backend.get());
 
-namespace {
-constexpr size_t ASSET_FIELD_SIZE = sizeof(uint8_t);
-constexpr size_t MIN_VALUE_SIZE = ASSET_FIELD_SIZE + sizeof(uint64_t);
+    // Saved stats are trusted only after a complete flush; otherwise (or for
+    // stores that predate them) they are rebuilt from the coins on disk.
+    UtxoStatsTracker stats;
+    auto blob = backend->GetStats();
+    if (pendingReplay || !blob || !stats.Deserialize(*blob)) {
+        stats = UtxoStatsTracker{};
+        backend->ForEachCoin([&stats](const OutPoint& out, const Coin& coin) {
+            stats.AddCoin(out, coin);
+        });
+        statsDirty = true;
+    }
+    ResetShardsLocked(std::move(stats));
+    MarkFlushed();
 }
 
-std::size_t OutPointHash::operator()(const OutPoint& o) const noexcept
+Chainstate::~Chainstate()
 {
-    size_t h = 0;
-    for (auto b : o.hash) h = (h * 131) ^ b;
-    h ^= static_cast<size_t>(o.index + 0x9e3779b97f4a7c15ULL + (h<<6) + (h>>2));
-    return h;
+    // Write-back mode keeps unflushed coins in memory; persist them on a
+    // clean shutdown. Errors cannot be reported from here.
+    try {
+        std::lock_guard<std::mutex> l(mu);
+        for (auto& shard : shards) {
+            shard.txView.reset();
+            shard.txStats.reset();
+        }
+        FlushLocked();
+    } catch (...) {
+    }
 }
 
-bool OutPointEq::operator()(const OutPoint& a, const OutPoint& b) const noexcept
+std::size_t Chainstate::ShardIndex(const OutPoint& out)
 {
-    return a.index == b.index && std::equal(a.hash.begin(), a.hash.end(), b.hash.begin());
+    // Txids are uniformly distributed, and mixing in the index spreads the
+    // outputs of one transaction over different shards.
+    return (static_cast<std::size_t>(out.hash[0]) ^ out.index) % kCoinShards;
 }
 
-Chainstate::Chainstate(const std::string& path, std::size_t cacheCapacity)
-    : storagePath(path), maxCacheEntries(cacheCapacity)
+Chainstate::Shard& Chainstate::ShardFor(const OutPoint& out) const
 {
-#ifdef DRACHMA_HAVE_LEVELDB
-    leveldb::Options opts;
-    opts.create_if_missing = true;
-    leveldb::DB* rawDb = nullptr;
-    auto status = leveldb::DB::Open(opts, storagePath + ".ldb", &rawDb);
-    if (status.ok()) {
-        db.reset(rawDb);
-        useDb = true;
+    return shards[ShardIndex(out)];
+}
+
+std::vector<std::unique_lock<std::mutex>> Chainstate::LockShards() const
+{
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(shards.size());
+    for (auto& shard : shards)
+        locks.emplace_back(shard.mu);
+    return locks;
+}
+
+void Chainstate::ResetShardsLocked(UtxoStatsTracker stats)
+{
+    bestBlock = backend->GetBestBlock();
+    collector->flushedBest = bestBlock;
+    for (auto& shard : shards) {
+        shard.txView.reset();
+        shard.txStats.reset();
+        shard.cache = std::make_unique<CoinsViewCache>(collector.get(), cacheBytes / kCoinShards);
+        shard.stats = UtxoStatsTracker{};
+        shard.NoteUsage();
     }
-#endif
-    Load();
+    // Only the product over all shards is meaningful, so the totals can
+    // start out in any one of them.
+    shards[0].stats = std::move(stats);
+}
+
+UtxoStatsTracker Chainstate::MergedStatsLocked() const
+{
+    UtxoStatsTracker merged;
+    for (const auto& shard : shards)
+        merged.Merge(shard.stats);
+    return merged;
 }
 
 bool Chainstate::HaveUTXO(const OutPoint& out) const
 {
-    std::lock_guard<std::mutex> l(mu);
-    if (cache.find(out) != cache.end())
-        return true;
-    return utxos.find(out) != utxos.end();
+    auto& shard = ShardFor(out);
+    std::lock_guard<std::mutex> l(shard.mu);
+    const bool have = shard.ActiveView().HaveCoin(out);
+    shard.NoteUsage();
+    return have;
 }
 
 std::optional<TxOut> Chainstate::TryGetUTXO(const OutPoint& out) const
 {
-    std::lock_guard<std::mutex> l(mu);
-    auto itCache = cache.find(out);
-    if (itCache != cache.end())
-        return itCache->second;
-
-    auto it = utxos.find(out);
-    if (it == utxos.end())
+    auto coin = TryGetCoin(out);
+    if (!coin)
         return std::nullopt;
+    return coin->ToTxOut();
+}
 
-    cache.emplace(out, it->second);
-    MaybeEvict();
-    return it->second;
+std::optional<Coin> Chainstate::TryGetCoin(const OutPoint& out) const
+{
+    auto& shard = ShardFor(out);
+    std::lock_guard<std::mutex> l(shard.mu);
+    auto coin = shard.ActiveView().GetCoin(out);
+    shard.NoteUsage();
+    return coin;
 }
 
 TxOut Chainstate::GetUTXO(const OutPoint& out) const
@@ -75,162 +152,307 @@ TxOut Chainstate::GetUTXO(const OutPoint& out) const
     return *coin;
 }
 
-void Chainstate::AddUTXO(const OutPoint& out, const TxOut& txout)
+std::size_t Chainstate::WarmCoins(const std::vector<OutPoint>& outs) const
 {
-    std::lock_guard<std::mutex> l(mu);
-    auto itExisting = utxos.find(out);
-    if (inTransaction) {
-        ChangeLog change;
-        change.out = out;
-        change.hadOld = itExisting != utxos.end();
-        if (change.hadOld) change.oldValue = itExisting->second;
-        change.hadNew = true;
-        change.newValue = txout;
-        pending.push_back(change);
+    std::size_t found = 0;
+    for (const auto& out : outs) {
+        auto& shard = ShardFor(out);
+        std::lock_guard<std::mutex> l(shard.mu);
+        // Warm the committed layer; a staging layer reads through to it.
+        if (shard.cache->HaveCoin(out))
+            ++found;
+        shard.NoteUsage();
     }
+    return found;
+}
 
-    utxos[out] = txout;
-    cache[out] = txout;
-#ifdef DRACHMA_HAVE_LEVELDB
-    if (useDb && !inTransaction) {
-        leveldb::WriteBatch batch;
-        // value layout: [asset(1)][value(8)][scriptPubKey]
-        std::string value;
-        value.resize(ASSET_FIELD_SIZE + sizeof(txout.value));
-        value[0] = static_cast<char>(txout.assetId);
-        std::memcpy(value.data() + ASSET_FIELD_SIZE, &txout.value, sizeof(txout.value));
-        value.append(reinterpret_cast<const char*>(txout.scriptPubKey.data()), txout.scriptPubKey.size());
-
-        std::string key;
-        key.reserve(out.hash.size() + sizeof(out.index));
-        key.append(reinterpret_cast<const char*>(out.hash.data()), out.hash.size());
-        key.append(reinterpret_cast<const char*>(&out.index), sizeof(out.index));
-        batch.Put(key, value);
-        PersistBatch(batch);
+void Chainstate::AddUTXO(const OutPoint& out, const TxOut& txout, bool possibleOverwrite)
+{
+    AddCoin(out, Coin(txout, 0, false), possibleOverwrite);
+}
+
+void Chainstate::AddCoin(const OutPoint& out, Coin coin, bool possibleOverwrite)
+{
+    auto& shard = ShardFor(out);
+    bool staged;
+    {
+        std::lock_guard<std::mutex> l(shard.mu);
+        auto& view = shard.ActiveView();
+        auto& stats = shard.ActiveStats();
+        if (possibleOverwrite) {
+            if (auto previous = view.GetCoin(out))
+                stats.RemoveCoin(out, *previous);
+        }
+        stats.AddCoin(out, coin);
+        view.AddCoin(out, std::move(coin), possibleOverwrite);
+        shard.NoteUsage();
+        staged = shard.txView != nullptr;
     }
-#endif
-    MaybeEvict();
+    AfterUpdate(staged);
 }
 
 void Chainstate::SpendUTXO(const OutPoint& out)
 {
-    std::lock_guard<std::mutex> l(mu);
-    auto it = utxos.find(out);
-    if (it == utxos.end()) throw std::runtime_error("spend missing utxo");
-    if (inTransaction) {
-        ChangeLog change;
-        change.out = out;
-        change.hadOld = true;
-        change.oldValue = it->second;
-        change.hadNew = false;
-        pending.push_back(change);
+    auto& shard = ShardFor(out);
+    bool staged;
+    {
+        std::lock_guard<std::mutex> l(shard.mu);
+        Coin spent;
+        if (shard.ActiveView().SpendCoin(out, &spent))
+            shard.ActiveStats().RemoveCoin(out, spent);
+        else if (!replaying)
+            throw std::runtime_error("spend missing utxo");
+        shard.NoteUsage();
+        staged = shard.txView != nullptr;
     }
-    utxos.erase(it);
-    cache.erase(out);
-#ifdef DRACHMA_HAVE_LEVELDB
-    if (useDb && !inTransaction) {
-        leveldb::WriteBatch batch;
-        std::string key;
-        key.reserve(out.hash.size() + sizeof(out.index));
-        key.append(reinterpret_cast<const char*>(out.hash.data()), out.hash.size());
-        key.append(reinterpret_cast<const char*>(&out.index), sizeof(out.index));
-        batch.Delete(key);
-        PersistBatch(batch);
-    }
-#endif
+    AfterUpdate(staged);
 }
 
-void Chainstate::Flush() const { Persist(); }
+bool Chainstate::SpendCoin(const OutPoint& out, Coin* moveTo)
+{
+    auto& shard = ShardFor(out);
+    bool staged;
+    {
+        std::lock_guard<std::mutex> l(shard.mu);
+        Coin spent;
+        const bool found = shard.ActiveView().SpendCoin(out, &spent);
+        shard.NoteUsage();
+        if (!found)
+            return false;
+        shard.ActiveStats().RemoveCoin(out, spent);
+        if (moveTo)
+            *moveTo = std::move(spent);
+        staged = shard.txView != nullptr;
+    }
+    AfterUpdate(staged);
+    return true;
+}
 
-std::size_t Chainstate::CachedEntries() const
+void Chainstate::AfterUpdate(bool staged)
 {
+    // Staged updates are checked when the transaction commits. Most updates
+    // need no flush, and those never touch the chainstate lock.
+    if (staged || !FlushNeeded())
+        return;
     std::lock_guard<std::mutex> l(mu);
-    return cache.size();
+    FlushIfNeededLocked();
 }
 
-void Chainstate::Load()
+void Chainstate::Flush() const
 {
     std::lock_guard<std::mutex> l(mu);
-#ifdef DRACHMA_HAVE_LEVELDB
-    if (useDb) {
-        std::unique_ptr<leveldb::Iterator> it(db->NewIterator(leveldb::ReadOptions()));
-        for (it->SeekToFirst(); it->Valid(); it->Next()) {
-            const auto& key = it->key();
-            const auto& val = it->value();
-            OutPoint op{};
-            if (key.size() != op.hash.size() + sizeof(uint32_t) || val.size() < MIN_VALUE_SIZE)
-                continue;
-            std::memcpy(op.hash.data(), key.data(), op.hash.size());
-            std::memcpy(&op.index, key.data() + op.hash.size(), sizeof(op.index));
-            TxOut txo{};
-            txo.assetId = static_cast<uint8_t>(val.data()[0]);
-            std::memcpy(&txo.value, val.data() + ASSET_FIELD_SIZE, sizeof(txo.value));
-            txo.scriptPubKey.assign(val.data() + ASSET_FIELD_SIZE + sizeof(txo.value), val.data() + val.size());
-            utxos.emplace(op, txo);
+    FlushLocked();
+}
+
+void Chainstate::FlushLocked() const
+{
+    {
+        auto locks = LockShards();
+        for (auto& shard : shards) {
+            shard.cache->Flush();
+            shard.NoteUsage();
         }
-        return;
+        if (!collector->pending.empty() || collector->flushedBest != bestBlock || statsDirty) {
+            backend->SetStats(MergedStatsLocked().Serialize());
+            backend->BatchWrite(collector->pending, bestBlock);
+            statsDirty = false;
+            collector->pending.clear();
+            collector->flushedBest = bestBlock;
+        }
+        backend->Sync();
     }
-#endif
-    std::ifstream in(storagePath, std::ios::binary);
-    if (!in.good()) return;
-    uint32_t count = 0;
-    in.read(reinterpret_cast<char*>(&count), sizeof(count));
-    for (uint32_t i = 0; i < count; ++i) {
-        OutPoint op{};
-        in.read(reinterpret_cast<char*>(op.hash.data()), op.hash.size());
-        in.read(reinterpret_cast<char*>(&op.index), sizeof(op.index));
-        TxOut txo{};
-        in.read(reinterpret_cast<char*>(&txo.assetId), sizeof(txo.assetId));
-        in.read(reinterpret_cast<char*>(&txo.value), sizeof(txo.value));
-        uint32_t scriptSize = 0;
-        in.read(reinterpret_cast<char*>(&scriptSize), sizeof(scriptSize));
-        txo.scriptPubKey.resize(scriptSize);
-        in.read(reinterpret_cast<char*>(txo.scriptPubKey.data()), scriptSize);
-        if (!in) throw std::runtime_error("corrupt utxo set");
-        utxos.emplace(op, txo);
+    MarkFlushed();
+    pendingReplay.reset();
+    replaying = false;
+}
+
+void Chainstate::FlushIfNeededLocked()
+{
+    if (!inTransaction && FlushNeeded())
+        FlushLocked();
+}
+
+bool Chainstate::FlushNeeded() const
+{
+    if (policy.writeThrough)
+        return true;
+    // Dirty coins cannot be evicted, so a cache over budget has to be
+    // written out before it can shrink.
+    std::size_t usage = 0;
+    for (const auto& shard : shards)
+        usage += shard.usage.load(std::memory_order_relaxed);
+    if (usage > cacheBytes)
+        return true;
+    const auto last = std::chrono::steady_clock::time_point(
+        std::chrono::steady_clock::duration(lastFlush.load(std::memory_order_relaxed)));
+    return std::chrono::steady_clock::now() - last >= policy.maxFlushInterval;
+}
+
+void Chainstate::MarkFlushed() const
+{
+    lastFlush.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+uint256 Chainstate::GetBestBlock() const
+{
+    std::lock_guard<std::mutex> l(mu);
+    return txBestBlock ? *txBestBlock : bestBlock;
+}
+
+void Chainstate::SetBestBlock(const uint256& hash)
+{
+    std::lock_guard<std::mutex> l(mu);
+    if (inTransaction)
+        txBestBlock = hash;
+    else
+        bestBlock = hash;
+}
+
+std::optional<CoinsReplayRange> Chainstate::PendingReplay() const
+{
+    std::lock_guard<std::mutex> l(mu);
+    return pendingReplay;
+}
+
+SnapshotMetadata Chainstate::DumpSnapshot(const std::string& path)
+{
+    // Only the flush and the cursor need the lock: the cursor reads the
+    // backend as of its creation, so blocks connected while the file is
+    // written do not leak into it.
+    std::unique_ptr<CoinsCursor> cursor;
+    uint256 base;
+    uint256 tracked;
+    {
+        std::lock_guard<std::mutex> l(mu);
+        if (inTransaction)
+            throw std::runtime_error("cannot dump utxo set during a block transaction");
+        FlushLocked();
+        base = backend->GetBestBlock();
+        {
+            auto locks = LockShards();
+            tracked = MergedStatsLocked().SetHash();
+        }
+        cursor = backend->Cursor();
     }
+
+    UtxoSnapshotWriter writer(path, base);
+    for (; cursor->Valid(); cursor->Next())
+        writer.Add(cursor->Key(), cursor->Value());
+    auto meta = writer.Finish();
+    // The running hash and the one recomputed from disk must agree.
+    if (meta.setHash != tracked)
+        throw std::runtime_error("utxo set hash does not match the coins on disk");
+    return meta;
 }
 
-void Chainstate::Persist() const
+SnapshotMetadata Chainstate::LoadSnapshot(const std::string& path, const consensus::Params& params, bool allowUntrusted)
 {
+    constexpr std::size_t kImportChunk = 1 << 16;
+
+    UtxoSnapshot snapshot(path);
+    if (!allowUntrusted) {
+        // The set hash is recomputed from the coins below, so matching the
+        // header against a trusted entry pins the contents too.
+        const auto& meta = snapshot.Metadata();
+        const bool trusted = meta.setHash != uint256{} &&
+                             std::any_of(params.assumeUtxo.begin(), params.assumeUtxo.end(), [&](const auto& entry) {
+                                 return entry.second.baseBlock == meta.baseBlock && entry.second.setHash == meta.setHash;
+                             });
+        if (!trusted)
+            throw std::runtime_error("utxo snapshot is not a trusted assumeutxo snapshot");
+    }
     std::lock_guard<std::mutex> l(mu);
-#ifdef DRACHMA_HAVE_LEVELDB
-    if (useDb) {
-        return; // LevelDB writes are handled incrementally in Add/Spend/Commit
+    if (inTransaction)
+        throw std::runtime_error("cannot load utxo set during a block transaction");
+    if (bestBlock != uint256{})
+        throw std::runtime_error("chainstate already has a best block");
+    FlushLocked();
+    // Readers must not touch the backend while it is being rewritten.
+    auto locks = LockShards();
+    if (MergedStatsLocked().Coins() != 0)
+        throw std::runtime_error("chainstate is not empty");
+
+    // Check the coins against the set hash before writing any of them.
+    UtxoStatsTracker stats;
+    for (std::size_t i = 0; i < snapshot.Size(); ++i) {
+        const auto entry = snapshot.At(i);
+        stats.AddCoin(entry.first, entry.second);
     }
-#endif
-    std::ofstream out(storagePath, std::ios::binary | std::ios::trunc);
-    uint32_t count = static_cast<uint32_t>(utxos.size());
-    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
-    for (const auto& entry : utxos) {
-        out.write(reinterpret_cast<const char*>(entry.first.hash.data()), entry.first.hash.size());
-        out.write(reinterpret_cast<const char*>(&entry.first.index), sizeof(entry.first.index));
-        out.write(reinterpret_cast<const char*>(&entry.second.assetId), sizeof(entry.second.assetId));
-        out.write(reinterpret_cast<const char*>(&entry.second.value), sizeof(entry.second.value));
-        uint32_t scriptSize = static_cast<uint32_t>(entry.second.scriptPubKey.size());
-        out.write(reinterpret_cast<const char*>(&scriptSize), sizeof(scriptSize));
-        out.write(reinterpret_cast<const char*>(entry.second.scriptPubKey.data()), scriptSize);
+    const uint256 setHash = snapshot.Metadata().setHash;
+    if (setHash != uint256{} && stats.SetHash() != setHash)
+        throw std::runtime_error("utxo snapshot set hash mismatch");
+
+    CoinsMap chunk;
+    chunk.reserve(std::min(kImportChunk, snapshot.Size()));
+    for (std::size_t i = 0; i < snapshot.Size(); ++i) {
+        auto entry = snapshot.At(i);
+        CoinsCacheEntry& e = chunk[entry.first];
+        e.coin = std::move(entry.second);
+        e.flags = CoinsCacheEntry::DIRTY;
+        if (chunk.size() == kImportChunk) {
+            backend->BatchWrite(chunk, uint256{});
+            chunk.clear();
+        }
     }
+    backend->SetStats(stats.Serialize());
+    backend->BatchWrite(chunk, snapshot.Metadata().baseBlock);
+    backend->Sync();
+    // The caches may hold lookups made before the import; start over.
+    ResetShardsLocked(std::move(stats));
+    MarkFlushed();
+    return snapshot.Metadata();
 }
 
-void Chainstate::MaybeEvict() const
+std::size_t Chainstate::CachedEntries() const
 {
-    if (cache.size() <= maxCacheEntries)
-        return;
+    std::size_t entries = 0;
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> l(shard.mu);
+        entries += shard.cache->Entries();
+    }
+    return entries;
+}
 
-    // Evict the oldest entries deterministically to prevent unbounded growth
-    // and keep hot coins resident.
-    const size_t target = maxCacheEntries / 2;
-    auto it = cache.begin();
-    while (cache.size() > target && it != cache.end()) {
-        it = cache.erase(it);
+CoinsCacheStats Chainstate::CacheStats() const
+{
+    CoinsCacheStats total;
+    total.maxBytes = cacheBytes;
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> l(shard.mu);
+        const auto stats = shard.cache->Stats();
+        total.entries += stats.entries;
+        total.usageBytes += stats.usageBytes;
+        total.hits += stats.hits;
+        total.misses += stats.misses;
     }
+    return total;
+}
+
+UtxoSetStats Chainstate::GetUtxoSetStats() const
+{
+    std::lock_guard<std::mutex> l(mu);
+    UtxoStatsTracker merged;
+    {
+        auto locks = LockShards();
+        merged = MergedStatsLocked();
+    }
+    UtxoSetStats out;
+    out.bestBlock = bestBlock;
+    out.coins = merged.Coins();
+    out.assets = merged.Assets();
+    out.setHash = merged.SetHash();
+    return out;
 }
 
 void Chainstate::BeginTransaction()
 {
     std::lock_guard<std::mutex> l(mu);
-    pending.clear();
+    auto locks = LockShards();
+    for (auto& shard : shards) {
+        shard.txView = std::make_unique<CoinsViewCache>(shard.cache.get());
+        shard.txStats = shard.stats;
+    }
+    txBestBlock.reset();
     inTransaction = true;
 }
 
@@ -239,68 +461,33 @@ void Chainstate::Commit()
     std::lock_guard<std::mutex> l(mu);
     if (!inTransaction) return;
 
-#ifdef DRACHMA_HAVE_LEVELDB
-    if (useDb && !pending.empty()) {
-        leveldb::WriteBatch batch;
-        for (const auto& change : pending) {
-            std::string key;
-            key.reserve(change.out.hash.size() + sizeof(change.out.index));
-            key.append(reinterpret_cast<const char*>(change.out.hash.data()), change.out.hash.size());
-            key.append(reinterpret_cast<const char*>(&change.out.index), sizeof(change.out.index));
-            if (change.hadNew) {
-                std::string value;
-                value.resize(ASSET_FIELD_SIZE + sizeof(change.newValue.value));
-                value[0] = static_cast<char>(change.newValue.assetId);
-                std::memcpy(value.data() + ASSET_FIELD_SIZE, &change.newValue.value, sizeof(change.newValue.value));
-                value.append(reinterpret_cast<const char*>(change.newValue.scriptPubKey.data()), change.newValue.scriptPubKey.size());
-                batch.Put(key, value);
-            } else {
-                batch.Delete(key);
-            }
+    {
+        // Coins created and spent inside the transaction were FRESH in the
+        // staging layer and vanish here without reaching the backend.
+        auto locks = LockShards();
+        for (auto& shard : shards) {
+            shard.txView->Flush();
+            shard.txView.reset();
+            shard.NoteUsage();
+            shard.stats = std::move(*shard.txStats);
+            shard.txStats.reset();
         }
-        PersistBatch(batch);
-    }
-    const bool use_db = useDb;
-#else
-    const bool use_db = false;
-    (void)pending;
-#endif
-
-    if (!use_db) {
-        Persist();
     }
-
-    pending.clear();
+    if (txBestBlock)
+        bestBlock = *txBestBlock;
+    txBestBlock.reset();
     inTransaction = false;
+    FlushIfNeededLocked();
 }
 
 void Chainstate::Rollback()
 {
     std::lock_guard<std::mutex> l(mu);
-    if (!inTransaction) return;
-
-    for (auto it = pending.rbegin(); it != pending.rend(); ++it) {
-        if (it->hadOld) {
-            utxos[it->out] = it->oldValue;
-            cache[it->out] = it->oldValue;
-        } else {
-            utxos.erase(it->out);
-            cache.erase(it->out);
-        }
+    auto locks = LockShards();
+    for (auto& shard : shards) {
+        shard.txView.reset();
+        shard.txStats.reset();
     }
-    pending.clear();
+    txBestBlock.reset();
     inTransaction = false;
 }
-
-#ifdef DRACHMA_HAVE_LEVELDB
-void Chainstate::PersistBatch(leveldb::WriteBatch& batch) const
-{
-    if (!useDb)
-        return;
-    leveldb::WriteOptions opts;
-    opts.sync = true; // durability for mainnet safety
-    auto status = db->Write(opts, &batch);
-    if (!status.ok())
-        throw std::runtime_error("leveldb write failed: " + status.ToString());
-}
-#endif
@@ -1,76 +1,157 @@
 #pragma once
 
 #include "../tx/transaction.h"
+#include "coins_view.h"
+#include "snapshot.h"
+#include "utxo_stats.h"
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <mutex>
 #include <optional>
 #include <string>
-#include <unordered_map>
-#include <algorithm>
 #include <memory>
 #include <vector>
 
-#ifdef DRACHMA_HAVE_LEVELDB
-#include <leveldb/db.h>
-#include <leveldb/write_batch.h>
-#endif
+namespace consensus {
+struct Params;
+}
 
-struct OutPointHash {
-    std::size_t operator()(const OutPoint& o) const noexcept;
-};
-struct OutPointEq {
-    bool operator()(const OutPoint& a, const OutPoint& b) const noexcept;
+// Default memory budget for the UTXO cache layer.
+constexpr std::size_t kDefaultCoinsCacheBytes = 64 * 1024 * 1024;
+
+// When the coins cache is pushed to disk. In write-back mode changes stay in
+// memory and are flushed as one batch once the cache outgrows its budget or
+// maxFlushInterval has passed since the previous flush; both are checked at
+// block boundaries (Commit) and after individual updates. writeThrough
+// restores the old behaviour of flushing every AddUTXO/SpendUTXO.
+struct ChainstateFlushPolicy {
+    bool writeThrough{false};
+    std::chrono::seconds maxFlushInterval{std::chrono::minutes(10)};
 };
 
-// Persistent chainstate with a bounded UTXO cache for fast lookups during
-// block/transaction validation.
+// Persistent chainstate: a memory-bounded coins cache layered over the
+// LevelDB backend (or the flat-file fallback), so the full UTXO set no
+// longer needs to be resident during block/transaction validation.
+//
+// The cache is split into kCoinShards shards by outpoint, each with its own
+// lock, so coin lookups only contend with updates to the same shard and
+// block application can update independent coins from several threads.
+// Transactions, flushes and the best block are serialized by a separate
+// chainstate lock that is always taken before any shard lock.
+//
+// The backend records the hash of the block the flushed coins correspond
+// to. If a flush was interrupted, PendingReplay() reports the blocks whose
+// effects must be re-applied (ReplayInterruptedFlush does this); until the
+// next flush completes, spending a missing coin is tolerated so replay is
+// idempotent.
 class Chainstate {
 public:
-    explicit Chainstate(const std::string& path, std::size_t cacheCapacity = 64 * 1024);
+    static constexpr std::size_t kCoinShards = 16;
+
+    explicit Chainstate(const std::string& path,
+                        std::size_t cacheBytes = kDefaultCoinsCacheBytes,
+                        ChainstateFlushPolicy policy = {});
+    ~Chainstate();
 
     bool HaveUTXO(const OutPoint& out) const;
     std::optional<TxOut> TryGetUTXO(const OutPoint& out) const;
     TxOut GetUTXO(const OutPoint& out) const;
 
-    void AddUTXO(const OutPoint& out, const TxOut& txout);
+    void AddUTXO(const OutPoint& out, const TxOut& txout, bool possibleOverwrite = true);
     void SpendUTXO(const OutPoint& out);
+
+    // Compact form carrying the creation height and coinbase flag.
+    std::optional<Coin> TryGetCoin(const OutPoint& out) const;
+    // Coin updates are safe to issue from several threads at once.
+    void AddCoin(const OutPoint& out, Coin coin, bool possibleOverwrite = true);
+    // Non-throwing spend; moves the removed coin into moveTo (for undo data).
+    bool SpendCoin(const OutPoint& out, Coin* moveTo = nullptr);
     void Flush() const;
+    // Pull coins into the cache so later lookups are hits. Each lookup holds
+    // only its own shard's lock. Returns how many of the coins exist.
+    std::size_t WarmCoins(const std::vector<OutPoint>& outs) const;
+
+    // Tip the current coin set corresponds to. Written to disk in the same
+    // batch as the coins on the next flush.
+    uint256 GetBestBlock() const;
+    void SetBestBlock(const uint256& hash);
+    std::optional<CoinsReplayRange> PendingReplay() const;
+
+    // Flush and write the full coin set as a UTXO snapshot of the current
+    // best block (see snapshot.h). The lock is held only for the flush; the
+    // coins are then streamed from a backend cursor.
+    SnapshotMetadata DumpSnapshot(const std::string& path);
+    // Verify a snapshot and import it, adopting its base block as the best
+    // block. The base block and set hash must match an entry in
+    // params.assumeUtxo unless allowUntrusted is set. Meant for a fresh
+    // node: refuses to run once a best block is set. Coins are written in
+    // chunks and the best block last, so an interrupted load can simply be
+    // repeated.
+    SnapshotMetadata LoadSnapshot(const std::string& path, const consensus::Params& params,
+                                  bool allowUntrusted = false);
 
     // Simple transactional API used by block validation to stage updates before
-    // finalizing a new tip. Rollback restores the in-memory view without
-    // touching persistent storage.
+    // finalizing a new tip. Updates go to a child cache layered over the
+    // main one; Commit merges them in (flushing per the flush policy) and
+    // Rollback discards the layer without touching persistent storage.
     void BeginTransaction();
     void Commit();
     void Rollback();
 
     std::size_t CachedEntries() const;
+    CoinsCacheStats CacheStats() const;
+
+    // Coin count, per-asset supply and MuHash of the committed coin set,
+    // maintained as coins are added and spent and persisted with each
+    // flush. Stores without saved stats are scanned once on open.
+    UtxoSetStats GetUtxoSetStats() const;
+
+    static std::size_t ShardIndex(const OutPoint& out);
 
 private:
+    struct Shard {
+        mutable std::mutex mu;
+        std::unique_ptr<CoinsViewCache> cache;
+        std::unique_ptr<CoinsViewCache> txView;
+        UtxoStatsTracker stats;
+        std::optional<UtxoStatsTracker> txStats;
+        // DynamicUsage of the committed cache, written under mu so the flush
+        // check can sum the shards without locking them.
+        std::atomic<std::size_t> usage{0};
+
+        CoinsViewCache& ActiveView() const { return txView ? *txView : *cache; }
+        UtxoStatsTracker& ActiveStats() { return txStats ? *txStats : stats; }
+        void NoteUsage() { usage.store(cache->DynamicUsage(), std::memory_order_relaxed); }
+    };
+    class FlushCollector;
+
     std::string storagePath;
-    mutable std::unordered_map<OutPoint, TxOut, OutPointHash, OutPointEq> utxos;
-    mutable std::unordered_map<OutPoint, TxOut, OutPointHash, OutPointEq> cache;
-    std::size_t maxCacheEntries;
-    mutable std::mutex mu;
+    std::unique_ptr<CoinsView> backend;
+    std::unique_ptr<FlushCollector> collector;
+    mutable std::array<Shard, kCoinShards> shards;
+    std::size_t cacheBytes;
+    ChainstateFlushPolicy policy;
+    // Guarded by mu.
+    uint256 bestBlock{};
+    std::optional<uint256> txBestBlock;
     bool inTransaction{false};
-    struct ChangeLog {
-        OutPoint out;
-        bool hadOld{false};
-        TxOut oldValue{};
-        bool hadNew{false};
-        TxOut newValue{};
-    };
-    std::vector<ChangeLog> pending;
-
-#ifdef DRACHMA_HAVE_LEVELDB
-    std::unique_ptr<leveldb::DB> db;
-    bool useDb{false};
-#endif
-
-    void Load();
-    void Persist() const;
-    void MaybeEvict() const;
-#ifdef DRACHMA_HAVE_LEVELDB
-    void PersistBatch(leveldb::WriteBatch& batch) const;
-#endif
-};
+    mutable std::optional<CoinsReplayRange> pendingReplay;
+    mutable bool statsDirty{false};
+    mutable std::mutex mu;
+    mutable std::atomic<bool> replaying{false};
+    // steady_clock ticks of the last flush; read without mu by FlushNeeded.
+    mutable std::atomic<std::chrono::steady_clock::rep> lastFlush;
 
+    Shard& ShardFor(const OutPoint& out) const;
+    std::vector<std::unique_lock<std::mutex>> LockShards() const;
+    void ResetShardsLocked(UtxoStatsTracker stats);
+    UtxoStatsTracker MergedStatsLocked() const;
+    void FlushLocked() const;
+    void FlushIfNeededLocked();
+    // Lock-free check of the flush policy; callers recheck under mu.
+    bool FlushNeeded() const;
+    void MarkFlushed() const;
+    void AfterUpdate(bool staged);
+};
@@ -0,0 +1,685 @@
+#include "coins_view.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef DRACHMA_HAVE_LEVELDB
+#include <leveldb/iterator.h>
+#include <leveldb/write_batch.h>
+#endif
+
+namespace {
+// Magic count written ahead of the compact flat-file format; legacy files
+// start with a real coin count and can never hold this many coins.
+constexpr uint32_t kCoinsFileMagic = 0xffffffffu;
+constexpr uint32_t kCoinsFileVersion = 1;
+
+#ifdef DRACHMA_HAVE_LEVELDB
+// Metadata keys are a single byte and can never collide with coin keys.
+const std::string kBestBlockKey = "B";
+const std::string kHeadBlocksKey = "H";
+const std::string kStatsKey = "S";
+// Compact coins live under [C][txid(32)][index(4)]. Legacy databases keyed
+// coins by the bare 36-byte outpoint with [asset][value][script] values.
+constexpr char kCoinPrefix = 'C';
+constexpr std::size_t kLegacyKeySize = 36;
+
+std::string EncodeKey(const OutPoint& out)
+{
+    std::string key;
+    key.reserve(1 + out.hash.size() + sizeof(out.index));
+    key.push_back(kCoinPrefix);
+    key.append(reinterpret_cast<const char*>(out.hash.data()), out.hash.size());
+    key.append(reinterpret_cast<const char*>(&out.index), sizeof(out.index));
+    return key;
+}
+
+std::string EncodeValue(const Coin& coin)
+{
+    std::string value;
+    value.reserve(48);
+    EncodeCoin(coin, value);
+    return value;
+}
+
+// Decode the coin under a compact key. Returns false once the iterator has
+// left the coin keys.
+bool ReadCoinEntry(const leveldb::Iterator& it, OutPoint& out, Coin& coin)
+{
+    constexpr std::size_t kKeySize = 1 + sizeof(uint256) + sizeof(uint32_t);
+    const auto key = it.key();
+    if (key.empty() || key[0] != kCoinPrefix)
+        return false;
+    if (key.size() != kKeySize)
+        throw std::runtime_error("corrupt utxo key");
+    std::memcpy(out.hash.data(), key.data() + 1, out.hash.size());
+    std::memcpy(&out.index, key.data() + 1 + out.hash.size(), sizeof(out.index));
+    const auto val = it.value();
+    if (!DecodeCoin(reinterpret_cast<const uint8_t*>(val.data()), val.size(), coin))
+        throw std::runtime_error("corrupt utxo entry");
+    return true;
+}
+#endif
+
+bool OutPointLess(const OutPoint& a, const OutPoint& b)
+{
+    if (int c = std::memcmp(a.hash.data(), b.hash.data(), a.hash.size()))
+        return c < 0;
+    return a.index < b.index;
+}
+
+using CoinEntries = std::vector<std::pair<OutPoint, Coin>>;
+
+void SortCoinEntries(CoinEntries& entries)
+{
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+        return OutPointLess(a.first, b.first);
+    });
+}
+
+class CoinEntriesCursor : public CoinsCursor {
+public:
+    explicit CoinEntriesCursor(CoinEntries entries_) : entries(std::move(entries_)) {}
+
+    bool Valid() const override { return pos < entries.size(); }
+    void Next() override { ++pos; }
+    const OutPoint& Key() const override { return entries[pos].first; }
+    const Coin& Value() const override { return entries[pos].second; }
+
+private:
+    CoinEntries entries;
+    std::size_t pos{0};
+};
+
+#ifdef DRACHMA_HAVE_LEVELDB
+// The index is stored in native byte order, so the outputs of one txid are
+// not in numeric order on disk. The cursor reads one txid's outputs at a
+// time and sorts them; txids themselves already come out in memcmp order.
+class CoinsViewDBCursor : public CoinsCursor {
+public:
+    explicit CoinsViewDBCursor(leveldb::Iterator* it_) : it(it_)
+    {
+        it->Seek(std::string(1, kCoinPrefix));
+        Fill();
+    }
+
+    bool Valid() const override { return pos < group.size(); }
+    void Next() override
+    {
+        if (++pos == group.size())
+            Fill();
+    }
+    const OutPoint& Key() const override { return group[pos].first; }
+    const Coin& Value() const override { return group[pos].second; }
+
+private:
+    std::unique_ptr<leveldb::Iterator> it;
+    CoinEntries group;
+    std::size_t pos{0};
+
+    void Fill()
+    {
+        group.clear();
+        pos = 0;
+        OutPoint out{};
+        Coin coin;
+        for (; it->Valid() && ReadCoinEntry(*it, out, coin); it->Next()) {
+            if (!group.empty() && out.hash != group.front().first.hash)
+                break;
+            group.emplace_back(out, coin);
+        }
+        if (!it->status().ok())
+            throw std::runtime_error("leveldb iteration failed: " + it->status().ToString());
+        SortCoinEntries(group);
+    }
+};
+#endif
+} // namespace
+
+std::size_t OutPointHash::operator()(const OutPoint& o) const noexcept
+{
+    size_t h = 0;
+    for (auto b : o.hash) h = (h * 131) ^ b;
+    h ^= static_cast<size_t>(o.index + 0x9e3779b97f4a7c15ULL + (h<<6) + (h>>2));
+    return h;
+}
+
+bool OutPointEq::operator()(const OutPoint& a, const OutPoint& b) const noexcept
+{
+    return a.index == b.index && std::equal(a.hash.begin(), a.hash.end(), b.hash.begin());
+}
+
+void CoinsView::ForEachCoin(const CoinVisitor&) const
+{
+    throw std::logic_error("coins view does not support iteration");
+}
+
+std::unique_ptr<CoinsCursor> CoinsView::Cursor() const
+{
+    throw std::logic_error("coins view does not support iteration");
+}
+
+#ifdef DRACHMA_HAVE_LEVELDB
+CoinsViewDB::CoinsViewDB(const std::string& path, std::size_t batchChunkBytes_)
+    : batchChunkBytes(batchChunkBytes_)
+{
+    leveldb::Options opts;
+    opts.create_if_missing = true;
+    leveldb::DB* rawDb = nullptr;
+    auto status = leveldb::DB::Open(opts, path, &rawDb);
+    if (status.ok()) {
+        db.reset(rawDb);
+        UpgradeLegacyValues();
+    }
+}
+
+void CoinsViewDB::UpgradeLegacyValues()
+{
+    // Each batch moves a set of coins to their new key and encoding
+    // atomically, so an interrupted upgrade simply resumes on the next open.
+    std::string resumeKey;
+    for (;;) {
+        leveldb::WriteBatch batch;
+        std::string lastKey;
+        {
+            std::unique_ptr<leveldb::Iterator> it(db->NewIterator(leveldb::ReadOptions()));
+            if (resumeKey.empty())
+                it->SeekToFirst();
+            else
+                it->Seek(resumeKey);
+            for (; it->Valid() && batch.ApproximateSize() < batchChunkBytes; it->Next()) {
+                const auto key = it->key();
+                if (key.size() != kLegacyKeySize)
+                    continue;
+                const auto val = it->value();
+                Coin coin;
+                if (!DecodeLegacyCoin(reinterpret_cast<const uint8_t*>(val.data()), val.size(), coin))
+                    throw std::runtime_error("corrupt legacy utxo entry");
+                std::string newKey(1, kCoinPrefix);
+                newKey.append(key.data(), key.size());
+                batch.Put(newKey, EncodeValue(coin));
+                batch.Delete(key);
+                lastKey = key.ToString();
+            }
+            if (!it->status().ok())
+                throw std::runtime_error("leveldb iteration failed: " + it->status().ToString());
+        }
+        if (lastKey.empty())
+            return;
+        auto status = db->Write(leveldb::WriteOptions(), &batch);
+        if (!status.ok())
+            throw std::runtime_error("leveldb write failed: " + status.ToString());
+        resumeKey = lastKey;
+    }
+}
+
+std::optional<Coin> CoinsViewDB::GetCoin(const OutPoint& out) const
+{
+    if (!db)
+        return std::nullopt;
+    std::string val;
+    auto status = db->Get(leveldb::ReadOptions(), EncodeKey(out), &val);
+    if (!status.ok())
+        return std::nullopt;
+    Coin coin;
+    if (!DecodeCoin(reinterpret_cast<const uint8_t*>(val.data()), val.size(), coin))
+        return std::nullopt;
+    return coin;
+}
+
+void CoinsViewDB::ForEachCoin(const CoinVisitor& visit) const
+{
+    if (!db)
+        return;
+    std::unique_ptr<leveldb::Iterator> it(db->NewIterator(leveldb::ReadOptions()));
+    OutPoint out{};
+    Coin coin;
+    for (it->Seek(std::string(1, kCoinPrefix)); it->Valid() && ReadCoinEntry(*it, out, coin); it->Next())
+        visit(out, coin);
+    if (!it->status().ok())
+        throw std::runtime_error("leveldb iteration failed: " + it->status().ToString());
+}
+
+std::unique_ptr<CoinsCursor> CoinsViewDB::Cursor() const
+{
+    if (!db)
+        return std::make_unique<CoinEntriesCursor>(CoinEntries{});
+    // An iterator reads the implicit snapshot taken when it is created.
+    return std::make_unique<CoinsViewDBCursor>(db->NewIterator(leveldb::ReadOptions()));
+}
+
+std::optional<std::string> CoinsViewDB::GetStats() const
+{
+    std::string val;
+    if (!db || !db->Get(leveldb::ReadOptions(), kStatsKey, &val).ok())
+        return std::nullopt;
+    return val;
+}
+
+uint256 CoinsViewDB::GetBestBlock() const
+{
+    uint256 hash{};
+    std::string val;
+    if (db && db->Get(leveldb::ReadOptions(), kBestBlockKey, &val).ok() && val.size() == hash.size())
+        std::memcpy(hash.data(), val.data(), hash.size());
+    return hash;
+}
+
+std::optional<CoinsReplayRange> CoinsViewDB::GetHeadBlocks() const
+{
+    std::string val;
+    if (!db || !db->Get(leveldb::ReadOptions(), kHeadBlocksKey, &val).ok())
+        return std::nullopt;
+    CoinsReplayRange range;
+    if (val.size() != range.to.size() + range.from.size())
+        throw std::runtime_error("corrupt head blocks marker");
+    std::memcpy(range.to.data(), val.data(), range.to.size());
+    std::memcpy(range.from.data(), val.data() + range.to.size(), range.from.size());
+    return range;
+}
+
+void CoinsViewDB::BatchWrite(const CoinsMap& changes, const uint256& bestBlock)
+{
+    if (!db)
+        return;
+    auto write = [this](leveldb::WriteBatch& batch, bool sync) {
+        leveldb::WriteOptions opts;
+        opts.sync = sync;
+        auto status = db->Write(opts, &batch);
+        if (!status.ok())
+            throw std::runtime_error("leveldb write failed: " + status.ToString());
+        batch.Clear();
+    };
+
+    const uint256 oldBest = GetBestBlock();
+    bool markerWritten = false;
+    leveldb::WriteBatch batch;
+    for (const auto& entry : changes) {
+        if (!(entry.second.flags & CoinsCacheEntry::DIRTY))
+            continue;
+        if (entry.second.spent)
+            batch.Delete(EncodeKey(entry.first));
+        else
+            batch.Put(EncodeKey(entry.first), EncodeValue(entry.second.coin));
+        if (batch.ApproximateSize() < batchChunkBytes)
+            continue;
+        // This flush will not land atomically; record which blocks to
+        // re-apply should we stop before the final chunk.
+        if (!markerWritten) {
+            std::string marker;
+            marker.append(reinterpret_cast<const char*>(bestBlock.data()), bestBlock.size());
+            marker.append(reinterpret_cast<const char*>(oldBest.data()), oldBest.size());
+            leveldb::WriteBatch head;
+            head.Put(kHeadBlocksKey, marker);
+            write(head, false);
+            markerWritten = true;
+        }
+        write(batch, false);
+    }
+
+    batch.Delete(kHeadBlocksKey);
+    if (pendingStats) {
+        batch.Put(kStatsKey, *pendingStats);
+        pendingStats.reset();
+    }
+    if (bestBlock != uint256{})
+        batch.Put(kBestBlockKey, std::string(reinterpret_cast<const char*>(bestBlock.data()), bestBlock.size()));
+    // One fsync per flush: LevelDB replays its log in order, so syncing the
+    // last batch makes every earlier unsynced chunk durable too.
+    write(batch, true);
+}
+#endif
+
+CoinsViewFile::CoinsViewFile(const std::string& path_)
+    : path(path_)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in.good()) return;
+    uint32_t count = 0;
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (count == kCoinsFileMagic) {
+        // [magic][version][count] then [outpoint][u32 size][compact coin]...
+        uint32_t version = 0;
+        in.read(reinterpret_cast<char*>(&version), sizeof(version));
+        in.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (!in || version != kCoinsFileVersion) throw std::runtime_error("unsupported utxo set version");
+        std::vector<uint8_t> buf;
+        for (uint32_t i = 0; i < count; ++i) {
+            OutPoint op{};
+            in.read(reinterpret_cast<char*>(op.hash.data()), op.hash.size());
+            in.read(reinterpret_cast<char*>(&op.index), sizeof(op.index));
+            uint32_t size = 0;
+            in.read(reinterpret_cast<char*>(&size), sizeof(size));
+            if (!in) throw std::runtime_error("corrupt utxo set");
+            buf.resize(size);
+            in.read(reinterpret_cast<char*>(buf.data()), size);
+            Coin coin;
+            if (!in || !DecodeCoin(buf.data(), buf.size(), coin)) throw std::runtime_error("corrupt utxo set");
+            coins.emplace(op, std::move(coin));
+        }
+    } else {
+        for (uint32_t i = 0; i < count; ++i) {
+            OutPoint op{};
+            in.read(reinterpret_cast<char*>(op.hash.data()), op.hash.size());
+            in.read(reinterpret_cast<char*>(&op.index), sizeof(op.index));
+            TxOut txo{};
+            in.read(reinterpret_cast<char*>(&txo.assetId), sizeof(txo.assetId));
+            in.read(reinterpret_cast<char*>(&txo.value), sizeof(txo.value));
+            uint32_t scriptSize = 0;
+            in.read(reinterpret_cast<char*>(&scriptSize), sizeof(scriptSize));
+            txo.scriptPubKey.resize(scriptSize);
+            in.read(reinterpret_cast<char*>(txo.scriptPubKey.data()), scriptSize);
+            if (!in) throw std::runtime_error("corrupt utxo set");
+            coins.emplace(op, Coin(txo, 0, false));
+        }
+    }
+    // Optional trailers; files written before they existed simply end here.
+    uint256 hash{};
+    if (!in.read(reinterpret_cast<char*>(hash.data()), hash.size()))
+        return;
+    bestBlock = hash;
+    uint32_t statsSize = 0;
+    if (!in.read(reinterpret_cast<char*>(&statsSize), sizeof(statsSize)))
+        return;
+    std::string blob(statsSize, '\0');
+    if (in.read(&blob[0], statsSize))
+        stats = std::move(blob);
+}
+
+std::optional<std::string> CoinsViewFile::GetStats() const
+{
+    if (stats.empty())
+        return std::nullopt;
+    return stats;
+}
+
+std::optional<Coin> CoinsViewFile::GetCoin(const OutPoint& out) const
+{
+    auto it = coins.find(out);
+    if (it == coins.end())
+        return std::nullopt;
+    return it->second;
+}
+
+void CoinsViewFile::ForEachCoin(const CoinVisitor& visit) const
+{
+    for (const auto& entry : coins)
+        visit(entry.first, entry.second);
+}
+
+std::unique_ptr<CoinsCursor> CoinsViewFile::Cursor() const
+{
+    CoinEntries entries(coins.begin(), coins.end());
+    SortCoinEntries(entries);
+    return std::make_unique<CoinEntriesCursor>(std::move(entries));
+}
+
+void CoinsViewFile::BatchWrite(const CoinsMap& changes, const uint256& bestBlock_)
+{
+    if (bestBlock_ != uint256{})
+        bestBlock = bestBlock_;
+    if (pendingStats) {
+        stats = std::move(*pendingStats);
+        pendingStats.reset();
+    }
+    for (const auto& entry : changes) {
+        if (!(entry.second.flags & CoinsCacheEntry::DIRTY))
+            continue;
+        if (entry.second.spent)
+            coins.erase(entry.first);
+        else
+            coins[entry.first] = entry.second.coin;
+    }
+}
+
+void CoinsViewFile::Sync()
+{
+    const std::string tmpPath = path + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    const uint32_t header[] = {kCoinsFileMagic, kCoinsFileVersion, static_cast<uint32_t>(coins.size())};
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    std::string buf;
+    for (const auto& entry : coins) {
+        buf.clear();
+        EncodeCoin(entry.second, buf);
+        const uint32_t size = static_cast<uint32_t>(buf.size());
+        out.write(reinterpret_cast<const char*>(entry.first.hash.data()), entry.first.hash.size());
+        out.write(reinterpret_cast<const char*>(&entry.first.index), sizeof(entry.first.index));
+        out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        out.write(buf.data(), buf.size());
+    }
+    out.write(reinterpret_cast<const char*>(bestBlock.data()), bestBlock.size());
+    if (!stats.empty()) {
+        const uint32_t statsSize = static_cast<uint32_t>(stats.size());
+        out.write(reinterpret_cast<const char*>(&statsSize), sizeof(statsSize));
+        out.write(stats.data(), stats.size());
+    }
+    out.close();
+    if (!out || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("failed to write utxo set");
+}
+
+CoinsViewCache::CoinsViewCache(CoinsView* base_, std::size_t maxBytes_)
+    : base(base_), maxBytes(maxBytes_)
+{
+}
+
+std::size_t CoinsViewCache::EntryUsage(const CoinsCacheEntry& entry)
+{
+    // Node payload plus the per-node next pointer and cached hash kept by
+    // libstdc++/libc++ unordered containers, plus any out-of-line script.
+    return sizeof(CoinsMap::value_type) + 2 * sizeof(void*) + entry.coin.DynamicUsage();
+}
+
+std::size_t CoinsViewCache::DynamicUsage() const
+{
+    return cachedUsage + cacheCoins.bucket_count() * sizeof(void*);
+}
+
+CoinsMap::iterator CoinsViewCache::FetchCoin(const OutPoint& out) const
+{
+    auto it = cacheCoins.find(out);
+    if (it != cacheCoins.end()) {
+        ++hits;
+        it->second.flags |= CoinsCacheEntry::REFERENCED;
+        return it;
+    }
+    ++misses;
+    auto coin = base ? base->GetCoin(out) : std::nullopt;
+    if (!coin)
+        return cacheCoins.end();
+    it = cacheCoins.emplace(out, CoinsCacheEntry{std::move(*coin), false, 0}).first;
+    cachedUsage += EntryUsage(it->second);
+    return it;
+}
+
+std::optional<Coin> CoinsViewCache::GetCoin(const OutPoint& out) const
+{
+    auto it = FetchCoin(out);
+    if (it == cacheCoins.end() || it->second.spent)
+        return std::nullopt;
+    std::optional<Coin> coin = it->second.coin;
+    if (DynamicUsage() > maxBytes)
+        Trim();
+    return coin;
+}
+
+bool CoinsViewCache::HaveCoin(const OutPoint& out) const
+{
+    auto it = FetchCoin(out);
+    const bool have = it != cacheCoins.end() && !it->second.spent;
+    if (DynamicUsage() > maxBytes)
+        Trim();
+    return have;
+}
+
+void CoinsViewCache::MarkDirty(CoinsMap::iterator it)
+{
+    if (it->second.flags & CoinsCacheEntry::DIRTY)
+        return;
+    it->second.flags |= CoinsCacheEntry::DIRTY;
+    ++dirtyCount;
+    dirtyKeys.push_back(it->first);
+}
+
+CoinsMap::iterator CoinsViewCache::EraseEntry(CoinsMap::iterator it) const
+{
+    cachedUsage -= EntryUsage(it->second);
+    if (it->second.flags & CoinsCacheEntry::DIRTY)
+        --dirtyCount;
+    return cacheCoins.erase(it);
+}
+
+void CoinsViewCache::AddCoin(const OutPoint& out, Coin coin, bool possibleOverwrite)
+{
+    auto [it, inserted] = cacheCoins.try_emplace(out);
+    bool fresh = false;
+    if (inserted) {
+        fresh = !possibleOverwrite;
+    } else {
+        if (!possibleOverwrite && !it->second.spent)
+            throw std::logic_error("attempted to overwrite an unspent coin");
+        // A spent entry that is not DIRTY never reached the parent, so the
+        // parent cannot hold this outpoint either.
+        fresh = it->second.spent && !(it->second.flags & CoinsCacheEntry::DIRTY);
+        cachedUsage -= EntryUsage(it->second);
+    }
+    it->second.coin = std::move(coin);
+    it->second.spent = false;
+    if (fresh)
+        it->second.flags |= CoinsCacheEntry::FRESH;
+    MarkDirty(it);
+    cachedUsage += EntryUsage(it->second);
+}
+
+bool CoinsViewCache::SpendCoin(const OutPoint& out, Coin* moveTo)
+{
+    auto it = FetchCoin(out);
+    if (it == cacheCoins.end() || it->second.spent)
+        return false;
+    if (moveTo)
+        *moveTo = std::move(it->second.coin);
+    if (it->second.flags & CoinsCacheEntry::FRESH) {
+        EraseEntry(it);
+        return true;
+    }
+    cachedUsage -= EntryUsage(it->second);
+    it->second.coin = Coin{};
+    it->second.spent = true;
+    MarkDirty(it);
+    cachedUsage += EntryUsage(it->second);
+    return true;
+}
+
+uint256 CoinsViewCache::GetBestBlock() const
+{
+    if (!hashBlock)
+        hashBlock = base ? base->GetBestBlock() : uint256{};
+    return *hashBlock;
+}
+
+void CoinsViewCache::SetBestBlock(const uint256& hash)
+{
+    hashBlock = hash;
+    bestBlockDirty = true;
+}
+
+void CoinsViewCache::BatchWrite(const CoinsMap& changes, const uint256& bestBlock)
+{
+    if (bestBlock != uint256{})
+        SetBestBlock(bestBlock);
+    for (const auto& change : changes) {
+        const auto& child = change.second;
+        if (!(child.flags & CoinsCacheEntry::DIRTY))
+            continue;
+        auto it = cacheCoins.find(change.first);
+        if (it == cacheCoins.end()) {
+            // Created and spent entirely in the child layer: nothing to record.
+            if ((child.flags & CoinsCacheEntry::FRESH) && child.spent)
+                continue;
+            it = cacheCoins.emplace(change.first, CoinsCacheEntry{child.coin, child.spent, 0}).first;
+            it->second.flags = child.flags & CoinsCacheEntry::FRESH;
+            cachedUsage += EntryUsage(it->second);
+            MarkDirty(it);
+            continue;
+        }
+        if ((child.flags & CoinsCacheEntry::FRESH) && !it->second.spent)
+            throw std::logic_error("FRESH flag misapplied to coin that exists in parent cache");
+        if ((it->second.flags & CoinsCacheEntry::FRESH) && child.spent) {
+            // The parent never pushed this coin further down either.
+            EraseEntry(it);
+            continue;
+        }
+        cachedUsage -= EntryUsage(it->second);
+        it->second.coin = child.coin;
+        it->second.spent = child.spent;
+        cachedUsage += EntryUsage(it->second);
+        MarkDirty(it);
+    }
+}
+
+void CoinsViewCache::Flush()
+{
+    if ((dirtyCount > 0 || bestBlockDirty) && base) {
+        CoinsMap changes;
+        changes.reserve(dirtyCount);
+        for (const auto& out : dirtyKeys) {
+            auto it = cacheCoins.find(out);
+            if (it == cacheCoins.end() || !(it->second.flags & CoinsCacheEntry::DIRTY))
+                continue;
+            changes.emplace(out, it->second);
+        }
+        base->BatchWrite(changes, GetBestBlock());
+        bestBlockDirty = false;
+        for (const auto& out : dirtyKeys) {
+            auto it = cacheCoins.find(out);
+            if (it == cacheCoins.end() || !(it->second.flags & CoinsCacheEntry::DIRTY))
+                continue;
+            if (it->second.spent) {
+                EraseEntry(it);
+            } else {
+                it->second.flags &= static_cast<uint8_t>(~(CoinsCacheEntry::DIRTY | CoinsCacheEntry::FRESH));
+                --dirtyCount;
+            }
+        }
+    }
+    dirtyKeys.clear();
+    Trim();
+}
+
+void CoinsViewCache::Trim() const
+{
+    if (DynamicUsage() <= maxBytes)
+        return;
+    // Evict down to a low watermark so a full cache does not sweep on every
+    // miss. Entries touched since the previous sweep get a second chance.
+    const std::size_t target = maxBytes - maxBytes / 10;
+    for (int pass = 0; pass < 2 && DynamicUsage() > target; ++pass) {
+        for (auto it = cacheCoins.begin(); it != cacheCoins.end() && DynamicUsage() > target;) {
+            auto& entry = it->second;
+            if (entry.flags & CoinsCacheEntry::DIRTY) {
+                ++it;
+                continue;
+            }
+            if (pass == 0 && (entry.flags & CoinsCacheEntry::REFERENCED)) {
+                entry.flags &= static_cast<uint8_t>(~CoinsCacheEntry::REFERENCED);
+                ++it;
+                continue;
+            }
+            it = EraseEntry(it);
+        }
+    }
+}
+
+CoinsCacheStats CoinsViewCache::Stats() const
+{
+    CoinsCacheStats stats;
+    stats.entries = cacheCoins.size();
+    stats.usageBytes = DynamicUsage();
+    stats.maxBytes = maxBytes;
+    stats.hits = hits;
+    stats.misses = misses;
+    return stats;
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "../crypto/tagged_hash.h"
+#include "../tx/transaction.h"
+#include "coin.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef DRACHMA_HAVE_LEVELDB
+#include <leveldb/db.h>
+#endif
+
+struct OutPointHash {
+    std::size_t operator()(const OutPoint& o) const noexcept;
+};
+struct OutPointEq {
+    bool operator()(const OutPoint& a, const OutPoint& b) const noexcept;
+};
+
+// A coin as tracked by a cache layer. DIRTY entries differ from the parent
+// view and must be written on flush. FRESH entries are known to be absent
+// from the parent, so spending them can simply drop the entry without ever
+// touching the layer below.
+struct CoinsCacheEntry {
+    enum Flags : uint8_t {
+        DIRTY = 1 << 0,
+        FRESH = 1 << 1,
+        REFERENCED = 1 << 2, // second-chance bit used by the eviction sweep
+    };
+
+    Coin coin{};
+    bool spent{false};
+    uint8_t flags{0};
+};
+
+using CoinsMap = std::unordered_map<OutPoint, CoinsCacheEntry, OutPointHash, OutPointEq>;
+
+struct CoinsCacheStats {
+    std::size_t entries{0};
+    std::size_t usageBytes{0};
+    std::size_t maxBytes{0};
+    uint64_t hits{0};
+    uint64_t misses{0};
+};
+
+// Forward iterator over a backend's coins in outpoint order: txid bytes,
+// then numeric output index. A cursor reads the set as it was when it was
+// created; later writes to the view do not show up in it.
+class CoinsCursor {
+public:
+    virtual ~CoinsCursor() = default;
+
+    virtual bool Valid() const = 0;
+    virtual void Next() = 0;
+    virtual const OutPoint& Key() const = 0;
+    virtual const Coin& Value() const = 0;
+};
+
+// Abstract read/write view of the UTXO set. Views can be layered: a cache
+// sits on top of a backend (or another cache) and pushes its modifications
+// down with BatchWrite.
+class CoinsView {
+public:
+    virtual ~CoinsView() = default;
+
+    virtual std::optional<Coin> GetCoin(const OutPoint& out) const = 0;
+    virtual bool HaveCoin(const OutPoint& out) const { return GetCoin(out).has_value(); }
+
+    // Hash of the block this view's coins correspond to (all zero if unknown).
+    virtual uint256 GetBestBlock() const { return uint256{}; }
+
+    // Apply a set of modified entries together with the new best block. Only
+    // DIRTY entries are considered; spent entries are erased from this view.
+    virtual void BatchWrite(const CoinsMap& changes, const uint256& bestBlock) = 0;
+
+    // Make previously written batches durable.
+    virtual void Sync() {}
+
+    // Opaque statistics about the coin set, kept next to the best block.
+    // A blob passed to SetStats is stored by the next BatchWrite.
+    virtual std::optional<std::string> GetStats() const { return std::nullopt; }
+    virtual void SetStats(std::string) {}
+
+    // Visit every coin held by this view, in no particular order. Only
+    // backends hold a complete set; caches do not support iteration.
+    using CoinVisitor = std::function<void(const OutPoint&, const Coin&)>;
+    virtual void ForEachCoin(const CoinVisitor& visit) const;
+
+    // Sorted, point-in-time iteration over a backend (see CoinsCursor).
+    virtual std::unique_ptr<CoinsCursor> Cursor() const;
+};
+
+// Blocks bracketing a flush that did not complete: coins may reflect any
+// mix of the two states, so blocks from `from` to `to` must be re-applied.
+struct CoinsReplayRange {
+    uint256 from{};
+    uint256 to{};
+};
+
+#ifdef DRACHMA_HAVE_LEVELDB
+// LevelDB-backed coin storage keyed by [txid(32)][index(4)], with values in
+// the compact Coin encoding. Databases written with the old
+// [asset][value][script] values are rewritten on open.
+//
+// Flushes are written without fsync in chunks of at most batchChunkBytes.
+// When a flush needs more than one chunk, a head-blocks marker ('H' =
+// [new best][old best]) is written first. The last chunk removes it and
+// records the new best block ('B'), and only that last chunk is synced. If
+// the marker is still there at startup, the flush was interrupted.
+class CoinsViewDB : public CoinsView {
+public:
+    static constexpr std::size_t kDefaultBatchChunkBytes = 16 * 1024 * 1024;
+
+    explicit CoinsViewDB(const std::string& path, std::size_t batchChunkBytes = kDefaultBatchChunkBytes);
+
+    bool IsOpen() const { return static_cast<bool>(db); }
+
+    std::optional<Coin> GetCoin(const OutPoint& out) const override;
+    uint256 GetBestBlock() const override;
+    void BatchWrite(const CoinsMap& changes, const uint256& bestBlock) override;
+
+    void ForEachCoin(const CoinVisitor& visit) const override;
+    std::unique_ptr<CoinsCursor> Cursor() const override;
+    std::optional<std::string> GetStats() const override;
+    void SetStats(std::string blob) override { pendingStats = std::move(blob); }
+
+    std::optional<CoinsReplayRange> GetHeadBlocks() const;
+
+private:
+    std::unique_ptr<leveldb::DB> db;
+    std::size_t batchChunkBytes;
+    std::optional<std::string> pendingStats;
+
+    void UpgradeLegacyValues();
+};
+#endif
+
+// Flat-file coin storage used when LevelDB is unavailable. The whole set is
+// kept in memory and rewritten on Sync as a versioned file of compact coins
+// followed by the best block hash and the stats blob ([u32 size][bytes]);
+// legacy count-prefixed files still load. The file is replaced by rename
+// so a crash leaves either the old or the new set.
+class CoinsViewFile : public CoinsView {
+public:
+    explicit CoinsViewFile(const std::string& path);
+
+    std::optional<Coin> GetCoin(const OutPoint& out) const override;
+    uint256 GetBestBlock() const override { return bestBlock; }
+    void BatchWrite(const CoinsMap& changes, const uint256& bestBlock) override;
+    void Sync() override;
+    void ForEachCoin(const CoinVisitor& visit) const override;
+    // Takes a sorted copy: the set is in memory and may change under the
+    // cursor.
+    std::unique_ptr<CoinsCursor> Cursor() const override;
+    std::optional<std::string> GetStats() const override;
+    void SetStats(std::string blob) override { pendingStats = std::move(blob); }
+
+private:
+    std::string path;
+    std::unordered_map<OutPoint, Coin, OutPointHash, OutPointEq> coins;
+    uint256 bestBlock{};
+    std::string stats;
+    std::optional<std::string> pendingStats;
+};
+
+// Memory-bounded write-back cache over another view. Not thread-safe; the
+// owning Chainstate serializes access.
+class CoinsViewCache : public CoinsView {
+public:
+    explicit CoinsViewCache(CoinsView* base, std::size_t maxBytes = std::numeric_limits<std::size_t>::max());
+
+    std::optional<Coin> GetCoin(const OutPoint& out) const override;
+    bool HaveCoin(const OutPoint& out) const override;
+    uint256 GetBestBlock() const override;
+    void BatchWrite(const CoinsMap& changes, const uint256& bestBlock) override;
+
+    void SetBestBlock(const uint256& hash);
+
+    // Insert a coin. possibleOverwrite must be true unless the caller knows
+    // the outpoint cannot already exist in a lower layer; only then can the
+    // entry be marked FRESH.
+    void AddCoin(const OutPoint& out, Coin coin, bool possibleOverwrite = true);
+    // Returns false when the coin does not exist in any layer.
+    bool SpendCoin(const OutPoint& out, Coin* moveTo = nullptr);
+
+    // Push every DIRTY entry and the best block to the base view and mark
+    // the entries clean.
+    void Flush();
+    // Evict clean entries until the cache fits its memory budget.
+    void Trim() const;
+
+    std::size_t Entries() const { return cacheCoins.size(); }
+    std::size_t DirtyEntries() const { return dirtyCount; }
+    std::size_t DynamicUsage() const;
+    CoinsCacheStats Stats() const;
+
+private:
+    CoinsView* base;
+    std::size_t maxBytes;
+    mutable std::optional<uint256> hashBlock;
+    bool bestBlockDirty{false};
+    mutable CoinsMap cacheCoins;
+    mutable std::size_t cachedUsage{0};
+    mutable uint64_t hits{0};
+    mutable uint64_t misses{0};
+    mutable std::size_t dirtyCount{0};
+    // Outpoints that became DIRTY since the last flush, so flushing costs
+    // O(changes) rather than a walk over the whole cache.
+    std::vector<OutPoint> dirtyKeys;
+
+    CoinsMap::iterator FetchCoin(const OutPoint& out) const;
+    void MarkDirty(CoinsMap::iterator it);
+    CoinsMap::iterator EraseEntry(CoinsMap::iterator it) const;
+    static std::size_t EntryUsage(const CoinsCacheEntry& entry);
+};
@@ -0,0 +1,320 @@
+#include "snapshot.h"
+#include "utxo_stats.h"
+#include <openssl/sha.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr char kSnapshotMagic[8] = {'D', 'R', 'M', 'U', 'T', 'X', 'O', '\0'};
+
+// Header field offsets.
+constexpr std::size_t kVersionOffset = 8;
+constexpr std::size_t kRecordSizeOffset = 12;
+constexpr std::size_t kBaseBlockOffset = 16;
+constexpr std::size_t kCountOffset = 48;
+constexpr std::size_t kOverflowOffset = 56;
+constexpr std::size_t kContentHashOffset = 64;
+constexpr std::size_t kSetHashOffset = 96;
+
+// Record field offsets.
+constexpr std::size_t kIndexOffset = 32;
+constexpr std::size_t kHeightOffset = 36;
+constexpr std::size_t kValueOffset = 40;
+constexpr std::size_t kAssetOffset = 48;
+constexpr std::size_t kScriptSizeOffset = 52;
+constexpr std::size_t kScriptOffset = 56;
+
+static_assert(kScriptOffset + Coin::kInlineScriptSize == kSnapshotRecordSize, "record layout");
+
+void PutLE(uint8_t* out, uint64_t v, std::size_t bytes)
+{
+    for (std::size_t i = 0; i < bytes; ++i)
+        out[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+uint64_t GetLE(const uint8_t* in, std::size_t bytes)
+{
+    uint64_t v = 0;
+    for (std::size_t i = 0; i < bytes; ++i)
+        v |= static_cast<uint64_t>(in[i]) << (8 * i);
+    return v;
+}
+
+int CompareOutPoint(const OutPoint& a, const OutPoint& b)
+{
+    if (int c = std::memcmp(a.hash.data(), b.hash.data(), a.hash.size()))
+        return c;
+    return a.index < b.index ? -1 : (a.index > b.index ? 1 : 0);
+}
+
+OutPoint RecordOutPoint(const uint8_t* rec)
+{
+    OutPoint out{};
+    std::memcpy(out.hash.data(), rec, out.hash.size());
+    out.index = static_cast<uint32_t>(GetLE(rec + kIndexOffset, 4));
+    return out;
+}
+
+int CompareRecord(const uint8_t* rec, const OutPoint& out)
+{
+    if (int c = std::memcmp(rec, out.hash.data(), out.hash.size()))
+        return c;
+    const auto index = static_cast<uint32_t>(GetLE(rec + kIndexOffset, 4));
+    return index < out.index ? -1 : (index > out.index ? 1 : 0);
+}
+} // namespace
+
+UtxoSnapshotWriter::UtxoSnapshotWriter(const std::string& path_, const uint256& baseBlock)
+    : path(path_), tmpPath(path_ + ".tmp"), overflowPath(path_ + ".overflow.tmp")
+{
+    meta.baseBlock = baseBlock;
+    records.open(tmpPath, std::ios::binary | std::ios::trunc);
+    overflow.open(overflowPath, std::ios::binary | std::ios::trunc);
+    // The header is filled in by Finish once the counts and hashes are known.
+    const uint8_t header[kSnapshotHeaderSize] = {};
+    records.write(reinterpret_cast<const char*>(header), sizeof(header));
+    if (!records || !overflow)
+        throw std::runtime_error("failed to write utxo snapshot");
+    SHA256_Init(&content);
+}
+
+UtxoSnapshotWriter::~UtxoSnapshotWriter()
+{
+    if (finished)
+        return;
+    records.close();
+    overflow.close();
+    std::remove(tmpPath.c_str());
+    std::remove(overflowPath.c_str());
+}
+
+void UtxoSnapshotWriter::Add(const OutPoint& out, const Coin& coin)
+{
+    if (finished)
+        throw std::logic_error("utxo snapshot already finished");
+    if (meta.coinCount > 0) {
+        const int c = CompareOutPoint(last, out);
+        if (c == 0)
+            throw std::runtime_error("duplicate outpoint in utxo snapshot");
+        if (c > 0)
+            throw std::runtime_error("utxo snapshot coins are not sorted");
+    }
+    last = out;
+    ++meta.coinCount;
+    stats.AddCoin(out, coin);
+
+    uint8_t rec[kSnapshotRecordSize] = {};
+    std::memcpy(rec, out.hash.data(), out.hash.size());
+    PutLE(rec + kIndexOffset, out.index, 4);
+    PutLE(rec + kHeightOffset, (static_cast<uint64_t>(coin.Height()) << 1) | (coin.IsCoinBase() ? 1 : 0), 4);
+    PutLE(rec + kValueOffset, coin.Value(), 8);
+    rec[kAssetOffset] = coin.Asset();
+    PutLE(rec + kScriptSizeOffset, coin.ScriptSize(), 4);
+    if (coin.ScriptSize() <= Coin::kInlineScriptSize) {
+        std::memcpy(rec + kScriptOffset, coin.ScriptData(), coin.ScriptSize());
+    } else {
+        PutLE(rec + kScriptOffset, overflowBytes, 8);
+        overflow.write(reinterpret_cast<const char*>(coin.ScriptData()), coin.ScriptSize());
+        overflowBytes += coin.ScriptSize();
+    }
+    SHA256_Update(&content, rec, sizeof(rec));
+    records.write(reinterpret_cast<const char*>(rec), sizeof(rec));
+    if (!records || !overflow)
+        throw std::runtime_error("failed to write utxo snapshot");
+}
+
+SnapshotMetadata UtxoSnapshotWriter::Finish()
+{
+    if (finished)
+        throw std::logic_error("utxo snapshot already finished");
+    overflow.close();
+    if (!overflow)
+        throw std::runtime_error("failed to write utxo snapshot");
+
+    // The overflow area follows the records and is covered by the same hash.
+    std::ifstream in(overflowPath, std::ios::binary);
+    char buf[64 * 1024];
+    while (in) {
+        in.read(buf, sizeof(buf));
+        const auto got = static_cast<std::size_t>(in.gcount());
+        SHA256_Update(&content, buf, got);
+        records.write(buf, got);
+    }
+    if (!in.eof())
+        throw std::runtime_error("failed to write utxo snapshot");
+    in.close();
+
+    meta.setHash = stats.SetHash();
+    SHA256_Final(meta.contentHash.data(), &content);
+
+    uint8_t header[kSnapshotHeaderSize] = {};
+    std::memcpy(header, kSnapshotMagic, sizeof(kSnapshotMagic));
+    PutLE(header + kVersionOffset, kSnapshotVersion, 4);
+    PutLE(header + kRecordSizeOffset, kSnapshotRecordSize, 4);
+    std::memcpy(header + kBaseBlockOffset, meta.baseBlock.data(), meta.baseBlock.size());
+    PutLE(header + kCountOffset, meta.coinCount, 8);
+    PutLE(header + kOverflowOffset, overflowBytes, 8);
+    std::memcpy(header + kContentHashOffset, meta.contentHash.data(), meta.contentHash.size());
+    std::memcpy(header + kSetHashOffset, meta.setHash.data(), meta.setHash.size());
+    records.seekp(0);
+    records.write(reinterpret_cast<const char*>(header), sizeof(header));
+    records.close();
+    if (!records || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("failed to write utxo snapshot");
+    finished = true;
+    std::remove(overflowPath.c_str());
+    return meta;
+}
+
+SnapshotMetadata WriteUtxoSnapshot(const std::string& path, const uint256& baseBlock,
+                                   std::vector<std::pair<OutPoint, Coin>> coins)
+{
+    std::sort(coins.begin(), coins.end(), [](const auto& a, const auto& b) {
+        return CompareOutPoint(a.first, b.first) < 0;
+    });
+    UtxoSnapshotWriter writer(path, baseBlock);
+    for (const auto& entry : coins)
+        writer.Add(entry.first, entry.second);
+    return writer.Finish();
+}
+
+UtxoSnapshot::UtxoSnapshot(const std::string& path)
+{
+#ifndef _WIN32
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("cannot open utxo snapshot");
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(kSnapshotHeaderSize)) {
+        ::close(fd);
+        throw std::runtime_error("truncated utxo snapshot");
+    }
+    size = static_cast<std::size_t>(st.st_size);
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        throw std::runtime_error("cannot map utxo snapshot");
+    data = static_cast<const uint8_t*>(map);
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in.good())
+        throw std::runtime_error("cannot open utxo snapshot");
+    buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    data = buffer.data();
+    size = buffer.size();
+#endif
+
+    try {
+        if (size < kSnapshotHeaderSize || std::memcmp(data, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0)
+            throw std::runtime_error("not a utxo snapshot");
+        if (GetLE(data + kVersionOffset, 4) != kSnapshotVersion ||
+            GetLE(data + kRecordSizeOffset, 4) != kSnapshotRecordSize)
+            throw std::runtime_error("unsupported utxo snapshot version");
+        std::memcpy(meta.baseBlock.data(), data + kBaseBlockOffset, meta.baseBlock.size());
+        meta.coinCount = GetLE(data + kCountOffset, 8);
+        overflowBytes = GetLE(data + kOverflowOffset, 8);
+        std::memcpy(meta.contentHash.data(), data + kContentHashOffset, meta.contentHash.size());
+        std::memcpy(meta.setHash.data(), data + kSetHashOffset, meta.setHash.size());
+
+        const std::size_t body = size - kSnapshotHeaderSize;
+        if (meta.coinCount > body / kSnapshotRecordSize ||
+            body - meta.coinCount * kSnapshotRecordSize != overflowBytes)
+            throw std::runtime_error("truncated utxo snapshot");
+
+        uint256 hash{};
+        SHA256(data + kSnapshotHeaderSize, body, hash.data());
+        if (hash != meta.contentHash)
+            throw std::runtime_error("utxo snapshot content hash mismatch");
+
+        for (std::size_t i = 0; i < Size(); ++i) {
+            const uint8_t* rec = Record(i);
+            if (i > 0 && CompareRecord(Record(i - 1), RecordOutPoint(rec)) >= 0)
+                throw std::runtime_error("utxo snapshot is not sorted");
+            const uint64_t scriptSize = GetLE(rec + kScriptSizeOffset, 4);
+            if (scriptSize > Coin::kMaxScriptSize)
+                throw std::runtime_error("corrupt utxo snapshot record");
+            if (scriptSize > Coin::kInlineScriptSize) {
+                const uint64_t offset = GetLE(rec + kScriptOffset, 8);
+                if (offset > overflowBytes || scriptSize > overflowBytes - offset)
+                    throw std::runtime_error("corrupt utxo snapshot record");
+            }
+        }
+    } catch (...) {
+#ifndef _WIN32
+        ::munmap(const_cast<uint8_t*>(data), size);
+#endif
+        throw;
+    }
+}
+
+UtxoSnapshot::~UtxoSnapshot()
+{
+#ifndef _WIN32
+    if (data)
+        ::munmap(const_cast<uint8_t*>(data), size);
+#endif
+}
+
+const uint8_t* UtxoSnapshot::Record(std::size_t i) const
+{
+    return data + kSnapshotHeaderSize + i * kSnapshotRecordSize;
+}
+
+Coin UtxoSnapshot::DecodeRecord(const uint8_t* rec) const
+{
+    const auto heightCode = static_cast<uint32_t>(GetLE(rec + kHeightOffset, 4));
+    const auto scriptSize = static_cast<std::size_t>(GetLE(rec + kScriptSizeOffset, 4));
+    const uint8_t* script = rec + kScriptOffset;
+    if (scriptSize > Coin::kInlineScriptSize)
+        script = Record(Size()) + GetLE(rec + kScriptOffset, 8);
+    return Coin(GetLE(rec + kValueOffset, 8), rec[kAssetOffset], script, scriptSize,
+                heightCode >> 1, (heightCode & 1) != 0);
+}
+
+std::pair<OutPoint, Coin> UtxoSnapshot::At(std::size_t i) const
+{
+    if (i >= Size())
+        throw std::out_of_range("utxo snapshot index out of range");
+    const uint8_t* rec = Record(i);
+    return {RecordOutPoint(rec), DecodeRecord(rec)};
+}
+
+std::optional<Coin> UtxoSnapshot::GetCoin(const OutPoint& out) const
+{
+    std::size_t lo = 0;
+    std::size_t hi = Size();
+    while (lo < hi) {
+        const std::size_t mid = lo + (hi - lo) / 2;
+        const int c = CompareRecord(Record(mid), out);
+        if (c == 0)
+            return DecodeRecord(Record(mid));
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return std::nullopt;
+}
+
+void UtxoSnapshot::BatchWrite(const CoinsMap&, const uint256&)
+{
+    throw std::logic_error("utxo snapshot is read-only");
+}
+
+void UtxoSnapshot::ForEachCoin(const CoinVisitor& visit) const
+{
+    for (std::size_t i = 0; i < Size(); ++i) {
+        auto entry = At(i);
+        visit(entry.first, entry.second);
+    }
+}
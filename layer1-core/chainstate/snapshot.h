@@ -0,0 +1,108 @@
+#pragma once
+
+#include "../crypto/tagged_hash.h"
+#include "../tx/transaction.h"
+#include "coin.h"
+#include "coins_view.h"
+#include "utxo_stats.h"
+#include <openssl/sha.h>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Flat UTXO snapshot used by dumptxoutset/loadtxoutset.
+//
+// Layout (all integers little-endian):
+//   header  [magic(8)][version(4)][record size(4)][base block(32)]
+//           [coin count(8)][overflow bytes(8)][content hash(32)]
+//           [set hash(32)]
+//   records coin count fixed-stride records sorted by (txid, index)
+//   overflow scripts longer than Coin::kInlineScriptSize, back to back
+//
+// A record is [txid(32)][index(4)][height << 1 | coinbase(4)][value(8)]
+// [asset(1)][pad(3)][script size(4)][script(32)]. Short scripts are stored
+// inline; longer ones hold an 8-byte offset into the overflow area. The
+// fixed stride lets a mapped snapshot be binary-searched in place. The
+// content hash is SHA-256 over the record and overflow areas; the set hash
+// is the MuHash of the coins (see utxo_stats.h), which a node tracking its
+// UTXO set can compare without a rescan.
+constexpr std::size_t kSnapshotHeaderSize = 128;
+constexpr std::size_t kSnapshotRecordSize = 88;
+constexpr uint32_t kSnapshotVersion = 1;
+
+struct SnapshotMetadata {
+    uint256 baseBlock{};
+    uint64_t coinCount{0};
+    uint256 contentHash{};
+    uint256 setHash{};
+};
+
+// Streams coins into a snapshot of the chain at baseBlock without holding
+// the set in memory. Coins must be added in strictly increasing outpoint
+// order (txid bytes, then index), as a CoinsCursor yields them. Records go
+// straight to a temporary file and long scripts to a side file that Finish
+// appends; Finish then fills in the header and renames the snapshot into
+// place. Temporary files are removed if the writer is dropped unfinished.
+// Throws std::runtime_error on disorder, duplicates or I/O failure.
+class UtxoSnapshotWriter {
+public:
+    UtxoSnapshotWriter(const std::string& path, const uint256& baseBlock);
+    ~UtxoSnapshotWriter();
+    UtxoSnapshotWriter(const UtxoSnapshotWriter&) = delete;
+    UtxoSnapshotWriter& operator=(const UtxoSnapshotWriter&) = delete;
+
+    void Add(const OutPoint& out, const Coin& coin);
+    SnapshotMetadata Finish();
+
+private:
+    std::string path;
+    std::string tmpPath;
+    std::string overflowPath;
+    std::ofstream records;
+    std::ofstream overflow;
+    uint64_t overflowBytes{0};
+    SnapshotMetadata meta;
+    OutPoint last{};
+    UtxoStatsTracker stats;
+    SHA256_CTX content{};
+    bool finished{false};
+};
+
+// Write coins, in any order, as a snapshot of the chain at baseBlock.
+SnapshotMetadata WriteUtxoSnapshot(const std::string& path, const uint256& baseBlock,
+                                   std::vector<std::pair<OutPoint, Coin>> coins);
+
+// Read-only view over a memory-mapped snapshot. The constructor checks the
+// header and the content hash and throws std::runtime_error if either is
+// wrong; lookups then read straight from the mapping.
+class UtxoSnapshot : public CoinsView {
+public:
+    explicit UtxoSnapshot(const std::string& path);
+    ~UtxoSnapshot() override;
+    UtxoSnapshot(const UtxoSnapshot&) = delete;
+    UtxoSnapshot& operator=(const UtxoSnapshot&) = delete;
+
+    const SnapshotMetadata& Metadata() const { return meta; }
+    std::size_t Size() const { return static_cast<std::size_t>(meta.coinCount); }
+    // Decode the i-th record in sort order.
+    std::pair<OutPoint, Coin> At(std::size_t i) const;
+
+    std::optional<Coin> GetCoin(const OutPoint& out) const override;
+    uint256 GetBestBlock() const override { return meta.baseBlock; }
+    void BatchWrite(const CoinsMap& changes, const uint256& bestBlock) override;
+    void ForEachCoin(const CoinVisitor& visit) const override;
+
+private:
+    const uint8_t* data{nullptr};
+    std::size_t size{0};
+    std::vector<uint8_t> buffer; // used where mmap is unavailable
+    SnapshotMetadata meta;
+    uint64_t overflowBytes{0};
+
+    const uint8_t* Record(std::size_t i) const;
+    Coin DecodeRecord(const uint8_t* rec) const;
+};
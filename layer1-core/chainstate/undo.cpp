@@ -0,0 +1,59 @@
+#include "undo.h"
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+std::vector<uint8_t> SerializeBlockUndo(const BlockUndo& undo)
+{
+    std::vector<uint8_t> out;
+    out.reserve(sizeof(uint32_t) + undo.spent.size() * 84);
+    auto append = [&out](const void* p, size_t n) {
+        const auto* b = static_cast<const uint8_t*>(p);
+        out.insert(out.end(), b, b + n);
+    };
+    const uint32_t count = static_cast<uint32_t>(undo.spent.size());
+    append(&count, sizeof(count));
+    std::string coin;
+    for (const auto& entry : undo.spent) {
+        coin.clear();
+        EncodeCoin(entry.coin, coin);
+        const uint32_t size = static_cast<uint32_t>(coin.size());
+        append(entry.prevout.hash.data(), entry.prevout.hash.size());
+        append(&entry.prevout.index, sizeof(entry.prevout.index));
+        append(&size, sizeof(size));
+        append(coin.data(), coin.size());
+    }
+    return out;
+}
+
+BlockUndo DeserializeBlockUndo(const std::vector<uint8_t>& data)
+{
+    size_t offset = 0;
+    auto read = [&](void* p, size_t n) {
+        if (offset + n > data.size())
+            throw std::runtime_error("truncated undo data");
+        std::memcpy(p, data.data() + offset, n);
+        offset += n;
+    };
+    BlockUndo undo;
+    uint32_t count = 0;
+    read(&count, sizeof(count));
+    // Each entry needs at least the outpoint and a size field.
+    if (count > (data.size() - offset) / (32 + 2 * sizeof(uint32_t)))
+        throw std::runtime_error("undo entry count exceeds data");
+    undo.spent.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        UndoEntry entry;
+        read(entry.prevout.hash.data(), entry.prevout.hash.size());
+        read(&entry.prevout.index, sizeof(entry.prevout.index));
+        uint32_t size = 0;
+        read(&size, sizeof(size));
+        if (offset + size > data.size() || !DecodeCoin(data.data() + offset, size, entry.coin))
+            throw std::runtime_error("corrupt undo coin");
+        offset += size;
+        undo.spent.push_back(std::move(entry));
+    }
+    if (offset != data.size())
+        throw std::runtime_error("trailing bytes in undo data");
+    return undo;
+}
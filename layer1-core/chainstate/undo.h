@@ -1,13 +1,20 @@
 #pragma once
+#include <cstdint>
 #include <vector>
-#include <string>
-#include "utxo.h"
+#include "coin.h"
 
+// A coin consumed by a connected block, kept so the spend can be reversed.
 struct UndoEntry {
-    OutPointKey key;
-    UTXO utxo;
+    OutPoint prevout{};
+    Coin coin{};
 };
 
+// Undo data for one block: every coin it spent, in the order the inputs were
+// applied. DisconnectBlock walks the list backwards.
 struct BlockUndo {
     std::vector<UndoEntry> spent;
 };
+
+// Layout: [u32 count] then per entry [txid(32)][index(4)][u32 size][coin].
+std::vector<uint8_t> SerializeBlockUndo(const BlockUndo& undo);
+BlockUndo DeserializeBlockUndo(const std::vector<uint8_t>& data);
@@ -0,0 +1,237 @@
+#include "utxo_stats.h"
+#include <openssl/sha.h>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint8_t kStatsVersion = 1;
+
+const BIGNUM* Modulus()
+{
+    static const BIGNUM* p = [] {
+        BIGNUM* m = BN_new();
+        BIGNUM* offset = BN_new();
+        if (!m || !offset || !BN_set_bit(m, 3072) || !BN_set_word(offset, 1103717) || !BN_sub(m, m, offset))
+            throw std::runtime_error("muhash modulus setup failed");
+        BN_free(offset);
+        return m;
+    }();
+    return p;
+}
+
+BN_CTX* ThreadContext()
+{
+    // BN_CTX is scratch space and must not be shared between threads.
+    thread_local struct Holder {
+        BN_CTX* ctx{BN_CTX_new()};
+        ~Holder() { BN_CTX_free(ctx); }
+    } holder;
+    if (!holder.ctx)
+        throw std::runtime_error("BN_CTX_new failed");
+    return holder.ctx;
+}
+
+BIGNUM* NewOne()
+{
+    BIGNUM* bn = BN_new();
+    if (!bn || !BN_one(bn))
+        throw std::runtime_error("BN_new failed");
+    return bn;
+}
+
+// Expand SHA-256(data) into a 3072-bit residue with SHA-256 in counter mode.
+BIGNUM* ToResidue(const uint8_t* data, std::size_t size)
+{
+    uint8_t seed[SHA256_DIGEST_LENGTH + 1];
+    SHA256(data, size, seed);
+    uint8_t wide[MuHash3072::kBytes];
+    for (std::size_t i = 0; i < MuHash3072::kBytes / SHA256_DIGEST_LENGTH; ++i) {
+        seed[SHA256_DIGEST_LENGTH] = static_cast<uint8_t>(i);
+        SHA256(seed, sizeof(seed), wide + i * SHA256_DIGEST_LENGTH);
+    }
+    BIGNUM* bn = BN_lebin2bn(wide, sizeof(wide), nullptr);
+    if (!bn || !BN_nnmod(bn, bn, Modulus(), ThreadContext()))
+        throw std::runtime_error("muhash element mapping failed");
+    return bn;
+}
+
+void MulInto(BIGNUM* acc, const BIGNUM* factor)
+{
+    if (!BN_mod_mul(acc, acc, factor, Modulus(), ThreadContext()))
+        throw std::runtime_error("muhash multiplication failed");
+}
+
+void PutLE(std::string& out, uint64_t v, std::size_t bytes)
+{
+    for (std::size_t i = 0; i < bytes; ++i)
+        out.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+uint64_t GetLE(const uint8_t* in, std::size_t bytes)
+{
+    uint64_t v = 0;
+    for (std::size_t i = 0; i < bytes; ++i)
+        v |= static_cast<uint64_t>(in[i]) << (8 * i);
+    return v;
+}
+
+} // namespace
+
+MuHash3072::MuHash3072() : num(NewOne()), den(NewOne()) {}
+
+MuHash3072::MuHash3072(const MuHash3072& other) : num(BN_dup(other.num)), den(BN_dup(other.den))
+{
+    if (!num || !den)
+        throw std::runtime_error("BN_dup failed");
+}
+
+MuHash3072& MuHash3072::operator=(const MuHash3072& other)
+{
+    if (this != &other && (!BN_copy(num, other.num) || !BN_copy(den, other.den)))
+        throw std::runtime_error("BN_copy failed");
+    return *this;
+}
+
+MuHash3072::~MuHash3072()
+{
+    BN_free(num);
+    BN_free(den);
+}
+
+void MuHash3072::Insert(const uint8_t* data, std::size_t size)
+{
+    BIGNUM* e = ToResidue(data, size);
+    MulInto(num, e);
+    BN_free(e);
+}
+
+void MuHash3072::Remove(const uint8_t* data, std::size_t size)
+{
+    BIGNUM* e = ToResidue(data, size);
+    MulInto(den, e);
+    BN_free(e);
+}
+
+void MuHash3072::Combine(const MuHash3072& other)
+{
+    MulInto(num, other.num);
+    MulInto(den, other.den);
+}
+
+uint256 MuHash3072::Finalize() const
+{
+    BN_CTX* ctx = ThreadContext();
+    BIGNUM* r = BN_mod_inverse(nullptr, den, Modulus(), ctx);
+    if (!r || !BN_mod_mul(r, r, num, Modulus(), ctx)) {
+        BN_free(r);
+        throw std::runtime_error("muhash finalize failed");
+    }
+    uint8_t bytes[kBytes];
+    BN_bn2lebinpad(r, bytes, sizeof(bytes));
+    BN_free(r);
+    uint256 out{};
+    SHA256(bytes, sizeof(bytes), out.data());
+    return out;
+}
+
+std::string MuHash3072::Serialize() const
+{
+    std::string out(2 * kBytes, '\0');
+    BN_bn2lebinpad(num, reinterpret_cast<uint8_t*>(&out[0]), kBytes);
+    BN_bn2lebinpad(den, reinterpret_cast<uint8_t*>(&out[kBytes]), kBytes);
+    return out;
+}
+
+bool MuHash3072::Deserialize(const uint8_t* data, std::size_t size)
+{
+    if (size != 2 * kBytes)
+        return false;
+    BIGNUM* n = BN_lebin2bn(data, kBytes, nullptr);
+    BIGNUM* d = BN_lebin2bn(data + kBytes, kBytes, nullptr);
+    const bool ok = n && d && !BN_is_zero(n) && !BN_is_zero(d) &&
+                    BN_cmp(n, Modulus()) < 0 && BN_cmp(d, Modulus()) < 0;
+    if (ok) {
+        std::swap(num, n);
+        std::swap(den, d);
+    }
+    BN_free(n);
+    BN_free(d);
+    return ok;
+}
+
+std::string SerializeCoinForHash(const OutPoint& out, const Coin& coin)
+{
+    std::string buf;
+    buf.reserve(53 + coin.ScriptSize());
+    buf.append(reinterpret_cast<const char*>(out.hash.data()), out.hash.size());
+    PutLE(buf, out.index, 4);
+    PutLE(buf, (static_cast<uint64_t>(coin.Height()) << 1) | (coin.IsCoinBase() ? 1 : 0), 4);
+    PutLE(buf, coin.Value(), 8);
+    buf.push_back(static_cast<char>(coin.Asset()));
+    PutLE(buf, coin.ScriptSize(), 4);
+    buf.append(reinterpret_cast<const char*>(coin.ScriptData()), coin.ScriptSize());
+    return buf;
+}
+
+void UtxoStatsTracker::AddCoin(const OutPoint& out, const Coin& coin)
+{
+    const auto bytes = SerializeCoinForHash(out, coin);
+    hash.Insert(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+    ++coins;
+    if (coin.Asset() < assets.size()) {
+        ++assets[coin.Asset()].coins;
+        assets[coin.Asset()].amount += coin.Value();
+    }
+}
+
+void UtxoStatsTracker::RemoveCoin(const OutPoint& out, const Coin& coin)
+{
+    const auto bytes = SerializeCoinForHash(out, coin);
+    hash.Remove(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+    --coins;
+    if (coin.Asset() < assets.size()) {
+        --assets[coin.Asset()].coins;
+        assets[coin.Asset()].amount -= coin.Value();
+    }
+}
+
+void UtxoStatsTracker::Merge(const UtxoStatsTracker& other)
+{
+    hash.Combine(other.hash);
+    coins += other.coins;
+    for (std::size_t i = 0; i < assets.size(); ++i) {
+        assets[i].coins += other.assets[i].coins;
+        assets[i].amount += other.assets[i].amount;
+    }
+}
+
+std::string UtxoStatsTracker::Serialize() const
+{
+    std::string out(1, static_cast<char>(kStatsVersion));
+    PutLE(out, coins, 8);
+    for (const auto& asset : assets) {
+        PutLE(out, asset.coins, 8);
+        PutLE(out, asset.amount, 8);
+    }
+    out += hash.Serialize();
+    return out;
+}
+
+bool UtxoStatsTracker::Deserialize(const std::string& data)
+{
+    const std::size_t fixed = 1 + 8 + assets.size() * 16;
+    if (data.size() != fixed + 2 * MuHash3072::kBytes || static_cast<uint8_t>(data[0]) != kStatsVersion)
+        return false;
+    const auto* p = reinterpret_cast<const uint8_t*>(data.data());
+    MuHash3072 h;
+    if (!h.Deserialize(p + fixed, data.size() - fixed))
+        return false;
+    hash = h;
+    coins = GetLE(p + 1, 8);
+    for (std::size_t i = 0; i < assets.size(); ++i) {
+        assets[i].coins = GetLE(p + 9 + 16 * i, 8);
+        assets[i].amount = GetLE(p + 17 + 16 * i, 8);
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "../crypto/tagged_hash.h"
+#include "../tx/transaction.h"
+#include "coin.h"
+#include <openssl/bn.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Multiplicative multiset hash over the integers modulo the prime
+// 2^3072 - 1103717. Every element maps to a 3072-bit residue; insertions
+// multiply the numerator and removals the denominator, so the digest of a
+// set does not depend on the order its elements were added or removed and
+// two partial hashes can be combined by multiplication.
+class MuHash3072 {
+public:
+    static constexpr std::size_t kBytes = 384;
+
+    MuHash3072();
+    MuHash3072(const MuHash3072& other);
+    MuHash3072& operator=(const MuHash3072& other);
+    ~MuHash3072();
+
+    void Insert(const uint8_t* data, std::size_t size);
+    void Remove(const uint8_t* data, std::size_t size);
+    // Fold another hash's insertions and removals into this one.
+    void Combine(const MuHash3072& other);
+    // SHA-256 of numerator / denominator, as 384 little-endian bytes.
+    uint256 Finalize() const;
+
+    // [numerator(384)][denominator(384)], little-endian.
+    std::string Serialize() const;
+    bool Deserialize(const uint8_t* data, std::size_t size);
+
+private:
+    BIGNUM* num;
+    BIGNUM* den;
+};
+
+struct AssetSupply {
+    uint64_t coins{0};
+    uint64_t amount{0};
+};
+
+constexpr std::size_t kUtxoStatsAssets = static_cast<std::size_t>(AssetId::OBOLOS) + 1;
+
+// Snapshot of the statistics reported by gettxoutsetinfo.
+struct UtxoSetStats {
+    uint256 bestBlock{};
+    uint64_t coins{0};
+    std::array<AssetSupply, kUtxoStatsAssets> assets{};
+    uint256 setHash{};
+};
+
+// Running coin count, per-asset supply and MuHash of a coin set, updated
+// in constant time per added or removed coin. Coins with an unknown asset
+// id count towards the total and the hash but no asset.
+class UtxoStatsTracker {
+public:
+    void AddCoin(const OutPoint& out, const Coin& coin);
+    void RemoveCoin(const OutPoint& out, const Coin& coin);
+    void Merge(const UtxoStatsTracker& other);
+
+    uint64_t Coins() const { return coins; }
+    const std::array<AssetSupply, kUtxoStatsAssets>& Assets() const { return assets; }
+    uint256 SetHash() const { return hash.Finalize(); }
+
+    // [version(1)][coins(8)][per asset: coins(8) amount(8)][muhash]
+    std::string Serialize() const;
+    bool Deserialize(const std::string& data);
+
+private:
+    MuHash3072 hash;
+    uint64_t coins{0};
+    std::array<AssetSupply, kUtxoStatsAssets> assets{};
+};
+
+// The bytes a coin contributes to the set hash:
+//   [txid(32)][index(4)][height << 1 | coinbase(4)][value(8)][asset(1)]
+//   [script size(4)][script]
+// with little-endian integers.
+std::string SerializeCoinForHash(const OutPoint& out, const Coin& coin);
@@ -52,6 +52,41 @@ std::vector<uint256> ForkResolver::ReorgPath(const uint256& newTip) const
     return path;
 }
 
+std::optional<ReorgPlan> ForkResolver::PlanReorg(const uint256& fromTip, const uint256& toTip) const
+{
+    std::lock_guard<std::mutex> l(m_mu);
+    auto from = m_index.find(fromTip);
+    auto to = m_index.find(toTip);
+    if (from == m_index.end() || to == m_index.end())
+        return std::nullopt;
+
+    ReorgPlan plan;
+    const BlockMeta* a = &from->second;
+    const BlockMeta* b = &to->second;
+    auto parentOf = [this](const BlockMeta* meta) -> const BlockMeta* {
+        auto it = m_index.find(meta->parent);
+        return it == m_index.end() ? nullptr : &it->second;
+    };
+    // Walk the higher side down first, then both together until they meet.
+    while (a && b && a->hash != b->hash) {
+        if (a->height >= b->height) {
+            plan.disconnect.push_back(*a);
+            a = parentOf(a);
+        } else {
+            plan.connect.push_back(*b);
+            b = parentOf(b);
+        }
+    }
+    if (!a || !b)
+        return std::nullopt; // no common ancestor
+    plan.fork = a->hash;
+    std::reverse(plan.connect.begin(), plan.connect.end());
+    plan.connectMedianTimePast.reserve(plan.connect.size());
+    for (const auto& meta : plan.connect)
+        plan.connectMedianTimePast.push_back(ComputeMedianTimePast(meta.parent));
+    return plan;
+}
+
 bool ForkResolver::IsBetterChain(const BlockMeta& candidate) const
 {
     if (!m_bestTip)
@@ -42,6 +42,16 @@ struct OrphanBlock {
     uint32_t height{0};
 };
 
+// Steps to move the active chain from one tip to another: blocks to
+// disconnect (old tip first) and blocks to connect (fork point's child first),
+// with the median time past each connected block must exceed.
+struct ReorgPlan {
+    uint256 fork{};
+    std::vector<BlockMeta> disconnect;
+    std::vector<BlockMeta> connect;
+    std::vector<uint32_t> connectMedianTimePast;
+};
+
 struct Uint256Hasher {
     std::size_t operator()(const uint256& h) const noexcept
     {
@@ -63,7 +73,9 @@ struct Uint256Eq {
 // difficult unless the competing fork has clearly superior cumulative work.
 class ForkResolver {
 public:
-    explicit ForkResolver(uint32_t finalizationDepth = 100, uint32_t reorgWorkMarginBps = 500);
+    static constexpr uint32_t kDefaultFinalizationDepth = 100;
+
+    explicit ForkResolver(uint32_t finalizationDepth = kDefaultFinalizationDepth, uint32_t reorgWorkMarginBps = 500);
 
     // Returns true if the incoming header became the new tip.
     bool ConsiderHeader(
@@ -76,7 +88,12 @@ public:
         uint32_t maxFutureDrift = 2 * 60 * 60);
 
     const BlockMeta* Tip() const { return m_bestTip ? &(*m_bestTip) : nullptr; }
+    // Reorganizations up to this many blocks follow the plain most-work rule.
+    uint32_t FinalizationDepth() const { return m_finalizationDepth; }
     std::vector<uint256> ReorgPath(const uint256& newTip) const;
+    // Incremental alternative to ReorgPath: only the blocks on either side of
+    // the last common ancestor. nullopt if either tip is unknown.
+    std::optional<ReorgPlan> PlanReorg(const uint256& fromTip, const uint256& toTip) const;
 
 private:
     uint32_t m_finalizationDepth;
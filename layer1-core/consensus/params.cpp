@@ -27,7 +27,8 @@ static Params mainParams {
     DEFAULT_THRESHOLD,
     DEFAULT_WINDOW,
     { VBDeployment{28, -1, -1} },
-    1                  // nMultiAssetActivationHeight
+    1,                 // nMultiAssetActivationHeight
+    {}                 // assumeutxo snapshots
 };
 
 static Params testParams {
@@ -45,7 +46,8 @@ static Params testParams {
     DEFAULT_THRESHOLD,
     DEFAULT_WINDOW,
     { VBDeployment{28, -1, -1} },
-    1
+    1,
+    {}
 };
 
 const Params& Main()    { return mainParams; }
@@ -25,6 +25,14 @@ enum DeploymentPos {
     MAX_VERSION_BITS_DEPLOYMENTS
 };
 
+// A UTXO snapshot trusted as a starting point without validating the chain
+// below it: the block it was taken at and the MuHash of its coins (see
+// chainstate/utxo_stats.h).
+struct AssumeUtxoData {
+    uint256 baseBlock{};
+    uint256 setHash{};
+};
+
 struct Params {
     uint32_t nSubsidyHalvingInterval;
     uint32_t nPowTargetSpacing;
@@ -50,6 +58,10 @@ struct Params {
 
     // Multi-asset activation height (regenesis/fork point).
     uint32_t nMultiAssetActivationHeight{0};
+
+    // Snapshots loadtxoutset accepts, keyed by the height of their base
+    // block. Anything else needs an explicit override.
+    std::map<uint32_t, AssumeUtxoData> assumeUtxo;
 };
 
 const Params& Main();
@@ -0,0 +1,116 @@
+#include "crc32c.h"
+#include <array>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define DRACHMA_CRC32C_SSE42 1
+#include <nmmintrin.h>
+#endif
+
+namespace {
+
+constexpr uint32_t kPolynomial = 0x82F63B78u; // reflected Castagnoli
+
+// Slicing-by-8 tables: table[k][b] is the CRC of byte b followed by k zero bytes.
+struct Tables {
+    std::array<std::array<uint32_t, 256>, 8> t{};
+    Tables()
+    {
+        for (uint32_t b = 0; b < 256; ++b) {
+            uint32_t c = b;
+            for (int i = 0; i < 8; ++i)
+                c = (c >> 1) ^ ((c & 1) ? kPolynomial : 0);
+            t[0][b] = c;
+        }
+        for (uint32_t b = 0; b < 256; ++b)
+            for (std::size_t k = 1; k < 8; ++k)
+                t[k][b] = (t[k - 1][b] >> 8) ^ t[0][t[k - 1][b] & 0xff];
+    }
+};
+
+uint32_t Crc32cSoftware(const uint8_t* p, size_t size, uint32_t crc)
+{
+    static const Tables tables;
+    const auto& t = tables.t;
+    while (size >= 8) {
+        uint32_t lo, hi;
+        std::memcpy(&lo, p, 4);
+        std::memcpy(&hi, p + 4, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        lo = __builtin_bswap32(lo);
+        hi = __builtin_bswap32(hi);
+#endif
+        lo ^= crc;
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+        p += 8;
+        size -= 8;
+    }
+    while (size-- > 0)
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+    return crc;
+}
+
+#ifdef DRACHMA_CRC32C_SSE42
+__attribute__((target("sse4.2"))) uint32_t Crc32cHardware(const uint8_t* p, size_t size, uint32_t crc)
+{
+#if defined(__x86_64__)
+    uint64_t c = crc;
+    while (size >= 8) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+        p += 8;
+        size -= 8;
+    }
+    crc = static_cast<uint32_t>(c);
+#endif
+    while (size >= 4) {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        crc = _mm_crc32_u32(crc, v);
+        p += 4;
+        size -= 4;
+    }
+    while (size-- > 0)
+        crc = _mm_crc32_u8(crc, *p++);
+    return crc;
+}
+#endif
+
+} // namespace
+
+bool Crc32cHardwareAvailable()
+{
+#ifdef DRACHMA_CRC32C_SSE42
+    static const bool available = __builtin_cpu_supports("sse4.2");
+    return available;
+#else
+    return false;
+#endif
+}
+
+uint32_t Crc32c(const uint8_t* data, size_t size, uint32_t crc)
+{
+    if (Crc32cHardwareAvailable())
+        return crc32c_detail::Hardware(data, size, crc);
+    return crc32c_detail::Software(data, size, crc);
+}
+
+namespace crc32c_detail {
+
+uint32_t Software(const uint8_t* data, size_t size, uint32_t crc)
+{
+    return ~Crc32cSoftware(data, size, ~crc);
+}
+
+uint32_t Hardware(const uint8_t* data, size_t size, uint32_t crc)
+{
+#ifdef DRACHMA_CRC32C_SSE42
+    return ~Crc32cHardware(data, size, ~crc);
+#else
+    return Software(data, size, crc);
+#endif
+}
+
+} // namespace crc32c_detail
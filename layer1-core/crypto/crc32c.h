@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32C (Castagnoli), as used for block store record checksums. Uses the
+// SSE4.2 crc32 instruction when the CPU has it and a table-driven fallback
+// otherwise; both give the same result. `crc` continues an earlier call.
+uint32_t Crc32c(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+// True if Crc32c runs on the hardware instruction on this machine.
+bool Crc32cHardwareAvailable();
+
+namespace crc32c_detail {
+// The two implementations behind Crc32c, with the same interface, so tests
+// can check the one the CPU does not select. Hardware falls back to
+// Software when the instruction was not compiled in; only call it when
+// Crc32cHardwareAvailable() is true.
+uint32_t Software(const uint8_t* data, size_t size, uint32_t crc = 0);
+uint32_t Hardware(const uint8_t* data, size_t size, uint32_t crc = 0);
+} // namespace crc32c_detail
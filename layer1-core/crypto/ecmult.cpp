@@ -0,0 +1,438 @@
+#include "ecmult.h"
+
+#include <openssl/obj_mac.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+
+namespace {
+
+using ec_point_ptr = std::unique_ptr<EC_POINT, decltype(&EC_POINT_free)>;
+using bn_ctx_ptr = std::unique_ptr<BN_CTX, decltype(&BN_CTX_free)>;
+
+// Strauss wNAF width: tables hold the odd multiples P, 3P, ..., 15P.
+constexpr unsigned kStraussWindow = 5;
+constexpr size_t kStraussTableSize = size_t{1} << (kStraussWindow - 2);
+constexpr unsigned kMaxPippengerWindow = 16;
+constexpr size_t kGenWindows = 64;
+
+// 256-bit scalar as little-endian 32-bit limbs, with a spare limb so
+// recoding can carry past bit 255.
+struct scalar_limbs {
+    std::array<uint32_t, 9> v{};
+};
+
+bool load_scalar(const BIGNUM* k, scalar_limbs& out) {
+    std::array<uint8_t, 32> be{};
+    if (!k || BN_is_negative(k) || BN_bn2binpad(k, be.data(), 32) != 32) {
+        return false;
+    }
+    for (size_t i = 0; i < 8; ++i) {
+        const uint8_t* p = be.data() + 28 - 4 * i;
+        out.v[i] = (uint32_t{p[0]} << 24) | (uint32_t{p[1]} << 16) | (uint32_t{p[2]} << 8) | p[3];
+    }
+    out.v[8] = 0;
+    return true;
+}
+
+bool is_zero(const scalar_limbs& k) {
+    for (uint32_t limb : k.v) {
+        if (limb != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void add_small(scalar_limbs& k, uint32_t d) {
+    uint64_t carry = d;
+    for (auto& limb : k.v) {
+        const uint64_t sum = limb + carry;
+        limb = static_cast<uint32_t>(sum);
+        carry = sum >> 32;
+        if (carry == 0) {
+            return;
+        }
+    }
+}
+
+void sub_small(scalar_limbs& k, uint32_t d) {
+    uint64_t borrow = d;
+    for (auto& limb : k.v) {
+        if (limb >= borrow) {
+            limb -= static_cast<uint32_t>(borrow);
+            return;
+        }
+        limb = static_cast<uint32_t>((uint64_t{1} << 32) + limb - borrow);
+        borrow = 1;
+    }
+}
+
+void shift_right1(scalar_limbs& k) {
+    for (size_t i = 0; i < k.v.size(); ++i) {
+        const uint32_t high = i + 1 < k.v.size() ? (k.v[i + 1] << 31) : 0;
+        k.v[i] = (k.v[i] >> 1) | high;
+    }
+}
+
+// `count` (at most 16) bits of k starting at bit `pos`.
+uint32_t get_bits(const scalar_limbs& k, size_t pos, unsigned count) {
+    const size_t limb = pos / 32;
+    if (limb >= k.v.size()) {
+        return 0;
+    }
+    uint64_t word = k.v[limb];
+    if (limb + 1 < k.v.size()) {
+        word |= uint64_t{k.v[limb + 1]} << 32;
+    }
+    return static_cast<uint32_t>(word >> (pos % 32)) & ((1u << count) - 1);
+}
+
+// Width-w non-adjacent form, least significant digit first. Non-zero digits
+// are odd, lie in (-2^(w-1), 2^(w-1)) and are at least w positions apart.
+std::vector<int> wnaf(scalar_limbs k, unsigned w) {
+    std::vector<int> digits;
+    digits.reserve(257);
+    const int full = 1 << w;
+    const int half = 1 << (w - 1);
+    while (!is_zero(k)) {
+        int d = 0;
+        if (k.v[0] & 1) {
+            d = static_cast<int>(k.v[0] & static_cast<uint32_t>(full - 1));
+            if (d >= half) {
+                d -= full;
+            }
+            if (d > 0) {
+                sub_small(k, static_cast<uint32_t>(d));
+            } else {
+                add_small(k, static_cast<uint32_t>(-d));
+            }
+        }
+        digits.push_back(d);
+        shift_right1(k);
+    }
+    return digits;
+}
+
+// Signed fixed windows of c bits: k = sum(d[i] * 2^(c*i)) with every digit in
+// [-2^(c-1), 2^(c-1)]. The window count leaves the top window fewer than c
+// scalar bits, so the final carry always fits.
+size_t pippenger_windows(unsigned c) {
+    return 256 / c + 1;
+}
+
+void signed_windows(const scalar_limbs& k, unsigned c, int* out) {
+    const int half = 1 << (c - 1);
+    int carry = 0;
+    for (size_t i = 0; i < pippenger_windows(c); ++i) {
+        int bits = static_cast<int>(get_bits(k, i * c, c)) + carry;
+        carry = 0;
+        if (bits > half) {
+            bits -= 1 << c;
+            carry = 1;
+        }
+        out[i] = bits;
+    }
+}
+
+// Rough group-operation counts used to pick an algorithm and window size.
+size_t strauss_cost(size_t n) {
+    return n * (kStraussTableSize + 256 / (kStraussWindow + 1)) + 256;
+}
+
+size_t pippenger_cost(size_t n, unsigned c) {
+    return pippenger_windows(c) * (n + 2 * (size_t{1} << (c - 1)) + c);
+}
+
+unsigned pippenger_window(size_t n) {
+    unsigned best = 2;
+    for (unsigned c = 3; c <= kMaxPippengerWindow; ++c) {
+        if (pippenger_cost(n, c) < pippenger_cost(n, best)) {
+            best = c;
+        }
+    }
+    return best;
+}
+
+ec_point_ptr new_point(const EC_GROUP* group) {
+    ec_point_ptr p(EC_POINT_new(group), &EC_POINT_free);
+    if (p && EC_POINT_set_to_infinity(group, p.get()) != 1) {
+        p.reset();
+    }
+    return p;
+}
+
+ec_point_ptr negated_copy(const EC_GROUP* group, const EC_POINT* point, BN_CTX* ctx) {
+    ec_point_ptr p(EC_POINT_dup(point, group), &EC_POINT_free);
+    if (p && EC_POINT_invert(group, p.get(), ctx) != 1) {
+        p.reset();
+    }
+    return p;
+}
+
+bool check_inputs(const std::vector<const EC_POINT*>& points,
+                  const std::vector<const BIGNUM*>& scalars) {
+    if (points.size() != scalars.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (!points[i] || !scalars[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Converts a Jacobian point to Z = 1 so later additions take the mixed path.
+bool make_affine(const EC_GROUP* group, EC_POINT* point, BN_CTX* ctx) {
+    BN_CTX_start(ctx);
+    BIGNUM* x = BN_CTX_get(ctx);
+    BIGNUM* y = BN_CTX_get(ctx);
+    const bool ok = y &&
+                    EC_POINT_get_affine_coordinates(group, point, x, y, ctx) == 1 &&
+                    EC_POINT_set_affine_coordinates(group, point, x, y, ctx) == 1;
+    BN_CTX_end(ctx);
+    return ok;
+}
+
+secp256k1_curve* build_curve() {
+    auto curve = std::make_unique<secp256k1_curve>();
+    bn_ctx_ptr ctx(BN_CTX_new(), &BN_CTX_free);
+    curve->group = EC_GROUP_new_by_curve_name(NID_secp256k1);
+    curve->order = BN_new();
+    curve->field_prime = BN_new();
+    if (!ctx || !curve->group || !curve->order || !curve->field_prime ||
+        EC_GROUP_get_order(curve->group, curve->order, ctx.get()) != 1 ||
+        EC_GROUP_get_curve(curve->group, curve->field_prime, nullptr, nullptr, ctx.get()) != 1) {
+        return nullptr;
+    }
+
+    const EC_GROUP* group = curve->group;
+    ec_point_ptr base(EC_POINT_dup(EC_GROUP_get0_generator(group), group), &EC_POINT_free);
+    if (!base) {
+        return nullptr;
+    }
+    curve->gen_table.assign(kGenWindows * 16, nullptr);
+    for (size_t i = 0; i < kGenWindows; ++i) {
+        EC_POINT** row = curve->gen_table.data() + 16 * i;
+        row[0] = EC_POINT_new(group);
+        row[1] = EC_POINT_dup(base.get(), group);
+        if (!row[0] || !row[1] || EC_POINT_set_to_infinity(group, row[0]) != 1) {
+            return nullptr;
+        }
+        for (size_t d = 2; d < 16; ++d) {
+            row[d] = EC_POINT_new(group);
+            if (!row[d] || EC_POINT_add(group, row[d], row[d - 1], base.get(), ctx.get()) != 1) {
+                return nullptr;
+            }
+        }
+        // Next row's base: 16 * base = 15 * base + base.
+        if (EC_POINT_add(group, base.get(), row[15], base.get(), ctx.get()) != 1) {
+            return nullptr;
+        }
+        for (size_t d = 1; d < 16; ++d) {
+            if (!make_affine(group, row[d], ctx.get())) {
+                return nullptr;
+            }
+        }
+    }
+    return curve.release();
+}
+
+}  // namespace
+
+const secp256k1_curve* secp256k1_curve_get() {
+    // Built on first use and intentionally never freed: verification threads
+    // may still be running while static destructors execute at exit.
+    static const secp256k1_curve* curve = build_curve();
+    return curve;
+}
+
+bool ecmult_gen(const secp256k1_curve& curve, EC_POINT* r, const BIGNUM* k, BN_CTX* ctx) {
+    scalar_limbs limbs;
+    if (!r || !ctx || !load_scalar(k, limbs) || EC_POINT_set_to_infinity(curve.group, r) != 1) {
+        return false;
+    }
+    for (size_t i = 0; i < kGenWindows; ++i) {
+        const uint32_t d = get_bits(limbs, 4 * i, 4);
+        if (d != 0 && EC_POINT_add(curve.group, r, r, curve.gen_table[16 * i + d], ctx) != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ecmult_multi_strauss(const secp256k1_curve& curve, EC_POINT* r,
+                          const std::vector<const EC_POINT*>& points,
+                          const std::vector<const BIGNUM*>& scalars,
+                          BN_CTX* ctx) {
+    const EC_GROUP* group = curve.group;
+    if (!r || !ctx || !check_inputs(points, scalars)) {
+        return false;
+    }
+    const size_t n = points.size();
+
+    // Per point: the wNAF digits and odd multiples, positive then negated.
+    std::vector<std::vector<int>> nafs(n);
+    std::vector<ec_point_ptr> tables;
+    tables.reserve(2 * kStraussTableSize * n);
+    size_t max_len = 0;
+    ec_point_ptr twice = new_point(group);
+    if (!twice) {
+        return false;
+    }
+    for (size_t j = 0; j < n; ++j) {
+        scalar_limbs limbs;
+        if (!load_scalar(scalars[j], limbs)) {
+            return false;
+        }
+        nafs[j] = wnaf(limbs, kStraussWindow);
+        max_len = std::max(max_len, nafs[j].size());
+
+        const size_t first = tables.size();
+        tables.emplace_back(EC_POINT_dup(points[j], group), &EC_POINT_free);
+        if (!tables.back() || EC_POINT_dbl(group, twice.get(), points[j], ctx) != 1) {
+            return false;
+        }
+        for (size_t t = 1; t < kStraussTableSize; ++t) {
+            tables.push_back(new_point(group));
+            if (!tables.back() ||
+                EC_POINT_add(group, tables.back().get(), tables[first + t - 1].get(), twice.get(), ctx) != 1) {
+                return false;
+            }
+        }
+        for (size_t t = 0; t < kStraussTableSize; ++t) {
+            tables.push_back(negated_copy(group, tables[first + t].get(), ctx));
+            if (!tables.back()) {
+                return false;
+            }
+        }
+    }
+
+    if (EC_POINT_set_to_infinity(group, r) != 1) {
+        return false;
+    }
+    for (size_t bit = max_len; bit-- > 0;) {
+        if (EC_POINT_dbl(group, r, r, ctx) != 1) {
+            return false;
+        }
+        for (size_t j = 0; j < n; ++j) {
+            if (bit >= nafs[j].size() || nafs[j][bit] == 0) {
+                continue;
+            }
+            const int d = nafs[j][bit];
+            const size_t slot = 2 * kStraussTableSize * j +
+                                (d > 0 ? static_cast<size_t>(d - 1) / 2
+                                       : kStraussTableSize + static_cast<size_t>(-d - 1) / 2);
+            if (EC_POINT_add(group, r, r, tables[slot].get(), ctx) != 1) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool ecmult_multi_pippenger(const secp256k1_curve& curve, EC_POINT* r,
+                            const std::vector<const EC_POINT*>& points,
+                            const std::vector<const BIGNUM*>& scalars,
+                            BN_CTX* ctx) {
+    const EC_GROUP* group = curve.group;
+    if (!r || !ctx || !check_inputs(points, scalars)) {
+        return false;
+    }
+    const size_t n = points.size();
+    const unsigned c = pippenger_window(n);
+    const size_t windows = pippenger_windows(c);
+    const size_t bucket_count = size_t{1} << (c - 1);
+
+    std::vector<int> digits(n * windows);
+    std::vector<ec_point_ptr> negated;
+    negated.reserve(n);
+    for (size_t j = 0; j < n; ++j) {
+        scalar_limbs limbs;
+        if (!load_scalar(scalars[j], limbs)) {
+            return false;
+        }
+        signed_windows(limbs, c, digits.data() + j * windows);
+        negated.push_back(negated_copy(group, points[j], ctx));
+        if (!negated.back()) {
+            return false;
+        }
+    }
+
+    std::vector<ec_point_ptr> buckets;
+    buckets.reserve(bucket_count);
+    for (size_t b = 0; b < bucket_count; ++b) {
+        buckets.push_back(new_point(group));
+        if (!buckets.back()) {
+            return false;
+        }
+    }
+    std::vector<char> used(bucket_count);
+    ec_point_ptr running = new_point(group);
+    ec_point_ptr total = new_point(group);
+    if (!running || !total || EC_POINT_set_to_infinity(group, r) != 1) {
+        return false;
+    }
+
+    for (size_t w = windows; w-- > 0;) {
+        for (unsigned i = 0; i < c; ++i) {
+            if (EC_POINT_dbl(group, r, r, ctx) != 1) {
+                return false;
+            }
+        }
+
+        std::fill(used.begin(), used.end(), 0);
+        for (size_t j = 0; j < n; ++j) {
+            const int d = digits[j * windows + w];
+            if (d == 0) {
+                continue;
+            }
+            const size_t b = static_cast<size_t>(std::abs(d)) - 1;
+            const EC_POINT* term = d > 0 ? points[j] : negated[j].get();
+            const int ok = used[b] ? EC_POINT_add(group, buckets[b].get(), buckets[b].get(), term, ctx)
+                                   : EC_POINT_copy(buckets[b].get(), term);
+            if (ok != 1) {
+                return false;
+            }
+            used[b] = 1;
+        }
+
+        // sum((b + 1) * bucket[b]) as a running sum from the top bucket down.
+        bool have_running = false;
+        if (EC_POINT_set_to_infinity(group, total.get()) != 1) {
+            return false;
+        }
+        for (size_t b = bucket_count; b-- > 0;) {
+            if (used[b]) {
+                const int ok = have_running
+                                   ? EC_POINT_add(group, running.get(), running.get(), buckets[b].get(), ctx)
+                                   : EC_POINT_copy(running.get(), buckets[b].get());
+                if (ok != 1) {
+                    return false;
+                }
+                have_running = true;
+            }
+            if (have_running && EC_POINT_add(group, total.get(), total.get(), running.get(), ctx) != 1) {
+                return false;
+            }
+        }
+        if (EC_POINT_add(group, r, r, total.get(), ctx) != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ecmult_multi(const secp256k1_curve& curve, EC_POINT* r,
+                  const std::vector<const EC_POINT*>& points,
+                  const std::vector<const BIGNUM*>& scalars,
+                  BN_CTX* ctx) {
+    if (strauss_cost(points.size()) <= pippenger_cost(points.size(), pippenger_window(points.size()))) {
+        return ecmult_multi_strauss(curve, r, points, scalars, ctx);
+    }
+    return ecmult_multi_pippenger(curve, r, points, scalars, ctx);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+
+#include <cstddef>
+#include <vector>
+
+// secp256k1 point multiplication helpers for the Schnorr routines, built on
+// OpenSSL's EC_POINT arithmetic. OpenSSL keeps points in Jacobian coordinates,
+// so the additions and doublings below never invert a field element.
+
+// Curve data built once per process and shared read-only between threads.
+// Every call that does arithmetic supplies its own BN_CTX.
+struct secp256k1_curve {
+    EC_GROUP* group{nullptr};
+    BIGNUM* order{nullptr};
+    BIGNUM* field_prime{nullptr};
+    // gen_table[16 * i + d] = d * 16^i * G for 64 nibble positions, with
+    // affine entries so fixed-base products use mixed additions only.
+    std::vector<EC_POINT*> gen_table;
+};
+
+// The shared curve; nullptr only if OpenSSL failed to build it.
+const secp256k1_curve* secp256k1_curve_get();
+
+// r = k*G from the generator table: at most 64 additions, no doublings.
+// k must lie in [0, order).
+bool ecmult_gen(const secp256k1_curve& curve, EC_POINT* r, const BIGNUM* k, BN_CTX* ctx);
+
+// r = sum(scalars[i] * points[i]) with the doublings shared across all
+// points. Uses Strauss (interleaved wNAF) for small inputs and Pippenger
+// (bucket accumulation) once the point count makes it cheaper. Scalars must
+// lie in [0, order).
+bool ecmult_multi(const secp256k1_curve& curve, EC_POINT* r,
+                  const std::vector<const EC_POINT*>& points,
+                  const std::vector<const BIGNUM*>& scalars,
+                  BN_CTX* ctx);
+
+// The two algorithms behind ecmult_multi, exposed for tests and benchmarks.
+bool ecmult_multi_strauss(const secp256k1_curve& curve, EC_POINT* r,
+                          const std::vector<const EC_POINT*>& points,
+                          const std::vector<const BIGNUM*>& scalars,
+                          BN_CTX* ctx);
+bool ecmult_multi_pippenger(const secp256k1_curve& curve, EC_POINT* r,
+                            const std::vector<const EC_POINT*>& points,
+                            const std::vector<const BIGNUM*>& scalars,
+                            BN_CTX* ctx);
@@ -1,4 +1,5 @@
 #include "schnorr.h"
+#include "ecmult.h"
 #include "tagged_hash.h"
 
 #include <openssl/crypto.h>
@@ -17,10 +18,8 @@
 namespace {
 
 // RAII helpers for OpenSSL types to avoid leaks.
-using ec_group_ptr = std::unique_ptr<EC_GROUP, decltype(&EC_GROUP_free)>;
 using ec_point_ptr = std::unique_ptr<EC_POINT, decltype(&EC_POINT_free)>;
 using bn_ptr = std::unique_ptr<BIGNUM, decltype(&BN_clear_free)>;
-using bn_ctx_ptr = std::unique_ptr<BN_CTX, decltype(&BN_CTX_free)>;
 
 struct bn_ctx_guard {
     explicit bn_ctx_guard(BN_CTX* ctx_in) : ctx(ctx_in) { BN_CTX_start(ctx); }
@@ -37,11 +36,6 @@ static bn_ptr bn_from_bytes(const uint8_t* buf, size_t len) {
     return bn_ptr(BN_bin2bn(buf, static_cast<int>(len), nullptr), &BN_clear_free);
 }
 
-// Reads curve order p and group.
-static ec_group_ptr make_secp256k1_group() {
-    return ec_group_ptr(EC_GROUP_new_by_curve_name(NID_secp256k1), &EC_GROUP_free);
-}
-
 // Serialize BIGNUM to 32-byte big-endian array (padded).
 static bool bn_to_fixed_32(const BIGNUM* bn, uint8_t* out32) {
     if (!bn || !out32) {
@@ -115,7 +109,8 @@ static bn_ptr compute_bip340_nonce(const BIGNUM* seckey,
                                    const std::array<uint8_t, 32>& pubkey_x,
                                    const uint8_t* msg_hash32,
                                    const BIGNUM* order,
-                                   const uint8_t* aux_override) {
+                                   const uint8_t* aux_override,
+                                   BN_CTX* ctx) {
     uint8_t aux_rand[32]{};
     if (aux_override) {
         std::memcpy(aux_rand, aux_override, sizeof(aux_rand));
@@ -145,11 +140,7 @@ static bn_ptr compute_bip340_nonce(const BIGNUM* seckey,
         return bn_ptr(nullptr, &BN_clear_free);
     }
     // k = k0 mod n
-    bn_ctx_ptr ctx(BN_CTX_new(), &BN_CTX_free);
-    if (!ctx) {
-        return bn_ptr(nullptr, &BN_clear_free);
-    }
-    if (BN_mod(k.get(), k.get(), order, ctx.get()) != 1) {
+    if (BN_mod(k.get(), k.get(), order, ctx) != 1) {
         return bn_ptr(nullptr, &BN_clear_free);
     }
     if (BN_is_zero(k.get())) {
@@ -158,30 +149,88 @@ static bn_ptr compute_bip340_nonce(const BIGNUM* seckey,
     return k;
 }
 
-// Produce a uniform random scalar in [1, order-1].
-static bn_ptr random_scalar(const BIGNUM* order, BN_CTX* ctx) {
-    if (!order || !ctx) {
-        return bn_ptr(nullptr, &BN_clear_free);
+// Batch coefficients a_i: uniform non-zero 128-bit values, which bound the
+// chance of a forged batch passing at 2^-128 while halving the length of
+// the a_i * R_i terms.
+static bool random_batch_coefficients(size_t count, std::vector<bn_ptr>& out) {
+    std::vector<uint8_t> buf(count * 16);
+    if (!buf.empty() && RAND_bytes(buf.data(), static_cast<int>(buf.size())) != 1) {
+        return false;
     }
-    std::array<uint8_t, 32> buf{};
-    bn_ptr scalar(nullptr, &BN_clear_free);
-    do {
-        if (!fill_random(buf.data())) {
-            return bn_ptr(nullptr, &BN_clear_free);
-        }
-        scalar = bn_from_bytes(buf.data(), buf.size());
-        if (!scalar) {
-            return scalar;
-        }
-        if (BN_mod(scalar.get(), scalar.get(), order, ctx) != 1) {
-            return bn_ptr(nullptr, &BN_clear_free);
+    out.clear();
+    out.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        bn_ptr a = bn_from_bytes(buf.data() + 16 * i, 16);
+        if (!a || (BN_is_zero(a.get()) && BN_one(a.get()) != 1)) {
+            return false;
         }
-    } while (BN_is_zero(scalar.get()));
-    return scalar;
+        out.push_back(std::move(a));
+    }
+    return true;
+}
+
+// SHA256(tag) || SHA256(tag) is exactly one compression block, so the state
+// after absorbing it can be kept and copied for every challenge hash.
+static bool tag_midstate(const char* tag, SHA256_CTX& out) {
+    std::array<uint8_t, 32> tag_digest{};
+    SHA256_CTX ctx{};
+    if (SHA256_Init(&ctx) != 1 ||
+        SHA256_Update(&ctx, tag, std::strlen(tag)) != 1 ||
+        SHA256_Final(tag_digest.data(), &ctx) != 1) {
+        return false;
+    }
+    return SHA256_Init(&out) == 1 &&
+           SHA256_Update(&out, tag_digest.data(), tag_digest.size()) == 1 &&
+           SHA256_Update(&out, tag_digest.data(), tag_digest.size()) == 1;
 }
 
 }  // namespace
 
+struct schnorr_context {
+    const secp256k1_curve* curve{nullptr};
+    BN_CTX* bn{nullptr};
+    SHA256_CTX challenge{};
+    bool ready{false};
+
+    schnorr_context()
+        : curve(secp256k1_curve_get()), bn(BN_CTX_new()) {
+        ready = curve && bn && tag_midstate("BIP0340/challenge", challenge);
+    }
+    ~schnorr_context() { BN_CTX_free(bn); }
+
+    schnorr_context(const schnorr_context&) = delete;
+    schnorr_context& operator=(const schnorr_context&) = delete;
+};
+
+namespace {
+
+// e = int(hash_BIP0340/challenge(r || pub_x || msg)) mod n
+static bn_ptr challenge_scalar(const schnorr_context& ctx,
+                               const uint8_t* r32,
+                               const uint8_t* pub_x32,
+                               const uint8_t* msg_hash32) {
+    std::array<uint8_t, 32> digest{};
+    SHA256_CTX sha = ctx.challenge;
+    if (SHA256_Update(&sha, r32, 32) != 1 ||
+        SHA256_Update(&sha, pub_x32, 32) != 1 ||
+        SHA256_Update(&sha, msg_hash32, 32) != 1 ||
+        SHA256_Final(digest.data(), &sha) != 1) {
+        return bn_ptr(nullptr, &BN_clear_free);
+    }
+    bn_ptr e = bn_from_bytes(digest.data(), digest.size());
+    if (!e || BN_mod(e.get(), e.get(), ctx.curve->order, ctx.bn) != 1) {
+        return bn_ptr(nullptr, &BN_clear_free);
+    }
+    return e;
+}
+
+}  // namespace
+
+schnorr_context& schnorr_thread_context() {
+    thread_local schnorr_context ctx;
+    return ctx;
+}
+
 bool schnorr_sign(const uint8_t* private_key,
                   const uint8_t* msg_hash_32,
                   uint8_t* sig_64) {
@@ -192,28 +241,27 @@ bool schnorr_sign_with_aux(const uint8_t* private_key,
                            const uint8_t* msg_hash_32,
                            const uint8_t* aux_rand_32,
                            uint8_t* sig_64) {
-    if (!private_key || !msg_hash_32 || !sig_64) {
-        return false;
-    }
+    return schnorr_sign_with_aux(schnorr_thread_context(), private_key, msg_hash_32, aux_rand_32, sig_64);
+}
 
-    ec_group_ptr group = make_secp256k1_group();
-    if (!group) {
+bool schnorr_sign_with_aux(schnorr_context& sctx,
+                           const uint8_t* private_key,
+                           const uint8_t* msg_hash_32,
+                           const uint8_t* aux_rand_32,
+                           uint8_t* sig_64) {
+    if (!private_key || !msg_hash_32 || !sig_64 || !sctx.ready) {
         return false;
     }
 
-    bn_ctx_ptr ctx(BN_CTX_new(), &BN_CTX_free);
-    if (!ctx) {
-        return false;
-    }
-    bn_ctx_guard ctx_guard(ctx.get());
-
-    bn_ptr order(BN_new(), &BN_clear_free);
-    if (!order || EC_GROUP_get_order(group.get(), order.get(), ctx.get()) != 1) {
-        return false;
-    }
+    // Secret scalars go through OpenSSL's constant-time EC_POINT_mul rather
+    // than the variable-time generator table.
+    const EC_GROUP* group = sctx.curve->group;
+    const BIGNUM* order = sctx.curve->order;
+    BN_CTX* ctx = sctx.bn;
+    bn_ctx_guard ctx_guard(ctx);
 
     bn_ptr seckey = bn_from_bytes(private_key, 32);
-    if (!seckey || !is_valid_secret(seckey.get(), order.get())) {
+    if (!seckey || !is_valid_secret(seckey.get(), order)) {
         return false;
     }
 
@@ -224,20 +272,20 @@ bool schnorr_sign_with_aux(const uint8_t* private_key,
     }
 
     // Derive public key and enforce even Y by negating secret if needed.
-    ec_point_ptr pub_point = compute_public_point(group.get(), seckey.get(), ctx.get());
+    ec_point_ptr pub_point = compute_public_point(group, seckey.get(), ctx);
     if (!pub_point) {
         return false;
     }
-    if (get_affine_coordinates(group.get(), pub_point.get(), px.get(), py.get(), ctx.get()) != 1) {
+    if (get_affine_coordinates(group, pub_point.get(), px.get(), py.get(), ctx) != 1) {
         return false;
     }
     if (BN_is_odd(py.get())) {
         // seckey = n - seckey; pub_point = -pub_point
-        if (BN_sub(seckey.get(), order.get(), seckey.get()) != 1) {
+        if (BN_sub(seckey.get(), order, seckey.get()) != 1) {
             return false;
         }
-        EC_POINT_invert(group.get(), pub_point.get(), ctx.get());
-        if (get_affine_coordinates(group.get(), pub_point.get(), px.get(), py.get(), ctx.get()) != 1) {
+        EC_POINT_invert(group, pub_point.get(), ctx);
+        if (get_affine_coordinates(group, pub_point.get(), px.get(), py.get(), ctx) != 1) {
             return false;
         }
     }
@@ -247,29 +295,29 @@ bool schnorr_sign_with_aux(const uint8_t* private_key,
         return false;
     }
 
-    bn_ptr k = compute_bip340_nonce(seckey.get(), pub_x_bytes, msg_hash_32, order.get(), aux_rand_32);
+    bn_ptr k = compute_bip340_nonce(seckey.get(), pub_x_bytes, msg_hash_32, order, aux_rand_32, ctx);
     if (!k) {
         return false;
     }
 
     // Compute R = k*G and ensure even Y.
-    ec_point_ptr r_point = compute_public_point(group.get(), k.get(), ctx.get());
+    ec_point_ptr r_point = compute_public_point(group, k.get(), ctx);
     if (!r_point) {
         return false;
     }
     bn_ptr rx(BN_new(), &BN_clear_free);
     bn_ptr ry(BN_new(), &BN_clear_free);
     if (!rx || !ry ||
-        get_affine_coordinates(group.get(), r_point.get(), rx.get(), ry.get(), ctx.get()) != 1) {
+        get_affine_coordinates(group, r_point.get(), rx.get(), ry.get(), ctx) != 1) {
         return false;
     }
     if (BN_is_odd(ry.get())) {
         // k = n - k, R = -R to force even Y
-        if (BN_sub(k.get(), order.get(), k.get()) != 1) {
+        if (BN_sub(k.get(), order, k.get()) != 1) {
             return false;
         }
-        EC_POINT_invert(group.get(), r_point.get(), ctx.get());
-        if (get_affine_coordinates(group.get(), r_point.get(), rx.get(), ry.get(), ctx.get()) != 1) {
+        EC_POINT_invert(group, r_point.get(), ctx);
+        if (get_affine_coordinates(group, r_point.get(), rx.get(), ry.get(), ctx) != 1) {
             return false;
         }
     }
@@ -279,20 +327,10 @@ bool schnorr_sign_with_aux(const uint8_t* private_key,
         return false;
     }
 
-    // Compute challenge e = int(hash("BIP0340/challenge", r || pub_x || msg)) mod n
-    std::array<uint8_t, 96> challenge_preimage;
-    std::memcpy(challenge_preimage.data(), r_bytes.data(), 32);
-    std::memcpy(challenge_preimage.data() + 32, pub_x_bytes.data(), 32);
-    std::memcpy(challenge_preimage.data() + 64, msg_hash_32, 32);
-    const auto challenge_hash = tagged_hash(
-        "BIP0340/challenge", challenge_preimage.data(), challenge_preimage.size());
-    bn_ptr e(bn_from_bytes(challenge_hash.data(), challenge_hash.size()));
+    bn_ptr e = challenge_scalar(sctx, r_bytes.data(), pub_x_bytes.data(), msg_hash_32);
     if (!e) {
         return false;
     }
-    if (BN_mod(e.get(), e.get(), order.get(), ctx.get()) != 1) {
-        return false;
-    }
 
     // s = (k + e*seckey) mod n
     bn_ptr s(BN_new(), &BN_clear_free);
@@ -303,10 +341,10 @@ bool schnorr_sign_with_aux(const uint8_t* private_key,
     if (!tmp) {
         return false;
     }
-    if (BN_mod_mul(tmp.get(), e.get(), seckey.get(), order.get(), ctx.get()) != 1) {
+    if (BN_mod_mul(tmp.get(), e.get(), seckey.get(), order, ctx) != 1) {
         return false;
     }
-    if (BN_mod_add(s.get(), k.get(), tmp.get(), order.get(), ctx.get()) != 1) {
+    if (BN_mod_add(s.get(), k.get(), tmp.get(), order, ctx) != 1) {
         return false;
     }
 
@@ -321,110 +359,68 @@ bool schnorr_sign_with_aux(const uint8_t* private_key,
 bool schnorr_verify(const uint8_t* public_key_33_compressed,
                     const uint8_t* msg_hash_32,
                     const uint8_t* sig_64) {
-    if (!public_key_33_compressed || !msg_hash_32 || !sig_64) {
-        return false;
-    }
+    return schnorr_verify(schnorr_thread_context(), public_key_33_compressed, msg_hash_32, sig_64);
+}
 
-    ec_group_ptr group = make_secp256k1_group();
-    if (!group) {
+bool schnorr_verify(schnorr_context& sctx,
+                    const uint8_t* public_key_33_compressed,
+                    const uint8_t* msg_hash_32,
+                    const uint8_t* sig_64) {
+    if (!public_key_33_compressed || !msg_hash_32 || !sig_64 || !sctx.ready) {
         return false;
     }
 
-    bn_ctx_ptr ctx(BN_CTX_new(), &BN_CTX_free);
-    if (!ctx) {
-        return false;
-    }
-    bn_ctx_guard ctx_guard(ctx.get());
+    const secp256k1_curve& curve = *sctx.curve;
+    const EC_GROUP* group = curve.group;
+    BN_CTX* ctx = sctx.bn;
+    bn_ctx_guard ctx_guard(ctx);
 
-    // Parse r and s
+    // Parse r and s; r must be a field element and s a scalar.
     bn_ptr r = bn_from_bytes(sig_64, 32);
     bn_ptr s = bn_from_bytes(sig_64 + 32, 32);
     if (!r || !s) {
         return false;
     }
-
-    bn_ptr order(BN_new(), &BN_clear_free);
-    if (!order || EC_GROUP_get_order(group.get(), order.get(), ctx.get()) != 1) {
-        return false;
-    }
-
-    // Check field prime p for r < p
-    bn_ptr p(BN_new(), &BN_clear_free);
-    bn_ptr a(BN_new(), &BN_clear_free);
-    bn_ptr b(BN_new(), &BN_clear_free);
-    if (!p || !a || !b ||
-        EC_GROUP_get_curve_GFp(group.get(), p.get(), a.get(), b.get(), ctx.get()) != 1) {
-        return false;
-    }
-    if (BN_is_negative(r.get()) == 1 || BN_cmp(r.get(), p.get()) >= 0) {
-        return false;
-    }
-    if (BN_is_negative(s.get()) == 1 || BN_cmp(s.get(), order.get()) >= 0) {
+    if (BN_cmp(r.get(), curve.field_prime) >= 0 || BN_cmp(s.get(), curve.order) >= 0) {
         return false;
     }
 
-    // Load public key
-    ec_point_ptr pub_point = load_public_point(group.get(), public_key_33_compressed, ctx.get());
+    // Load public key; decoding rejects x >= p, so the encoded x is P's.
+    ec_point_ptr pub_point = load_public_point(group, public_key_33_compressed, ctx);
     if (!pub_point) {
         return false;
     }
-    bn_ptr px(BN_new(), &BN_clear_free);
-    bn_ptr py(BN_new(), &BN_clear_free);
-    if (!px || !py ||
-        get_affine_coordinates(group.get(), pub_point.get(), px.get(), py.get(), ctx.get()) != 1) {
-        return false;
-    }
-
-    std::array<uint8_t, 32> pub_x_bytes{};
-    if (!bn_to_fixed_32(px.get(), pub_x_bytes.data())) {
-        return false;
-    }
 
-    // Compute challenge hash
-    std::array<uint8_t, 32> r_bytes{};
-    if (!bn_to_fixed_32(r.get(), r_bytes.data())) {
-        return false;
-    }
-    std::array<uint8_t, 96> challenge_preimage;
-    std::memcpy(challenge_preimage.data(), r_bytes.data(), 32);
-    std::memcpy(challenge_preimage.data() + 32, pub_x_bytes.data(), 32);
-    std::memcpy(challenge_preimage.data() + 64, msg_hash_32, 32);
-    const auto challenge_hash = tagged_hash(
-        "BIP0340/challenge", challenge_preimage.data(), challenge_preimage.size());
-    bn_ptr e(bn_from_bytes(challenge_hash.data(), challenge_hash.size()));
+    bn_ptr e = challenge_scalar(sctx, sig_64, public_key_33_compressed + 1, msg_hash_32);
     if (!e) {
         return false;
     }
-    if (BN_mod(e.get(), e.get(), order.get(), ctx.get()) != 1) {
+    // R = s*G + (n - e)*P
+    if (!BN_is_zero(e.get()) && BN_sub(e.get(), curve.order, e.get()) != 1) {
         return false;
     }
 
-    // R = s*G - e*P
-    ec_point_ptr r_point(EC_POINT_new(group.get()), &EC_POINT_free);
-    ec_point_ptr sG(EC_POINT_new(group.get()), &EC_POINT_free);
-    ec_point_ptr eP(EC_POINT_new(group.get()), &EC_POINT_free);
-    if (!r_point || !sG || !eP) {
-        return false;
-    }
-    if (EC_POINT_mul(group.get(), sG.get(), s.get(), nullptr, nullptr, ctx.get()) != 1) {
-        return false;
-    }
-    if (EC_POINT_mul(group.get(), eP.get(), nullptr, pub_point.get(), e.get(), ctx.get()) != 1) {
+    ec_point_ptr r_point(EC_POINT_new(group), &EC_POINT_free);
+    ec_point_ptr eP(EC_POINT_new(group), &EC_POINT_free);
+    if (!r_point || !eP) {
         return false;
     }
-    EC_POINT_invert(group.get(), eP.get(), ctx.get());
-    if (EC_POINT_add(group.get(), r_point.get(), sG.get(), eP.get(), ctx.get()) != 1) {
+    const std::vector<const EC_POINT*> points{pub_point.get()};
+    const std::vector<const BIGNUM*> scalars{e.get()};
+    if (!ecmult_gen(curve, r_point.get(), s.get(), ctx) ||
+        !ecmult_multi(curve, eP.get(), points, scalars, ctx) ||
+        EC_POINT_add(group, r_point.get(), r_point.get(), eP.get(), ctx) != 1) {
         return false;
     }
 
-    if (EC_POINT_is_at_infinity(group.get(), r_point.get()) == 1) {
+    if (EC_POINT_is_at_infinity(group, r_point.get()) == 1) {
         return false;
     }
 
     bn_ptr rx(BN_new(), &BN_clear_free);
     bn_ptr ry(BN_new(), &BN_clear_free);
     if (!rx || !ry ||
-        get_affine_coordinates(group.get(), r_point.get(), rx.get(), ry.get(), ctx.get()) != 1) {
+        get_affine_coordinates(group, r_point.get(), rx.get(), ry.get(), ctx) != 1) {
         return false;
     }
 
@@ -434,7 +430,7 @@ bool schnorr_verify(const uint8_t* public_key_33_compressed,
         return false;
     }
     const bool y_even = BN_is_odd(ry.get()) == 0;
-    const bool x_matches = CRYPTO_memcmp(rx_bytes.data(), r_bytes.data(), rx_bytes.size()) == 0;
+    const bool x_matches = CRYPTO_memcmp(rx_bytes.data(), sig_64, rx_bytes.size()) == 0;
 
     return y_even && x_matches;
 }
@@ -442,29 +438,32 @@ bool schnorr_verify(const uint8_t* public_key_33_compressed,
 bool schnorr_batch_verify(const std::vector<std::array<uint8_t, 33>>& pubkeys,
                           const std::vector<std::array<uint8_t, 32>>& msg_hashes,
                           const std::vector<std::array<uint8_t, 64>>& signatures) {
+    return schnorr_batch_verify(schnorr_thread_context(), pubkeys, msg_hashes, signatures);
+}
+
+bool schnorr_batch_verify(schnorr_context& sctx,
+                          const std::vector<std::array<uint8_t, 33>>& pubkeys,
+                          const std::vector<std::array<uint8_t, 32>>& msg_hashes,
+                          const std::vector<std::array<uint8_t, 64>>& signatures) {
     const size_t n = pubkeys.size();
-    if (n == 0 || msg_hashes.size() != n || signatures.size() != n) {
+    if (n == 0 || msg_hashes.size() != n || signatures.size() != n || !sctx.ready) {
         return false;
     }
 
-    ec_group_ptr group = make_secp256k1_group();
-    if (!group) {
-        return false;
-    }
+    // Checks sum(a_i * s_i) * G == sum(a_i * R_i) + sum(a_i * e_i * P_i) with
+    // the right-hand side evaluated as a single multi-scalar multiplication.
+    const secp256k1_curve* curve = sctx.curve;
+    const EC_GROUP* group = curve->group;
+    const BIGNUM* order = curve->order;
+    BN_CTX* ctx = sctx.bn;
+    bn_ctx_guard guard(ctx);
 
-    bn_ctx_ptr ctx(BN_CTX_new(), &BN_CTX_free);
-    if (!ctx) {
+    std::vector<bn_ptr> coefficients;
+    if (!random_batch_coefficients(n, coefficients)) {
         return false;
     }
-    bn_ctx_guard guard(ctx.get());
-
-    bn_ptr order(BN_new(), &BN_clear_free);
-    bn_ptr p(BN_new(), &BN_clear_free);
-    bn_ptr a(BN_new(), &BN_clear_free);
-    bn_ptr b(BN_new(), &BN_clear_free);
-    if (!order || !p || !a || !b ||
-        EC_GROUP_get_order(group.get(), order.get(), ctx.get()) != 1 ||
-        EC_GROUP_get_curve_GFp(group.get(), p.get(), a.get(), b.get(), ctx.get()) != 1) {
+    // The first coefficient can be fixed without weakening the check.
+    if (BN_one(coefficients[0].get()) != 1) {
         return false;
     }
 
@@ -474,10 +473,10 @@ bool schnorr_batch_verify(const std::vector<std::array<uint8_t, 33>>& pubkeys,
     }
     BN_zero(scalar_sum.get());
 
-    ec_point_ptr rhs(EC_POINT_new(group.get()), &EC_POINT_free);
-    if (!rhs || EC_POINT_set_to_infinity(group.get(), rhs.get()) != 1) {
-        return false;
-    }
+    std::vector<ec_point_ptr> points;
+    std::vector<bn_ptr> scalars;
+    points.reserve(2 * n);
+    scalars.reserve(2 * n);
 
     for (size_t i = 0; i < n; ++i) {
         const auto& sig = signatures[i];
@@ -486,94 +485,80 @@ bool schnorr_batch_verify(const std::vector<std::array<uint8_t, 33>>& pubkeys,
         if (!r || !s) {
             return false;
         }
-        if (BN_is_negative(r.get()) || BN_cmp(r.get(), p.get()) >= 0 ||
-            BN_is_negative(s.get()) || BN_cmp(s.get(), order.get()) >= 0) {
+        if (BN_cmp(r.get(), curve->field_prime) >= 0 || BN_cmp(s.get(), order) >= 0) {
             return false;
         }
 
         // decompress R with even Y
         std::array<uint8_t, 33> r_comp{};
         r_comp[0] = 0x02;
-        if (!bn_to_fixed_32(r.get(), r_comp.data() + 1)) {
-            return false;
-        }
-        ec_point_ptr R = load_public_point(group.get(), r_comp.data(), ctx.get());
-        if (!R || EC_POINT_is_at_infinity(group.get(), R.get()) == 1) {
+        std::memcpy(r_comp.data() + 1, sig.data(), 32);
+        ec_point_ptr R = load_public_point(group, r_comp.data(), ctx);
+        if (!R) {
             return false;
         }
 
-        // load public key
-        ec_point_ptr P = load_public_point(group.get(), pubkeys[i].data(), ctx.get());
+        // The compressed encoding already carries P's x coordinate, and
+        // decoding it rejects x >= p.
+        ec_point_ptr P = load_public_point(group, pubkeys[i].data(), ctx);
         if (!P) {
             return false;
         }
 
-        // challenge e = tagged hash(r || px || m)
-        bn_ptr px(BN_new(), &BN_clear_free);
-        if (!px || EC_POINT_get_affine_coordinates_GFp(group.get(), P.get(), px.get(), nullptr, ctx.get()) != 1) {
-            return false;
-        }
-        std::array<uint8_t, 32> pub_x{};
-        if (!bn_to_fixed_32(px.get(), pub_x.data())) {
-            return false;
-        }
-        std::array<uint8_t, 96> preimage;
-        std::memcpy(preimage.data(), sig.data(), 32);
-        std::memcpy(preimage.data() + 32, pub_x.data(), 32);
-        std::memcpy(preimage.data() + 64, msg_hashes[i].data(), 32);
-        const auto challenge = tagged_hash("BIP0340/challenge", preimage.data(), preimage.size());
-        bn_ptr e = bn_from_bytes(challenge.data(), challenge.size());
-        if (!e || BN_mod(e.get(), e.get(), order.get(), ctx.get()) != 1) {
-            return false;
-        }
-
-        bn_ptr ai = random_scalar(order.get(), ctx.get());
-        if (!ai) {
+        bn_ptr e = challenge_scalar(sctx, sig.data(), pubkeys[i].data() + 1, msg_hashes[i].data());
+        if (!e) {
             return false;
         }
 
+        bn_ptr& ai = coefficients[i];
         bn_ptr tmp(BN_new(), &BN_clear_free);
-        if (!tmp || BN_mod_mul(tmp.get(), ai.get(), s.get(), order.get(), ctx.get()) != 1) {
+        if (!tmp || BN_mod_mul(tmp.get(), ai.get(), s.get(), order, ctx) != 1) {
             return false;
         }
-        if (BN_mod_add(scalar_sum.get(), scalar_sum.get(), tmp.get(), order.get(), ctx.get()) != 1) {
+        if (BN_mod_add(scalar_sum.get(), scalar_sum.get(), tmp.get(), order, ctx) != 1) {
             return false;
         }
 
-        // rhs += ai * R
-        ec_point_ptr aR(EC_POINT_new(group.get()), &EC_POINT_free);
-        if (!aR || EC_POINT_mul(group.get(), aR.get(), nullptr, R.get(), ai.get(), ctx.get()) != 1) {
-            return false;
-        }
-        if (EC_POINT_add(group.get(), rhs.get(), rhs.get(), aR.get(), ctx.get()) != 1) {
-            return false;
-        }
-
-        // rhs += ai*e*P
         bn_ptr ae(BN_new(), &BN_clear_free);
-        if (!ae || BN_mod_mul(ae.get(), ai.get(), e.get(), order.get(), ctx.get()) != 1) {
-            return false;
-        }
-        ec_point_ptr aeP(EC_POINT_new(group.get()), &EC_POINT_free);
-        if (!aeP || EC_POINT_mul(group.get(), aeP.get(), nullptr, P.get(), ae.get(), ctx.get()) != 1) {
-            return false;
-        }
-        if (EC_POINT_add(group.get(), rhs.get(), rhs.get(), aeP.get(), ctx.get()) != 1) {
+        if (!ae || BN_mod_mul(ae.get(), ai.get(), e.get(), order, ctx) != 1) {
             return false;
         }
+        points.push_back(std::move(R));
+        scalars.push_back(std::move(ai));
+        points.push_back(std::move(P));
+        scalars.push_back(std::move(ae));
     }
 
-    ec_point_ptr lhs(EC_POINT_new(group.get()), &EC_POINT_free);
-    if (!lhs || EC_POINT_mul(group.get(), lhs.get(), scalar_sum.get(), nullptr, nullptr, ctx.get()) != 1) {
+    std::vector<const EC_POINT*> point_refs;
+    std::vector<const BIGNUM*> scalar_refs;
+    point_refs.reserve(points.size());
+    scalar_refs.reserve(scalars.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        point_refs.push_back(points[i].get());
+        scalar_refs.push_back(scalars[i].get());
+    }
+
+    ec_point_ptr lhs(EC_POINT_new(group), &EC_POINT_free);
+    ec_point_ptr rhs(EC_POINT_new(group), &EC_POINT_free);
+    if (!lhs || !rhs ||
+        !ecmult_gen(*curve, lhs.get(), scalar_sum.get(), ctx) ||
+        !ecmult_multi(*curve, rhs.get(), point_refs, scalar_refs, ctx)) {
         return false;
     }
 
-    return EC_POINT_cmp(group.get(), lhs.get(), rhs.get(), ctx.get()) == 0;
+    return EC_POINT_cmp(group, lhs.get(), rhs.get(), ctx) == 0;
 }
 
 bool VerifySchnorr(const std::array<uint8_t, 32>& pubkey_x,
                    const std::array<uint8_t, 64>& sig,
                    const std::vector<uint8_t>& msg) {
+    return VerifySchnorr(schnorr_thread_context(), pubkey_x, sig, msg);
+}
+
+bool VerifySchnorr(schnorr_context& sctx,
+                   const std::array<uint8_t, 32>& pubkey_x,
+                   const std::array<uint8_t, 64>& sig,
+                   const std::vector<uint8_t>& msg) {
     // If the caller already provides a 32-byte digest (as used by BIP-340
     // vectors), avoid hashing again. Otherwise, hash the raw bytes so legacy
     // call sites keep their behavior.
@@ -597,7 +582,7 @@ bool VerifySchnorr(const std::array<uint8_t, 32>& pubkey_x,
     compressed_pub[0] = 0x02;  // Even Y as defined by BIP-340 x-only keys
     std::copy(pubkey_x.begin(), pubkey_x.end(), compressed_pub.begin() + 1);
 
-    return schnorr_verify(compressed_pub.data(), msg_hash.data(), sig.data());
+    return schnorr_verify(sctx, compressed_pub.data(), msg_hash.data(), sig.data());
 }
 
 // -----------------------------------------------------------------------------
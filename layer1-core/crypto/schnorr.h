@@ -13,6 +13,14 @@ bool schnorr_sign(const uint8_t* private_key,
                   const uint8_t* msg_hash_32,
                   uint8_t* sig_64);
 
+// Reusable signing/verification state: the shared secp256k1 tables (group,
+// order, field prime, generator multiples), a scratch BN_CTX and the
+// BIP0340/challenge hash midstate. A context must only be used by one thread
+// at a time; schnorr_thread_context() hands out the calling thread's own,
+// built on first use. The overloads without a context use that one.
+struct schnorr_context;
+schnorr_context& schnorr_thread_context();
+
 // Deterministic signing helper that accepts caller-supplied 32-byte auxiliary
 // randomness (as defined in BIP-340). When aux_rand_32 is nullptr, falls back
 // to secure randomness. Intended for test vectors and reproducibility.
@@ -20,10 +28,19 @@ bool schnorr_sign_with_aux(const uint8_t* private_key,
                            const uint8_t* msg_hash_32,
                            const uint8_t* aux_rand_32,
                            uint8_t* sig_64);
+bool schnorr_sign_with_aux(schnorr_context& ctx,
+                           const uint8_t* private_key,
+                           const uint8_t* msg_hash_32,
+                           const uint8_t* aux_rand_32,
+                           uint8_t* sig_64);
 
 bool schnorr_verify(const uint8_t* public_key_33_compressed,
                     const uint8_t* msg_hash_32,
                     const uint8_t* sig_64);
+bool schnorr_verify(schnorr_context& ctx,
+                    const uint8_t* public_key_33_compressed,
+                    const uint8_t* msg_hash_32,
+                    const uint8_t* sig_64);
 
 // Batch verification for multiple independent signatures. All vector inputs
 // must be identical in length. Returns true if every signature validates.
@@ -33,6 +50,10 @@ bool schnorr_verify(const uint8_t* public_key_33_compressed,
 bool schnorr_batch_verify(const std::vector<std::array<uint8_t, 33>>& pubkeys,
                           const std::vector<std::array<uint8_t, 32>>& msg_hashes,
                           const std::vector<std::array<uint8_t, 64>>& signatures);
+bool schnorr_batch_verify(schnorr_context& ctx,
+                          const std::vector<std::array<uint8_t, 33>>& pubkeys,
+                          const std::vector<std::array<uint8_t, 32>>& msg_hashes,
+                          const std::vector<std::array<uint8_t, 64>>& signatures);
 
 // Convenience wrapper used by legacy call sites that provide an x-only public
 // key, raw message bytes, and a 64-byte signature. When the message is already
@@ -42,6 +63,10 @@ bool schnorr_batch_verify(const std::vector<std::array<uint8_t, 33>>& pubkeys,
 bool VerifySchnorr(const std::array<uint8_t, 32>& pubkey_x,
                    const std::array<uint8_t, 64>& sig,
                    const std::vector<uint8_t>& msg);
+bool VerifySchnorr(schnorr_context& ctx,
+                   const std::array<uint8_t, 32>& pubkey_x,
+                   const std::array<uint8_t, 64>& sig,
+                   const std::vector<uint8_t>& msg);
 
 // Example usage (see schnorr.cpp for details and testing suggestions):
 //   std::array<uint8_t,32> priv{}; // load secret key
@@ -4,6 +4,7 @@
 
 #include <array>
 #include <mutex>
+#include <stdexcept>
 #include <unordered_map>
 #include <vector>
 
@@ -22,12 +23,11 @@ static bool sha256_once(const uint8_t* data, size_t len, uint8_t out[32]) {
 
 }  // namespace
 
-uint256 tagged_hash(const std::string& tag, const uint8_t* data, size_t size) {
-    uint256 result{};
-
+SHA256_CTX tagged_hash_context(const std::string& tag) {
     static std::unordered_map<std::string, std::array<uint8_t, 32>> tag_cache;
     static std::mutex cache_mu;
 
+    SHA256_CTX ctx{};
     std::array<uint8_t, 32> tag_digest{};
     {
         std::lock_guard<std::mutex> l(cache_mu);
@@ -36,22 +36,32 @@ uint256 tagged_hash(const std::string& tag, const uint8_t* data, size_t size) {
             tag_digest = it->second;
         } else {
             if (!sha256_once(reinterpret_cast<const uint8_t*>(tag.data()), tag.size(), tag_digest.data())) {
-                return result;
+                throw std::runtime_error("tag hash failed");
             }
             tag_cache.emplace(tag, tag_digest);
         }
     }
 
+    if (SHA256_Init(&ctx) != 1 ||
+        SHA256_Update(&ctx, tag_digest.data(), sizeof(tag_digest)) != 1 ||
+        SHA256_Update(&ctx, tag_digest.data(), sizeof(tag_digest)) != 1) {
+        throw std::runtime_error("tag hash failed");
+    }
+    return ctx;
+}
+
+uint256 tagged_hash(const std::string& tag, const uint8_t* data, size_t size) {
+    uint256 result{};
+
     // Prepare SHA256(tag_hash || tag_hash || data).
     SHA256_CTX ctx{};
-    if (SHA256_Init(&ctx) != 1) {
+    try {
+        ctx = tagged_hash_context(tag);
+    } catch (const std::runtime_error&) {
         return result;
     }
 
-    const bool updated = SHA256_Update(&ctx, tag_digest.data(), sizeof(tag_digest)) == 1 &&
-                         SHA256_Update(&ctx, tag_digest.data(), sizeof(tag_digest)) == 1 &&
-                         (size == 0 || SHA256_Update(&ctx, data, size) == 1);
-
+    const bool updated = size == 0 || SHA256_Update(&ctx, data, size) == 1;
     if (!updated || SHA256_Final(result.data(), &ctx) != 1) {
         result.fill(0);
     }
@@ -3,6 +3,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <string>
+#include <openssl/sha.h>
 
 using uint256 = std::array<uint8_t, 32>;
 // BIP-340 tagged hash: SHA256(SHA256(tag) || SHA256(tag) || data)
@@ -10,3 +11,8 @@ using uint256 = std::array<uint8_t, 32>;
 // callers that supply distinct tags. Data is interpreted as a big-endian
 // buffer and not modified.
 uint256 tagged_hash(const std::string& tag, const uint8_t* data, size_t size);
+
+// Streaming form of tagged_hash: a SHA-256 context that has already absorbed
+// SHA256(tag) || SHA256(tag). Feed the data with SHA256_Update and finish
+// with SHA256_Final; the digest equals tagged_hash(tag, data, size).
+SHA256_CTX tagged_hash_context(const std::string& tag);
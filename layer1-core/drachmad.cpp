@@ -3,13 +3,20 @@
 #include <filesystem>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <string>
 #include <thread>
 #include <type_traits>
 #include <vector>
 
+#include "chainstate/coins.h"
+#include "consensus/fork_resolution.h"
 #include "consensus/params.h"
+#include "storage/block_scrubber.h"
+#include "storage/blockstore.h"
+#include "validation/checkqueue.h"
+#include "validation/sigcache.h"
 #include "validation/validation.h"
 #include "../layer2-services/policy/policy.h"
 #include "../layer2-services/mempool/mempool.h"
@@ -44,7 +51,15 @@ void PrintHelp()
     std::cout << "  --rpcpassword=<pass>  RPC password (default: pass)\n";
     std::cout << "  --rpcport=<port>      RPC port (default: 8332)\n";
     std::cout << "  --port=<port>         P2P port (default: 9333)\n";
-    std::cout << "  --nolisten            Disable P2P listening\n\n";
+    std::cout << "  --nolisten            Disable P2P listening\n";
+    std::cout << "  --par=<n>             Script verification threads (0 = one per core, <0 = leave n cores free, default: 0)\n";
+    std::cout << "  --dbcache=<n>         UTXO cache size in MiB (default: 64)\n";
+    std::cout << "  --maxsigcachesize=<n> Signature cache size in MiB (0 disables, default: 32)\n";
+    std::cout << "  --blockcachesize=<n>  Recent block cache size in MiB (0 disables, default: 32)\n";
+    std::cout << "  --blockcompression    Compress newly stored blocks (needs zlib)\n";
+    std::cout << "  --prune=<n>           Delete old block files to stay under n MiB (0 disables, minimum: 550)\n";
+    std::cout << "  --blockchecksum=<c>   Checksum for new block records: crc32c or sha256 (default: crc32c)\n";
+    std::cout << "  --scrubrate=<n>       Re-verify block files in the background at n MiB/s (0 disables, default: 0)\n\n";
     std::cout << "For more information, visit: https://github.com/Tsoympet/PARTHENON-CHAIN\n";
 }
 
@@ -64,6 +79,9 @@ std::string DefaultDataDir()
     return (base / ".drachma").string();
 }
 
+// Room for several full block files plus the retained undo data.
+constexpr uint64_t kMinPruneMiB = 550;
+
 struct Config {
     std::string network{"mainnet"};
     std::string datadir{DefaultDataDir()};
@@ -72,6 +90,14 @@ struct Config {
     uint16_t rpcport{8332};
     uint16_t p2pport{9333};
     bool listen{true};
+    int par{0};
+    size_t dbCacheMiB{kDefaultCoinsCacheBytes >> 20};
+    size_t maxSigCacheMiB{kDefaultSignatureCacheBytes >> 20};
+    size_t blockCacheMiB{BlockStore::kDefaultCacheBytes >> 20};
+    bool blockCompression{false};
+    uint64_t pruneMiB{0};
+    std::string blockChecksum{"crc32c"};
+    uint64_t scrubMiBPerSec{0};
 };
 
 Config ParseArgs(int argc, char* argv[])
@@ -98,6 +124,19 @@ Config ParseArgs(int argc, char* argv[])
         else if (takeValue("--rpcport=", cfg.rpcport)) {}
         else if (takeValue("--port=", cfg.p2pport)) {}
         else if (arg == "--nolisten") cfg.listen = false;
+        else if (takeValue("--dbcache=", cfg.dbCacheMiB)) {}
+        else if (takeValue("--maxsigcachesize=", cfg.maxSigCacheMiB)) {}
+        else if (takeValue("--blockcachesize=", cfg.blockCacheMiB)) {}
+        else if (arg == "--blockcompression") cfg.blockCompression = true;
+        else if (takeValue("--prune=", cfg.pruneMiB)) {}
+        else if (arg.rfind("--blockchecksum=", 0) == 0) cfg.blockChecksum = arg.substr(16);
+        else if (takeValue("--scrubrate=", cfg.scrubMiBPerSec)) {}
+        else if (arg.rfind("--par=", 0) == 0 || arg.rfind("-par=", 0) == 0) {
+            try {
+                cfg.par = std::stoi(arg.substr(arg.find('=') + 1));
+            } catch (...) {
+            }
+        }
     }
     return cfg;
 }
@@ -146,6 +185,8 @@ int main(int argc, char* argv[])
     EnsureDatadir(cfg.datadir);
 
     const auto& params = ParamsFor(cfg.network);
+    SetScriptCheckThreads(cfg.par);
+    SetSignatureCacheBytes(cfg.maxSigCacheMiB << 20);
 
     boost::asio::io_context io;
     policy::FeePolicy feePolicy(1, 100000, 100);
@@ -160,20 +201,68 @@ int main(int argc, char* argv[])
         // best effort; wallet will still function for watching balances
     }
 
+    Chainstate chainstate(cfg.datadir + "/chainstate", cfg.dbCacheMiB << 20);
+    BlockStore blockStore(cfg.datadir + "/blocks", BlockStore::kDefaultMaxFileSize, cfg.blockCacheMiB << 20);
+    // Finish a coins flush that was cut short before anything reads the
+    // UTXO set.
+    if (!ReplayInterruptedFlush(chainstate, blockStore)) {
+        std::cerr << "error: blocks needed to recover the chainstate after an interrupted flush are missing\n";
+        return 1;
+    }
+    if (cfg.blockCompression) {
+        if (!CompressionAvailable()) {
+            std::cerr << "warning: built without zlib, --blockcompression ignored\n";
+        } else {
+            blockStore.SetCompression(true);
+            // Until blocks exist to train on, records are compressed without one.
+            blockStore.TrainCompressionDictionary();
+        }
+    }
+    if (cfg.pruneMiB > 0) {
+        if (cfg.pruneMiB < kMinPruneMiB) {
+            std::cerr << "warning: --prune raised to the minimum of " << kMinPruneMiB << " MiB\n";
+            cfg.pruneMiB = kMinPruneMiB;
+        }
+        // Keep every block a reorganization within the finalization depth
+        // would have to disconnect.
+        blockStore.SetPruneTarget(cfg.pruneMiB << 20, consensus::ForkResolver::kDefaultFinalizationDepth);
+        blockStore.Prune();
+    }
+    if (cfg.blockChecksum == "sha256")
+        blockStore.SetRecordChecksum(RecordChecksum::Sha256);
+    else if (cfg.blockChecksum != "crc32c")
+        std::cerr << "warning: unknown --blockchecksum " << cfg.blockChecksum << ", using crc32c\n";
+    std::unique_ptr<BlockScrubber> scrubber;
+    if (cfg.scrubMiBPerSec > 0) {
+        scrubber = std::make_unique<BlockScrubber>(blockStore, cfg.scrubMiBPerSec << 20);
+        scrubber->Start();
+    }
+
     txindex::TxIndex index;
     index.Open(cfg.datadir + "/txindex");
 
     net::P2PNode p2p(io, cfg.p2pport);
     p2p.SetLocalHeight(static_cast<uint32_t>(index.BlockCount()));
+    // Block getdata is answered from the store by hash, side branches included.
+    p2p.SetBlockProvider([&blockStore](const uint256& hash) -> std::optional<std::vector<uint8_t>> {
+        try {
+            if (auto blk = blockStore.GetBlockByHash(hash))
+                return blk->raw;
+        } catch (const std::exception&) {
+            // unreadable or pruned since the lookup
+        }
+        return std::nullopt;
+    });
 
     sidechain::wasm::ExecutionEngine wasmEngine;
     sidechain::state::StateStore sidechainState;
     sidechain::rpc::WasmRpcService wasmService(wasmEngine, sidechainState);
 
     rpc::RPCServer rpc(io, cfg.rpcuser, cfg.rpcpassword, cfg.rpcport);
-    rpc.SetBlockStorePath(cfg.datadir + "/blocks.dat");
+    rpc.SetBlockStore(blockStore);
     rpc.AttachCoreHandlers(pool, wallet, index, p2p);
     rpc.AttachSidechainHandlers(wasmService);
+    rpc.AttachChainstateHandlers(chainstate, params);
 
     if (cfg.listen) {
         p2p.Start();
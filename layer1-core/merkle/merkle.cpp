@@ -4,29 +4,28 @@
 
 #include <cstring>
 #include <stdexcept>
+#include <utility>
 
 uint256 ComputeMerkleRoot(const std::vector<Transaction>& txs)
+{
+    std::vector<uint256> layer;
+    layer.reserve(txs.size());
+    for (const auto& tx : txs) {
+        layer.push_back(TransactionHash(tx));
+    }
+    return ComputeMerkleRootFromHashes(std::move(layer));
+}
+
+uint256 ComputeMerkleRootFromHashes(std::vector<uint256> layer)
 {
     // Compute the Merkle root of transactions using tagged hashing (BIP-340 style).
     // The tree is built bottom-up by pairing transaction hashes and hashing pairs
     // until a single root hash remains. Odd-sized layers duplicate the last element
     // to maintain binary tree structure (Bitcoin-style).
     
-    if (txs.empty())
+    if (layer.empty())
         return uint256{};
 
-    // Edge case: single transaction returns its hash directly
-    if (txs.size() == 1)
-        return TransactionHash(txs[0]);
-
-    // Build initial layer of transaction hashes
-    // Note: uint256 is std::array<uint8_t, 32>, size is guaranteed to be 32
-    std::vector<uint256> layer;
-    layer.reserve(txs.size());
-    for (const auto& tx : txs) {
-        layer.push_back(TransactionHash(tx));
-    }
-
     // Optimize: use single allocation for concat buffer outside loop
     uint8_t concat[64];
     
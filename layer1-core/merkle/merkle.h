@@ -4,3 +4,5 @@
 #include "../tx/transaction.h"
 
 uint256 ComputeMerkleRoot(const std::vector<Transaction>& txs);
+// Root over already computed transaction hashes, in block order.
+uint256 ComputeMerkleRootFromHashes(std::vector<uint256> hashes);
@@ -8,7 +8,12 @@
 // Minimal script: scriptPubKey encodes a 32-byte x-only public key.
 // scriptSig encodes a 64-byte Schnorr signature over the transaction hash.
 
-bool VerifyScript(const Transaction& tx, size_t inputIndex, const TxOut& utxo)
+bool ExtractSchnorrCheck(const Transaction& tx, size_t inputIndex, const TxOut& utxo, SchnorrSigCheck& out)
+{
+    return ExtractSchnorrCheck(tx, inputIndex, utxo, PrecomputedTransactionData(tx), out);
+}
+
+bool ExtractSchnorrCheck(const Transaction& tx, size_t inputIndex, const TxOut& utxo, const PrecomputedTransactionData& txdata, SchnorrSigCheck& out)
 {
     if (inputIndex >= tx.vin.size())
         throw std::runtime_error("input index out of range");
@@ -20,13 +25,30 @@ bool VerifyScript(const Transaction& tx, size_t inputIndex, const TxOut& utxo)
     if (utxo.scriptPubKey.size() != 32)
         return false;
 
-    std::array<uint8_t,64> sig{};
-    std::copy(in.scriptSig.begin(), in.scriptSig.end(), sig.begin());
+    std::copy(in.scriptSig.begin(), in.scriptSig.end(), out.sig.begin());
+    std::copy(utxo.scriptPubKey.begin(), utxo.scriptPubKey.end(), out.pubkey.begin());
+    out.digest = txdata.InputDigest(inputIndex);
+    return true;
+}
 
-    std::array<uint8_t,32> pubkey{};
-    std::copy(utxo.scriptPubKey.begin(), utxo.scriptPubKey.end(), pubkey.begin());
+bool VerifySchnorrCheck(const SchnorrSigCheck& check)
+{
+    // x-only keys carry an implicit even Y, as in VerifySchnorr.
+    std::array<uint8_t, 33> compressed{};
+    compressed[0] = 0x02;
+    std::copy(check.pubkey.begin(), check.pubkey.end(), compressed.begin() + 1);
+    return schnorr_verify(compressed.data(), check.digest.data(), check.sig.data());
+}
 
-    auto digest = ComputeInputDigest(tx, inputIndex);
-    std::vector<uint8_t> msg(digest.begin(), digest.end());
-    return VerifySchnorr(pubkey, sig, msg);
+bool VerifyScript(const Transaction& tx, size_t inputIndex, const TxOut& utxo)
+{
+    return VerifyScript(tx, inputIndex, utxo, PrecomputedTransactionData(tx));
+}
+
+bool VerifyScript(const Transaction& tx, size_t inputIndex, const TxOut& utxo, const PrecomputedTransactionData& txdata)
+{
+    SchnorrSigCheck check;
+    if (!ExtractSchnorrCheck(tx, inputIndex, utxo, txdata, check))
+        return false;
+    return VerifySchnorrCheck(check);
 }
@@ -1,7 +1,25 @@
 #pragma once
 #include "../tx/transaction.h"
+#include <array>
+#include <cstdint>
 
 // Validate an input's signature against the provided UTXO's scriptPubKey.
 // This overload requires the caller to supply the previous output being spent
 // to avoid assuming the input references an output within the same transaction.
 bool VerifyScript(const Transaction& tx, size_t inputIndex, const TxOut& utxo);
+// As above, reusing sighash state precomputed once for all of tx's inputs.
+bool VerifyScript(const Transaction& tx, size_t inputIndex, const TxOut& utxo, const PrecomputedTransactionData& txdata);
+
+// The signature check VerifyScript would perform, extracted so callers can
+// verify many inputs at once with schnorr_batch_verify.
+struct SchnorrSigCheck {
+    std::array<uint8_t, 32> pubkey{};
+    std::array<uint8_t, 32> digest{};
+    std::array<uint8_t, 64> sig{};
+};
+
+// Returns false when the input or output is malformed and can never verify.
+bool ExtractSchnorrCheck(const Transaction& tx, size_t inputIndex, const TxOut& utxo, SchnorrSigCheck& out);
+bool ExtractSchnorrCheck(const Transaction& tx, size_t inputIndex, const TxOut& utxo, const PrecomputedTransactionData& txdata, SchnorrSigCheck& out);
+// Verify an extracted check on its own.
+bool VerifySchnorrCheck(const SchnorrSigCheck& check);
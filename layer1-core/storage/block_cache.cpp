@@ -0,0 +1,68 @@
+#include "block_cache.h"
+#include <utility>
+
+std::size_t CachedBlockBytes(const CachedBlock& entry)
+{
+    std::size_t total = sizeof(CachedBlock) + entry.raw.capacity() +
+                        entry.block.transactions.capacity() * sizeof(Transaction);
+    for (const auto& tx : entry.block.transactions) {
+        total += tx.vin.capacity() * sizeof(TxIn) + tx.vout.capacity() * sizeof(TxOut);
+        for (const auto& in : tx.vin)
+            total += in.scriptSig.capacity();
+        for (const auto& out : tx.vout)
+            total += out.scriptPubKey.capacity();
+    }
+    return total;
+}
+
+BlockCache::BlockCache(std::size_t maxBytes_) : maxBytes(maxBytes_) {}
+
+std::shared_ptr<const CachedBlock> BlockCache::Get(uint32_t height)
+{
+    std::lock_guard<std::mutex> l(mu);
+    auto it = nodes.find(height);
+    if (it == nodes.end()) {
+        ++misses;
+        return nullptr;
+    }
+    ++hits;
+    lru.splice(lru.begin(), lru, it->second.lru);
+    return it->second.entry;
+}
+
+void BlockCache::Put(uint32_t height, std::shared_ptr<const CachedBlock> entry)
+{
+    const std::size_t size = CachedBlockBytes(*entry);
+    std::lock_guard<std::mutex> l(mu);
+    auto existing = nodes.find(height);
+    if (existing != nodes.end())
+        EraseLocked(existing);
+    if (size > maxBytes)
+        return;
+    while (bytes + size > maxBytes)
+        EraseLocked(nodes.find(lru.back()));
+    lru.push_front(height);
+    nodes.emplace(height, Node{std::move(entry), size, lru.begin()});
+    bytes += size;
+}
+
+void BlockCache::Erase(uint32_t height)
+{
+    std::lock_guard<std::mutex> l(mu);
+    auto it = nodes.find(height);
+    if (it != nodes.end())
+        EraseLocked(it);
+}
+
+BlockCache::Stats BlockCache::GetStats() const
+{
+    std::lock_guard<std::mutex> l(mu);
+    return Stats{hits, misses, nodes.size(), bytes, maxBytes};
+}
+
+void BlockCache::EraseLocked(std::unordered_map<uint32_t, Node>::iterator it)
+{
+    bytes -= it->second.bytes;
+    lru.erase(it->second.lru);
+    nodes.erase(it);
+}
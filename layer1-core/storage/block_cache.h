@@ -0,0 +1,62 @@
+#pragma once
+
+#include "../block/block.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// A block as the store hands it out: decoded for validation and RPC, plus
+// the stored payload ([header][u32 tx count]([u32 size][tx])*) that P2P can
+// send without re-serializing. Entries are shared and never modified.
+struct CachedBlock {
+    Block block;
+    std::vector<uint8_t> raw;
+};
+
+// Approximate heap footprint of an entry, used for the byte budget.
+std::size_t CachedBlockBytes(const CachedBlock& entry);
+
+// Height-keyed LRU of recently written or read blocks, bounded by the total
+// CachedBlockBytes of its entries. A budget of zero disables caching.
+// Thread-safe.
+class BlockCache {
+public:
+    struct Stats {
+        uint64_t hits{0};
+        uint64_t misses{0};
+        std::size_t entries{0};
+        std::size_t bytes{0};
+        std::size_t maxBytes{0};
+    };
+
+    explicit BlockCache(std::size_t maxBytes);
+
+    bool Enabled() const { return maxBytes > 0; }
+    // Counts a hit or a miss.
+    std::shared_ptr<const CachedBlock> Get(uint32_t height);
+    // Insert or replace the entry for `height` and evict down to the budget.
+    void Put(uint32_t height, std::shared_ptr<const CachedBlock> entry);
+    void Erase(uint32_t height);
+    Stats GetStats() const;
+
+private:
+    struct Node {
+        std::shared_ptr<const CachedBlock> entry;
+        std::size_t bytes;
+        std::list<uint32_t>::iterator lru;
+    };
+
+    mutable std::mutex mu;
+    std::size_t maxBytes;
+    std::size_t bytes{0};
+    uint64_t hits{0};
+    uint64_t misses{0};
+    std::list<uint32_t> lru; // most recently used first
+    std::unordered_map<uint32_t, Node> nodes;
+
+    void EraseLocked(std::unordered_map<uint32_t, Node>::iterator it);
+};
@@ -0,0 +1,159 @@
+#include "block_hash_index.h"
+#include <cstring>
+#include <stdexcept>
+
+#ifdef DRACHMA_HAVE_LEVELDB
+#include <leveldb/iterator.h>
+#include <leveldb/write_batch.h>
+#endif
+
+namespace {
+
+#ifdef DRACHMA_HAVE_LEVELDB
+constexpr char kBlockPrefix = 'b';
+const std::string kEndKey = "E";
+constexpr std::size_t kValueSize = 20;
+constexpr std::size_t kEndSize = 12;
+
+std::string EncodeKey(const uint256& hash)
+{
+    std::string key(1, kBlockPrefix);
+    key.append(reinterpret_cast<const char*>(hash.data()), hash.size());
+    return key;
+}
+
+std::string EncodeValue(const BlockLocation& loc)
+{
+    std::string val(kValueSize, '\0');
+    std::memcpy(&val[0], &loc.pos.file, 4);
+    std::memcpy(&val[4], &loc.pos.length, 4);
+    std::memcpy(&val[8], &loc.pos.offset, 8);
+    std::memcpy(&val[16], &loc.height, 4);
+    return val;
+}
+
+bool DecodeValue(const char* data, std::size_t size, BlockLocation& loc)
+{
+    if (size != kValueSize)
+        return false;
+    std::memcpy(&loc.pos.file, data, 4);
+    std::memcpy(&loc.pos.length, data + 4, 4);
+    std::memcpy(&loc.pos.offset, data + 8, 8);
+    std::memcpy(&loc.height, data + 16, 4);
+    return loc.pos.length > 0;
+}
+#endif
+
+bool After(const FlatFilePos& a, const FlatFilePos& b)
+{
+    return a.file > b.file || (a.file == b.file && a.offset > b.offset);
+}
+
+} // namespace
+
+BlockHashIndex::BlockHashIndex(const std::string& path)
+{
+#ifdef DRACHMA_HAVE_LEVELDB
+    leveldb::Options opts;
+    opts.create_if_missing = true;
+    leveldb::DB* raw = nullptr;
+    auto status = leveldb::DB::Open(opts, path, &raw);
+    if (!status.ok())
+        throw std::runtime_error("cannot open block hash index " + path + ": " + status.ToString());
+    db.reset(raw);
+    std::string val;
+    if (db->Get(leveldb::ReadOptions(), kEndKey, &val).ok()) {
+        if (val.size() != kEndSize)
+            throw std::runtime_error("corrupt block hash index " + path);
+        std::memcpy(&end.file, val.data(), 4);
+        std::memcpy(&end.offset, val.data() + 4, 8);
+    }
+#else
+    (void)path;
+#endif
+}
+
+BlockHashIndex::~BlockHashIndex() = default;
+
+std::optional<BlockLocation> BlockHashIndex::Get(const uint256& hash) const
+{
+#ifdef DRACHMA_HAVE_LEVELDB
+    std::string val;
+    BlockLocation loc;
+    if (!db->Get(leveldb::ReadOptions(), EncodeKey(hash), &val).ok() || !DecodeValue(val.data(), val.size(), loc))
+        return std::nullopt;
+    return loc;
+#else
+    auto it = entries.find(hash);
+    if (it == entries.end())
+        return std::nullopt;
+    return it->second;
+#endif
+}
+
+void BlockHashIndex::Put(const uint256& hash, const BlockLocation& loc)
+{
+    const FlatFilePos recordEnd{loc.pos.file, loc.pos.offset + loc.pos.length};
+    const bool extends = After(recordEnd, end);
+#ifdef DRACHMA_HAVE_LEVELDB
+    leveldb::WriteBatch batch;
+    batch.Put(EncodeKey(hash), EncodeValue(loc));
+    if (extends) {
+        std::string val(kEndSize, '\0');
+        std::memcpy(&val[0], &recordEnd.file, 4);
+        std::memcpy(&val[4], &recordEnd.offset, 8);
+        batch.Put(kEndKey, val);
+    }
+    auto status = db->Write(leveldb::WriteOptions(), &batch);
+    if (!status.ok())
+        throw std::runtime_error("block hash index write failed: " + status.ToString());
+#else
+    entries[hash] = loc;
+#endif
+    if (extends)
+        end = recordEnd;
+}
+
+void BlockHashIndex::Erase(const std::vector<uint256>& hashes)
+{
+    if (hashes.empty())
+        return;
+#ifdef DRACHMA_HAVE_LEVELDB
+    leveldb::WriteBatch batch;
+    for (const auto& hash : hashes)
+        batch.Delete(EncodeKey(hash));
+    auto status = db->Write(leveldb::WriteOptions(), &batch);
+    if (!status.ok())
+        throw std::runtime_error("block hash index write failed: " + status.ToString());
+#else
+    for (const auto& hash : hashes)
+        entries.erase(hash);
+#endif
+}
+
+void BlockHashIndex::ForEach(const Visitor& visit) const
+{
+#ifdef DRACHMA_HAVE_LEVELDB
+    std::unique_ptr<leveldb::Iterator> it(db->NewIterator(leveldb::ReadOptions()));
+    const std::string prefix(1, kBlockPrefix);
+    for (it->Seek(prefix); it->Valid(); it->Next()) {
+        const auto key = it->key();
+        if (key.size() == 0 || key.data()[0] != kBlockPrefix)
+            break;
+        if (key.size() != 1 + 32)
+            continue;
+        BlockLocation loc;
+        const auto val = it->value();
+        if (!DecodeValue(val.data(), val.size(), loc))
+            continue;
+        uint256 hash{};
+        std::memcpy(hash.data(), key.data() + 1, hash.size());
+        visit(hash, loc);
+    }
+    if (!it->status().ok())
+        throw std::runtime_error("block hash index iteration failed: " + it->status().ToString());
+#else
+    for (const auto& [hash, loc] : entries)
+        visit(hash, loc);
+#endif
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../crypto/tagged_hash.h"
+#include "block_index.h"
+#include "flatfile.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifdef DRACHMA_HAVE_LEVELDB
+#include <leveldb/db.h>
+#endif
+
+// Where a block is stored and the height it was stored for.
+struct BlockLocation {
+    BlockPos pos;
+    uint32_t height{0};
+};
+
+// Block hash -> BlockLocation, covering every block the store has written:
+// the active chain and side branches alike, so a getdata by hash is one
+// lookup and one read. Kept in LevelDB under [b][hash(32)] with values
+// [file(4)][length(4)][offset(8)][height(4)], plus the end of the furthest
+// record any entry points at ('E' = [file(4)][offset(8)]), so appends can
+// resume past side-branch blocks that have no height slot.
+//
+// Writes are not synced. After a crash an entry may name a record that was
+// never made durable; BlockStore checks the block it reads against the
+// hash. Builds without LevelDB keep the map in memory only.
+//
+// Not synchronized; BlockStore serializes access.
+class BlockHashIndex {
+public:
+    using Visitor = std::function<void(const uint256& hash, const BlockLocation& loc)>;
+
+    // Opens or creates the index; throws std::runtime_error on failure.
+    explicit BlockHashIndex(const std::string& path);
+    ~BlockHashIndex();
+    BlockHashIndex(const BlockHashIndex&) = delete;
+    BlockHashIndex& operator=(const BlockHashIndex&) = delete;
+
+    std::optional<BlockLocation> Get(const uint256& hash) const;
+    void Put(const uint256& hash, const BlockLocation& loc);
+    void Erase(const std::vector<uint256>& hashes);
+    void ForEach(const Visitor& visit) const;
+    FlatFilePos End() const { return end; }
+
+private:
+#ifdef DRACHMA_HAVE_LEVELDB
+    std::unique_ptr<leveldb::DB> db;
+#else
+    std::map<uint256, BlockLocation> entries;
+#endif
+    FlatFilePos end{};
+};
@@ -0,0 +1,251 @@
+#include "block_index.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr uint32_t kIndexMagic = 0x58444948; // "HIDX"
+constexpr uint32_t kIndexVersion = 1;
+constexpr std::size_t kCountOffset = 8;
+constexpr std::size_t kPrunedOffset = 16;
+constexpr uint64_t kMapBytes = BlockHeightIndex::kHeaderSize +
+                               static_cast<uint64_t>(BlockHeightIndex::kMaxHeights) * BlockHeightIndex::kSlotSize;
+
+#ifdef _WIN32
+bool WriteThrough(int fd, const uint8_t* data, std::size_t size, uint64_t offset)
+{
+    return ::_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) >= 0 &&
+           ::_write(fd, data, static_cast<unsigned int>(size)) == static_cast<int>(size);
+}
+#endif
+
+} // namespace
+
+BlockHeightIndex::BlockHeightIndex(const std::string& path_) : path(path_)
+{
+#ifdef _WIN32
+    fd = ::_open(path.c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+    if (fd < 0)
+        throw std::runtime_error("cannot open block index " + path);
+    const __int64 existing = ::_lseeki64(fd, 0, SEEK_END);
+    fileBytes = existing < 0 ? 0 : static_cast<uint64_t>(existing);
+    buffer.resize(static_cast<std::size_t>(fileBytes));
+    if (fileBytes > 0 && (::_lseeki64(fd, 0, SEEK_SET) < 0 ||
+                          ::_read(fd, buffer.data(), static_cast<unsigned int>(fileBytes)) != static_cast<int>(fileBytes))) {
+        ::_close(fd);
+        throw std::runtime_error("cannot read block index " + path);
+    }
+    map = buffer.data();
+#else
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throw std::runtime_error("cannot open block index " + path);
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("cannot stat block index " + path);
+    }
+    fileBytes = static_cast<uint64_t>(st.st_size);
+    // Reserve the address range once so slots never move as the file grows;
+    // only the part backed by the file is ever touched.
+    void* m = ::mmap(nullptr, kMapBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("cannot map block index " + path);
+    }
+    map = static_cast<uint8_t*>(m);
+#endif
+
+    try {
+        if (fileBytes == 0) {
+            Grow(kHeaderSize + static_cast<uint64_t>(kGrowSlots) * kSlotSize);
+            uint8_t header[kHeaderSize] = {};
+            std::memcpy(header, &kIndexMagic, sizeof(kIndexMagic));
+            std::memcpy(header + 4, &kIndexVersion, sizeof(kIndexVersion));
+            std::memcpy(map, header, sizeof(header));
+#ifdef _WIN32
+            if (!WriteThrough(fd, header, sizeof(header), 0))
+                throw std::runtime_error("cannot write block index " + path);
+#endif
+        }
+        uint32_t magic = 0, version = 0;
+        uint64_t count = 0;
+        if (fileBytes < kHeaderSize)
+            throw std::runtime_error("truncated block index " + path);
+        std::memcpy(&magic, map, sizeof(magic));
+        std::memcpy(&version, map + 4, sizeof(version));
+        std::memcpy(&count, map + kCountOffset, sizeof(count));
+        std::memcpy(&prunedHeight, map + kPrunedOffset, sizeof(prunedHeight));
+        if (magic != kIndexMagic || version != kIndexVersion || count > kMaxHeights ||
+            kHeaderSize + count * kSlotSize > fileBytes)
+            throw std::runtime_error("corrupt block index " + path);
+        size = static_cast<uint32_t>(count);
+    } catch (...) {
+#ifndef _WIN32
+        ::munmap(map, kMapBytes);
+        ::close(fd);
+#else
+        ::_close(fd);
+#endif
+        throw;
+    }
+}
+
+BlockHeightIndex::~BlockHeightIndex()
+{
+    // No implicit Sync: the count may only advance once the owner has made
+    // the referenced records durable.
+#ifndef _WIN32
+    ::munmap(map, kMapBytes);
+    ::close(fd);
+#else
+    ::_close(fd);
+#endif
+}
+
+void BlockHeightIndex::Grow(uint64_t bytes)
+{
+#ifdef _WIN32
+    if (::_chsize_s(fd, static_cast<__int64>(bytes)) != 0)
+        throw std::runtime_error("cannot grow block index " + path);
+    buffer.resize(static_cast<std::size_t>(bytes));
+    map = buffer.data();
+#else
+    if (::ftruncate(fd, static_cast<off_t>(bytes)) != 0)
+        throw std::runtime_error("cannot grow block index " + path);
+#endif
+    fileBytes = bytes;
+}
+
+std::optional<BlockPos> BlockHeightIndex::Get(uint32_t height) const
+{
+    if (height >= size)
+        return std::nullopt;
+    const uint8_t* slot = Slot(height);
+    BlockPos pos;
+    std::memcpy(&pos.file, slot, sizeof(pos.file));
+    std::memcpy(&pos.length, slot + 4, sizeof(pos.length));
+    std::memcpy(&pos.offset, slot + 8, sizeof(pos.offset));
+    if (pos.length == 0)
+        return std::nullopt;
+    return pos;
+}
+
+void BlockHeightIndex::Set(uint32_t height, const BlockPos& pos)
+{
+    if (height >= kMaxHeights)
+        throw std::runtime_error("block height beyond index capacity");
+    const uint64_t needed = kHeaderSize + (static_cast<uint64_t>(height) + 1) * kSlotSize;
+    if (needed > fileBytes) {
+        const uint64_t step = static_cast<uint64_t>(kGrowSlots) * kSlotSize;
+        Grow(std::min(kMapBytes, kHeaderSize + (needed - kHeaderSize + step - 1) / step * step));
+    }
+    dirtyFrom = std::min(dirtyFrom, std::min(height, size));
+    if (height >= size) {
+        // Slots past the synced count may hold leftovers from before a crash.
+        std::memset(Slot(size), 0, static_cast<std::size_t>(height - size) * kSlotSize);
+#ifdef _WIN32
+        if (height > size && !WriteThrough(fd, Slot(size), static_cast<std::size_t>(height - size) * kSlotSize,
+                                           kHeaderSize + static_cast<uint64_t>(size) * kSlotSize))
+            throw std::runtime_error("cannot write block index " + path);
+#endif
+        size = height + 1;
+    }
+    uint8_t* slot = Slot(height);
+    std::memcpy(slot, &pos.file, sizeof(pos.file));
+    std::memcpy(slot + 4, &pos.length, sizeof(pos.length));
+    std::memcpy(slot + 8, &pos.offset, sizeof(pos.offset));
+#ifdef _WIN32
+    if (!WriteThrough(fd, slot, kSlotSize, kHeaderSize + static_cast<uint64_t>(height) * kSlotSize))
+        throw std::runtime_error("cannot write block index " + path);
+#endif
+}
+
+void BlockHeightIndex::Erase(uint32_t height)
+{
+    if (height >= size)
+        return;
+    dirtyFrom = std::min(dirtyFrom, height);
+    uint8_t* slot = Slot(height);
+    std::memset(slot, 0, kSlotSize);
+#ifdef _WIN32
+    if (!WriteThrough(fd, slot, kSlotSize, kHeaderSize + static_cast<uint64_t>(height) * kSlotSize))
+        throw std::runtime_error("cannot write block index " + path);
+#endif
+}
+
+void BlockHeightIndex::Truncate(uint32_t height)
+{
+    if (height >= size)
+        return;
+    const std::size_t bytes = static_cast<std::size_t>(size - height) * kSlotSize;
+    std::memset(Slot(height), 0, bytes);
+#ifdef _WIN32
+    if (!WriteThrough(fd, Slot(height), bytes, kHeaderSize + static_cast<uint64_t>(height) * kSlotSize))
+        throw std::runtime_error("cannot write block index " + path);
+#endif
+    size = height;
+    dirtyFrom = std::min(dirtyFrom, height);
+}
+
+FlatFilePos BlockHeightIndex::End() const
+{
+    FlatFilePos end{};
+    for (uint32_t h = 0; h < size; ++h) {
+        const auto pos = Get(h);
+        if (!pos)
+            continue;
+        const uint64_t recordEnd = pos->offset + pos->length;
+        if (pos->file > end.file || (pos->file == end.file && recordEnd > end.offset))
+            end = FlatFilePos{pos->file, recordEnd};
+    }
+    return end;
+}
+
+void BlockHeightIndex::Sync()
+{
+    const uint64_t count = size;
+    uint64_t stored = 0;
+    uint32_t storedPruned = 0;
+    std::memcpy(&stored, map + kCountOffset, sizeof(stored));
+    std::memcpy(&storedPruned, map + kPrunedOffset, sizeof(storedPruned));
+    const bool headerChanged = stored != count || storedPruned != prunedHeight;
+#ifdef _WIN32
+    if (headerChanged) {
+        std::memcpy(map + kCountOffset, &count, sizeof(count));
+        std::memcpy(map + kPrunedOffset, &prunedHeight, sizeof(prunedHeight));
+        if (!WriteThrough(fd, map + kCountOffset, kPrunedOffset + sizeof(prunedHeight) - kCountOffset, kCountOffset))
+            throw std::runtime_error("cannot write block index " + path);
+    }
+    if (::_commit(fd) != 0)
+        throw std::runtime_error("cannot sync block index " + path);
+#else
+    // Slots first, then the count that makes them visible after a restart.
+    if (dirtyFrom < size) {
+        const uint64_t page = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+        const uint64_t begin = (kHeaderSize + static_cast<uint64_t>(dirtyFrom) * kSlotSize) / page * page;
+        const uint64_t end = kHeaderSize + static_cast<uint64_t>(size) * kSlotSize;
+        if (::msync(map + begin, static_cast<std::size_t>(end - begin), MS_SYNC) != 0)
+            throw std::runtime_error("cannot sync block index " + path);
+    }
+    if (headerChanged) {
+        std::memcpy(map + kCountOffset, &count, sizeof(count));
+        std::memcpy(map + kPrunedOffset, &prunedHeight, sizeof(prunedHeight));
+        if (::msync(map, kHeaderSize, MS_SYNC) != 0)
+            throw std::runtime_error("cannot sync block index " + path);
+    }
+#endif
+    dirtyFrom = kMaxHeights;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "flatfile.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Where a block or undo record lives: file number, byte offset and the
+// length of the whole record including its header.
+struct BlockPos {
+    uint32_t file{0};
+    uint64_t offset{0};
+    uint32_t length{0};
+};
+
+// Height -> BlockPos table in a memory-mapped file with one fixed-size slot
+// per height, so a lookup is an array access and recording a block writes a
+// single slot; the file is never rewritten.
+//
+// Layout: header [magic(4)][version(4)][count(8)][pruned(4)][reserved(12)],
+// then the
+// slot for height h at kHeaderSize + h * kSlotSize, holding
+// [file(4)][length(4)][offset(8)]. A zero length marks an empty slot;
+// `pruned` is one past the highest height whose record was deleted. Only
+// the first `count` slots are trusted when the file is opened; Sync()
+// advances count and must be called only once the records the slots point
+// at are durable. The file grows kGrowSlots slots at a time inside a
+// mapping reserved once for kMaxHeights slots.
+//
+// Not synchronized; BlockStore serializes access.
+class BlockHeightIndex {
+public:
+    static constexpr std::size_t kHeaderSize = 32;
+    static constexpr std::size_t kSlotSize = 16;
+    static constexpr uint32_t kMaxHeights = 1u << 24;
+    static constexpr uint32_t kGrowSlots = 1u << 14;
+
+    // Opens or creates the index; throws std::runtime_error if it is corrupt.
+    explicit BlockHeightIndex(const std::string& path);
+    ~BlockHeightIndex();
+    BlockHeightIndex(const BlockHeightIndex&) = delete;
+    BlockHeightIndex& operator=(const BlockHeightIndex&) = delete;
+
+    std::optional<BlockPos> Get(uint32_t height) const;
+    void Set(uint32_t height, const BlockPos& pos);
+    // Empty the slot for `height`, e.g. once its record has been pruned.
+    void Erase(uint32_t height);
+    // Empty every slot from `height` up and shrink the count to match;
+    // the smaller count is persisted by the next Sync.
+    void Truncate(uint32_t height);
+    // Heights below this may have had their records deleted.
+    uint32_t PrunedHeight() const { return prunedHeight; }
+    // Raise the pruned height; persisted by the next Sync.
+    void SetPrunedHeight(uint32_t height) { prunedHeight = std::max(prunedHeight, height); }
+    // Number of slots in use (one past the highest height ever set).
+    uint32_t Size() const { return size; }
+    // End of the furthest record any slot points at; where appends resume.
+    FlatFilePos End() const;
+    void Sync();
+
+private:
+    std::string path;
+    uint8_t* map{nullptr};
+    std::vector<uint8_t> buffer; // stands in for the mapping where mmap is unavailable
+    uint64_t fileBytes{0};
+    uint32_t size{0};
+    uint32_t prunedHeight{0};
+    uint32_t dirtyFrom{kMaxHeights}; // lowest slot written since the last Sync
+    int fd{-1};
+
+    uint8_t* Slot(uint32_t height) const { return map + kHeaderSize + static_cast<std::size_t>(height) * kSlotSize; }
+    void Grow(uint64_t bytes);
+};
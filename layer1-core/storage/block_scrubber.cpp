@@ -0,0 +1,125 @@
+#include "block_scrubber.h"
+#include <iostream>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+void LowerThreadPriority()
+{
+#if defined(__linux__)
+    // Nice values are per thread on Linux.
+    ::setpriority(PRIO_PROCESS, static_cast<id_t>(::syscall(SYS_gettid)), 19);
+#endif
+}
+
+} // namespace
+
+BlockScrubber::BlockScrubber(BlockStore& store_, uint64_t bytesPerSecond_, Reporter report_,
+                             std::chrono::milliseconds pause_)
+    : store(store_), bytesPerSecond(bytesPerSecond_), report(std::move(report_)), pause(pause_)
+{
+    if (!report) {
+        report = [](const Corruption& c) {
+            std::cerr << "block scrubber: " << (c.undo ? "rev" : "blk") << " file " << c.pos.file << " offset "
+                      << c.pos.offset << ": " << c.error << "\n";
+        };
+    }
+}
+
+BlockScrubber::~BlockScrubber()
+{
+    Stop();
+}
+
+void BlockScrubber::Start()
+{
+    Stop();
+    {
+        std::lock_guard<std::mutex> l(mu);
+        stopping = false;
+    }
+    worker = std::thread([this] {
+        LowerThreadPriority();
+        while (RunPass()) {
+            if (!WaitUntil(std::chrono::steady_clock::now() + pause))
+                break;
+        }
+    });
+}
+
+void BlockScrubber::Stop()
+{
+    {
+        std::lock_guard<std::mutex> l(mu);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+bool BlockScrubber::WaitUntil(std::chrono::steady_clock::time_point until)
+{
+    std::unique_lock<std::mutex> l(mu);
+    return !cv.wait_until(l, until, [this] { return stopping; });
+}
+
+bool BlockScrubber::RunPass()
+{
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t passBytes = 0;
+    if (!ScrubFiles(false, start, passBytes) || !ScrubFiles(true, start, passBytes))
+        return false;
+    std::lock_guard<std::mutex> l(mu);
+    ++stats.passes;
+    return !stopping;
+}
+
+bool BlockScrubber::ScrubFiles(bool undo, std::chrono::steady_clock::time_point start, uint64_t& passBytes)
+{
+    const uint32_t lastFile = store.RecordsEnd(undo).file;
+    for (uint32_t file = 0; file <= lastFile; ++file) {
+        FlatFilePos pos{file, 0};
+        for (;;) {
+            const auto check = store.CheckRecordAt(undo, pos);
+            if (check.status == BlockStore::RecordCheck::Status::End ||
+                check.status == BlockStore::RecordCheck::Status::Missing)
+                break;
+            {
+                std::lock_guard<std::mutex> l(mu);
+                if (stopping)
+                    return false;
+                ++stats.records;
+                stats.bytes += check.length;
+                if (check.status == BlockStore::RecordCheck::Status::Corrupt)
+                    ++stats.corrupt;
+            }
+            if (check.status == BlockStore::RecordCheck::Status::Corrupt)
+                report(Corruption{undo, pos, check.error});
+            if (check.length == 0)
+                break;
+            pos.offset += check.length;
+
+            // Stay at or below the configured rate over the whole pass.
+            passBytes += check.length;
+            if (bytesPerSecond > 0) {
+                const auto due = start + std::chrono::microseconds(passBytes * 1000000 / bytesPerSecond);
+                if (due > std::chrono::steady_clock::now() && !WaitUntil(due))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+BlockScrubber::Stats BlockScrubber::GetStats() const
+{
+    std::lock_guard<std::mutex> l(mu);
+    return stats;
+}
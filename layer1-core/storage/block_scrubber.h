@@ -0,0 +1,64 @@
+#pragma once
+
+#include "blockstore.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Background integrity check of a BlockStore. A low-priority thread walks
+// the block and undo files record by record, verifying each checksum, at no
+// more than bytesPerSecond (0 = unthrottled), and starts a new pass after
+// `pause`. Corrupt records are counted and handed to the reporter; a
+// corrupt size field ends the walk of that file, since the next record
+// cannot be located. Reads on the request path still verify what they
+// read; the scrubber finds damage in blocks nobody has asked for.
+class BlockScrubber {
+public:
+    struct Corruption {
+        bool undo{false};
+        FlatFilePos pos;
+        std::string error;
+    };
+    using Reporter = std::function<void(const Corruption&)>;
+
+    struct Stats {
+        uint64_t passes{0};
+        uint64_t records{0};
+        uint64_t bytes{0};
+        uint64_t corrupt{0};
+    };
+
+    // Without a reporter, corruption is written to stderr.
+    BlockScrubber(BlockStore& store, uint64_t bytesPerSecond, Reporter report = {},
+                  std::chrono::milliseconds pause = std::chrono::hours(6));
+    ~BlockScrubber();
+    BlockScrubber(const BlockScrubber&) = delete;
+    BlockScrubber& operator=(const BlockScrubber&) = delete;
+
+    void Start();
+    // Interrupts a pass in progress; Start resumes with a new pass.
+    void Stop();
+    // One full pass on the calling thread. Returns false if it was stopped.
+    bool RunPass();
+    Stats GetStats() const;
+
+private:
+    BlockStore& store;
+    uint64_t bytesPerSecond;
+    Reporter report;
+    std::chrono::milliseconds pause;
+    std::thread worker;
+    mutable std::mutex mu;
+    std::condition_variable cv;
+    bool stopping{false};
+    Stats stats;
+
+    bool ScrubFiles(bool undo, std::chrono::steady_clock::time_point start, uint64_t& passBytes);
+    // Sleep until `until` or a stop; false if stopped.
+    bool WaitUntil(std::chrono::steady_clock::time_point until);
+};
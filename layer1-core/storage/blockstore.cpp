@@ -1,184 +1,660 @@
-#include "../block/block.h"
+#include "blockstore.h"
+#include "../block/block_view.h"
+#include "../crypto/crc32c.h"
+#include <algorithm>
+#include <array>
+#include <filesystem>
 #include <fstream>
-#include <unordered_map>
-#include <mutex>
+#include <iterator>
 #include <stdexcept>
-#include <vector>
 #include <cstring>
 #include <openssl/evp.h>
 
-class BlockStore {
-public:
-    explicit BlockStore(const std::string& path): path(path) { LoadIndex(); }
-    
-    ~BlockStore() {
-        std::lock_guard<std::mutex> l(mu);
-        FlushIndex();
+namespace {
+
+// Record header: [u32 size | flags][checksum]. The checksum is a CRC-32C
+// (4 bytes) when kCrc32cRecordFlag is set, otherwise SHA-256 (32 bytes), and
+// covers the data that follows.
+constexpr uint32_t kCrc32cRecordFlag = 0x40000000u;
+constexpr uint32_t kRecordSizeMask = ~(kCompressedRecordFlag | kCrc32cRecordFlag);
+constexpr uint32_t kSha256HeaderSize = sizeof(uint32_t) + 32;
+constexpr uint32_t kCrc32cHeaderSize = sizeof(uint32_t) + 4;
+// Validate block size to prevent allocation attacks
+constexpr uint32_t kMaxRecordData = 100 * 1024 * 1024;
+
+uint32_t RecordHeaderSize(uint32_t sizeField)
+{
+    return (sizeField & kCrc32cRecordFlag) ? kCrc32cHeaderSize : kSha256HeaderSize;
+}
+
+std::array<uint8_t, 32> Sha256(const uint8_t* data, std::size_t size)
+{
+    std::array<uint8_t, 32> digest;
+    unsigned int digestLen = 0;
+    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(mdctx, EVP_sha256(), nullptr);
+    EVP_DigestUpdate(mdctx, data, size);
+    EVP_DigestFinal_ex(mdctx, digest.data(), &digestLen);
+    EVP_MD_CTX_free(mdctx);
+    return digest;
+}
+
+// Check a whole record read from disk; returns nullptr if it is intact.
+const char* CheckRecord(const uint8_t* record, std::size_t length)
+{
+    if (length < sizeof(uint32_t))
+        return "truncated record";
+    uint32_t sizeField = 0;
+    std::memcpy(&sizeField, record, sizeof(sizeField));
+    const uint32_t header = RecordHeaderSize(sizeField);
+    if (length <= header || (sizeField & kRecordSizeMask) != length - header)
+        return "record size mismatch";
+    const uint8_t* data = record + header;
+    const std::size_t size = length - header;
+    if (sizeField & kCrc32cRecordFlag) {
+        uint32_t stored = 0;
+        std::memcpy(&stored, record + sizeof(sizeField), sizeof(stored));
+        if (stored != Crc32c(data, size))
+            return "block checksum mismatch - data corruption detected";
+    } else if (std::memcmp(record + sizeof(sizeField), Sha256(data, size).data(), 32) != 0) {
+        return "block checksum mismatch - data corruption detected";
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const CompressionDictionary> LoadDictionary(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return std::make_shared<const CompressionDictionary>();
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return std::make_shared<const CompressionDictionary>(std::move(bytes));
+}
+
+} // namespace
+
+std::string BlockStore::PrepareDirectory(const std::string& dir)
+{
+    if (std::filesystem::is_regular_file(dir))
+        throw std::runtime_error("single-file block store at " + dir + " is no longer supported; reindex required");
+    std::filesystem::create_directories(dir);
+    return dir;
+}
+
+BlockStore::BlockStore(const std::string& dir_, uint64_t maxFileSize, std::size_t cacheBytes)
+    : dir(PrepareDirectory(dir_)), blockFiles(dir, "blk", maxFileSize, kBlockChunkSize),
+      undoFiles(dir, "rev", maxFileSize, kUndoChunkSize), index(dir + "/blk.idx"), undoIndex(dir + "/rev.idx"),
+      hashIndex(dir + "/hashes"), cache(cacheBytes), dictionary(LoadDictionary(DictionaryPath()))
+{
+    compressionStats.dictionaryId = dictionary->Id();
+    compressionStats.dictionaryBytes = dictionary->Bytes().size();
+    // Appends resume after the last indexed record, side branches included.
+    const FlatFilePos heightEnd = index.End();
+    const FlatFilePos hashEnd = hashIndex.End();
+    const bool hashAhead = hashEnd.file > heightEnd.file ||
+                           (hashEnd.file == heightEnd.file && hashEnd.offset > heightEnd.offset);
+    blockFiles.Resume(hashAhead ? hashEnd : heightEnd);
+    undoFiles.Resume(undoIndex.End());
+}
+
+BlockStore::~BlockStore()
+{
+    std::lock_guard<std::mutex> l(mu);
+    try {
+        SyncIndex(index, blockFiles);
+        SyncIndex(undoIndex, undoFiles);
+        blockFiles.Close();
+        undoFiles.Close();
+    } catch (...) {
     }
+}
 
-    void WriteBlock(uint32_t height, const Block& block)
+void BlockStore::WriteBlock(uint32_t height, const Block& block)
+{
+    StoreBlock(height, block, true);
+}
+
+void BlockStore::WriteSideBlock(uint32_t height, const Block& block)
+{
+    StoreBlock(height, block, false);
+}
+
+void BlockStore::StoreBlock(uint32_t height, const Block& block, bool active)
+{
+    const uint256 hash = BlockHash(block.header);
+    size_t size = sizeof(BlockHeader) + sizeof(uint32_t);
+    for (const auto& tx : block.transactions)
+        size += sizeof(uint32_t) + GetSerializeSize(tx);
+    std::vector<uint8_t> buffer;
+    buffer.reserve(size);
+    buffer.insert(buffer.end(), reinterpret_cast<const uint8_t*>(&block.header), reinterpret_cast<const uint8_t*>(&block.header) + sizeof(BlockHeader));
+    uint32_t txCount = static_cast<uint32_t>(block.transactions.size());
+    buffer.insert(buffer.end(), reinterpret_cast<uint8_t*>(&txCount), reinterpret_cast<uint8_t*>(&txCount) + sizeof(txCount));
+    for (const auto& tx : block.transactions) {
+        uint32_t txSize = static_cast<uint32_t>(GetSerializeSize(tx));
+        buffer.insert(buffer.end(), reinterpret_cast<uint8_t*>(&txSize), reinterpret_cast<uint8_t*>(&txSize) + sizeof(txSize));
+        SerializeAppend(tx, buffer);
+    }
+
+    std::shared_ptr<const CompressionDictionary> dict;
     {
         std::lock_guard<std::mutex> l(mu);
-        std::ofstream out(path, std::ios::binary | std::ios::app);
-        if (!out) throw std::runtime_error("cannot open blockstore");
-        auto pos = out.tellp();
-
-        std::vector<uint8_t> buffer;
-        buffer.reserve(sizeof(BlockHeader) + sizeof(uint32_t) + 4096);
-        buffer.insert(buffer.end(), reinterpret_cast<const uint8_t*>(&block.header), reinterpret_cast<const uint8_t*>(&block.header) + sizeof(BlockHeader));
-        uint32_t txCount = static_cast<uint32_t>(block.transactions.size());
-        buffer.insert(buffer.end(), reinterpret_cast<uint8_t*>(&txCount), reinterpret_cast<uint8_t*>(&txCount) + sizeof(txCount));
-        for (const auto& tx : block.transactions) {
-            auto ser = Serialize(tx);
-            uint32_t txSize = static_cast<uint32_t>(ser.size());
-            buffer.insert(buffer.end(), reinterpret_cast<uint8_t*>(&txSize), reinterpret_cast<uint8_t*>(&txSize) + sizeof(txSize));
-            buffer.insert(buffer.end(), ser.begin(), ser.end());
-        }
+        if (compress)
+            dict = dictionary;
+    }
+    // Empty if compression is off or would not pay for itself.
+    const auto packed = dict ? CompressRecord(buffer, *dict) : std::vector<uint8_t>{};
+    const bool compressed = !packed.empty();
+
+    std::lock_guard<std::mutex> l(mu);
+    const BlockPos pos = AppendRecord(blockFiles, compressed ? packed : buffer, recordChecksum, compressed);
+    hashIndex.Put(hash, BlockLocation{pos, height});
+    if (trackFiles)
+        NoteRecord(blockFileContents, pos.file, height, &hash);
+    ++compressionStats.records;
+    compressionStats.rawBytes += buffer.size();
+    compressionStats.storedBytes += compressed ? packed.size() : buffer.size();
+    if (compressed)
+        ++compressionStats.compressedRecords;
+    if (active) {
+        index.Set(height, pos);
+        if (cache.Enabled())
+            cache.Put(height, std::make_shared<const CachedBlock>(CachedBlock{block, std::move(buffer)}));
+        else
+            cache.Erase(height);
+    }
+    ++dirtyCount;
+    if (dirtyCount >= kFlushThreshold) {
+        SyncIndex(index, blockFiles);
+        dirtyCount = 0;
+    }
+    // The previous file just filled up.
+    if (pruneTarget > 0 && pos.file > 0 && pos.offset == 0)
+        PruneLocked();
+}
+
+void BlockStore::WriteUndo(uint32_t height, const BlockUndo& undo)
+{
+    std::lock_guard<std::mutex> l(mu);
+    const BlockPos pos = AppendRecord(undoFiles, SerializeBlockUndo(undo), recordChecksum);
+    undoIndex.Set(height, pos);
+    if (trackFiles)
+        NoteRecord(undoFileContents, pos.file, height, nullptr);
+    ++undoDirtyCount;
+    if (undoDirtyCount >= kFlushThreshold) {
+        SyncIndex(undoIndex, undoFiles);
+        undoDirtyCount = 0;
+    }
+}
 
-        uint32_t totalSize = static_cast<uint32_t>(buffer.size());
-        
-        // Calculate SHA-256 checksum for integrity verification using modern EVP API
-        std::array<uint8_t, 32> checksum;
-        unsigned int checksumLen = 0;
-        EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-        EVP_DigestInit_ex(mdctx, EVP_sha256(), nullptr);
-        EVP_DigestUpdate(mdctx, buffer.data(), buffer.size());
-        EVP_DigestFinal_ex(mdctx, checksum.data(), &checksumLen);
-        EVP_MD_CTX_free(mdctx);
-        
-        // Write: [size][checksum][data]
-        out.write(reinterpret_cast<const char*>(&totalSize), sizeof(totalSize));
-        out.write(reinterpret_cast<const char*>(checksum.data()), checksum.size());
-        out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
-        
-        index[height] = static_cast<uint64_t>(pos);
+void BlockStore::TruncateAbove(uint32_t height)
+{
+    std::lock_guard<std::mutex> l(mu);
+    if (height >= BlockHeightIndex::kMaxHeights)
+        return;
+    for (uint32_t h = height + 1; h < index.Size(); ++h)
+        cache.Erase(h);
+    if (index.Size() > height + 1) {
+        index.Truncate(height + 1);
         ++dirtyCount;
-        if (dirtyCount >= kFlushThreshold) {
-            FlushIndex();
-            dirtyCount = 0;
-        }
     }
-    
-    void Sync() {
+    if (undoIndex.Size() > height + 1) {
+        undoIndex.Truncate(height + 1);
+        ++undoDirtyCount;
+    }
+}
+
+void BlockStore::Sync()
+{
+    std::lock_guard<std::mutex> l(mu);
+    if (dirtyCount > 0) {
+        SyncIndex(index, blockFiles);
+        dirtyCount = 0;
+    }
+    if (undoDirtyCount > 0) {
+        SyncIndex(undoIndex, undoFiles);
+        undoDirtyCount = 0;
+    }
+}
+
+std::shared_ptr<const CachedBlock> BlockStore::GetBlock(uint32_t height)
+{
+    if (auto hit = cache.Get(height)) return hit;
+    BlockPos pos;
+    std::shared_ptr<const CompressionDictionary> dict;
+    {
         std::lock_guard<std::mutex> l(mu);
-        if (dirtyCount > 0) {
-            FlushIndex();
-            dirtyCount = 0;
-        }
+        auto found = index.Get(height);
+        if (!found) throw std::runtime_error(height < index.PrunedHeight() ? "block pruned" : "unknown height");
+        pos = *found;
+        dict = dictionary;
     }
+    auto entry = LoadBlock(pos, dict);
+
+    // Only cache what the index still points at; a concurrent WriteBlock
+    // may have replaced this height while it was being read.
+    std::lock_guard<std::mutex> l(mu);
+    const auto current = index.Get(height);
+    if (current && current->file == pos.file && current->offset == pos.offset)
+        cache.Put(height, entry);
+    return entry;
+}
 
-    Block ReadBlock(uint32_t height)
+std::shared_ptr<const CachedBlock> BlockStore::GetBlockByHash(const uint256& hash)
+{
+    BlockLocation loc;
+    bool active = false;
+    std::shared_ptr<const CompressionDictionary> dict;
     {
         std::lock_guard<std::mutex> l(mu);
-        auto it = index.find(height);
-        if (it == index.end()) throw std::runtime_error("unknown height");
-        std::ifstream in(path, std::ios::binary);
-        in.seekg(it->second);
-        uint32_t size = 0;
-        in.read(reinterpret_cast<char*>(&size), sizeof(size));
-        
-        // Validate block size to prevent allocation attacks
-        const uint32_t MAX_BLOCK_SIZE = 100 * 1024 * 1024; // 100MB max
-        if (size == 0 || size > MAX_BLOCK_SIZE) {
-            throw std::runtime_error("invalid block size");
-        }
-        
-        // Read checksum
-        std::array<uint8_t, 32> storedChecksum;
-        in.read(reinterpret_cast<char*>(storedChecksum.data()), storedChecksum.size());
-        
-        // Read block data
-        std::vector<uint8_t> data(size);
-        in.read(reinterpret_cast<char*>(data.data()), size);
-        if (!in) throw std::runtime_error("corrupt blockstore");
-        
-        // Verify checksum for integrity using modern EVP API
-        std::array<uint8_t, 32> computedChecksum;
-        unsigned int checksumLen = 0;
-        EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-        EVP_DigestInit_ex(mdctx, EVP_sha256(), nullptr);
-        EVP_DigestUpdate(mdctx, data.data(), data.size());
-        EVP_DigestFinal_ex(mdctx, computedChecksum.data(), &checksumLen);
-        EVP_MD_CTX_free(mdctx);
-        
-        if (storedChecksum != computedChecksum) {
-            throw std::runtime_error("block checksum mismatch - data corruption detected");
+        const auto found = hashIndex.Get(hash);
+        if (!found)
+            return nullptr;
+        loc = *found;
+        dict = dictionary;
+        const auto slot = index.Get(loc.height);
+        active = slot && slot->file == loc.pos.file && slot->offset == loc.pos.offset;
+    }
+    // Blocks on the active chain go through the height cache, unless the
+    // height has been rewritten since the lookup.
+    if (active) {
+        auto entry = GetBlock(loc.height);
+        if (BlockHash(entry->block.header) == hash)
+            return entry;
+    }
+    std::shared_ptr<const CachedBlock> entry = LoadBlock(loc.pos, dict);
+    // An entry written just before a crash may name a record that was lost
+    // and overwritten since.
+    if (BlockHash(entry->block.header) != hash)
+        throw std::runtime_error("stale block hash index entry");
+    return entry;
+}
+
+std::optional<BlockLocation> BlockStore::LookupBlock(const uint256& hash)
+{
+    std::lock_guard<std::mutex> l(mu);
+    return hashIndex.Get(hash);
+}
+
+std::shared_ptr<CachedBlock> BlockStore::LoadBlock(const BlockPos& pos,
+                                                   const std::shared_ptr<const CompressionDictionary>& dict) const
+{
+    auto entry = std::make_shared<CachedBlock>();
+    bool compressed = false;
+    auto stored = ReadRecord(blockFiles, pos, &compressed);
+    entry->raw = DecodeBlockRecord(std::move(stored), compressed, dict);
+    entry->block = BlockView(entry->raw).ToBlock();
+    return entry;
+}
+
+Block BlockStore::ReadBlock(uint32_t height)
+{
+    return GetBlock(height)->block;
+}
+
+std::vector<uint8_t> BlockStore::ReadRawBlock(uint32_t height)
+{
+    return GetBlock(height)->raw;
+}
+
+BlockUndo BlockStore::ReadUndo(uint32_t height)
+{
+    BlockPos pos;
+    {
+        std::lock_guard<std::mutex> l(mu);
+        auto found = undoIndex.Get(height);
+        if (!found)
+            throw std::runtime_error(height < undoIndex.PrunedHeight() ? "undo data pruned" : "no undo data for height");
+        pos = *found;
+    }
+    return DeserializeBlockUndo(ReadRecord(undoFiles, pos));
+}
+
+std::optional<BlockPos> BlockStore::GetBlockPos(uint32_t height)
+{
+    std::lock_guard<std::mutex> l(mu);
+    return index.Get(height);
+}
+
+bool BlockStore::HasUndo(uint32_t height)
+{
+    std::lock_guard<std::mutex> l(mu);
+    return undoIndex.Get(height).has_value();
+}
+
+void BlockStore::SetCompression(bool enabled)
+{
+    if (enabled && !CompressionAvailable())
+        throw std::runtime_error("block compression needs a build with zlib");
+    std::lock_guard<std::mutex> l(mu);
+    compress = enabled;
+}
+
+bool BlockStore::TrainCompressionDictionary(std::size_t sampleBlocks)
+{
+    std::vector<BlockPos> positions;
+    std::shared_ptr<const CompressionDictionary> dict;
+    {
+        std::lock_guard<std::mutex> l(mu);
+        if (!dictionary->Empty())
+            return false;
+        dict = dictionary;
+        for (uint32_t h = index.Size(); h > 0 && positions.size() < sampleBlocks; --h) {
+            if (auto pos = index.Get(h - 1))
+                positions.push_back(*pos);
         }
+    }
+    if (positions.empty())
+        return false;
+
+    // Oldest first, so the newest blocks sit at the end of the dictionary.
+    std::vector<std::vector<uint8_t>> samples;
+    samples.reserve(positions.size());
+    for (auto it = positions.rbegin(); it != positions.rend(); ++it) {
+        bool compressed = false;
+        auto stored = ReadRecord(blockFiles, *it, &compressed);
+        samples.push_back(DecodeBlockRecord(std::move(stored), compressed, dict));
+    }
+    auto trained = std::make_shared<const CompressionDictionary>(CompressionDictionary::Train(samples));
+    if (trained->Empty())
+        return false;
+
+    std::lock_guard<std::mutex> l(mu);
+    if (!dictionary->Empty())
+        return false;
+    const std::string path = DictionaryPath();
+    {
+        std::ofstream out(path + ".tmp", std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(trained->Bytes().data()),
+                  static_cast<std::streamsize>(trained->Bytes().size()));
+        out.flush();
+        if (!out)
+            throw std::runtime_error("cannot write " + path);
+    }
+    std::filesystem::rename(path + ".tmp", path);
+    dictionary = trained;
+    compressionStats.dictionaryId = dictionary->Id();
+    compressionStats.dictionaryBytes = dictionary->Bytes().size();
+    return true;
+}
 
-        Block block{};
-        if (size < sizeof(BlockHeader) + sizeof(uint32_t)) throw std::runtime_error("block too small");
-        size_t offset = 0;
-        std::memcpy(&block.header, data.data() + offset, sizeof(BlockHeader));
-        offset += sizeof(BlockHeader);
-        uint32_t txCount = 0;
-        std::memcpy(&txCount, data.data() + offset, sizeof(txCount));
-        offset += sizeof(txCount);
-        
-        // Validate transaction count to prevent memory exhaustion
-        const uint32_t MAX_TX_COUNT = 100000;
-        if (txCount > MAX_TX_COUNT) {
-            throw std::runtime_error("transaction count exceeds maximum");
+BlockStore::CompressionStats BlockStore::GetCompressionStats()
+{
+    std::lock_guard<std::mutex> l(mu);
+    CompressionStats stats = compressionStats;
+    stats.enabled = compress;
+    return stats;
+}
+
+void BlockStore::SetPruneTarget(uint64_t targetBytes, uint32_t keepBlocks)
+{
+    std::lock_guard<std::mutex> l(mu);
+    pruneTarget = targetBytes;
+    pruneKeep = keepBlocks;
+    if (pruneTarget > 0 && !trackFiles)
+        TrackFilesLocked();
+}
+
+void BlockStore::TrackFilesLocked()
+{
+    // The only full pass over the indexes; writes keep the map current.
+    for (uint32_t h = 0; h < index.Size(); ++h) {
+        if (const auto pos = index.Get(h))
+            NoteRecord(blockFileContents, pos->file, h, nullptr);
+    }
+    for (uint32_t h = 0; h < undoIndex.Size(); ++h) {
+        if (const auto pos = undoIndex.Get(h))
+            NoteRecord(undoFileContents, pos->file, h, nullptr);
+    }
+    // Side-branch blocks have no height slot but age the same way.
+    hashIndex.ForEach([this](const uint256& hash, const BlockLocation& loc) {
+        NoteRecord(blockFileContents, loc.pos.file, loc.height, &hash);
+    });
+    trackFiles = true;
+}
+
+void BlockStore::NoteRecord(std::map<uint32_t, FileContents>& contents, uint32_t file, uint32_t height,
+                            const uint256* hash)
+{
+    FileContents& c = contents[file];
+    c.low = std::min(c.low, height);
+    c.top = std::max(c.top, height + 1);
+    if (hash)
+        c.hashes.push_back(*hash);
+}
+
+uint64_t BlockStore::Prune()
+{
+    std::lock_guard<std::mutex> l(mu);
+    return PruneLocked();
+}
+
+uint32_t BlockStore::PrunedHeight()
+{
+    std::lock_guard<std::mutex> l(mu);
+    return index.PrunedHeight();
+}
+
+uint64_t BlockStore::DiskUsage()
+{
+    std::lock_guard<std::mutex> l(mu);
+    uint64_t total = 0;
+    for (const FlatFileSeq* files : {&blockFiles, &undoFiles}) {
+        for (uint32_t f = 0; f <= files->End().file; ++f) {
+            std::error_code ec;
+            const auto size = std::filesystem::file_size(files->FilePath(f), ec);
+            if (!ec)
+                total += size;
         }
-        
-        for (uint32_t i = 0; i < txCount; ++i) {
-            if (offset + sizeof(uint32_t) > data.size()) throw std::runtime_error("truncated transaction size");
-            uint32_t txSize = 0;
-            std::memcpy(&txSize, data.data() + offset, sizeof(txSize));
-            offset += sizeof(txSize);
-            
-            // Validate transaction size
-            const uint32_t MAX_TX_SIZE = 10 * 1024 * 1024; // 10MB max per tx
-            if (txSize == 0 || txSize > MAX_TX_SIZE) {
-                throw std::runtime_error("invalid transaction size");
-            }
-            
-            if (offset + txSize > data.size()) throw std::runtime_error("truncated transaction data");
-            std::vector<uint8_t> txdata(data.begin() + offset, data.begin() + offset + txSize);
-            offset += txSize;
-            block.transactions.push_back(DeserializeTransaction(txdata));
+    }
+    return total;
+}
+
+uint64_t BlockStore::PruneLocked()
+{
+    if (pruneTarget == 0 || index.Size() <= pruneKeep)
+        return 0;
+    // Files whose every record is below this height may go.
+    const uint32_t keepFrom = index.Size() - pruneKeep;
+
+    struct Candidate {
+        FlatFileSeq* files;
+        BlockHeightIndex* idx;
+        std::map<uint32_t, FileContents>* contents;
+        uint32_t file;
+        uint64_t bytes;
+        uint32_t top; // one past the highest height stored in the file
+    };
+    struct Seq {
+        FlatFileSeq* files;
+        BlockHeightIndex* idx;
+        std::map<uint32_t, FileContents>* contents;
+    };
+    const Seq seqs[] = {{&blockFiles, &index, &blockFileContents}, {&undoFiles, &undoIndex, &undoFileContents}};
+    std::vector<Candidate> candidates;
+    uint64_t total = 0;
+    for (const auto& seq : seqs) {
+        const uint32_t current = seq.files->End().file;
+        for (uint32_t f = 0; f <= current; ++f) {
+            std::error_code ec;
+            const uint64_t size = std::filesystem::file_size(seq.files->FilePath(f), ec);
+            if (ec)
+                continue;
+            total += size;
+            const auto it = seq.contents->find(f);
+            const uint32_t top = it == seq.contents->end() ? 0 : it->second.top;
+            // The file being appended to is never pruned.
+            if (f < current && top <= keepFrom)
+                candidates.push_back(Candidate{seq.files, seq.idx, seq.contents, f, size, top});
         }
-        return block;
     }
+    if (total <= pruneTarget)
+        return 0;
 
-private:
-    std::string path;
-    std::unordered_map<uint32_t, uint64_t> index;
-    std::mutex mu;
-    size_t dirtyCount{0};
-    static constexpr size_t kFlushThreshold = 100;
+    // Oldest data first; a block file and its undo file age together.
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const Candidate& a, const Candidate& b) { return a.top < b.top; });
+    std::vector<Candidate> doomed;
+    uint64_t freed = 0;
+    for (const auto& c : candidates) {
+        if (total - freed <= pruneTarget)
+            break;
+        doomed.push_back(c);
+        freed += c.bytes;
+    }
+    if (doomed.empty())
+        return 0;
 
-    void LoadIndex()
-    {
-        std::ifstream in(path + ".idx", std::ios::binary);
-        if (!in.good()) return;
-        uint32_t count = 0;
-        in.read(reinterpret_cast<char*>(&count), sizeof(count));
-        
-        // Validate index count to prevent memory exhaustion
-        const uint32_t MAX_INDEX_ENTRIES = 10000000; // 10 million blocks max
-        if (count > MAX_INDEX_ENTRIES) {
-            throw std::runtime_error("index count exceeds maximum");
+    // Drop the index entries and make that durable before any file goes, so
+    // the index never points into a deleted file.
+    uint32_t prunedTop[2] = {0, 0};
+    for (const auto& c : doomed) {
+        const bool blocks = c.idx == &index;
+        prunedTop[blocks ? 0 : 1] = std::max(prunedTop[blocks ? 0 : 1], c.top);
+        const auto it = c.contents->find(c.file);
+        if (it == c.contents->end())
+            continue;
+        const FileContents& contents = it->second;
+        for (uint32_t h = contents.low; h < contents.top; ++h) {
+            const auto pos = c.idx->Get(h);
+            if (pos && pos->file == c.file) {
+                c.idx->Erase(h);
+                if (blocks)
+                    cache.Erase(h);
+            }
         }
-        
-        for (uint32_t i = 0; i < count; ++i) {
-            uint32_t height; uint64_t off;
-            in.read(reinterpret_cast<char*>(&height), sizeof(height));
-            in.read(reinterpret_cast<char*>(&off), sizeof(off));
-            if (!in.good()) {
-                throw std::runtime_error("corrupt index file");
+        if (blocks) {
+            std::vector<uint256> hashes;
+            for (const auto& hash : contents.hashes) {
+                const auto loc = hashIndex.Get(hash);
+                if (loc && loc->pos.file == c.file)
+                    hashes.push_back(hash);
             }
-            index[height] = off;
+            hashIndex.Erase(hashes);
         }
+        c.contents->erase(it);
+    }
+    index.SetPrunedHeight(prunedTop[0]);
+    undoIndex.SetPrunedHeight(prunedTop[1]);
+    SyncIndex(index, blockFiles);
+    SyncIndex(undoIndex, undoFiles);
+    dirtyCount = 0;
+    undoDirtyCount = 0;
+
+    for (const auto& c : doomed) {
+        c.files->ForgetFile(c.file);
+        std::error_code ec;
+        std::filesystem::remove(c.files->FilePath(c.file), ec);
+    }
+    return freed;
+}
+
+std::vector<uint8_t> BlockStore::DecodeBlockRecord(std::vector<uint8_t> stored, bool compressed,
+                                                   const std::shared_ptr<const CompressionDictionary>& dict)
+{
+    if (!compressed)
+        return stored;
+    const uint32_t id = CompressedRecordDictionary(stored);
+    if (id == 0)
+        return DecompressRecord(stored, CompressionDictionary{});
+    if (id != dict->Id())
+        throw std::runtime_error("block record needs a compression dictionary this store does not have");
+    return DecompressRecord(stored, *dict);
+}
+
+BlockPos BlockStore::AppendRecord(FlatFileSeq& files, const std::vector<uint8_t>& data, RecordChecksum checksum,
+                                  bool compressed)
+{
+    const bool crc = checksum == RecordChecksum::Crc32c;
+    const uint32_t header = crc ? kCrc32cHeaderSize : kSha256HeaderSize;
+    const uint32_t sizeField = static_cast<uint32_t>(data.size()) | (compressed ? kCompressedRecordFlag : 0) |
+                               (crc ? kCrc32cRecordFlag : 0);
+
+    // Write: [size][checksum][data], in one append so a record never
+    // straddles two files.
+    std::vector<uint8_t> record(header + data.size());
+    std::memcpy(record.data(), &sizeField, sizeof(sizeField));
+    if (crc) {
+        const uint32_t sum = Crc32c(data.data(), data.size());
+        std::memcpy(record.data() + sizeof(sizeField), &sum, sizeof(sum));
+    } else {
+        const auto sum = Sha256(data.data(), data.size());
+        std::memcpy(record.data() + sizeof(sizeField), sum.data(), sum.size());
     }
+    if (!data.empty())
+        std::memcpy(record.data() + header, data.data(), data.size());
+    const FlatFilePos pos = files.Append(record.data(), record.size());
+    return BlockPos{pos.file, pos.offset, static_cast<uint32_t>(record.size())};
+}
 
-    void FlushIndex()
+std::vector<uint8_t> BlockStore::ReadRecord(const FlatFileSeq& files, const BlockPos& pos, bool* compressed)
+{
+    if (pos.length <= kCrc32cHeaderSize || pos.length - kCrc32cHeaderSize > kMaxRecordData)
+        throw std::runtime_error("invalid block size");
+
+    std::vector<uint8_t> record(pos.length);
+    if (!files.Read(FlatFilePos{pos.file, pos.offset}, record.data(), record.size()))
+        throw std::runtime_error("corrupt blockstore");
+    if (const char* error = CheckRecord(record.data(), record.size()))
+        throw std::runtime_error(error);
+    uint32_t sizeField = 0;
+    std::memcpy(&sizeField, record.data(), sizeof(sizeField));
+    const bool flagged = (sizeField & kCompressedRecordFlag) != 0;
+    if (flagged && !compressed)
+        throw std::runtime_error("corrupt blockstore");
+    if (compressed)
+        *compressed = flagged;
+    return std::vector<uint8_t>(record.begin() + RecordHeaderSize(sizeField), record.end());
+}
+
+BlockStore::RecordCheck BlockStore::CheckRecordAt(bool undo, const FlatFilePos& pos)
+{
+    const FlatFileSeq& files = undo ? undoFiles : blockFiles;
+    FlatFilePos end;
     {
-        std::ofstream out(path + ".idx", std::ios::binary | std::ios::trunc);
-        uint32_t count = static_cast<uint32_t>(index.size());
-        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
-        for (const auto& e : index) {
-            out.write(reinterpret_cast<const char*>(&e.first), sizeof(e.first));
-            out.write(reinterpret_cast<const char*>(&e.second), sizeof(e.second));
-        }
+        std::lock_guard<std::mutex> l(mu);
+        end = files.End();
+    }
+    if (pos.file > end.file || (pos.file == end.file && pos.offset >= end.offset))
+        return {RecordCheck::Status::End, 0, {}};
+
+    uint32_t sizeField = 0;
+    if (!files.Read(pos, reinterpret_cast<uint8_t*>(&sizeField), sizeof(sizeField))) {
+        std::error_code ec;
+        const bool exists = std::filesystem::exists(files.FilePath(pos.file), ec);
+        return {exists ? RecordCheck::Status::End : RecordCheck::Status::Missing, 0, {}};
     }
-};
+    // Finished files end at their last record; a zero size is unwritten space.
+    if (sizeField == 0)
+        return {RecordCheck::Status::End, 0, {}};
+    const uint32_t dataSize = sizeField & kRecordSizeMask;
+    if (dataSize > kMaxRecordData)
+        return {RecordCheck::Status::Corrupt, 0, "invalid record size"};
+
+    const uint32_t length = RecordHeaderSize(sizeField) + dataSize;
+    std::vector<uint8_t> record(length);
+    if (!files.Read(pos, record.data(), record.size()))
+        return {RecordCheck::Status::Corrupt, 0, "truncated record"};
+    if (const char* error = CheckRecord(record.data(), record.size()))
+        return {RecordCheck::Status::Corrupt, length, error};
+    return {RecordCheck::Status::Ok, length, {}};
+}
+
+void BlockStore::SetRecordChecksum(RecordChecksum checksum)
+{
+    std::lock_guard<std::mutex> l(mu);
+    recordChecksum = checksum;
+}
+
+FlatFilePos BlockStore::RecordsEnd(bool undo)
+{
+    std::lock_guard<std::mutex> l(mu);
+    return undo ? undoFiles.End() : blockFiles.End();
+}
+
+void BlockStore::SyncIndex(BlockHeightIndex& idx, FlatFileSeq& files)
+{
+    // The index must never point at data that could still be lost.
+    files.Flush();
+    idx.Sync();
+}
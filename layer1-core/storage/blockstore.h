@@ -0,0 +1,201 @@
+#pragma once
+
+#include "../block/block.h"
+#include "../chainstate/undo.h"
+#include "block_cache.h"
+#include "block_hash_index.h"
+#include "block_index.h"
+#include "compression.h"
+#include "flatfile.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Checksum stored with each block and undo record.
+enum class RecordChecksum : uint8_t {
+    Crc32c,
+    Sha256, // legacy format
+};
+
+// Append-only block storage in the directory `dir`. Blocks go to numbered
+// `blkNNNNN.dat` files and their undo data to `revNNNNN.dat`, each file
+// capped at maxFileSize bytes (see FlatFileSeq). Both use
+// [u32 size][checksum(data)][data] records with a memory-mapped height ->
+// BlockPos index (`blk.idx` / `rev.idx`, see BlockHeightIndex) that is
+// synced every kFlushThreshold writes and on Sync/destruction, after the
+// data it points at.
+// Writes are serialized; reads only take the lock for the index lookup and
+// then read, verify and decode concurrently with each other and with writes.
+// The checksum is a CRC-32C by default, cheap enough to verify on every
+// read; stores written before it used SHA-256, which is still read and can
+// still be selected. Flags in the size field say which a record carries.
+// BlockScrubber re-verifies whole files in the background.
+//
+// Every block written is also recorded by hash (see BlockHashIndex), so
+// peers can be served by hash, including blocks on side branches stored
+// with WriteSideBlock, which take no height slot.
+// Recently written and read blocks are kept in a BlockCache of cacheBytes,
+// so serving the tip to many peers costs no disk reads.
+//
+// With compression enabled, block records are written deflated (see
+// compression.h) when that makes them smaller and flagged in the size
+// field; plain and compressed records are read back alike, so the setting
+// can change between runs. A dictionary trained from stored blocks is kept
+// in `blk.dict` and never replaced, since records name the one they need.
+//
+// With a prune target set, whole block and undo files are deleted oldest
+// first once the files on disk exceed it, keeping at least the most recent
+// keepBlocks heights so reorganizations within that depth can still be
+// disconnected. Reads of a pruned height throw "block pruned". The heights
+// and hashes each file holds are tracked as records are written, so
+// pruning only visits the entries of the files it deletes.
+class BlockStore {
+public:
+    // Result of checking one record in place (see CheckRecordAt).
+    struct RecordCheck {
+        enum class Status {
+            Ok,
+            End,     // no record starts here: the end of the file's data
+            Missing, // the file is gone, e.g. pruned
+            Corrupt,
+        };
+        Status status{Status::End};
+        uint32_t length{0}; // whole record; 0 if its size is unreadable
+        std::string error;
+    };
+
+    struct CompressionStats {
+        bool enabled{false};
+        uint32_t dictionaryId{0};
+        std::size_t dictionaryBytes{0};
+        // Blocks written since the store was opened.
+        uint64_t records{0};
+        uint64_t compressedRecords{0};
+        uint64_t rawBytes{0};
+        uint64_t storedBytes{0};
+
+        double Ratio() const { return storedBytes == 0 ? 1.0 : static_cast<double>(rawBytes) / storedBytes; }
+    };
+
+    static constexpr uint64_t kDefaultMaxFileSize = 128ull << 20;
+    static constexpr std::size_t kDefaultCacheBytes = 32u << 20;
+
+    explicit BlockStore(const std::string& dir, uint64_t maxFileSize = kDefaultMaxFileSize,
+                        std::size_t cacheBytes = kDefaultCacheBytes);
+    ~BlockStore();
+
+    void WriteBlock(uint32_t height, const Block& block);
+    // Store a block that is not on the active chain: reachable by hash only.
+    void WriteSideBlock(uint32_t height, const Block& block);
+    Block ReadBlock(uint32_t height);
+    // The stored payload, as sent to peers.
+    std::vector<uint8_t> ReadRawBlock(uint32_t height);
+    // Decoded block and payload without copying either; throws like ReadBlock.
+    std::shared_ptr<const CachedBlock> GetBlock(uint32_t height);
+    std::optional<BlockPos> GetBlockPos(uint32_t height);
+    // Any stored block by hash; nullptr if it is unknown or was pruned.
+    // Throws like ReadBlock if the record cannot be read.
+    std::shared_ptr<const CachedBlock> GetBlockByHash(const uint256& hash);
+    std::optional<BlockLocation> LookupBlock(const uint256& hash);
+
+    // Undo data for the block connected at `height`, written alongside it.
+    void WriteUndo(uint32_t height, const BlockUndo& undo);
+    BlockUndo ReadUndo(uint32_t height);
+    bool HasUndo(uint32_t height);
+
+    // Drop the active chain above `height`, e.g. after a reorganization to a
+    // shorter branch: reads of those heights fail and their undo data is
+    // forgotten. The blocks stay reachable by hash. Persisted by the next
+    // Sync.
+    void TruncateAbove(uint32_t height);
+
+    void Sync();
+    BlockCache::Stats CacheStats() const { return cache.GetStats(); }
+
+    // Compress blocks written from now on. Throws in builds without zlib.
+    void SetCompression(bool enabled);
+    // Train and save a dictionary from up to `sampleBlocks` of the most
+    // recent blocks. Returns false if the store already has a dictionary or
+    // holds no blocks yet.
+    bool TrainCompressionDictionary(std::size_t sampleBlocks = 256);
+    CompressionStats GetCompressionStats();
+
+    // Checksum written with new records; either kind is read.
+    void SetRecordChecksum(RecordChecksum checksum);
+    // Verify the record starting at `pos` in the block (or undo) files
+    // without decoding it or touching the cache.
+    RecordCheck CheckRecordAt(bool undo, const FlatFilePos& pos);
+    // Where the written data of the block (or undo) files ends.
+    FlatFilePos RecordsEnd(bool undo);
+
+    // Keep block and undo files within targetBytes; zero disables pruning.
+    // Checked each time a block file fills up.
+    void SetPruneTarget(uint64_t targetBytes, uint32_t keepBlocks);
+    // Prune now rather than at the next full file; returns the bytes deleted.
+    uint64_t Prune();
+    // Heights below this may have been pruned.
+    uint32_t PrunedHeight();
+    // Size of the block and undo files on disk.
+    uint64_t DiskUsage();
+
+    std::string BlockFilePath(uint32_t file) const { return blockFiles.FilePath(file); }
+
+private:
+    std::string dir;
+    FlatFileSeq blockFiles;
+    FlatFileSeq undoFiles;
+    BlockHeightIndex index;
+    BlockHeightIndex undoIndex;
+    BlockHashIndex hashIndex;
+    BlockCache cache;
+    std::mutex mu;
+    bool compress{false};
+    std::shared_ptr<const CompressionDictionary> dictionary;
+    CompressionStats compressionStats;
+    RecordChecksum recordChecksum{RecordChecksum::Crc32c};
+    uint64_t pruneTarget{0};
+    uint32_t pruneKeep{0};
+
+    // Heights and block hashes stored in one block (or undo) file. Slots
+    // and hash entries may since point elsewhere after a reorganization,
+    // so pruning checks each one before dropping it.
+    struct FileContents {
+        uint32_t low{std::numeric_limits<uint32_t>::max()};
+        uint32_t top{0}; // one past the highest height
+        std::vector<uint256> hashes;
+    };
+    // Built from the indexes when pruning is first enabled and updated by
+    // every write from then on.
+    bool trackFiles{false};
+    std::map<uint32_t, FileContents> blockFileContents;
+    std::map<uint32_t, FileContents> undoFileContents;
+    size_t dirtyCount{0};
+    size_t undoDirtyCount{0};
+    static constexpr size_t kFlushThreshold = 100;
+    static constexpr uint64_t kBlockChunkSize = 16ull << 20;
+    static constexpr uint64_t kUndoChunkSize = 1ull << 20;
+
+    static BlockPos AppendRecord(FlatFileSeq& files, const std::vector<uint8_t>& data, RecordChecksum checksum,
+                                 bool compressed = false);
+    // Returns the stored bytes; `compressed` reports the record's flag, and
+    // a flagged record is rejected when it is null.
+    static std::vector<uint8_t> ReadRecord(const FlatFileSeq& files, const BlockPos& pos, bool* compressed = nullptr);
+    static std::vector<uint8_t> DecodeBlockRecord(std::vector<uint8_t> stored, bool compressed,
+                                                  const std::shared_ptr<const CompressionDictionary>& dict);
+    std::string DictionaryPath() const { return dir + "/blk.dict"; }
+    uint64_t PruneLocked();
+    void TrackFilesLocked();
+    static void NoteRecord(std::map<uint32_t, FileContents>& contents, uint32_t file, uint32_t height,
+                           const uint256* hash);
+    void StoreBlock(uint32_t height, const Block& block, bool active);
+    std::shared_ptr<CachedBlock> LoadBlock(const BlockPos& pos,
+                                           const std::shared_ptr<const CompressionDictionary>& dict) const;
+    static std::string PrepareDirectory(const std::string& dir);
+    static void SyncIndex(BlockHeightIndex& idx, FlatFileSeq& files);
+};
@@ -0,0 +1,148 @@
+#include "compression.h"
+#include <openssl/sha.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#ifdef DRACHMA_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+constexpr uint32_t kMaxRawSize = 100 * 1024 * 1024;
+
+void PutLE32(uint8_t* out, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i)
+        out[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+uint32_t GetLE32(const uint8_t* in)
+{
+    return static_cast<uint32_t>(in[0]) | (static_cast<uint32_t>(in[1]) << 8) |
+           (static_cast<uint32_t>(in[2]) << 16) | (static_cast<uint32_t>(in[3]) << 24);
+}
+
+} // namespace
+
+bool CompressionAvailable()
+{
+#ifdef DRACHMA_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+CompressionDictionary::CompressionDictionary(std::vector<uint8_t> bytes_) : bytes(std::move(bytes_))
+{
+    if (bytes.size() > kMaxSize)
+        bytes.erase(bytes.begin(), bytes.end() - static_cast<std::ptrdiff_t>(kMaxSize));
+    if (bytes.empty())
+        return;
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    SHA256(bytes.data(), bytes.size(), digest);
+    id = GetLE32(digest);
+    if (id == 0)
+        id = 1; // zero means "no dictionary"
+}
+
+CompressionDictionary CompressionDictionary::Train(const std::vector<std::vector<uint8_t>>& samples, std::size_t maxSize)
+{
+    maxSize = std::min(maxSize, kMaxSize);
+    std::size_t nonEmpty = 0;
+    for (const auto& s : samples)
+        nonEmpty += s.empty() ? 0 : 1;
+    if (nonEmpty == 0 || maxSize == 0)
+        return {};
+    const std::size_t slice = std::max<std::size_t>(64, maxSize / nonEmpty);
+    std::vector<uint8_t> out;
+    out.reserve(maxSize);
+    for (const auto& s : samples) {
+        const std::size_t take = std::min(slice, s.size());
+        out.insert(out.end(), s.begin(), s.begin() + static_cast<std::ptrdiff_t>(take));
+    }
+    return CompressionDictionary(std::move(out));
+}
+
+std::vector<uint8_t> CompressRecord(const std::vector<uint8_t>& data, const CompressionDictionary& dict)
+{
+#ifdef DRACHMA_HAVE_ZLIB
+    if (data.empty() || data.size() > kMaxRawSize)
+        return {};
+    z_stream zs{};
+    if (deflateInit2(&zs, 1, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw std::runtime_error("deflateInit2 failed");
+    if (!dict.Empty() &&
+        deflateSetDictionary(&zs, dict.Bytes().data(), static_cast<uInt>(dict.Bytes().size())) != Z_OK) {
+        deflateEnd(&zs);
+        throw std::runtime_error("deflateSetDictionary failed");
+    }
+    std::vector<uint8_t> out(kCompressedHeaderSize + deflateBound(&zs, static_cast<uLong>(data.size())));
+    zs.next_in = const_cast<Bytef*>(data.data());
+    zs.avail_in = static_cast<uInt>(data.size());
+    zs.next_out = out.data() + kCompressedHeaderSize;
+    zs.avail_out = static_cast<uInt>(out.size() - kCompressedHeaderSize);
+    const int rc = deflate(&zs, Z_FINISH);
+    const std::size_t produced = zs.total_out;
+    deflateEnd(&zs);
+    if (rc != Z_STREAM_END)
+        throw std::runtime_error("deflate failed");
+    if (kCompressedHeaderSize + produced >= data.size())
+        return {};
+    out.resize(kCompressedHeaderSize + produced);
+    out[0] = static_cast<uint8_t>(RecordCodec::Deflate);
+    PutLE32(out.data() + 1, dict.Id());
+    PutLE32(out.data() + 5, static_cast<uint32_t>(data.size()));
+    return out;
+#else
+    (void)data;
+    (void)dict;
+    return {};
+#endif
+}
+
+uint32_t CompressedRecordDictionary(const std::vector<uint8_t>& payload)
+{
+    if (payload.size() < kCompressedHeaderSize)
+        throw std::runtime_error("truncated compressed record");
+    return GetLE32(payload.data() + 1);
+}
+
+std::vector<uint8_t> DecompressRecord(const std::vector<uint8_t>& payload, const CompressionDictionary& dict)
+{
+    if (payload.size() < kCompressedHeaderSize)
+        throw std::runtime_error("truncated compressed record");
+    if (payload[0] != static_cast<uint8_t>(RecordCodec::Deflate))
+        throw std::runtime_error("unknown record codec");
+    if (CompressedRecordDictionary(payload) != dict.Id())
+        throw std::runtime_error("compression dictionary mismatch");
+    const uint32_t rawSize = GetLE32(payload.data() + 5);
+    if (rawSize == 0 || rawSize > kMaxRawSize)
+        throw std::runtime_error("invalid decompressed size");
+#ifdef DRACHMA_HAVE_ZLIB
+    z_stream zs{};
+    if (inflateInit2(&zs, -15) != Z_OK)
+        throw std::runtime_error("inflateInit2 failed");
+    if (!dict.Empty() &&
+        inflateSetDictionary(&zs, dict.Bytes().data(), static_cast<uInt>(dict.Bytes().size())) != Z_OK) {
+        inflateEnd(&zs);
+        throw std::runtime_error("inflateSetDictionary failed");
+    }
+    std::vector<uint8_t> out(rawSize);
+    zs.next_in = const_cast<Bytef*>(payload.data() + kCompressedHeaderSize);
+    zs.avail_in = static_cast<uInt>(payload.size() - kCompressedHeaderSize);
+    zs.next_out = out.data();
+    zs.avail_out = rawSize;
+    const int rc = inflate(&zs, Z_FINISH);
+    const bool complete = rc == Z_STREAM_END && zs.total_out == rawSize && zs.avail_in == 0;
+    inflateEnd(&zs);
+    if (!complete)
+        throw std::runtime_error("corrupt compressed record");
+    return out;
+#else
+    throw std::runtime_error("compressed block records need a build with zlib");
+#endif
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-record compression for BlockStore. A compressed record's payload is
+//   [codec(1)][dictionary id(4)][raw size(4)][compressed bytes]
+// and BlockStore marks it with kCompressedRecordFlag in the record size
+// field, so compressed and plain records can share a file.
+//
+// The codec is raw deflate at level 1 (zlib). A preset dictionary built from
+// sample block payloads primes the compressor with the fixed-width fields
+// and repeated keys every block contains, which is where most of the gain
+// on small records comes from. Compression is available only in builds
+// with zlib (DRACHMA_HAVE_ZLIB).
+enum class RecordCodec : uint8_t {
+    None = 0,
+    Deflate = 1,
+};
+
+constexpr uint32_t kCompressedRecordFlag = 0x80000000u;
+constexpr std::size_t kCompressedHeaderSize = 1 + 4 + 4;
+
+bool CompressionAvailable();
+
+class CompressionDictionary {
+public:
+    // Deflate only looks back 32 KiB, so a larger dictionary is wasted.
+    static constexpr std::size_t kMaxSize = 32 * 1024;
+
+    CompressionDictionary() = default;
+    explicit CompressionDictionary(std::vector<uint8_t> bytes);
+
+    // Build a dictionary from sample payloads by taking an equal slice of
+    // each, so it covers many blocks rather than the first few. Later
+    // samples end up closest to the data, where deflate finds matches
+    // most cheaply, so pass the most representative (recent) ones last.
+    static CompressionDictionary Train(const std::vector<std::vector<uint8_t>>& samples,
+                                       std::size_t maxSize = kMaxSize);
+
+    bool Empty() const { return bytes.empty(); }
+    // Nonzero for a non-empty dictionary; recorded in every record it
+    // compressed.
+    uint32_t Id() const { return id; }
+    const std::vector<uint8_t>& Bytes() const { return bytes; }
+
+private:
+    std::vector<uint8_t> bytes;
+    uint32_t id{0};
+};
+
+// Encode `data` as a compressed payload (header included), or return an
+// empty vector if compression would not make it smaller.
+std::vector<uint8_t> CompressRecord(const std::vector<uint8_t>& data, const CompressionDictionary& dict);
+// Decode a compressed payload; `dict` must be the one whose id it carries.
+// Throws std::runtime_error on malformed input.
+std::vector<uint8_t> DecompressRecord(const std::vector<uint8_t>& payload, const CompressionDictionary& dict);
+// The dictionary id a compressed payload was written with.
+uint32_t CompressedRecordDictionary(const std::vector<uint8_t>& payload);
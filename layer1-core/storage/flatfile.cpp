@@ -0,0 +1,269 @@
+#include "flatfile.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+int OpenFd(const std::string& path, int flags)
+{
+    return ::_open(path.c_str(), flags | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+constexpr int kWriteFlags = _O_RDWR | _O_CREAT;
+constexpr int kTruncFlag = _O_TRUNC;
+constexpr int kReadFlags = _O_RDONLY;
+
+void CloseFd(int fd) { ::_close(fd); }
+
+bool WriteAt(int fd, const uint8_t* data, std::size_t size, uint64_t offset)
+{
+    if (::_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0)
+        return false;
+    while (size > 0) {
+        const int n = ::_write(fd, data, static_cast<unsigned int>(std::min<std::size_t>(size, 1u << 30)));
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+bool ReadAt(int fd, uint8_t* out, std::size_t size, uint64_t offset)
+{
+    if (::_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0)
+        return false;
+    while (size > 0) {
+        const int n = ::_read(fd, out, static_cast<unsigned int>(std::min<std::size_t>(size, 1u << 30)));
+        if (n <= 0)
+            return false;
+        out += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+uint64_t FileSize(int fd)
+{
+    const __int64 size = ::_lseeki64(fd, 0, SEEK_END);
+    return size < 0 ? 0 : static_cast<uint64_t>(size);
+}
+
+bool SetSize(int fd, uint64_t size) { return ::_chsize_s(fd, static_cast<__int64>(size)) == 0; }
+bool Preallocate(int fd, uint64_t offset, uint64_t length) { return SetSize(fd, offset + length); }
+bool SyncFd(int fd) { return ::_commit(fd) == 0; }
+#else
+int OpenFd(const std::string& path, int flags)
+{
+    return ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+}
+constexpr int kWriteFlags = O_RDWR | O_CREAT;
+constexpr int kTruncFlag = O_TRUNC;
+constexpr int kReadFlags = O_RDONLY;
+
+void CloseFd(int fd) { ::close(fd); }
+
+bool WriteAt(int fd, const uint8_t* data, std::size_t size, uint64_t offset)
+{
+    while (size > 0) {
+        const ssize_t n = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= static_cast<std::size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+bool ReadAt(int fd, uint8_t* out, std::size_t size, uint64_t offset)
+{
+    while (size > 0) {
+        const ssize_t n = ::pread(fd, out, size, static_cast<off_t>(offset));
+        if (n <= 0)
+            return false;
+        out += n;
+        size -= static_cast<std::size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+uint64_t FileSize(int fd)
+{
+    struct stat st {};
+    return ::fstat(fd, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+}
+
+bool SetSize(int fd, uint64_t size) { return ::ftruncate(fd, static_cast<off_t>(size)) == 0; }
+
+bool Preallocate(int fd, uint64_t offset, uint64_t length)
+{
+#if defined(__linux__)
+    // Reserve real blocks; a file system without fallocate support falls
+    // back to a sparse extension below.
+    if (::posix_fallocate(fd, static_cast<off_t>(offset), static_cast<off_t>(length)) == 0)
+        return true;
+#endif
+    return SetSize(fd, offset + length);
+}
+
+bool SyncFd(int fd)
+{
+#if defined(__linux__)
+    return ::fdatasync(fd) == 0;
+#else
+    return ::fsync(fd) == 0;
+#endif
+}
+#endif
+
+} // namespace
+
+struct FlatFileSeq::ReadHandle {
+    int fd{-1};
+#ifdef _WIN32
+    std::mutex mu; // seek + read is not atomic on a shared descriptor
+#endif
+    ~ReadHandle()
+    {
+        if (fd >= 0)
+            CloseFd(fd);
+    }
+};
+
+FlatFileSeq::FlatFileSeq(std::string dir_, std::string prefix_, uint64_t maxFileSize_, uint64_t chunkSize_)
+    : dir(std::move(dir_)), prefix(std::move(prefix_)), maxFileSize(maxFileSize_),
+      chunkSize(std::max<uint64_t>(1, std::min(chunkSize_, maxFileSize_)))
+{
+    if (maxFileSize == 0)
+        throw std::invalid_argument("flat file size limit must be positive");
+}
+
+FlatFileSeq::~FlatFileSeq()
+{
+    try {
+        Close();
+    } catch (...) {
+    }
+}
+
+std::string FlatFileSeq::FilePath(uint32_t file) const
+{
+    char name[16];
+    std::snprintf(name, sizeof(name), "%05u.dat", file);
+    return dir + "/" + prefix + name;
+}
+
+void FlatFileSeq::Open(bool truncate)
+{
+    fd = OpenFd(FilePath(current), kWriteFlags | (truncate ? kTruncFlag : 0));
+    if (fd < 0)
+        throw std::runtime_error("cannot open " + FilePath(current));
+    allocated = FileSize(fd);
+}
+
+void FlatFileSeq::Resume(const FlatFilePos& pos)
+{
+    Close();
+    current = pos.file;
+    end = pos.offset;
+}
+
+void FlatFileSeq::Reserve(uint64_t needed)
+{
+    if (needed <= allocated)
+        return;
+    // Round up to whole chunks, but never reserve past the size limit
+    // unless a single oversized record needs it.
+    uint64_t target = (needed + chunkSize - 1) / chunkSize * chunkSize;
+    target = std::max(needed, std::min(target, maxFileSize));
+    if (!Preallocate(fd, allocated, target - allocated))
+        throw std::runtime_error("cannot reserve space in " + FilePath(current));
+    allocated = target;
+}
+
+FlatFilePos FlatFileSeq::Append(const uint8_t* data, std::size_t size)
+{
+    if (end > 0 && end + size > maxFileSize) {
+        Close();
+        ++current;
+        end = 0;
+    }
+    if (fd < 0)
+        // A file started from scratch may hold leftovers of a lost write.
+        Open(end == 0);
+    Reserve(end + size);
+    if (!WriteAt(fd, data, size, end))
+        throw std::runtime_error("write failed on " + FilePath(current));
+    const FlatFilePos pos{current, end};
+    end += size;
+    return pos;
+}
+
+std::shared_ptr<FlatFileSeq::ReadHandle> FlatFileSeq::GetReadHandle(uint32_t file) const
+{
+    std::lock_guard<std::mutex> l(readMu);
+    for (auto it = readHandles.begin(); it != readHandles.end(); ++it) {
+        if (it->first == file) {
+            readHandles.splice(readHandles.begin(), readHandles, it);
+            return it->second;
+        }
+    }
+    auto handle = std::make_shared<ReadHandle>();
+    handle->fd = OpenFd(FilePath(file), kReadFlags);
+    if (handle->fd < 0)
+        return nullptr;
+    readHandles.emplace_front(file, handle);
+    if (readHandles.size() > kMaxReadHandles)
+        readHandles.pop_back();
+    return handle;
+}
+
+bool FlatFileSeq::Read(const FlatFilePos& pos, uint8_t* out, std::size_t size) const
+{
+    const auto handle = GetReadHandle(pos.file);
+    if (!handle)
+        return false;
+#ifdef _WIN32
+    std::lock_guard<std::mutex> l(handle->mu);
+#endif
+    return ReadAt(handle->fd, out, size, pos.offset);
+}
+
+void FlatFileSeq::ForgetFile(uint32_t file) const
+{
+    std::lock_guard<std::mutex> l(readMu);
+    readHandles.remove_if([file](const auto& entry) { return entry.first == file; });
+}
+
+void FlatFileSeq::Flush()
+{
+    if (fd >= 0 && !SyncFd(fd))
+        throw std::runtime_error("sync failed on " + FilePath(current));
+}
+
+void FlatFileSeq::Close()
+{
+    if (fd < 0)
+        return;
+    const int f = fd;
+    fd = -1;
+    const bool ok = (allocated == end || SetSize(f, end)) && SyncFd(f);
+    CloseFd(f);
+    allocated = 0;
+    if (!ok)
+        throw std::runtime_error("cannot finish " + FilePath(current));
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+// Position of a record within a numbered file sequence.
+struct FlatFilePos {
+    uint32_t file{0};
+    uint64_t offset{0};
+};
+
+// Numbered append-only files `<dir>/<prefix>NNNNN.dat`. Records go to the
+// highest-numbered file until the next one would push it past maxFileSize,
+// then the sequence moves on to a fresh file; a record larger than the
+// limit gets a file of its own. Space is reserved chunkSize bytes at a time
+// (fallocate where available) so a file grows in a few large extents rather
+// than one per record, and the unused tail is cut off when the file is
+// finished or the sequence is closed. Appends are not synchronized.
+//
+// Reads are safe from any number of threads, including alongside an
+// append: they use positional reads on a small LRU of read-only
+// descriptors, and the cache lock is held only to find or open one.
+class FlatFileSeq {
+public:
+    FlatFileSeq(std::string dir, std::string prefix, uint64_t maxFileSize, uint64_t chunkSize);
+    ~FlatFileSeq();
+    FlatFileSeq(const FlatFileSeq&) = delete;
+    FlatFileSeq& operator=(const FlatFileSeq&) = delete;
+
+    // Continue appending at `end`. Anything already past it (a preallocated
+    // tail, or records lost with an unflushed index) is overwritten.
+    void Resume(const FlatFilePos& end);
+    // Append one record and return where it starts. Throws on I/O failure.
+    FlatFilePos Append(const uint8_t* data, std::size_t size);
+    // Read `size` bytes at `pos`; false if the file is missing or too short.
+    bool Read(const FlatFilePos& pos, uint8_t* out, std::size_t size) const;
+    // Drop any cached read descriptor for `file`, e.g. before deleting it.
+    void ForgetFile(uint32_t file) const;
+    // Make everything appended so far durable.
+    void Flush();
+    // Truncate the current file to its logical end and close it.
+    void Close();
+
+    std::string FilePath(uint32_t file) const;
+    FlatFilePos End() const { return {current, end}; }
+    uint64_t MaxFileSize() const { return maxFileSize; }
+
+private:
+    std::string dir;
+    std::string prefix;
+    uint64_t maxFileSize;
+    uint64_t chunkSize;
+    uint32_t current{0};
+    uint64_t end{0};       // logical end of the current file
+    uint64_t allocated{0}; // bytes reserved on disk for the current file
+    int fd{-1};
+
+    struct ReadHandle;
+    static constexpr std::size_t kMaxReadHandles = 16;
+    mutable std::mutex readMu;
+    // Most recently used first. A handle stays open while a reader holds it,
+    // even after it has been evicted.
+    mutable std::list<std::pair<uint32_t, std::shared_ptr<ReadHandle>>> readHandles;
+
+    std::shared_ptr<ReadHandle> GetReadHandle(uint32_t file) const;
+    void Open(bool truncate);
+    void Reserve(uint64_t needed);
+};
@@ -1,4 +1,5 @@
 #include "transaction.h"
+#include "transaction_view.h"
 
 #include "../crypto/tagged_hash.h"
 
@@ -8,36 +9,80 @@
 #include <limits>
 #include <openssl/sha.h>
 
-static void WriteUint32(std::vector<uint8_t>& out, uint32_t v)
+namespace {
+
+// Serialized size excluding scripts.
+// Base: version(4) + vinSize(4) + voutSize(4) + lockTime(4) = 16 bytes
+// Per input: hash(32) + index(4) + assetId(1) + scriptSig_len(4) + sequence(4) = 45 bytes
+// Per output: assetId(1) + value(8) + scriptPubKey_len(4) = 13 bytes
+constexpr size_t BASE_SIZE = 16;
+constexpr size_t INPUT_OVERHEAD = 45;
+constexpr size_t OUTPUT_OVERHEAD = 13;
+
+// Sinks for WriteTransaction. Each receives the encoding in small pieces.
+struct VectorSink {
+    std::vector<uint8_t>& out;
+    void Write(const uint8_t* data, size_t size) { out.insert(out.end(), data, data + size); }
+};
+
+struct BufferSink {
+    uint8_t* out;
+    size_t capacity;
+    size_t used{0};
+    void Write(const uint8_t* data, size_t size)
+    {
+        if (size > capacity - used)
+            throw std::length_error("serialization buffer too small");
+        std::memcpy(out + used, data, size);
+        used += size;
+    }
+};
+
+// Batches the small field writes so SHA-256 sees a few large updates.
+class HashSink {
+public:
+    explicit HashSink(SHA256_CTX& ctx_) : ctx(ctx_) {}
+    void Write(const uint8_t* data, size_t size)
+    {
+        if (used + size > sizeof(buf)) {
+            Flush();
+            if (size >= sizeof(buf)) {
+                SHA256_Update(&ctx, data, size);
+                return;
+            }
+        }
+        std::memcpy(buf + used, data, size);
+        used += size;
+    }
+    void Flush()
+    {
+        if (used > 0)
+            SHA256_Update(&ctx, buf, used);
+        used = 0;
+    }
+
+private:
+    SHA256_CTX& ctx;
+    uint8_t buf[256];
+    size_t used{0};
+};
+
+template <typename Sink>
+void WriteUint32(Sink& sink, uint32_t v)
 {
-    // Optimize: write all 4 bytes at once using array
-    uint8_t bytes[4] = {
+    const uint8_t bytes[4] = {
         static_cast<uint8_t>(v & 0xFF),
         static_cast<uint8_t>((v >> 8) & 0xFF),
         static_cast<uint8_t>((v >> 16) & 0xFF),
         static_cast<uint8_t>((v >> 24) & 0xFF)
     };
-    out.insert(out.end(), bytes, bytes + 4);
-}
-
-static void WriteUint8(std::vector<uint8_t>& out, uint8_t v)
-{
-    out.push_back(v);
-}
-
-static uint32_t ReadUint32(const std::vector<uint8_t>& data, size_t& offset)
-{
-    if (offset + 4 > data.size()) throw std::runtime_error("deserialize uint32 overflow");
-    uint32_t v = 0;
-    for (int i = 0; i < 4; ++i)
-        v |= static_cast<uint32_t>(data[offset++]) << (8 * i);
-    return v;
+    sink.Write(bytes, 4);
 }
 
-static void WriteUint64(std::vector<uint8_t>& out, uint64_t v)
+template <typename Sink>
+void WriteUint64(Sink& sink, uint64_t v)
 {
-    // Optimize: write all 8 bytes at once using array
-    uint8_t bytes[8] = {
+    const uint8_t bytes[8] = {
         static_cast<uint8_t>(v & 0xFF),
         static_cast<uint8_t>((v >> 8) & 0xFF),
         static_cast<uint8_t>((v >> 16) & 0xFF),
@@ -47,157 +92,130 @@ static void WriteUint64(std::vector<uint8_t>& out, uint64_t v)
         static_cast<uint8_t>((v >> 48) & 0xFF),
         static_cast<uint8_t>((v >> 56) & 0xFF)
     };
-    out.insert(out.end(), bytes, bytes + 8);
+    sink.Write(bytes, 8);
 }
 
-static uint64_t ReadUint64(const std::vector<uint8_t>& data, size_t& offset)
+template <typename Sink>
+void WriteVarBytes(Sink& sink, const std::vector<uint8_t>& bytes)
 {
-    if (offset + 8 > data.size()) throw std::runtime_error("deserialize uint64 overflow");
-    uint64_t v = 0;
-    for (int i = 0; i < 8; ++i)
-        v |= static_cast<uint64_t>(data[offset++]) << (8 * i);
-    return v;
+    WriteUint32(sink, static_cast<uint32_t>(bytes.size()));
+    if (!bytes.empty())
+        sink.Write(bytes.data(), bytes.size());
 }
 
-static uint8_t ReadUint8(const std::vector<uint8_t>& data, size_t& offset)
+// The one encoder behind every serialization path. With blankScriptSigs the
+// scriptSigs are written as empty, which is the signature-hash preimage.
+template <typename Sink>
+void WriteTransaction(Sink& sink, const Transaction& tx, bool blankScriptSigs)
 {
-    if (offset + 1 > data.size()) throw std::runtime_error("deserialize uint8 overflow");
-    return data[offset++];
+    static const std::vector<uint8_t> EMPTY_SCRIPT;
+    WriteUint32(sink, tx.version);
+    WriteUint32(sink, static_cast<uint32_t>(tx.vin.size()));
+    for (const auto& in : tx.vin) {
+        sink.Write(in.prevout.hash.data(), in.prevout.hash.size());
+        WriteUint32(sink, in.prevout.index);
+        sink.Write(&in.assetId, 1);
+        WriteVarBytes(sink, blankScriptSigs ? EMPTY_SCRIPT : in.scriptSig);
+        WriteUint32(sink, in.sequence);
+    }
+    WriteUint32(sink, static_cast<uint32_t>(tx.vout.size()));
+    for (const auto& o : tx.vout) {
+        sink.Write(&o.assetId, 1);
+        WriteUint64(sink, o.value);
+        WriteVarBytes(sink, o.scriptPubKey);
+    }
+    WriteUint32(sink, tx.lockTime);
 }
 
-static void WriteVarBytes(std::vector<uint8_t>& out, const std::vector<uint8_t>& bytes)
+} // namespace
+
+size_t GetSerializeSize(const Transaction& tx)
 {
-    WriteUint32(out, static_cast<uint32_t>(bytes.size()));
-    out.insert(out.end(), bytes.begin(), bytes.end());
+    size_t size = BASE_SIZE + tx.vin.size() * INPUT_OVERHEAD + tx.vout.size() * OUTPUT_OVERHEAD;
+    for (const auto& in : tx.vin)
+        size += in.scriptSig.size();
+    for (const auto& o : tx.vout)
+        size += o.scriptPubKey.size();
+    return size;
 }
 
-static std::vector<uint8_t> ReadVarBytes(const std::vector<uint8_t>& data, size_t& offset)
+size_t SerializeInto(const Transaction& tx, uint8_t* out, size_t capacity)
 {
-    uint32_t len = ReadUint32(data, offset);
-    if (offset + len > data.size()) throw std::runtime_error("deserialize var bytes overflow");
-    std::vector<uint8_t> out(data.begin() + offset, data.begin() + offset + len);
-    offset += len;
-    return out;
+    BufferSink sink{out, capacity};
+    WriteTransaction(sink, tx, false);
+    return sink.used;
 }
 
-static const std::vector<uint8_t> EMPTY_SCRIPT;
+void SerializeAppend(const Transaction& tx, std::vector<uint8_t>& out)
+{
+    const size_t offset = out.size();
+    out.resize(offset + GetSerializeSize(tx));
+    SerializeInto(tx, out.data() + offset, out.size() - offset);
+}
+
+void SerializeToHash(const Transaction& tx, SHA256_CTX& ctx)
+{
+    HashSink sink(ctx);
+    WriteTransaction(sink, tx, false);
+    sink.Flush();
+}
 
 std::vector<uint8_t> Serialize(const Transaction& tx)
 {
     std::vector<uint8_t> out;
-    // Pre-allocate approximate size to reduce reallocations
-    // Base: version(4) + vinSize(4) + voutSize(4) + lockTime(4) = 16 bytes
-    // Per input: hash(32) + index(4) + assetId(1) + sequence(4) + scriptSig_len(4) + scriptSig
-    //            = 45 bytes + scriptSig size
-    // Per output: assetId(1) + value(8) + scriptPubKey_len(4) + scriptPubKey
-    //            = 13 bytes + scriptPubKey size
-    constexpr size_t BASE_SIZE = 16;
-    constexpr size_t INPUT_OVERHEAD = 45;  // Fixed fields per input (excluding scriptSig)
-    constexpr size_t OUTPUT_OVERHEAD = 13; // Fixed fields per output (excluding scriptPubKey)
-    
-    size_t estimated = BASE_SIZE + tx.vin.size() * INPUT_OVERHEAD + tx.vout.size() * OUTPUT_OVERHEAD;
-    for (const auto& in : tx.vin) estimated += in.scriptSig.size();
-    for (const auto& o : tx.vout) estimated += o.scriptPubKey.size();
-    out.reserve(estimated);
-    
-    WriteUint32(out, tx.version);
-    WriteUint32(out, static_cast<uint32_t>(tx.vin.size()));
-    for (const auto& in : tx.vin) {
-        out.insert(out.end(), in.prevout.hash.begin(), in.prevout.hash.end());
-        WriteUint32(out, in.prevout.index);
-        WriteUint8(out, in.assetId);
-        WriteVarBytes(out, in.scriptSig);
-        WriteUint32(out, in.sequence);
-    }
-    WriteUint32(out, static_cast<uint32_t>(tx.vout.size()));
-    for (const auto& o : tx.vout) {
-        WriteUint8(out, o.assetId);
-        WriteUint64(out, o.value);
-        WriteVarBytes(out, o.scriptPubKey);
-    }
-    WriteUint32(out, tx.lockTime);
+    SerializeAppend(tx, out);
     return out;
 }
 
 Transaction DeserializeTransaction(const std::vector<uint8_t>& data)
 {
-    Transaction tx;
-    size_t offset = 0;
-    tx.version = ReadUint32(data, offset);
-    uint32_t vinSize = ReadUint32(data, offset);
-    tx.vin.resize(vinSize);
-    for (uint32_t i = 0; i < vinSize; ++i) {
-        if (offset + tx.vin[i].prevout.hash.size() > data.size())
-            throw std::runtime_error("deserialize hash overflow");
-        std::memcpy(tx.vin[i].prevout.hash.data(), data.data() + offset, tx.vin[i].prevout.hash.size());
-        offset += tx.vin[i].prevout.hash.size();
-        tx.vin[i].prevout.index = ReadUint32(data, offset);
-        tx.vin[i].assetId = ReadUint8(data, offset);
-        tx.vin[i].scriptSig = ReadVarBytes(data, offset);
-        tx.vin[i].sequence = ReadUint32(data, offset);
-    }
-    uint32_t voutSize = ReadUint32(data, offset);
-    tx.vout.resize(voutSize);
-    for (uint32_t i = 0; i < voutSize; ++i) {
-        tx.vout[i].assetId = ReadUint8(data, offset);
-        tx.vout[i].value = ReadUint64(data, offset);
-        tx.vout[i].scriptPubKey = ReadVarBytes(data, offset);
-    }
-    tx.lockTime = ReadUint32(data, offset);
-    if (offset != data.size())
-        throw std::runtime_error("unexpected trailing data");
-    return tx;
+    return TransactionView(data).ToTransaction();
 }
 
-std::array<uint8_t, 32> ComputeInputDigest(const Transaction& tx, size_t inputIndex)
+PrecomputedTransactionData::PrecomputedTransactionData(const Transaction& tx)
+    : m_inputs(tx.vin.size())
 {
     // Counts and indices are serialized as 32-bit values; reject impossible sizes early for consistency with the wire format.
     if (tx.vin.size() > std::numeric_limits<uint32_t>::max())
         throw std::runtime_error("too many inputs");
+
+    SHA256_Init(&m_midstate);
+    HashSink sink(m_midstate);
+    WriteTransaction(sink, tx, true);
+    sink.Flush();
+}
+
+std::array<uint8_t, 32> PrecomputedTransactionData::InputDigest(size_t inputIndex) const
+{
     if (inputIndex > std::numeric_limits<uint32_t>::max())
         throw std::runtime_error("input index overflow");
-    if (inputIndex >= tx.vin.size())
+    if (inputIndex >= m_inputs)
         throw std::runtime_error("input index out of range");
 
-    std::vector<uint8_t> ser;
-    // Pre-allocate approximate size to reduce reallocations
-    // Same estimation as Serialize() function
-    constexpr size_t BASE_SIZE = 16;
-    constexpr size_t INPUT_OVERHEAD = 45;
-    constexpr size_t OUTPUT_OVERHEAD = 13;
-    size_t estimated = BASE_SIZE + tx.vin.size() * INPUT_OVERHEAD + tx.vout.size() * OUTPUT_OVERHEAD;
-    ser.reserve(estimated);
-    WriteUint32(ser, tx.version);
-    WriteUint32(ser, static_cast<uint32_t>(tx.vin.size()));
-    for (const auto& in : tx.vin) {
-        ser.insert(ser.end(), in.prevout.hash.begin(), in.prevout.hash.end());
-        WriteUint32(ser, in.prevout.index);
-        WriteUint8(ser, in.assetId);
-        WriteVarBytes(ser, EMPTY_SCRIPT);
-        WriteUint32(ser, in.sequence);
-    }
-    WriteUint32(ser, static_cast<uint32_t>(tx.vout.size()));
-    for (const auto& o : tx.vout) {
-        WriteUint8(ser, o.assetId);
-        WriteUint64(ser, o.value);
-        WriteVarBytes(ser, o.scriptPubKey);
-    }
-    WriteUint32(ser, tx.lockTime);
-
     uint32_t idx = static_cast<uint32_t>(inputIndex);
     std::array<uint8_t, 32> digest{};
-    SHA256_CTX ctx;
-    SHA256_Init(&ctx);
-    SHA256_Update(&ctx, ser.data(), ser.size());
+    SHA256_CTX ctx = m_midstate;
     SHA256_Update(&ctx, &idx, sizeof(idx));
     SHA256_Final(digest.data(), &ctx);
     return digest;
 }
 
+std::array<uint8_t, 32> ComputeInputDigest(const Transaction& tx, size_t inputIndex)
+{
+    if (inputIndex >= tx.vin.size())
+        throw std::runtime_error("input index out of range");
+    return PrecomputedTransactionData(tx).InputDigest(inputIndex);
+}
+
 uint256 TransactionHash(const Transaction& tx)
 {
-    auto bytes = Serialize(tx);
-    return tagged_hash("TX", bytes.data(), bytes.size());
+    // The tag prefix is the same for every transaction; absorb it once.
+    static const SHA256_CTX kTxTag = tagged_hash_context("TX");
+    SHA256_CTX ctx = kTxTag;
+    SerializeToHash(tx, ctx);
+    uint256 hash{};
+    SHA256_Final(hash.data(), &ctx);
+    return hash;
 }
 
 uint256 Transaction::GetHash() const
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <string>
 #include "../crypto/tagged_hash.h"
+#include <openssl/sha.h>
 
 enum class AssetId : uint8_t { TALANTON = 0, DRACHMA = 1, OBOLOS = 2 };
 
@@ -41,8 +42,38 @@ struct Transaction {
 
 // Serialization helpers
 std::vector<uint8_t> Serialize(const Transaction& tx);
+// Length of Serialize(tx), computed from the field sizes without encoding.
+size_t GetSerializeSize(const Transaction& tx);
+// Encode into out[0, capacity) and return the bytes written. Throws
+// std::length_error if the buffer is too small; GetSerializeSize gives the
+// exact size needed.
+size_t SerializeInto(const Transaction& tx, uint8_t* out, size_t capacity);
+// Append the encoding to `out`, e.g. a block buffer or a reused scratch
+// vector, growing it by exactly GetSerializeSize(tx).
+void SerializeAppend(const Transaction& tx, std::vector<uint8_t>& out);
+// Feed the encoding to a SHA-256 context without materializing it.
+void SerializeToHash(const Transaction& tx, SHA256_CTX& ctx);
 Transaction DeserializeTransaction(const std::vector<uint8_t>& data);
 std::array<uint8_t, 32> ComputeInputDigest(const Transaction& tx, size_t inputIndex);
 
+// Signature-hash state shared by every input of a transaction. The
+// transaction (with empty scriptSigs) is serialized and absorbed into
+// SHA-256 once; each input digest then finishes a copy of that state with
+// its 4-byte index, instead of re-serializing the transaction per input.
+// Signing an input does not change the shared state, so one instance
+// serves a whole signing or verification pass.
+class PrecomputedTransactionData {
+public:
+    explicit PrecomputedTransactionData(const Transaction& tx);
+
+    // Equal to ComputeInputDigest(tx, inputIndex).
+    std::array<uint8_t, 32> InputDigest(size_t inputIndex) const;
+    size_t InputCount() const { return m_inputs; }
+
+private:
+    SHA256_CTX m_midstate;
+    size_t m_inputs;
+};
+
 // Utility for tagged hash of a transaction
 uint256 TransactionHash(const Transaction& tx);
@@ -0,0 +1,19 @@
+#include "transaction_ref.h"
+
+#include "../crypto/tagged_hash.h"
+
+#include <utility>
+
+SharedTransaction::SharedTransaction(Transaction tx)
+    : m_tx(std::move(tx)), m_bytes(Serialize(m_tx))
+{
+    m_hash = tagged_hash("TX", m_bytes.data(), m_bytes.size());
+}
+
+SharedTransaction::SharedTransaction(std::vector<uint8_t> bytes)
+    : m_tx(DeserializeTransaction(bytes)), m_bytes(std::move(bytes))
+{
+    // The encoding is canonical, so hashing the received bytes gives the
+    // same txid as hashing a re-serialization.
+    m_hash = tagged_hash("TX", m_bytes.data(), m_bytes.size());
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "transaction.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// A transaction frozen at construction together with its txid and wire
+// encoding, both computed once. Holders share one instance through
+// TransactionRef, so the mempool, relay and RPC pass pointers around
+// instead of copying, re-serializing or re-hashing the transaction.
+class SharedTransaction {
+public:
+    explicit SharedTransaction(Transaction tx);
+    // Adopt a wire encoding as received. Throws std::runtime_error on
+    // malformed or trailing data, like DeserializeTransaction.
+    explicit SharedTransaction(std::vector<uint8_t> bytes);
+
+    const Transaction& Tx() const { return m_tx; }
+    const uint256& GetHash() const { return m_hash; }
+    const std::vector<uint8_t>& Bytes() const { return m_bytes; }
+    size_t Size() const { return m_bytes.size(); }
+
+private:
+    Transaction m_tx;
+    std::vector<uint8_t> m_bytes;
+    uint256 m_hash{};
+};
+
+using TransactionRef = std::shared_ptr<const SharedTransaction>;
+
+inline TransactionRef MakeTransactionRef(Transaction tx)
+{
+    return std::make_shared<const SharedTransaction>(std::move(tx));
+}
+
+inline TransactionRef MakeTransactionRef(std::vector<uint8_t> bytes)
+{
+    return std::make_shared<const SharedTransaction>(std::move(bytes));
+}
@@ -0,0 +1,145 @@
+#include "transaction_view.h"
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Fixed bytes around each variable-length script.
+constexpr std::size_t kInputFixedSize = 32 + 4 + 1 + 4 + 4;
+constexpr std::size_t kOutputFixedSize = 1 + 8 + 4;
+
+uint32_t GetLE32(const uint8_t* p)
+{
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t GetLE64(const uint8_t* p)
+{
+    return static_cast<uint64_t>(GetLE32(p)) | (static_cast<uint64_t>(GetLE32(p + 4)) << 32);
+}
+
+class Cursor {
+public:
+    explicit Cursor(ByteSpan bytes) : m_bytes(bytes) {}
+
+    std::size_t Offset() const { return m_offset; }
+    std::size_t Remaining() const { return m_bytes.size() - m_offset; }
+    void Skip(std::size_t n, const char* what)
+    {
+        if (n > Remaining())
+            throw std::runtime_error(std::string("deserialize ") + what + " overflow");
+        m_offset += n;
+    }
+    uint32_t Read32(const char* what)
+    {
+        Skip(4, what);
+        return GetLE32(m_bytes.data() + m_offset - 4);
+    }
+
+private:
+    ByteSpan m_bytes;
+    std::size_t m_offset{0};
+};
+
+// A count is only plausible if that many minimal entries fit in the rest.
+uint32_t ReadCount(Cursor& c, std::size_t minEntrySize)
+{
+    const uint32_t count = c.Read32("uint32");
+    if (count > c.Remaining() / minEntrySize)
+        throw std::runtime_error("deserialize count overflow");
+    return count;
+}
+
+} // namespace
+
+OutPoint TxInView::Prevout() const
+{
+    OutPoint out{};
+    std::memcpy(out.hash.data(), prevoutHash, out.hash.size());
+    out.index = prevoutIndex;
+    return out;
+}
+
+TransactionView::TransactionView(ByteSpan bytes) : m_bytes(bytes)
+{
+    if (bytes.size() > UINT32_MAX)
+        throw std::runtime_error("transaction too large");
+    Cursor c(bytes);
+    c.Skip(4, "uint32"); // version
+    const uint32_t vinSize = ReadCount(c, kInputFixedSize);
+    m_offsets.reserve(vinSize + 1);
+    for (uint32_t i = 0; i < vinSize; ++i) {
+        m_offsets.push_back(static_cast<uint32_t>(c.Offset()));
+        c.Skip(32 + 4 + 1, "hash");
+        c.Skip(c.Read32("uint32"), "var bytes");
+        c.Skip(4, "uint32"); // sequence
+    }
+    m_inputs = vinSize;
+    const uint32_t voutSize = ReadCount(c, kOutputFixedSize);
+    m_offsets.reserve(m_offsets.size() + voutSize);
+    for (uint32_t i = 0; i < voutSize; ++i) {
+        m_offsets.push_back(static_cast<uint32_t>(c.Offset()));
+        c.Skip(1 + 8, "uint64");
+        c.Skip(c.Read32("uint32"), "var bytes");
+    }
+    c.Skip(4, "uint32"); // lock time
+    if (c.Remaining() != 0)
+        throw std::runtime_error("unexpected trailing data");
+}
+
+uint32_t TransactionView::Version() const
+{
+    return GetLE32(m_bytes.data());
+}
+
+uint32_t TransactionView::LockTime() const
+{
+    return GetLE32(m_bytes.end() - 4);
+}
+
+TxInView TransactionView::Input(std::size_t i) const
+{
+    if (i >= m_inputs)
+        throw std::out_of_range("input index out of range");
+    const uint8_t* p = m_bytes.data() + m_offsets[i];
+    const uint32_t scriptSize = GetLE32(p + 37);
+    return TxInView{p, GetLE32(p + 32), p[36], ByteSpan(p + 41, scriptSize), GetLE32(p + 41 + scriptSize)};
+}
+
+TxOutView TransactionView::Output(std::size_t i) const
+{
+    if (i >= OutputCount())
+        throw std::out_of_range("output index out of range");
+    const uint8_t* p = m_bytes.data() + m_offsets[m_inputs + i];
+    return TxOutView{p[0], GetLE64(p + 1), ByteSpan(p + 13, GetLE32(p + 9))};
+}
+
+uint256 TransactionView::GetHash() const
+{
+    return tagged_hash("TX", m_bytes.data(), m_bytes.size());
+}
+
+Transaction TransactionView::ToTransaction() const
+{
+    Transaction tx;
+    tx.version = Version();
+    tx.lockTime = LockTime();
+    tx.vin.resize(InputCount());
+    for (std::size_t i = 0; i < tx.vin.size(); ++i) {
+        const auto in = Input(i);
+        tx.vin[i].prevout = in.Prevout();
+        tx.vin[i].assetId = in.assetId;
+        tx.vin[i].scriptSig = in.scriptSig.ToVector();
+        tx.vin[i].sequence = in.sequence;
+    }
+    tx.vout.resize(OutputCount());
+    for (std::size_t i = 0; i < tx.vout.size(); ++i) {
+        const auto out = Output(i);
+        tx.vout[i].assetId = out.assetId;
+        tx.vout[i].value = out.value;
+        tx.vout[i].scriptPubKey = out.scriptPubKey.ToVector();
+    }
+    return tx;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "transaction.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Read-only window over bytes owned elsewhere. The owner must outlive it.
+class ByteSpan {
+public:
+    ByteSpan() = default;
+    ByteSpan(const uint8_t* data, std::size_t size) : m_data(data), m_size(size) {}
+    ByteSpan(const std::vector<uint8_t>& bytes) : m_data(bytes.data()), m_size(bytes.size()) {}
+
+    const uint8_t* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const uint8_t* begin() const { return m_data; }
+    const uint8_t* end() const { return m_data + m_size; }
+    uint8_t operator[](std::size_t i) const { return m_data[i]; }
+    ByteSpan subspan(std::size_t offset, std::size_t size) const { return {m_data + offset, size}; }
+    std::vector<uint8_t> ToVector() const { return {begin(), end()}; }
+
+private:
+    const uint8_t* m_data{nullptr};
+    std::size_t m_size{0};
+};
+
+struct TxInView {
+    const uint8_t* prevoutHash; // 32 bytes
+    uint32_t prevoutIndex;
+    uint8_t assetId;
+    ByteSpan scriptSig;
+    uint32_t sequence;
+
+    OutPoint Prevout() const;
+};
+
+struct TxOutView {
+    uint8_t assetId;
+    uint64_t value;
+    ByteSpan scriptPubKey;
+};
+
+// A serialized transaction parsed in place. The constructor walks the wire
+// format once, rejecting anything DeserializeTransaction would reject, and
+// remembers where each input and output starts; accessors then decode
+// fields straight from the buffer and scripts are returned as spans into
+// it. The only allocation is the offset table. ToTransaction() builds an
+// owning copy for callers that need one.
+class TransactionView {
+public:
+    // Throws std::runtime_error on malformed or trailing data.
+    explicit TransactionView(ByteSpan bytes);
+
+    uint32_t Version() const;
+    uint32_t LockTime() const;
+    std::size_t InputCount() const { return m_inputs; }
+    std::size_t OutputCount() const { return m_offsets.size() - m_inputs; }
+    TxInView Input(std::size_t i) const;
+    TxOutView Output(std::size_t i) const;
+
+    // The exact serialized bytes; Serialize(ToTransaction()) == Bytes().
+    ByteSpan Bytes() const { return m_bytes; }
+    // Same as TransactionHash(ToTransaction()), without re-serializing.
+    uint256 GetHash() const;
+    Transaction ToTransaction() const;
+
+private:
+    ByteSpan m_bytes;
+    std::size_t m_inputs{0};
+    std::vector<uint32_t> m_offsets; // inputs, then outputs
+};
@@ -0,0 +1,139 @@
+#include "checkqueue.h"
+#include <algorithm>
+
+CheckQueue::CheckQueue(unsigned workerThreads)
+{
+    threads.reserve(workerThreads);
+    for (unsigned i = 0; i < workerThreads; ++i)
+        threads.emplace_back([this] { WorkerLoop(); });
+}
+
+CheckQueue::~CheckQueue()
+{
+    {
+        std::lock_guard<std::mutex> l(mu);
+        stopping = true;
+    }
+    workCv.notify_all();
+    for (auto& t : threads)
+        t.join();
+}
+
+bool CheckQueue::RunInline(const std::vector<Check>& checks)
+{
+    for (const auto& check : checks) {
+        try {
+            if (!check())
+                return false;
+        } catch (...) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CheckQueue::RunAll(const std::vector<Check>& checks)
+{
+    if (threads.empty() || checks.size() < 2)
+        return RunInline(checks);
+    std::unique_lock<std::mutex> owner(control, std::try_to_lock);
+    if (!owner.owns_lock())
+        return RunInline(checks);
+
+    {
+        std::lock_guard<std::mutex> l(mu);
+        batch = &checks;
+        // Several chunks per thread so uneven checks still balance out.
+        chunk = std::max<std::size_t>(1, checks.size() / ((threads.size() + 1) * 4));
+        next.store(0);
+        failed.store(false);
+        active = static_cast<unsigned>(threads.size());
+        ++generation;
+    }
+    workCv.notify_all();
+    Drain(checks);
+
+    std::unique_lock<std::mutex> l(mu);
+    doneCv.wait(l, [this] { return active == 0; });
+    batch = nullptr;
+    return !failed.load();
+}
+
+void CheckQueue::WorkerLoop()
+{
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> l(mu);
+    for (;;) {
+        workCv.wait(l, [&] { return stopping || generation != seen; });
+        if (stopping)
+            return;
+        seen = generation;
+        const auto* checks = batch;
+        l.unlock();
+        Drain(*checks);
+        l.lock();
+        if (--active == 0)
+            doneCv.notify_one();
+    }
+}
+
+void CheckQueue::Drain(const std::vector<Check>& checks)
+{
+    const std::size_t n = checks.size();
+    while (!failed.load(std::memory_order_relaxed)) {
+        const std::size_t begin = next.fetch_add(chunk);
+        if (begin >= n)
+            return;
+        const std::size_t end = std::min(n, begin + chunk);
+        for (std::size_t i = begin; i < end; ++i) {
+            bool ok = false;
+            try {
+                ok = checks[i]();
+            } catch (...) {
+            }
+            if (!ok) {
+                failed.store(true);
+                return;
+            }
+            if (failed.load(std::memory_order_relaxed))
+                return;
+        }
+    }
+}
+
+namespace {
+
+std::mutex g_scriptCheckMu;
+int g_scriptCheckThreads = 0;
+std::shared_ptr<CheckQueue> g_scriptCheckQueue;
+
+int ResolveThreads(int requested)
+{
+    const int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    int threads = requested > 0 ? requested : cores + requested;
+    return std::clamp(threads, 1, kMaxScriptCheckThreads);
+}
+
+} // namespace
+
+void SetScriptCheckThreads(int threads)
+{
+    std::lock_guard<std::mutex> l(g_scriptCheckMu);
+    g_scriptCheckThreads = threads;
+    // Batches still running keep the old pool alive through their reference.
+    g_scriptCheckQueue.reset();
+}
+
+int GetScriptCheckThreads()
+{
+    std::lock_guard<std::mutex> l(g_scriptCheckMu);
+    return ResolveThreads(g_scriptCheckThreads);
+}
+
+std::shared_ptr<CheckQueue> GetScriptCheckQueue()
+{
+    std::lock_guard<std::mutex> l(g_scriptCheckMu);
+    if (!g_scriptCheckQueue)
+        g_scriptCheckQueue = std::make_shared<CheckQueue>(static_cast<unsigned>(ResolveThreads(g_scriptCheckThreads) - 1));
+    return g_scriptCheckQueue;
+}
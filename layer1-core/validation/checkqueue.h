@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of verification workers. A batch of independent checks is
+// split into chunks that the workers and the submitting thread claim from a
+// shared cursor; the first failing (or throwing) check stops everyone else
+// from starting new work.
+//
+// One batch runs at a time. A caller that finds the pool busy runs its
+// batch on its own thread instead of waiting.
+class CheckQueue {
+public:
+    using Check = std::function<bool()>;
+
+    explicit CheckQueue(unsigned workerThreads);
+    ~CheckQueue();
+
+    CheckQueue(const CheckQueue&) = delete;
+    CheckQueue& operator=(const CheckQueue&) = delete;
+
+    // True when every check returned true.
+    bool RunAll(const std::vector<Check>& checks);
+
+    unsigned WorkerThreads() const { return static_cast<unsigned>(threads.size()); }
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex control; // held by the thread that owns the current batch
+    std::mutex mu;
+    std::condition_variable workCv;
+    std::condition_variable doneCv;
+    const std::vector<Check>* batch{nullptr};
+    std::size_t chunk{1};
+    std::atomic<std::size_t> next{0};
+    std::atomic<bool> failed{false};
+    uint64_t generation{0};
+    unsigned active{0};
+    bool stopping{false};
+
+    void WorkerLoop();
+    void Drain(const std::vector<Check>& checks);
+    static bool RunInline(const std::vector<Check>& checks);
+};
+
+// Script-check parallelism for block and transaction validation, counting
+// the calling thread (the -par option). 0 picks one thread per core and a
+// negative value leaves that many cores free; 1 disables the worker pool.
+constexpr int kMaxScriptCheckThreads = 64;
+void SetScriptCheckThreads(int threads);
+int GetScriptCheckThreads();
+// The shared pool sized by SetScriptCheckThreads, built on first use.
+std::shared_ptr<CheckQueue> GetScriptCheckQueue();
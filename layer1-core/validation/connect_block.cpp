@@ -1,102 +1,402 @@
 #include "validation.h"
 #include "../chainstate/coins.h"
-#include <unordered_set>
+#include "../chainstate/undo.h"
+#include "../consensus/fork_resolution.h"
+#include "../storage/blockstore.h"
+#include "checkqueue.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
 #include <stdexcept>
-
-namespace validation {
+#include <unordered_map>
+#include <unordered_set>
 
 namespace {
 
-struct OutPointHasher {
-    std::size_t operator()(const OutPoint& o) const noexcept {
-        size_t h = 0;
-        for (auto b : o.hash) h = (h * 131) ^ b;
-        h ^= static_cast<size_t>(o.index + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
-        return h;
+bool IsCoinbaseTx(const Transaction& tx)
+{
+    if (tx.vin.size() != 1)
+        return false;
+    const auto& prevout = tx.vin[0].prevout;
+    if (prevout.index != std::numeric_limits<uint32_t>::max())
+        return false;
+    for (auto b : prevout.hash) {
+        if (b != 0)
+            return false;
     }
-};
+    return true;
+}
+
+// Below this many transactions a wave is applied on the calling thread.
+constexpr size_t kMinParallelApplyTxs = 16;
 
-struct OutPointEq {
-    bool operator()(const OutPoint& a, const OutPoint& b) const noexcept {
-        return a.index == b.index && a.hash == b.hash;
+// Group a block's transactions into waves such that every transaction only
+// spends coins that exist before its wave starts: a transaction spending an
+// output created in the block lands one wave after the creating one. The
+// transactions of a wave touch disjoint coins and can be applied in any
+// order. Fails if a transaction spends an output of itself or of a later
+// transaction, which applying in block order could never accept.
+bool BuildApplyWaves(const Block& block, const std::vector<uint256>& txids, std::vector<std::vector<size_t>>& waves)
+{
+    std::unordered_map<uint256, size_t, consensus::Uint256Hasher> position;
+    position.reserve(txids.size());
+    for (size_t i = 0; i < txids.size(); ++i)
+        position.emplace(txids[i], i);
+
+    std::vector<size_t> wave(block.transactions.size(), 0);
+    for (size_t txIdx = 0; txIdx < block.transactions.size(); ++txIdx) {
+        if (txIdx == 0 && IsCoinbaseTx(block.transactions[0]))
+            continue;
+        for (const auto& input : block.transactions[txIdx].vin) {
+            auto it = position.find(input.prevout.hash);
+            if (it == position.end())
+                continue;
+            if (it->second >= txIdx)
+                return false;
+            wave[txIdx] = std::max(wave[txIdx], wave[it->second] + 1);
+        }
+        if (wave[txIdx] >= waves.size())
+            waves.resize(wave[txIdx] + 1);
+        waves[wave[txIdx]].push_back(txIdx);
+    }
+    if (!block.transactions.empty() && IsCoinbaseTx(block.transactions[0])) {
+        if (waves.empty())
+            waves.resize(1);
+        waves[0].insert(waves[0].begin(), 0);
     }
-};
+    return true;
+}
 
-} // namespace
+// Hash every transaction of the block once, for all later passes to share.
+std::vector<uint256> BlockTxids(const Block& block)
+{
+    std::vector<uint256> txids;
+    txids.reserve(block.transactions.size());
+    for (const auto& tx : block.transactions)
+        txids.push_back(tx.GetHash());
+    return txids;
+}
 
-// ConnectBlock applies a validated block to the UTXO set and checks that
-// all inputs are available and signed correctly.
-bool ConnectBlock(const Block& block, 
-                  chainstate::Chainstate& chainstate,
-                  const consensus::Params& params,
-                  int height,
-                  const UTXOLookup& fallbackLookup)
+// Apply the coin changes of an already validated block inside a chainstate
+// transaction. Each wave from BuildApplyWaves is spread over the script
+// check workers; undo entries keep block order regardless of which thread
+// applied them.
+bool ApplyBlockCoins(const Block& block, const std::vector<uint256>& txids, Chainstate& chainstate, uint32_t height, BlockUndo& undo)
 {
-    // First, validate the block structure and PoW
-    BlockValidationOptions opts;
-    opts.medianTimePast = 1; // Caller must provide proper MTP
-    if (!ValidateBlock(block, params, height, fallbackLookup, opts)) {
+    const size_t txCount = block.transactions.size();
+    std::vector<size_t> undoOffset(txCount, 0);
+    size_t spends = 0;
+    for (size_t txIdx = 0; txIdx < txCount; ++txIdx) {
+        const auto& tx = block.transactions[txIdx];
+        undoOffset[txIdx] = spends;
+        if (!(txIdx == 0 && IsCoinbaseTx(tx)))
+            spends += tx.vin.size();
+    }
+    std::vector<std::vector<size_t>> waves;
+    if (!BuildApplyWaves(block, txids, waves))
+        return false;
+
+    undo.spent.clear();
+    undo.spent.resize(spends);
+    auto applyTx = [&](size_t txIdx) {
+        const auto& tx = block.transactions[txIdx];
+        const bool isCoinbase = txIdx == 0 && IsCoinbaseTx(tx);
+        if (!isCoinbase) {
+            for (size_t i = 0; i < tx.vin.size(); ++i) {
+                UndoEntry& entry = undo.spent[undoOffset[txIdx] + i];
+                entry.prevout = tx.vin[i].prevout;
+                if (!chainstate.SpendCoin(entry.prevout, &entry.coin))
+                    return false; // missing or already spent
+            }
+        }
+        for (size_t outIdx = 0; outIdx < tx.vout.size(); ++outIdx) {
+            OutPoint op{txids[txIdx], static_cast<uint32_t>(outIdx)};
+            // Only a coinbase can repeat an earlier txid.
+            chainstate.AddCoin(op, Coin(tx.vout[outIdx], height, isCoinbase), isCoinbase);
+        }
+        return true;
+    };
+
+    auto queue = GetScriptCheckQueue();
+    chainstate.BeginTransaction();
+    try {
+        for (const auto& wave : waves) {
+            bool ok = true;
+            if (queue && queue->WorkerThreads() > 0 && wave.size() >= kMinParallelApplyTxs) {
+                std::vector<CheckQueue::Check> checks;
+                checks.reserve(wave.size());
+                for (size_t txIdx : wave)
+                    checks.emplace_back([&applyTx, txIdx] { return applyTx(txIdx); });
+                ok = queue->RunAll(checks);
+            } else {
+                for (size_t txIdx : wave) {
+                    if (!(ok = applyTx(txIdx)))
+                        break;
+                }
+            }
+            if (!ok) {
+                chainstate.Rollback();
+                undo.spent.clear();
+                return false;
+            }
+        }
+    } catch (const std::exception&) {
+        chainstate.Rollback();
+        undo.spent.clear();
         return false;
     }
+    chainstate.SetBestBlock(BlockHash(block.header));
+    chainstate.Commit();
+    return true;
+}
 
-    // Track all inputs spent in this block to detect double-spends within block
-    std::unordered_set<OutPoint, OutPointHasher, OutPointEq> spentInBlock;
+size_t PrefetchInputs(const Block& block, const std::vector<uint256>& txids, Chainstate& chainstate)
+{
+    const std::unordered_set<uint256, consensus::Uint256Hasher> inBlock(txids.begin(), txids.end());
 
-    // Process all transactions
+    // One work unit per shard keeps the workers off each other's locks.
+    std::array<std::vector<OutPoint>, Chainstate::kCoinShards> byShard;
     for (size_t txIdx = 0; txIdx < block.transactions.size(); ++txIdx) {
         const auto& tx = block.transactions[txIdx];
-        
-        // Detect coinbase: must be first tx with single input that has null prevout
-        bool isCoinbase = false;
-        if (txIdx == 0 && tx.vin.size() == 1) {
-            const auto& input = tx.vin[0];
-            // Check for null hash (all zeros) and max index
-            bool hasNullHash = true;
-            for (auto b : input.prevout.hash) {
-                if (b != 0) {
-                    hasNullHash = false;
-                    break;
-                }
+        if (txIdx == 0 && IsCoinbaseTx(tx))
+            continue;
+        for (const auto& input : tx.vin) {
+            if (!inBlock.count(input.prevout.hash))
+                byShard[Chainstate::ShardIndex(input.prevout)].push_back(input.prevout);
+        }
+    }
+
+    std::atomic<size_t> resident{0};
+    std::vector<CheckQueue::Check> checks;
+    for (const auto& outs : byShard) {
+        if (outs.empty())
+            continue;
+        checks.emplace_back([&chainstate, &outs, &resident] {
+            resident += chainstate.WarmCoins(outs);
+            return true;
+        });
+    }
+    auto queue = GetScriptCheckQueue();
+    if (queue && queue->WorkerThreads() > 0 && checks.size() > 1) {
+        queue->RunAll(checks);
+    } else {
+        for (const auto& check : checks)
+            check();
+    }
+    return resident.load();
+}
+
+} // namespace
+
+size_t PrefetchBlockInputs(const Block& block, Chainstate& chainstate)
+{
+    return PrefetchInputs(block, BlockTxids(block), chainstate);
+}
+
+bool ConnectBlock(const Block& block, Chainstate& chainstate, const consensus::Params& params, int height, BlockUndo& undo, const BlockValidationOptions& opts)
+{
+    if (height < 0)
+        return false;
+    const uint256 best = chainstate.GetBestBlock();
+    if (best != uint256{} && block.header.prevBlockHash != best)
+        return false; // does not extend the current tip
+    // Every pass below shares these instead of hashing the block again.
+    const std::vector<uint256> txids = BlockTxids(block);
+    PrefetchInputs(block, txids, chainstate);
+
+    // Inputs may refer to outputs created earlier in the same block.
+    std::unordered_map<OutPoint, TxOut, OutPointHash, OutPointEq> created;
+    for (size_t txIdx = 0; txIdx < block.transactions.size(); ++txIdx) {
+        const auto& tx = block.transactions[txIdx];
+        for (size_t i = 0; i < tx.vout.size(); ++i)
+            created.emplace(OutPoint{txids[txIdx], static_cast<uint32_t>(i)}, tx.vout[i]);
+    }
+    UTXOLookup lookup = [&](const OutPoint& out) -> std::optional<TxOut> {
+        auto it = created.find(out);
+        if (it != created.end())
+            return it->second;
+        return chainstate.TryGetUTXO(out);
+    };
+    BlockValidationOptions withTxids = opts;
+    withTxids.txids = &txids;
+    if (!ValidateBlock(block, params, height, lookup, withTxids))
+        return false;
+
+    return ApplyBlockCoins(block, txids, chainstate, static_cast<uint32_t>(height), undo);
+}
+
+bool ReplayBlock(const Block& block, Chainstate& chainstate, uint32_t height)
+{
+    chainstate.BeginTransaction();
+    try {
+        for (size_t txIdx = 0; txIdx < block.transactions.size(); ++txIdx) {
+            const auto& tx = block.transactions[txIdx];
+            const bool isCoinbase = txIdx == 0 && IsCoinbaseTx(tx);
+            if (!isCoinbase) {
+                for (const auto& in : tx.vin)
+                    chainstate.SpendCoin(in.prevout); // false if the flush already removed it
             }
-            isCoinbase = hasNullHash && input.prevout.index == std::numeric_limits<uint32_t>::max();
+            const uint256 txid = tx.GetHash();
+            for (size_t outIdx = 0; outIdx < tx.vout.size(); ++outIdx)
+                chainstate.AddCoin(OutPoint{txid, static_cast<uint32_t>(outIdx)}, Coin(tx.vout[outIdx], height, isCoinbase), true);
         }
-        
-        if (!isCoinbase) {
-            // Verify all inputs exist and aren't double-spent
-            for (const auto& input : tx.vin) {
-                // Check for intra-block double spend
-                if (spentInBlock.count(input.prevout)) {
-                    return false; // Double spend within this block
+    } catch (const std::exception&) {
+        chainstate.Rollback();
+        return false;
+    }
+    chainstate.SetBestBlock(BlockHash(block.header));
+    chainstate.Commit();
+    return true;
+}
+
+bool ReplayInterruptedFlush(Chainstate& chainstate, BlockStore& store)
+{
+    const auto range = chainstate.PendingReplay();
+    if (!range)
+        return true;
+    // Walk back from the new best block; the old one was fully applied.
+    std::vector<std::pair<std::shared_ptr<const CachedBlock>, uint32_t>> blocks;
+    for (uint256 hash = range->to; hash != range->from;) {
+        if (hash == uint256{})
+            return false; // ran past genesis without meeting the old best block
+        const auto loc = store.LookupBlock(hash);
+        std::shared_ptr<const CachedBlock> blk;
+        try {
+            blk = store.GetBlockByHash(hash);
+        } catch (const std::runtime_error&) {
+        }
+        if (!loc || !blk)
+            return false;
+        blocks.emplace_back(blk, loc->height);
+        hash = blk->block.header.prevBlockHash;
+    }
+    for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+        if (!ReplayBlock(it->first->block, chainstate, it->second))
+            throw std::runtime_error("cannot replay block after interrupted flush");
+    }
+    // Completing a flush is what ends the replay.
+    chainstate.Flush();
+    return true;
+}
+
+bool DisconnectBlock(const Block& block, Chainstate& chainstate, const BlockUndo& undo)
+{
+    if (chainstate.GetBestBlock() != BlockHash(block.header))
+        return false;
+
+    chainstate.BeginTransaction();
+    size_t remaining = undo.spent.size();
+    try {
+        for (size_t txIdx = block.transactions.size(); txIdx-- > 0;) {
+            const auto& tx = block.transactions[txIdx];
+            const auto txHash = tx.GetHash();
+            for (size_t outIdx = 0; outIdx < tx.vout.size(); ++outIdx) {
+                if (!chainstate.SpendCoin(OutPoint{txHash, static_cast<uint32_t>(outIdx)})) {
+                    chainstate.Rollback();
+                    return false; // output missing: chainstate does not match block
                 }
-                spentInBlock.insert(input.prevout);
-                
-                // Verify UTXO exists (either in chainstate or fallback)
-                std::optional<TxOut> utxo = chainstate.TryGetUTXO(input.prevout);
-                if (!utxo && fallbackLookup) {
-                    utxo = fallbackLookup(input.prevout);
+            }
+            if (txIdx == 0 && IsCoinbaseTx(tx))
+                continue;
+            for (size_t inIdx = tx.vin.size(); inIdx-- > 0;) {
+                if (remaining == 0) {
+                    chainstate.Rollback();
+                    return false;
                 }
-                if (!utxo) {
-                    return false; // Missing UTXO
+                const auto& entry = undo.spent[--remaining];
+                const auto& prevout = tx.vin[inIdx].prevout;
+                if (entry.prevout.index != prevout.index || entry.prevout.hash != prevout.hash) {
+                    chainstate.Rollback();
+                    return false; // undo data belongs to another block
                 }
+                chainstate.AddCoin(prevout, entry.coin, false);
             }
         }
-        
-        // Add new outputs to UTXO set
-        auto txHash = tx.GetHash();
-        for (size_t outIdx = 0; outIdx < tx.vout.size(); ++outIdx) {
-            OutPoint op{txHash, static_cast<uint32_t>(outIdx)};
-            chainstate.AddUTXO(op, tx.vout[outIdx]);
+    } catch (const std::exception&) {
+        chainstate.Rollback();
+        return false;
+    }
+    if (remaining != 0) {
+        chainstate.Rollback();
+        return false;
+    }
+    chainstate.SetBestBlock(block.header.prevBlockHash);
+    chainstate.Commit();
+    return true;
+}
+
+bool ApplyReorg(const consensus::ReorgPlan& plan, Chainstate& chainstate, BlockStore& store, const consensus::Params& params, const BlockProvider& newBlocks, const BlockValidationOptions& opts)
+{
+    struct Step {
+        Block block;
+        BlockUndo undo;
+        uint32_t height{0};
+    };
+    std::vector<Step> disconnected;
+    std::vector<Step> connected;
+    disconnected.reserve(plan.disconnect.size());
+    connected.reserve(plan.connect.size());
+    if (plan.disconnect.empty() && plan.connect.empty())
+        return true;
+    // Disconnects run from the old tip down, connects from the fork up.
+    const uint32_t forkHeight = plan.disconnect.empty() ? plan.connect.front().height - 1
+                                                        : plan.disconnect.back().height - 1;
+    const uint32_t oldTip = plan.disconnect.empty() ? forkHeight : plan.disconnect.front().height;
+    const uint32_t newTip = plan.connect.empty() ? forkHeight : plan.connect.back().height;
+
+    // Unwind whatever part of the plan ran and put the old branch back. Old
+    // blocks were valid when first connected, so they are re-applied without
+    // another full validation pass; only heights the new branch overwrote in
+    // the store are written again.
+    auto restore = [&]() {
+        for (auto it = connected.rbegin(); it != connected.rend(); ++it) {
+            if (!DisconnectBlock(it->block, chainstate, it->undo))
+                throw std::runtime_error("reorg rollback failed to disconnect block");
         }
-        
-        // Remove spent inputs from UTXO set
-        if (!isCoinbase) {
-            for (const auto& input : tx.vin) {
-                chainstate.SpendUTXO(input.prevout);
+        const uint32_t overwrittenTop = connected.empty() ? forkHeight : connected.back().height;
+        for (auto it = disconnected.rbegin(); it != disconnected.rend(); ++it) {
+            if (!ApplyBlockCoins(it->block, BlockTxids(it->block), chainstate, it->height, it->undo))
+                throw std::runtime_error("reorg rollback failed to reconnect block");
+            if (it->height <= overwrittenTop) {
+                store.WriteBlock(it->height, it->block);
+                store.WriteUndo(it->height, it->undo);
             }
         }
+        store.TruncateAbove(oldTip);
+        return false;
+    };
+
+    for (const auto& meta : plan.disconnect) {
+        Step step;
+        try {
+            step = Step{store.ReadBlock(meta.height), store.ReadUndo(meta.height), meta.height};
+        } catch (const std::runtime_error&) {
+            return restore(); // block or rev data unreadable
+        }
+        if (BlockHash(step.block.header) != meta.hash)
+            return restore();
+        if (!DisconnectBlock(step.block, chainstate, step.undo))
+            return restore();
+        disconnected.push_back(std::move(step));
     }
 
+    for (size_t i = 0; i < plan.connect.size(); ++i) {
+        const auto& meta = plan.connect[i];
+        auto block = newBlocks ? newBlocks(meta.hash) : std::nullopt;
+        if (!block || BlockHash(block->header) != meta.hash)
+            return restore();
+        BlockValidationOptions blockOpts = opts;
+        if (i < plan.connectMedianTimePast.size())
+            blockOpts.medianTimePast = plan.connectMedianTimePast[i];
+        Step step{std::move(*block), BlockUndo{}, meta.height};
+        if (!ConnectBlock(step.block, chainstate, params, static_cast<int>(meta.height), step.undo, blockOpts))
+            return restore();
+        store.WriteBlock(meta.height, step.block);
+        store.WriteUndo(meta.height, step.undo);
+        connected.push_back(std::move(step));
+    }
+    // A shorter branch leaves the old one's upper heights behind.
+    store.TruncateAbove(newTip);
     return true;
 }
-
-} // namespace validation
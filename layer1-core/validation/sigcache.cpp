@@ -0,0 +1,96 @@
+#include "sigcache.h"
+
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+SignatureCache::SignatureCache(size_t maxBytes)
+    : maxPerShard(std::max<size_t>(1, maxBytes / kEntryBytes / kShards))
+{
+    if (RAND_bytes(salt.data(), static_cast<int>(salt.size())) != 1)
+        throw std::runtime_error("signature cache salt");
+}
+
+size_t SignatureCache::KeyHasher::operator()(const Key& key) const noexcept
+{
+    // Keys are already uniformly distributed hash output.
+    size_t h = 0;
+    std::memcpy(&h, key.data() + 8, sizeof(h));
+    return h;
+}
+
+SignatureCache::Key SignatureCache::MakeKey(const SchnorrSigCheck& check) const
+{
+    Key key{};
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, salt.data(), salt.size());
+    SHA256_Update(&ctx, check.pubkey.data(), check.pubkey.size());
+    SHA256_Update(&ctx, check.digest.data(), check.digest.size());
+    SHA256_Update(&ctx, check.sig.data(), check.sig.size());
+    SHA256_Final(key.data(), &ctx);
+    return key;
+}
+
+SignatureCache::Shard& SignatureCache::ShardFor(const Key& key) const
+{
+    return shards[key[0] % kShards];
+}
+
+bool SignatureCache::Contains(const SchnorrSigCheck& check) const
+{
+    const Key key = MakeKey(check);
+    const Shard& shard = ShardFor(key);
+    std::shared_lock<std::shared_mutex> l(shard.mu);
+    return shard.entries.count(key) != 0;
+}
+
+void SignatureCache::Insert(const SchnorrSigCheck& check)
+{
+    const Key key = MakeKey(check);
+    Shard& shard = ShardFor(key);
+    std::unique_lock<std::shared_mutex> l(shard.mu);
+    if (!shard.entries.insert(key).second)
+        return;
+    shard.order.push_back(key);
+    while (shard.order.size() > maxPerShard) {
+        shard.entries.erase(shard.order.front());
+        shard.order.pop_front();
+    }
+}
+
+size_t SignatureCache::Size() const
+{
+    size_t total = 0;
+    for (const auto& shard : shards) {
+        std::shared_lock<std::shared_mutex> l(shard.mu);
+        total += shard.entries.size();
+    }
+    return total;
+}
+
+namespace {
+
+std::mutex g_sigCacheMu;
+size_t g_sigCacheBytes = kDefaultSignatureCacheBytes;
+std::shared_ptr<SignatureCache> g_sigCache;
+
+} // namespace
+
+void SetSignatureCacheBytes(size_t bytes)
+{
+    std::lock_guard<std::mutex> l(g_sigCacheMu);
+    g_sigCacheBytes = bytes;
+    g_sigCache.reset();
+}
+
+std::shared_ptr<SignatureCache> GetSignatureCache()
+{
+    std::lock_guard<std::mutex> l(g_sigCacheMu);
+    if (!g_sigCache && g_sigCacheBytes > 0)
+        g_sigCache = std::make_shared<SignatureCache>(g_sigCacheBytes);
+    return g_sigCache;
+}
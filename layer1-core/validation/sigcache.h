@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../script/interpreter.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_set>
+
+// Bounded set of signature checks already known to be valid, so a
+// transaction verified on mempool entry is not verified again when it is
+// connected in a block. Entries are keyed by a salted SHA-256 of
+// (pubkey, digest, signature); the per-process salt keeps peers from
+// predicting which entries share a shard or get evicted together.
+//
+// The set is split into shards behind their own shared_mutex, so lookups
+// from script-check workers only contend with inserts into the same shard.
+// Each shard evicts its oldest entry once full.
+class SignatureCache {
+public:
+    // Rough heap cost of one entry (key in the set and in the FIFO).
+    static constexpr size_t kEntryBytes = 128;
+
+    explicit SignatureCache(size_t maxBytes);
+
+    SignatureCache(const SignatureCache&) = delete;
+    SignatureCache& operator=(const SignatureCache&) = delete;
+
+    bool Contains(const SchnorrSigCheck& check) const;
+    void Insert(const SchnorrSigCheck& check);
+
+    size_t Size() const;
+    size_t MaxEntries() const { return maxPerShard * kShards; }
+
+private:
+    using Key = std::array<uint8_t, 32>;
+    struct KeyHasher {
+        size_t operator()(const Key& key) const noexcept;
+    };
+    struct Shard {
+        mutable std::shared_mutex mu;
+        std::unordered_set<Key, KeyHasher> entries;
+        std::deque<Key> order; // insertion order for eviction
+    };
+
+    static constexpr size_t kShards = 16;
+
+    Key MakeKey(const SchnorrSigCheck& check) const;
+    Shard& ShardFor(const Key& key) const;
+
+    std::array<uint8_t, 32> salt{};
+    size_t maxPerShard{1};
+    mutable std::array<Shard, kShards> shards;
+};
+
+// Signature cache size in bytes (the -maxsigcachesize option, given in MiB
+// on the command line); 0 disables caching.
+constexpr size_t kDefaultSignatureCacheBytes = size_t{32} << 20;
+void SetSignatureCacheBytes(size_t bytes);
+// The shared cache sized by SetSignatureCacheBytes, built on first use;
+// nullptr when caching is disabled.
+std::shared_ptr<SignatureCache> GetSignatureCache();
@@ -1,7 +1,10 @@
 #include "validation.h"
 #include "../pow/difficulty.h"
 #include "../merkle/merkle.h"
+#include "../crypto/schnorr.h"
 #include "../script/interpreter.h"
+#include "checkqueue.h"
+#include "sigcache.h"
 #include <openssl/crypto.h>
 #include <array>
 #include <algorithm>
@@ -9,6 +12,8 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <chrono>
+#include <deque>
+#include <mutex>
 #include <optional>
 
 namespace {
@@ -117,31 +122,219 @@ private:
     std::unordered_map<OutPoint, TxOut, OutPointHasher, OutPointEq> m_cache;
 };
 
-} // namespace
+struct PendingScript {
+    const Transaction* tx;
+    const PrecomputedTransactionData* txdata;
+    size_t txIndex;
+    size_t inputIndex;
+    TxOut spent;
+};
 
-bool ValidateTransactions(const std::vector<Transaction>& txs, const consensus::Params& params, int height, const UTXOLookup& lookup)
+constexpr size_t MAX_TX_SIZE = 1000000; // 1MB hard cap per tx
+constexpr size_t MAX_BLOCK_WEIGHT = 4000000; // approximate weight limit
+constexpr uint64_t DUST_THRESHOLD = 546; // satoshi-equivalent dust floor
+
+bool CheckAsset(std::optional<uint8_t>& asset, uint8_t candidate)
 {
-    if (txs.empty()) return false;
+    if (!IsValidAssetId(candidate))
+        return false;
+    if (asset && *asset != candidate)
+        return false;
+    asset = candidate;
+    return true;
+}
 
-    const bool multiAssetActive = consensus::IsMultiAssetActive(params, height);
-    constexpr size_t MAX_TX_SIZE = 1000000; // 1MB hard cap per tx
-    constexpr size_t MAX_BLOCK_WEIGHT = 4000000; // approximate weight limit
-    constexpr uint64_t DUST_THRESHOLD = 546; // satoshi-equivalent dust floor
+// State shared by the spending transactions of one block.
+struct SpendState {
+    explicit SpendState(const UTXOLookup& lookup) : cachedLookup(lookup, 1024) {}
 
     std::unordered_set<OutPoint, OutPointHasher, OutPointEq> seenPrevouts;
-    seenPrevouts.reserve(txs.size() * 2);
     size_t runningWeight = 0;
-    CachedLookup cachedLookup(lookup, 1024);
+    CachedLookup cachedLookup;
+    // Signature checks dominate; they run on the script-check pool once all
+    // cheap structural and amount checks have passed.
+    std::vector<PendingScript> scripts;
+    // Sighash midstates, one per spending transaction, referenced by scripts.
+    std::deque<PrecomputedTransactionData> txdata;
+};
+
+// Size, output, input and amount checks for one non-coinbase transaction.
+// Its signature checks are queued on `state` and its fee returned in `fee`.
+bool CheckSpend(const Transaction& tx, size_t txIndex, const consensus::Params& params, const UTXOLookup& lookup, SpendState& state, uint64_t& fee)
+{
+    std::optional<uint8_t> txAsset;
 
-    auto checkAsset = [](std::optional<uint8_t>& asset, uint8_t candidate) {
-        if (!IsValidAssetId(candidate))
+    const size_t txSize = GetSerializeSize(tx);
+    if (txSize == 0 || txSize > MAX_TX_SIZE)
+        return false;
+    state.runningWeight += txSize * 4; // legacy weight approximation
+    if (state.runningWeight > MAX_BLOCK_WEIGHT)
+        return false;
+
+    uint64_t totalOut = 0;
+    for (const auto& out : tx.vout) {
+        if (!CheckAsset(txAsset, out.assetId))
             return false;
-        if (asset && *asset != candidate)
+        uint64_t next = 0;
+        if (!SafeAdd(totalOut, out.value, next))
             return false;
-        asset = candidate;
-        return true;
+        totalOut = next;
+        const uint8_t assetForRange = txAsset.value_or(out.assetId);
+        if (!consensus::MoneyRange(out.value, params, assetForRange) || !consensus::MoneyRange(totalOut, params, assetForRange))
+            return false;
+        if (out.scriptPubKey.size() != 32)
+            return false; // enforce schnorr-only pubkeys
+        if (out.value < DUST_THRESHOLD)
+            return false;
+    }
+
+    if (IsCoinbase(tx))
+        return false; // only the first tx may be coinbase
+
+    if (!lookup)
+        return false; // cannot validate spends without a UTXO provider
+
+    if (tx.vin.empty() || tx.vout.empty())
+        return false;
+
+    const auto& txdata = state.txdata.emplace_back(tx);
+    uint64_t totalIn = 0;
+    for (size_t inIdx = 0; inIdx < tx.vin.size(); ++inIdx) {
+        const auto& in = tx.vin[inIdx];
+        if (IsNullOutPoint(in.prevout))
+            return false;
+        if (in.scriptSig.empty())
+            return false;
+        if (in.scriptSig.size() > 1650)
+            return false; // oversized scripts risk DoS
+
+        if (!CheckAsset(txAsset, in.assetId))
+            return false;
+        if (!state.seenPrevouts.insert(in.prevout).second)
+            return false; // duplicate spend within block
+
+        auto utxo = state.cachedLookup(in.prevout);
+        if (!utxo || in.assetId != utxo->assetId || !CheckAsset(txAsset, utxo->assetId))
+            return false;
+
+        state.scripts.push_back({&tx, &txdata, txIndex, inIdx, *utxo});
+
+        uint64_t next = 0;
+        if (!SafeAdd(totalIn, utxo->value, next))
+            return false;
+        totalIn = next;
+        if (!consensus::MoneyRange(totalIn, params, txAsset.value_or(in.assetId)))
+            return false;
+    }
+
+    if (totalOut > totalIn)
+        return false; // overspends
+
+    fee = totalIn - totalOut;
+    return true;
+}
+
+// Below this many signatures per batch the fixed cost of the batch equation
+// outweighs what it saves over individual checks.
+constexpr size_t kMinSignatureBatch = 16;
+// Smallest slice handed to one worker, so large blocks still use every core
+// without shrinking batches to where they stop paying off.
+constexpr size_t kSignatureBatchChunk = 64;
+
+bool BatchVerifySignatures(const std::vector<SchnorrSigCheck>& sigs, CheckQueue& queue)
+{
+    const size_t threads = queue.WorkerThreads() + 1;
+    const size_t chunk = std::max(kSignatureBatchChunk, (sigs.size() + threads - 1) / threads);
+    std::vector<CheckQueue::Check> checks;
+    for (size_t begin = 0; begin < sigs.size(); begin += chunk) {
+        const size_t end = std::min(sigs.size(), begin + chunk);
+        checks.emplace_back([&sigs, begin, end]() {
+            std::vector<std::array<uint8_t, 33>> pubkeys(end - begin);
+            std::vector<std::array<uint8_t, 32>> msgs(end - begin);
+            std::vector<std::array<uint8_t, 64>> sigBytes(end - begin);
+            for (size_t i = begin; i < end; ++i) {
+                // x-only keys carry an implicit even Y, as in VerifySchnorr.
+                pubkeys[i - begin][0] = 0x02;
+                std::copy(sigs[i].pubkey.begin(), sigs[i].pubkey.end(), pubkeys[i - begin].begin() + 1);
+                msgs[i - begin] = sigs[i].digest;
+                sigBytes[i - begin] = sigs[i].sig;
+            }
+            return schnorr_batch_verify(pubkeys, msgs, sigBytes);
+        });
+    }
+    return queue.RunAll(checks);
+}
+
+// Signatures found in the signature cache are skipped. With `storeInCache`
+// the newly verified ones are added once every check has passed.
+bool VerifyScripts(const std::vector<PendingScript>& pending, bool batch, bool storeInCache, std::optional<ScriptFailure>* failure)
+{
+    auto reportFailure = [failure](const PendingScript& p) {
+        if (failure && !*failure)
+            *failure = ScriptFailure{p.txIndex, p.inputIndex};
     };
 
+    auto cache = GetSignatureCache();
+    std::vector<SchnorrSigCheck> sigs;
+    std::vector<const PendingScript*> owners;
+    sigs.reserve(pending.size());
+    owners.reserve(pending.size());
+    for (const auto& p : pending) {
+        SchnorrSigCheck check;
+        if (!ExtractSchnorrCheck(*p.tx, p.inputIndex, p.spent, *p.txdata, check)) {
+            reportFailure(p);
+            return false;
+        }
+        if (cache && cache->Contains(check))
+            continue;
+        sigs.push_back(check);
+        owners.push_back(&p);
+    }
+    if (sigs.empty())
+        return true;
+
+    auto queue = GetScriptCheckQueue();
+    bool ok = batch && sigs.size() >= kMinSignatureBatch && BatchVerifySignatures(sigs, *queue);
+    if (!ok) {
+        // Per-input checks: either batching is off or some batch failed and
+        // the offending input has to be found.
+        std::mutex failureMu;
+        std::vector<CheckQueue::Check> checks;
+        checks.reserve(sigs.size());
+        for (size_t i = 0; i < sigs.size(); ++i) {
+            checks.emplace_back([&, i]() {
+                if (VerifySchnorrCheck(sigs[i]))
+                    return true;
+                std::lock_guard<std::mutex> l(failureMu);
+                reportFailure(*owners[i]);
+                return false;
+            });
+        }
+        ok = queue->RunAll(checks);
+    }
+    if (ok && storeInCache && cache) {
+        for (const auto& check : sigs)
+            cache->Insert(check);
+    }
+    return ok;
+}
+
+} // namespace
+
+bool ValidateTransactions(const std::vector<Transaction>& txs, const consensus::Params& params, int height, const UTXOLookup& lookup)
+{
+    return ValidateTransactions(txs, params, height, lookup, false);
+}
+
+bool ValidateTransactions(const std::vector<Transaction>& txs, const consensus::Params& params, int height, const UTXOLookup& lookup, bool batchSignatures, std::optional<ScriptFailure>* scriptFailure)
+{
+    if (txs.empty()) return false;
+
+    const bool multiAssetActive = consensus::IsMultiAssetActive(params, height);
+
+    SpendState state(lookup);
+    state.seenPrevouts.reserve(txs.size() * 2);
+
     // Coinbase must be first and unique
     if (!IsCoinbase(txs.front()))
         return false;
@@ -157,7 +350,7 @@ bool ValidateTransactions(const std::vector<Transaction>& txs, const consensus::
     uint64_t coinbaseOutTotal = 0;
     std::optional<uint8_t> coinbaseAsset;
     for (const auto& out : txs.front().vout) {
-        if (!checkAsset(coinbaseAsset, out.assetId))
+        if (!CheckAsset(coinbaseAsset, out.assetId))
             return false;
         uint64_t next = 0;
         if (!SafeAdd(coinbaseOutTotal, out.value, next))
@@ -171,7 +364,7 @@ bool ValidateTransactions(const std::vector<Transaction>& txs, const consensus::
         if (out.value < DUST_THRESHOLD)
             return false;
     }
-    if (!coinbaseAsset || !checkAsset(coinbaseAsset, txs.front().vin.front().assetId))
+    if (!coinbaseAsset || !CheckAsset(coinbaseAsset, txs.front().vin.front().assetId))
         return false;
 
     if (multiAssetActive) {
@@ -185,83 +378,16 @@ bool ValidateTransactions(const std::vector<Transaction>& txs, const consensus::
     uint64_t totalFees = 0;
 
     for (size_t i = 1; i < txs.size(); ++i) {
-        const auto& tx = txs[i];
-        std::optional<uint8_t> txAsset;
-
-        const size_t txSize = Serialize(tx).size();
-        if (txSize == 0 || txSize > MAX_TX_SIZE)
+        uint64_t fee = 0;
+        if (!CheckSpend(txs[i], i, params, lookup, state, fee))
             return false;
-        runningWeight += txSize * 4; // legacy weight approximation
-        if (runningWeight > MAX_BLOCK_WEIGHT)
+        uint64_t nextFees = 0;
+        if (!SafeAdd(totalFees, fee, nextFees))
             return false;
-
-        uint64_t totalOut = 0;
-        for (const auto& out : tx.vout) {
-            if (!checkAsset(txAsset, out.assetId))
-                return false;
-            uint64_t next = 0;
-            if (!SafeAdd(totalOut, out.value, next))
-                return false;
-            totalOut = next;
-            const uint8_t assetForRange = txAsset.value_or(out.assetId);
-            if (!consensus::MoneyRange(out.value, params, assetForRange) || !consensus::MoneyRange(totalOut, params, assetForRange))
-                return false;
-            if (out.scriptPubKey.size() != 32)
-                return false; // enforce schnorr-only pubkeys
-            if (out.value < DUST_THRESHOLD)
-                return false;
-        }
-
-        if (IsCoinbase(tx))
-            return false; // only the first tx may be coinbase
-
-        if (!lookup)
-            return false; // cannot validate spends without a UTXO provider
-
-        if (tx.vin.empty() || tx.vout.empty())
+        totalFees = nextFees;
+        if (!consensus::MoneyRange(totalFees, params))
             return false;
-
-            uint64_t totalIn = 0;
-            for (size_t inIdx = 0; inIdx < tx.vin.size(); ++inIdx) {
-                const auto& in = tx.vin[inIdx];
-                if (IsNullOutPoint(in.prevout))
-                    return false;
-                if (in.scriptSig.empty())
-                    return false;
-                if (in.scriptSig.size() > 1650)
-                    return false; // oversized scripts risk DoS
-
-                if (!checkAsset(txAsset, in.assetId))
-                    return false;
-                if (!seenPrevouts.insert(in.prevout).second)
-                    return false; // duplicate spend within block
-
-                auto utxo = cachedLookup(in.prevout);
-                if (!utxo || in.assetId != utxo->assetId || !checkAsset(txAsset, utxo->assetId))
-                    return false;
-
-                if (!VerifyScript(tx, inIdx, *utxo))
-                    return false;
-
-                uint64_t next = 0;
-                if (!SafeAdd(totalIn, utxo->value, next))
-                    return false;
-                totalIn = next;
-                if (!consensus::MoneyRange(totalIn, params, txAsset.value_or(in.assetId)))
-                    return false;
-            }
-
-            if (totalOut > totalIn)
-                return false; // overspends
-
-            uint64_t fee = totalIn - totalOut;
-            uint64_t nextFees = 0;
-            if (!SafeAdd(totalFees, fee, nextFees))
-                return false;
-            totalFees = nextFees;
-            if (!consensus::MoneyRange(totalFees, params))
-                return false;
-        }
+    }
 
     uint64_t maxCoinbase = multiAssetActive && coinbaseAsset
         ? consensus::GetBlockSubsidy(height, params, *coinbaseAsset)
@@ -272,7 +398,18 @@ bool ValidateTransactions(const std::vector<Transaction>& txs, const consensus::
     if (coinbaseOutTotal > maxCoinbase)
         return false;
 
-    return true;
+    return VerifyScripts(state.scripts, batchSignatures, false, scriptFailure);
+}
+
+bool ValidateTransaction(const Transaction& tx, const consensus::Params& params, const UTXOLookup& lookup)
+{
+    SpendState state(lookup);
+    uint64_t fee = 0;
+    if (!CheckSpend(tx, 0, params, lookup, state, fee))
+        return false;
+    if (!consensus::MoneyRange(fee, params))
+        return false;
+    return VerifyScripts(state.scripts, false, true, nullptr);
 }
 
 bool ValidateBlock(const Block& block, const consensus::Params& params, int height, const UTXOLookup& lookup, const BlockValidationOptions& opts)
@@ -287,9 +424,11 @@ bool ValidateBlock(const Block& block, const consensus::Params& params, int heig
             opts.nftStateRoot != opts.expectedNftStateRoot)
             return false;
     }
-    if (!ValidateTransactions(block.transactions, params, height, lookup))
+    if (!ValidateTransactions(block.transactions, params, height, lookup, opts.batchSignatures, opts.scriptFailure))
         return false;
-    const auto merkle = ComputeMerkleRoot(block.transactions);
+    const auto merkle = opts.txids && opts.txids->size() == block.transactions.size()
+                            ? ComputeMerkleRootFromHashes(*opts.txids)
+                            : ComputeMerkleRoot(block.transactions);
     if (CRYPTO_memcmp(merkle.data(), block.header.merkleRoot.data(), merkle.size()) != 0)
         return false;
     return true;
@@ -7,8 +7,24 @@
 #include <optional>
 #include <cstdint>
 #include <ctime>
+#include <vector>
+
+class BlockStore;
+class Chainstate;
+struct BlockUndo;
+namespace consensus {
+struct ReorgPlan;
+}
 
 using UTXOLookup = std::function<std::optional<TxOut>(const OutPoint&)>;
+using BlockProvider = std::function<std::optional<Block>(const uint256& hash)>;
+
+// Position of an input whose signature check failed, within the block's
+// transaction list.
+struct ScriptFailure {
+    size_t txIndex{0};
+    size_t inputIndex{0};
+};
 
 struct BlockValidationOptions {
     // Median time past over the last 11 blocks. Must be provided to enforce
@@ -33,8 +49,58 @@ struct BlockValidationOptions {
     bool requireNftStateRoot = false;
     std::array<uint8_t, 32> nftStateRoot{};
     std::array<uint8_t, 32> expectedNftStateRoot{};
+
+    // Verify the block's signatures with schnorr_batch_verify. A failing
+    // batch is re-checked input by input so the bad input can be reported.
+    bool batchSignatures = true;
+
+    // When set, receives the first input found with an invalid signature.
+    std::optional<ScriptFailure>* scriptFailure = nullptr;
+
+    // Hashes of the block's transactions in order, if the caller already
+    // computed them. The merkle root is then built from these rather than
+    // by hashing every transaction again.
+    const std::vector<uint256>* txids = nullptr;
 };
 
 bool ValidateBlockHeader(const BlockHeader& header, const consensus::Params& params, const BlockValidationOptions& opts = {}, bool skipPowCheck = false);
 bool ValidateTransactions(const std::vector<Transaction>& txs, const consensus::Params& params, int height, const UTXOLookup& lookup = {});
+// As above, optionally batching signature checks and reporting the failing
+// input (see BlockValidationOptions::batchSignatures).
+bool ValidateTransactions(const std::vector<Transaction>& txs, const consensus::Params& params, int height, const UTXOLookup& lookup, bool batchSignatures, std::optional<ScriptFailure>* scriptFailure = nullptr);
+// Validate one non-coinbase transaction for the mempool. Signatures that
+// verify are added to the signature cache so the block carrying the
+// transaction does not check them again.
+bool ValidateTransaction(const Transaction& tx, const consensus::Params& params, const UTXOLookup& lookup);
 bool ValidateBlock(const Block& block, const consensus::Params& params, int height, const UTXOLookup& lookup = {}, const BlockValidationOptions& opts = {});
+
+// Load the coins spent by `block` into the chainstate cache ahead of
+// validation, reading them from the backend in parallel on the script check
+// workers. Inputs spending outputs of the block itself are skipped. Returns
+// the number of coins now resident. ConnectBlock calls this itself; callers
+// that deserialize blocks ahead of connecting them can start it earlier.
+size_t PrefetchBlockInputs(const Block& block, Chainstate& chainstate);
+
+// Validate a block against the coins in `chainstate` and apply it on top of
+// the current best block, recording every spent coin in `undo`. The
+// chainstate is left untouched when the block is rejected.
+bool ConnectBlock(const Block& block, Chainstate& chainstate, const consensus::Params& params, int height, BlockUndo& undo, const BlockValidationOptions& opts = {});
+// Re-apply a block whose coin changes may have partly reached disk before an
+// interrupted flush (see Chainstate::PendingReplay), making it the tip. The
+// block is not validated again. Spends of coins already gone are skipped and
+// outputs replace any flushed copy instead of shadowing it.
+bool ReplayBlock(const Block& block, Chainstate& chainstate, uint32_t height);
+// Replay every block from the replay range's old best block (exclusive) to
+// its new one, read from `store` by hash, then flush. Returns false, leaving
+// the chainstate unchanged, if a block in the range is missing; true if
+// nothing needed replaying.
+bool ReplayInterruptedFlush(Chainstate& chainstate, BlockStore& store);
+// Reverse ConnectBlock using its undo data, making the parent block the tip.
+bool DisconnectBlock(const Block& block, Chainstate& chainstate, const BlockUndo& undo);
+// Move the chainstate along a ForkResolver::PlanReorg plan. Blocks being
+// disconnected come from `store` with their rev data; blocks being connected
+// come from `newBlocks` and are written to `store` with their rev data.
+// `opts` apply to every connected block except medianTimePast, which comes
+// from the plan. If a step fails, the original chain is restored and false
+// is returned.
+bool ApplyReorg(const consensus::ReorgPlan& plan, Chainstate& chainstate, BlockStore& store, const consensus::Params& params, const BlockProvider& newBlocks, const BlockValidationOptions& opts = {});
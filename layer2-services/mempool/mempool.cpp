@@ -35,20 +35,23 @@ bool Mempool::MaybeReplace(const Transaction& tx, uint64_t fee, uint64_t feeRate
 
 bool Mempool::Accept(const Transaction& tx, uint64_t fee)
 {
-    std::function<void(const Transaction&)> callback;
-    Transaction txCopy;
+    return Accept(MakeTransactionRef(tx), fee);
+}
+
+bool Mempool::Accept(TransactionRef ref, uint64_t fee)
+{
+    std::function<void(const TransactionRef&)> callback;
     {
         std::lock_guard<std::mutex> g(m_mutex);
-        const auto ser = Serialize(tx);
-        const size_t txSize = ser.size();
+        const Transaction& tx = ref->Tx();
+        const size_t txSize = ref->Size();
         const uint64_t feeRate = (txSize ? (fee * 1000 / txSize) : fee * 1000);
-        uint256 hash = tx.GetHash();
+        const uint256& hash = ref->GetHash();
         if (m_entries.count(hash)) return false;
         if (!m_policy.IsFeeAcceptable(tx, fee)) return false;
 
         if (m_params) {
-            std::vector<Transaction> batch{tx};
-            if (!ValidateTransactions(batch, *m_params, m_chainHeight, m_lookup)) return false;
+            if (!ValidateTransaction(tx, *m_params, m_lookup)) return false;
         }
 
         bool replace = false;
@@ -66,15 +69,15 @@ bool Mempool::Accept(const Transaction& tx, uint64_t fee)
         if (m_entries.size() >= m_policy.MaxEntries()) EvictOne();
         EvictExpired();
 
-        MempoolEntry entry{tx, fee, feeRate, txSize, std::chrono::steady_clock::now(), replace};
+        MempoolEntry entry{ref, fee, feeRate, txSize, std::chrono::steady_clock::now(), replace};
         m_arrival.push_back(hash);
         m_byFeeRate.emplace(feeRate, hash);
         m_entries.emplace(hash, std::move(entry));
         for (const auto& in : tx.vin) m_spent[in.prevout] = hash;
+        ++m_epoch;
         callback = m_onAccept;
-        txCopy = tx;
     }
-    if (callback) callback(txCopy);
+    if (callback) callback(ref);
     return true;
 }
 
@@ -90,32 +93,40 @@ bool Mempool::SpendsKnown(const OutPoint& op) const
     return m_spent.count(op) != 0;
 }
 
-std::vector<Transaction> Mempool::Snapshot() const
+TransactionRef Mempool::Get(const uint256& hash) const
 {
     std::lock_guard<std::mutex> g(m_mutex);
-    std::vector<Transaction> out;
-    out.reserve(m_entries.size()); // Pre-allocate to avoid reallocations
-    
-    // Build a vector of (hash, transaction) pairs to avoid recomputing hashes during sort
-    std::vector<std::pair<uint256, Transaction>> pairs;
-    pairs.reserve(m_entries.size());
-    for (const auto& kv : m_entries) {
-        pairs.emplace_back(kv.first, kv.second.tx); // Use entry's hash key directly
-    }
-    
-    // Sort by pre-computed hash
-    std::sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b) {
-        return a.first < b.first;
-    });
-    
-    // Extract transactions in sorted order
-    // Note: Using emplace_back with move for better performance
-    for (auto& p : pairs) {
-        out.emplace_back(std::move(p.second));
-    }
+    auto it = m_entries.find(hash);
+    return it == m_entries.end() ? nullptr : it->second.tx;
+}
+
+std::vector<TransactionRef> Mempool::Snapshot() const
+{
+    std::lock_guard<std::mutex> g(m_mutex);
+    std::vector<TransactionRef> out;
+    out.reserve(m_entries.size());
+    for (const auto& kv : m_entries) out.push_back(kv.second.tx);
     return out;
 }
 
+MempoolPage Mempool::GetPage(const std::optional<uint256>& after, size_t limit) const
+{
+    std::lock_guard<std::mutex> g(m_mutex);
+    MempoolPage page;
+    page.epoch = m_epoch;
+    limit = std::max<size_t>(limit, 1); // an empty page could not advance the cursor
+    auto it = after ? m_entries.upper_bound(*after) : m_entries.begin();
+    for (; it != m_entries.end() && page.txs.size() < limit; ++it) page.txs.push_back(it->second.tx);
+    if (it != m_entries.end() && !page.txs.empty()) page.next = page.txs.back()->GetHash();
+    return page;
+}
+
+uint64_t Mempool::Epoch() const
+{
+    std::lock_guard<std::mutex> g(m_mutex);
+    return m_epoch;
+}
+
 void Mempool::Remove(const std::vector<uint256>& hashes)
 {
     for (const auto& h : hashes) {
@@ -125,11 +136,12 @@ void Mempool::Remove(const std::vector<uint256>& hashes)
             for (auto fr = range.first; fr != range.second; ++fr) {
                 if (fr->second == h) { m_byFeeRate.erase(fr); break; }
             }
-            for (const auto& in : it->second.tx.vin) {
+            for (const auto& in : it->second.tx->Tx().vin) {
                 auto s = m_spent.find(in.prevout);
                 if (s != m_spent.end() && s->second == h) m_spent.erase(s);
             }
             m_entries.erase(it);
+            ++m_epoch;
         }
     }
 
@@ -189,19 +201,12 @@ void Mempool::SetValidationContext(const consensus::Params& params, int height,
     m_lookup = std::move(lookup);
 }
 
-void Mempool::SetOnAccept(std::function<void(const Transaction&)> cb)
+void Mempool::SetOnAccept(std::function<void(const TransactionRef&)> cb)
 {
     std::lock_guard<std::mutex> g(m_mutex);
     m_onAccept = std::move(cb);
 }
 
-size_t Mempool::ArrayHasher::operator()(const uint256& data) const noexcept
-{
-    size_t h = 0;
-    for (auto b : data) h = (h * 131) ^ b;
-    return h;
-}
-
 size_t Mempool::OutPointHasher::operator()(const OutPoint& op) const noexcept
 {
     size_t h = 0;
@@ -224,11 +229,12 @@ void Mempool::EvictOne()
         m_byFeeRate.erase(it);
         auto entryIt = m_entries.find(hash);
         if (entryIt != m_entries.end()) {
-            for (const auto& in : entryIt->second.tx.vin) {
+            for (const auto& in : entryIt->second.tx->Tx().vin) {
                 auto s = m_spent.find(in.prevout);
                 if (s != m_spent.end() && s->second == hash) m_spent.erase(s);
             }
             m_entries.erase(entryIt);
+            ++m_epoch;
         }
         return;
     }
@@ -237,11 +243,12 @@ void Mempool::EvictOne()
         m_arrival.pop_front();
         auto it = m_entries.find(h);
         if (it != m_entries.end()) {
-            for (const auto& in : it->second.tx.vin) {
+            for (const auto& in : it->second.tx->Tx().vin) {
                 auto s = m_spent.find(in.prevout);
                 if (s != m_spent.end() && s->second == h) m_spent.erase(s);
             }
             m_entries.erase(it);
+            ++m_epoch;
             break;
         }
     }
@@ -2,6 +2,7 @@
 
 #include "../../layer1-core/consensus/params.h"
 #include "../../layer1-core/tx/transaction.h"
+#include "../../layer1-core/tx/transaction_ref.h"
 #include "../../layer1-core/validation/validation.h"
 #include "../policy/policy.h"
 #include <chrono>
@@ -17,7 +18,7 @@
 namespace mempool {
 
 struct MempoolEntry {
-    Transaction tx;
+    TransactionRef tx;
     uint64_t fee{0};
     uint64_t feeRate{0};
     size_t txSize{0};  // Cache serialized size to avoid repeated serialization
@@ -25,25 +26,41 @@ struct MempoolEntry {
     bool replaceable{false};
 };
 
+// One page of a walk over the pool, in txid order.
+struct MempoolPage {
+    std::vector<TransactionRef> txs;
+    // Pool version the page was read at. It changes on every insertion and
+    // removal, so a walk whose pages all carry the same epoch saw one
+    // consistent pool.
+    uint64_t epoch{0};
+    // Pass as `after` to read the next page; empty once the walk is done.
+    std::optional<uint256> next;
+};
+
 class Mempool {
 public:
     explicit Mempool(const policy::FeePolicy& policy);
 
     bool Accept(const Transaction& tx, uint64_t fee);
+    bool Accept(TransactionRef tx, uint64_t fee);
     bool Exists(const uint256& hash) const;
+    // The pooled transaction with this txid, or null.
+    TransactionRef Get(const uint256& hash) const;
     bool SpendsKnown(const OutPoint& op) const;
-    std::vector<Transaction> Snapshot() const;
+    // Every pooled transaction in txid order. Entries are shared, not copied.
+    std::vector<TransactionRef> Snapshot() const;
+    // Up to `limit` transactions with txids above `after` (from the start
+    // when empty). Entries present for the whole walk are returned exactly
+    // once; ones added behind the cursor are missed, which the epoch shows.
+    MempoolPage GetPage(const std::optional<uint256>& after, size_t limit) const;
+    uint64_t Epoch() const;
     void Remove(const std::vector<uint256>& hashes);
     void RemoveForBlock(const std::vector<Transaction>& blockTxs);
     uint64_t EstimateFeeRate(size_t percentile) const; // sat/kB
     void SetValidationContext(const consensus::Params& params, int height, UTXOLookup lookup);
-    void SetOnAccept(std::function<void(const Transaction&)> cb);
+    void SetOnAccept(std::function<void(const TransactionRef&)> cb);
 
 private:
-    struct ArrayHasher {
-        size_t operator()(const uint256& data) const noexcept;
-    };
-
     struct OutPointHasher {
         size_t operator()(const OutPoint& op) const noexcept;
     };
@@ -57,14 +74,15 @@ private:
     bool MaybeReplace(const Transaction& tx, uint64_t fee, uint64_t feeRate);
 
     policy::FeePolicy m_policy;
-    std::unordered_map<uint256, MempoolEntry, ArrayHasher> m_entries;
+    std::map<uint256, MempoolEntry> m_entries; // ordered for paging
+    uint64_t m_epoch{0};
     std::multimap<uint64_t, uint256> m_byFeeRate; // feeRate -> txid
     std::deque<uint256> m_arrival;
     std::unordered_map<OutPoint, uint256, OutPointHasher, OutPointEqual> m_spent;
     std::optional<consensus::Params> m_params;
     int m_chainHeight{0};
     UTXOLookup m_lookup;
-    std::function<void(const Transaction&)> m_onAccept;
+    std::function<void(const TransactionRef&)> m_onAccept;
     mutable std::mutex m_mutex;
     const size_t m_targetBytes{5 * 1024 * 1024};
 };
@@ -4,7 +4,6 @@
 #include <boost/beast/version.hpp>
 #include <algorithm>
 #include <chrono>
-#include <fstream>
 #include <sstream>
 #include <stdexcept>
 #include <cstring>
@@ -12,7 +11,9 @@
 #include <openssl/sha.h>
 
 #include "rpcserver.h"
+#include "../../layer1-core/block/block_view.h"
 #include "../../layer1-core/consensus/params.h"
+#include "../../layer1-core/storage/blockstore.h"
 #include "../../layer1-core/tx/transaction.h"
 #include "../../sidechain/wasm/runtime/types.h"
 
@@ -176,45 +177,33 @@ std::string FormatExecResult(const sidechain::wasm::ExecutionResult& res)
 }
 } // namespace
 
-static Block DeserializeBlock(const std::vector<uint8_t>& buf)
-{
-    Block block{};
-    if (buf.size() < sizeof(BlockHeader)) return block;
-
-    std::memcpy(&block.header, buf.data(), sizeof(BlockHeader));
-    size_t offset = sizeof(BlockHeader);
-
-    if (offset + sizeof(uint32_t) > buf.size()) return block;
-    uint32_t txCount{0};
-    std::memcpy(&txCount, buf.data() + offset, sizeof(txCount));
-    offset += sizeof(txCount);
-
-    block.transactions.reserve(txCount);
-    for (uint32_t i = 0; i < txCount && offset < buf.size(); ++i) {
-        if (offset + sizeof(uint32_t) > buf.size()) break;
-        uint32_t len{0};
-        std::memcpy(&len, buf.data() + offset, sizeof(len));
-        offset += sizeof(len);
-        if (offset + len > buf.size()) break;
-        std::vector<uint8_t> txBytes(buf.begin() + offset, buf.begin() + offset + len);
-        offset += len;
-        try {
-            block.transactions.push_back(DeserializeTransaction(txBytes));
-        } catch (...) {
-            break;
-        }
-    }
-    return block;
-}
-
 RPCServer::RPCServer(boost::asio::io_context& io, const std::string& user, const std::string& pass, uint16_t port)
     : m_io(io), m_acceptor(io, {boost::asio::ip::tcp::v4(), port}), m_user(user), m_pass(pass)
 {
 }
 
-void RPCServer::SetBlockStorePath(std::string path)
+void RPCServer::SetBlockStore(BlockStore& store)
 {
-    m_blockPath = std::move(path);
+    m_blockStore = &store;
+
+    Register("getblockcacheinfo", [&store](const std::string&) {
+        const auto stats = store.CacheStats();
+        std::stringstream ss;
+        ss << "{\"entries\":" << stats.entries << ",\"bytes\":" << stats.bytes
+           << ",\"max_bytes\":" << stats.maxBytes << ",\"hits\":" << stats.hits
+           << ",\"misses\":" << stats.misses << "}";
+        return ss.str();
+    });
+    Register("getblockstoreinfo", [&store](const std::string&) {
+        const auto stats = store.GetCompressionStats();
+        std::stringstream ss;
+        ss << "{\"compression\":" << (stats.enabled ? "true" : "false")
+           << ",\"dictionary_id\":" << stats.dictionaryId << ",\"dictionary_bytes\":" << stats.dictionaryBytes
+           << ",\"blocks_written\":" << stats.records << ",\"blocks_compressed\":" << stats.compressedRecords
+           << ",\"raw_bytes\":" << stats.rawBytes << ",\"stored_bytes\":" << stats.storedBytes
+           << ",\"ratio\":" << stats.Ratio() << "}";
+        return ss.str();
+    });
 }
 
 void RPCServer::AttachCoreHandlers(mempool::Mempool& pool, wallet::WalletBackend& wallet, txindex::TxIndex& index, net::P2PNode& p2p)
@@ -250,9 +239,8 @@ void RPCServer::AttachCoreHandlers(mempool::Mempool& pool, wallet::WalletBackend
         return false;
     };
 
-    pool.SetOnAccept([&p2p](const Transaction& tx) {
-        auto payload = Serialize(tx);
-        p2p.Broadcast(net::Message{"tx", payload});
+    pool.SetOnAccept([&p2p](const TransactionRef& tx) {
+        p2p.Broadcast(net::Message{"tx", tx->Bytes()});
     });
 
     Register("getbalance", [&wallet, &formatBalances, &parseAssetParam](const std::string& params) {
@@ -277,16 +265,23 @@ void RPCServer::AttachCoreHandlers(mempool::Mempool& pool, wallet::WalletBackend
         return std::string("{\"found\":") + (found ? "true" : "false") + ",\"height\":" + std::to_string(height) + "}";
     });
 
-    Register("getrawtransaction", [&index, this](const std::string& params) {
+    Register("getrawtransaction", [&index, &pool, this](const std::string& params) {
         auto hash = ParseHash(params);
         std::stringstream ss;
+        if (auto pooled = pool.Get(hash)) {
+            ss << '"' << HexEncode(pooled->Bytes()) << '"';
+            return ss.str();
+        }
         uint32_t height{0};
         if (!index.Lookup(hash, height)) return std::string("null");
         auto blk = ReadBlock(height);
         if (!blk) return std::string("null");
-        for (const auto& tx : blk->transactions) {
+        // Hash and encode the stored bytes directly instead of
+        // re-serializing every decoded transaction.
+        const BlockView view(blk->raw);
+        for (const auto& tx : view.Transactions()) {
             if (tx.GetHash() == hash) {
-                ss << '"' << HexEncode(Serialize(tx)) << '"';
+                ss << '"' << HexEncode(tx.Bytes().ToVector()) << '"';
                 return ss.str();
             }
         }
@@ -310,16 +305,13 @@ void RPCServer::AttachCoreHandlers(mempool::Mempool& pool, wallet::WalletBackend
         return std::to_string(pool.EstimateFeeRate(percentile));
     });
 
-    Register("sendtx", [&pool, &p2p](const std::string& params) {
+    // Relay happens in the on-accept callback above.
+    Register("sendtx", [&pool](const std::string& params) {
         auto hex = TrimQuotes(params);
-        auto raw = ParseHex(hex);
-        Transaction tx = DeserializeTransaction(raw);
+        // Keep the submitted bytes as the encoding relayed to peers.
+        auto tx = MakeTransactionRef(ParseHex(hex));
         uint64_t fee = 0; // rely on caller to include fee in inputs/outputs difference
-        bool ok = pool.Accept(tx, fee);
-        if (ok) {
-            auto payload = Serialize(tx);
-            p2p.Broadcast(net::Message{"tx", payload});
-        }
+        bool ok = pool.Accept(std::move(tx), fee);
         return std::string("{\"accepted\":") + (ok ? "true" : "false") + "}";
     });
 
@@ -540,6 +532,62 @@ void RPCServer::AttachSidechainHandlers(sidechain::rpc::WasmRpcService& wasm)
     });
 }
 
+void RPCServer::AttachChainstateHandlers(Chainstate& chainstate, const consensus::Params& consensusParams)
+{
+    auto formatSnapshot = [](const SnapshotMetadata& meta) {
+        std::stringstream ss;
+        ss << "{\"coins\":" << meta.coinCount
+           << ",\"base_hash\":\"" << HexEncode({meta.baseBlock.begin(), meta.baseBlock.end()})
+           << "\",\"content_hash\":\"" << HexEncode({meta.contentHash.begin(), meta.contentHash.end()})
+           << "\",\"muhash\":\"" << HexEncode({meta.setHash.begin(), meta.setHash.end()}) << "\"}";
+        return ss.str();
+    };
+
+    Register("dumptxoutset", [&chainstate, formatSnapshot](const std::string& params) {
+        auto path = TrimQuotes(params);
+        if (path.empty() || path == "null")
+            throw std::runtime_error("snapshot path required");
+        return formatSnapshot(chainstate.DumpSnapshot(path));
+    });
+
+    Register("loadtxoutset", [&chainstate, &consensusParams, formatSnapshot](const std::string& params) {
+        auto path = TrimQuotes(params);
+        bool allowUntrusted = false;
+        if (path.rfind("path=", 0) == 0) {
+            auto kv = ParseKeyValues(params);
+            path = kv["path"];
+            allowUntrusted = kv["allowuntrusted"] == "1" || kv["allowuntrusted"] == "true";
+        }
+        if (path.empty() || path == "null")
+            throw std::runtime_error("snapshot path required");
+        return formatSnapshot(chainstate.LoadSnapshot(path, consensusParams, allowUntrusted));
+    });
+
+    Register("getcoinscacheinfo", [&chainstate](const std::string&) {
+        const auto stats = chainstate.CacheStats();
+        std::stringstream ss;
+        ss << "{\"entries\":" << stats.entries << ",\"bytes\":" << stats.usageBytes
+           << ",\"max_bytes\":" << stats.maxBytes << ",\"hits\":" << stats.hits
+           << ",\"misses\":" << stats.misses << "}";
+        return ss.str();
+    });
+
+    Register("gettxoutsetinfo", [&chainstate](const std::string&) {
+        const auto stats = chainstate.GetUtxoSetStats();
+        std::stringstream ss;
+        ss << "{\"bestblock\":\"" << HexEncode({stats.bestBlock.begin(), stats.bestBlock.end()})
+           << "\",\"txouts\":" << stats.coins
+           << ",\"muhash\":\"" << HexEncode({stats.setHash.begin(), stats.setHash.end()}) << "\",\"assets\":{";
+        for (size_t i = 0; i < stats.assets.size(); ++i) {
+            if (i) ss << ",";
+            ss << "\"" << consensus::AssetSymbol(static_cast<uint8_t>(i)) << "\":{\"txouts\":"
+               << stats.assets[i].coins << ",\"amount\":" << stats.assets[i].amount << "}";
+        }
+        ss << "}}";
+        return ss.str();
+    });
+}
+
 void RPCServer::Register(const std::string& method, Handler handler)
 {
     std::lock_guard<std::mutex> g(m_mutex);
@@ -667,85 +715,14 @@ std::string RPCServer::HexEncode(const std::vector<uint8_t>& data)
     return EncodeHex(data);
 }
 
-std::optional<Block> RPCServer::ReadBlock(uint32_t height)
+std::shared_ptr<const CachedBlock> RPCServer::ReadBlock(uint32_t height)
 {
-    // Improved block retrieval using indexed access via height->offset mapping.
-    // Block index file (.idx) contains height->file_offset pairs for O(1) lookups
-    // instead of the previous O(n) linear scan through all blocks.
-    
-    // Load block index if not already cached
-    std::ifstream indexFile(m_blockPath + ".idx", std::ios::binary);
-    if (!indexFile.is_open()) {
-        // Fallback: If index doesn't exist, try legacy linear scan for backwards compatibility
-        // This ensures the RPC server can still read old block files without an index.
-        std::ifstream file(m_blockPath, std::ios::binary);
-        if (!file.is_open()) return std::nullopt;
-        
-        while (file.peek() != EOF) {
-            uint32_t h = 0; uint32_t len = 0;
-            file.read(reinterpret_cast<char*>(&h), sizeof(h));
-            file.read(reinterpret_cast<char*>(&len), sizeof(len));
-            if (!file || len > 100*1024*1024) break; // Sanity check: block size < 100MB
-            std::vector<uint8_t> buf(len);
-            file.read(reinterpret_cast<char*>(buf.data()), len);
-            if (h == height) {
-                return DeserializeBlock(buf);
-            }
-        }
-        return std::nullopt;
-    }
-    
-    // Read index to find block offset
-    // Index file format: [count] [height, offset] pairs
-    // Heights are stored in ascending order, allowing binary search
-    uint32_t indexCount = 0;
-    indexFile.read(reinterpret_cast<char*>(&indexCount), sizeof(indexCount));
-    if (!indexFile || indexCount > 10000000) return std::nullopt; // Sanity check
-    
-    // Binary search through index entries for O(log n) lookup
-    // This is more efficient than O(n) linear scan for large blockchains
-    std::optional<uint64_t> blockOffset;
-    uint32_t left = 0, right = indexCount;
-    
-    while (left < right) {
-        uint32_t mid = left + (right - left) / 2;
-        indexFile.seekg(sizeof(uint32_t) + mid * (sizeof(uint32_t) + sizeof(uint64_t)));
-        
-        uint32_t h = 0;
-        uint64_t offset = 0;
-        indexFile.read(reinterpret_cast<char*>(&h), sizeof(h));
-        indexFile.read(reinterpret_cast<char*>(&offset), sizeof(offset));
-        
-        if (!indexFile) break;
-        
-        if (h == height) {
-            blockOffset = offset;
-            break;
-        } else if (h < height) {
-            left = mid + 1;
-        } else {
-            right = mid;
-        }
+    if (!m_blockStore) return nullptr;
+    try {
+        return m_blockStore->GetBlock(height);
+    } catch (const std::exception&) {
+        return nullptr;
     }
-    
-    if (!blockOffset) return std::nullopt;
-    
-    // Seek to block offset and read
-    std::ifstream blockFile(m_blockPath, std::ios::binary);
-    if (!blockFile.is_open()) return std::nullopt;
-    
-    blockFile.seekg(*blockOffset);
-    if (!blockFile.good()) return std::nullopt;
-    
-    uint32_t blockSize = 0;
-    blockFile.read(reinterpret_cast<char*>(&blockSize), sizeof(blockSize));
-    if (!blockFile || blockSize == 0 || blockSize > 100*1024*1024) return std::nullopt;
-    
-    std::vector<uint8_t> buf(blockSize);
-    blockFile.read(reinterpret_cast<char*>(buf.data()), blockSize);
-    if (!blockFile) return std::nullopt;
-    
-    return DeserializeBlock(buf);
 }
 
 std::vector<uint8_t> RPCServer::ParseHex(const std::string& hex)
@@ -3,6 +3,7 @@
 #include <boost/asio.hpp>
 #include <boost/beast/http.hpp>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
@@ -14,10 +15,14 @@
 #include "../net/p2p.h"
 #include "../wallet/wallet.h"
 #include "../../layer1-core/block/block.h"
+#include "../../layer1-core/chainstate/coins.h"
 #include "../../layer1-core/tx/transaction.h"
 #include "../crosschain/bridge/bridge_manager.h"
 #include "../../sidechain/rpc/wasm_rpc.h"
 
+class BlockStore;
+struct CachedBlock;
+
 namespace rpc {
 
 class RPCServer {
@@ -26,11 +31,17 @@ public:
 
     RPCServer(boost::asio::io_context& io, const std::string& user, const std::string& pass, uint16_t port);
 
-    void SetBlockStorePath(std::string path);
+    // Blocks served over RPC are read through the node's block store, which
+    // also adds getblockcacheinfo and getblockstoreinfo.
+    void SetBlockStore(BlockStore& store);
 
     void AttachCoreHandlers(mempool::Mempool& pool, wallet::WalletBackend& wallet, txindex::TxIndex& index, net::P2PNode& p2p);
     void AttachBridgeHandlers(crosschain::BridgeManager& bridge);
     void AttachSidechainHandlers(sidechain::rpc::WasmRpcService& wasm);
+    // Adds the UTXO set and snapshot calls plus getcoinscacheinfo.
+    // loadtxoutset only accepts snapshots listed in params.assumeUtxo unless
+    // called as "path=<file>;allowuntrusted=1".
+    void AttachChainstateHandlers(Chainstate& chainstate, const consensus::Params& params);
 
     void Register(const std::string& method, Handler handler);
 
@@ -46,7 +57,7 @@ private:
     bool RateLimit(const std::string& remote);
     Handler GetHandler(const std::string& name);
     static std::string HexEncode(const std::vector<uint8_t>& data);
-    std::optional<Block> ReadBlock(uint32_t height);
+    std::shared_ptr<const CachedBlock> ReadBlock(uint32_t height);
     static std::vector<uint8_t> ParseHex(const std::string& hex);
     static uint256 ParseHash(const std::string& params);
     static std::string TrimQuotes(std::string in);
@@ -58,7 +69,7 @@ private:
     std::string m_pass;
     std::unordered_map<std::string, Handler> m_handlers;
     mutable std::mutex m_mutex;
-    std::string m_blockPath{"mainnet/blocks.dat"};
+    BlockStore* m_blockStore{nullptr};
     std::unordered_map<std::string, std::pair<size_t, std::chrono::steady_clock::time_point>> m_rate;
     std::string m_token{"drachma-token"};
 };
@@ -285,9 +285,9 @@ PubKey WalletBackend::DerivePub(const PrivKey& priv) const
     return derive_pubkey(priv);
 }
 
-std::vector<uint8_t> WalletBackend::SignDigest(const PrivKey& key, const Transaction& tx, size_t inputIndex) const
+std::vector<uint8_t> WalletBackend::SignDigest(const PrivKey& key, const PrecomputedTransactionData& txdata, size_t inputIndex) const
 {
-    auto digest = ComputeInputDigest(tx, inputIndex);
+    auto digest = txdata.InputDigest(inputIndex);
     std::array<uint8_t, 64> sig{};
     std::array<uint8_t, 32> aux{};
     unsigned int aux_len = 0;
@@ -333,8 +333,10 @@ Transaction WalletBackend::CreateSpend(const std::vector<TxOut>& outputs, const
         tx.vout.push_back(change);
     }
 
+    // scriptSigs are not part of the digest, so one precomputation covers every input.
+    const PrecomputedTransactionData txdata(tx);
     for (size_t i = 0; i < tx.vin.size(); ++i) {
-        tx.vin[i].scriptSig = SignDigest(key, tx, i);
+        tx.vin[i].scriptSig = SignDigest(key, txdata, i);
     }
     std::vector<OutPoint> spent;
     spent.reserve(tx.vin.size());
@@ -495,11 +497,12 @@ Transaction WalletBackend::CreateMultisigSpend(const std::vector<TxOut>& outputs
         tx.vout.push_back(change);
     }
 
+    const PrecomputedTransactionData txdata(tx);
     for (size_t i = 0; i < tx.vin.size(); ++i) {
         std::vector<uint8_t> sigBlob;
         sigBlob.push_back(0x00); // multisig bug compat
         for (size_t k = 0; k < threshold; ++k) {
-            auto sig = SignDigest(keys[k], tx, i);
+            auto sig = SignDigest(keys[k], txdata, i);
             sigBlob.push_back(static_cast<uint8_t>(sig.size()));
             sigBlob.insert(sigBlob.end(), sig.begin(), sig.end());
         }
@@ -49,7 +49,7 @@ public:
 
 private:
     std::vector<UTXO> SelectCoins(uint64_t amount, std::optional<uint8_t> assetId = std::nullopt) const;
-    std::vector<uint8_t> SignDigest(const PrivKey& key, const Transaction& tx, size_t inputIndex) const;
+    std::vector<uint8_t> SignDigest(const PrivKey& key, const PrecomputedTransactionData& txdata, size_t inputIndex) const;
     PubKey DerivePub(const PrivKey& priv) const;
     void RemoveCoins(const std::vector<OutPoint>& used);
 
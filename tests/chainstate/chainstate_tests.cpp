@@ -1,8 +1,15 @@
 #include "../../layer1-core/chainstate/coins.h"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <filesystem>
+#include <thread>
 #include <vector>
 
+#ifdef DRACHMA_HAVE_LEVELDB
+#include <leveldb/db.h>
+#endif
+
 namespace {
 
 OutPoint MakeOutPoint(uint8_t seed, uint32_t index)
@@ -22,6 +29,18 @@ TxOut MakeOutput(uint64_t value, uint8_t tag, uint8_t asset = 1)
     return out;
 }
 
+Coin MakeCoin(uint64_t value, uint8_t tag)
+{
+    return Coin(MakeOutput(value, tag), 0, false);
+}
+
+uint256 MakeBlockHash(uint8_t seed)
+{
+    uint256 hash{};
+    hash.fill(seed);
+    return hash;
+}
+
 } // namespace
 
 int main()
@@ -29,6 +48,7 @@ int main()
     std::filesystem::path temp = std::filesystem::temp_directory_path() / "drachma_chainstate.dat";
     std::error_code ec;
     std::filesystem::remove(temp, ec);
+    std::filesystem::remove_all(temp.string() + ".ldb", ec);
 
     // Persist, reload, and enforce spends.
     {
@@ -54,22 +74,69 @@ int main()
         assert(threw);
     }
 
-    // Cache should evict when capacity exceeded but keep lookups correct.
+    // Cache should evict when its byte budget is exceeded but keep lookups correct.
     {
-        Chainstate cs(temp.string(), 2);
-        auto opA = MakeOutPoint(0x02, 0);
-        auto opB = MakeOutPoint(0x03, 0);
-        auto opC = MakeOutPoint(0x04, 0);
-        cs.AddUTXO(opA, MakeOutput(75, 0xAB));
-        cs.AddUTXO(opB, MakeOutput(80, 0xAC));
-        cs.AddUTXO(opC, MakeOutput(90, 0xAD));
+        // Each shard keeps its own bucket array, so the budget has to cover
+        // that fixed overhead before coins can be cached at all.
+        constexpr std::size_t kBudget = 4096;
+        Chainstate cs(temp.string(), kBudget);
+        std::vector<OutPoint> ops;
+        for (uint8_t i = 0; i < 32; ++i) {
+            ops.push_back(MakeOutPoint(static_cast<uint8_t>(0x20 + i), 0));
+            cs.AddUTXO(ops.back(), MakeOutput(100 + i, 0xAB));
+        }
+        for (const auto& op : ops)
+            (void)cs.TryGetUTXO(op);
+        auto stats = cs.CacheStats();
+        assert(stats.usageBytes <= kBudget);
+        assert(stats.entries < ops.size());
+        assert(stats.misses > 0);
+        assert(cs.GetUTXO(ops[1]).value == 101);
+        assert(cs.GetUTXO(ops[31]).value == 131);
+        for (const auto& op : ops)
+            cs.SpendUTXO(op);
+    }
 
-        (void)cs.TryGetUTXO(opA);
-        (void)cs.TryGetUTXO(opB);
-        (void)cs.TryGetUTXO(opC);
-        assert(cs.CachedEntries() <= 2);
-        assert(cs.GetUTXO(opB).value == 80);
-        assert(cs.GetUTXO(opC).value == 90);
+    // Hits and misses are reported for the cache layer.
+    {
+        Chainstate cs(temp.string(), 1 << 20);
+        auto op = MakeOutPoint(0x08, 0);
+        cs.AddUTXO(op, MakeOutput(70, 0xAE));
+        auto before = cs.CacheStats();
+        (void)cs.TryGetUTXO(op);
+        (void)cs.TryGetUTXO(MakeOutPoint(0x09, 0));
+        auto after = cs.CacheStats();
+        assert(after.hits == before.hits + 1);
+        assert(after.misses == before.misses + 1);
+        cs.SpendUTXO(op);
+    }
+
+    // Coins created and spent inside a cache layer never reach the backend,
+    // and a spent coin that was already flushed is deleted on flush.
+    {
+        CoinsViewFile backend((temp.string() + ".view"));
+        CoinsViewCache cache(&backend);
+        auto opA = MakeOutPoint(0x0A, 0);
+        auto opB = MakeOutPoint(0x0B, 0);
+        cache.AddCoin(opA, MakeCoin(10, 0xA1), false);
+        assert(cache.DirtyEntries() == 1);
+        assert(cache.SpendCoin(opA));
+        assert(cache.Entries() == 0);
+        assert(cache.DirtyEntries() == 0);
+        cache.AddCoin(opB, MakeCoin(11, 0xA2), false);
+        cache.Flush();
+        assert(!backend.HaveCoin(opA));
+        assert(backend.GetCoin(opB)->Value() == 11);
+
+        CoinsViewCache child(&cache);
+        assert(child.SpendCoin(opB));
+        assert(!child.HaveCoin(opB));
+        assert(cache.HaveCoin(opB));
+        child.Flush();
+        assert(!cache.HaveCoin(opB));
+        cache.Flush();
+        assert(!backend.HaveCoin(opB));
+        assert(!cache.SpendCoin(opB));
     }
 
     // Balance updates and asset tags survive overwrites and removals.
@@ -106,6 +173,242 @@ int main()
         assert(cs.GetUTXO(opA).value == 25);
     }
 
+    // Write-back mode keeps updates in memory until a flush; the best block
+    // is persisted in the same batch and clean shutdown flushes the rest.
+    {
+        ChainstateFlushPolicy policy;
+        policy.maxFlushInterval = std::chrono::hours(1);
+        Chainstate cs(temp.string(), 1 << 20, policy);
+        cs.BeginTransaction();
+        cs.AddUTXO(MakeOutPoint(0x30, 0), MakeOutput(300, 0xB0));
+        cs.SetBestBlock(MakeBlockHash(0x41));
+        cs.Commit();
+        assert(cs.CacheStats().entries == 1);
+        assert(cs.GetBestBlock() == MakeBlockHash(0x41));
+        cs.AddUTXO(MakeOutPoint(0x31, 0), MakeOutput(301, 0xB1));
+    }
+    {
+        Chainstate cs(temp.string(), 1 << 20);
+        assert(!cs.PendingReplay());
+        assert(cs.GetBestBlock() == MakeBlockHash(0x41));
+        assert(cs.GetUTXO(MakeOutPoint(0x30, 0)).value == 300);
+        assert(cs.GetUTXO(MakeOutPoint(0x31, 0)).value == 301);
+        cs.SpendUTXO(MakeOutPoint(0x30, 0));
+        cs.SpendUTXO(MakeOutPoint(0x31, 0));
+    }
+
+    // Shards let writers on different threads and readers proceed together,
+    // inside and outside a block transaction.
+    {
+        Chainstate cs(temp.string() + ".sharded", 1 << 20);
+        cs.BeginTransaction();
+        std::atomic<bool> done{false};
+        std::thread reader([&] {
+            while (!done)
+                (void)cs.HaveUTXO(MakeOutPoint(0x01, 7));
+        });
+        std::vector<std::thread> writers;
+        for (uint32_t t = 0; t < 4; ++t) {
+            writers.emplace_back([&cs, t] {
+                for (uint32_t i = 0; i < 500; ++i) {
+                    auto op = MakeOutPoint(static_cast<uint8_t>(i), t * 1000 + i);
+                    cs.AddCoin(op, MakeCoin(i, 0xC0), false);
+                    if (i % 2 == 0) {
+                        Coin spent;
+                        assert(cs.SpendCoin(op, &spent) && spent.Value() == i);
+                    }
+                }
+            });
+        }
+        for (auto& w : writers)
+            w.join();
+        done = true;
+        reader.join();
+        cs.SetBestBlock(MakeBlockHash(0x55));
+        cs.Commit();
+        for (uint32_t t = 0; t < 4; ++t) {
+            for (uint32_t i = 0; i < 500; ++i)
+                assert(cs.HaveUTXO(MakeOutPoint(static_cast<uint8_t>(i), t * 1000 + i)) == (i % 2 == 1));
+        }
+        std::size_t perShard[Chainstate::kCoinShards] = {};
+        for (uint32_t i = 0; i < 64; ++i)
+            ++perShard[Chainstate::ShardIndex(MakeOutPoint(0x42, i))];
+        assert(std::count(std::begin(perShard), std::end(perShard), 0u) == 0);
+        cs.Flush();
+        assert(cs.GetBestBlock() == MakeBlockHash(0x55));
+    }
+
+    // Writers outside a transaction trip the byte budget from the per-shard
+    // usage counters and flush without waiting for the timer.
+    {
+        constexpr std::size_t kBudget = 8192;
+        ChainstateFlushPolicy policy;
+        policy.maxFlushInterval = std::chrono::hours(1);
+        Chainstate cs(temp.string() + ".budget", kBudget, policy);
+        std::vector<std::thread> writers;
+        for (uint32_t t = 0; t < 4; ++t) {
+            writers.emplace_back([&cs, t] {
+                for (uint32_t i = 0; i < 200; ++i)
+                    cs.AddCoin(MakeOutPoint(static_cast<uint8_t>(i), t * 1000 + i), MakeCoin(i, 0xC1), false);
+            });
+        }
+        for (auto& w : writers)
+            w.join();
+        assert(cs.CacheStats().entries < 800);
+        for (uint32_t t = 0; t < 4; ++t) {
+            for (uint32_t i = 0; i < 200; ++i)
+                assert(cs.TryGetCoin(MakeOutPoint(static_cast<uint8_t>(i), t * 1000 + i))->Value() == i);
+        }
+    }
+    {
+        Chainstate cs(temp.string() + ".sharded", 1 << 20);
+        assert(cs.GetBestBlock() == MakeBlockHash(0x55));
+        assert(cs.HaveUTXO(MakeOutPoint(3, 3003)));
+        assert(!cs.HaveUTXO(MakeOutPoint(4, 3004)));
+    }
+    std::filesystem::remove(temp.string() + ".sharded", ec);
+    std::filesystem::remove_all(temp.string() + ".sharded.ldb", ec);
+
+#ifdef DRACHMA_HAVE_LEVELDB
+    // Flushes split across several batches still land completely and clear
+    // the head-blocks marker.
+    {
+        const std::string path = temp.string() + ".chunked.ldb";
+        std::filesystem::remove_all(path, ec);
+        CoinsViewDB db(path, 1);
+        CoinsViewCache cache(&db);
+        for (uint8_t i = 0; i < 8; ++i)
+            cache.AddCoin(MakeOutPoint(static_cast<uint8_t>(0x50 + i), 0), MakeCoin(500 + i, 0xC0));
+        cache.SetBestBlock(MakeBlockHash(0x42));
+        cache.Flush();
+        assert(!db.GetHeadBlocks());
+        assert(db.GetBestBlock() == MakeBlockHash(0x42));
+        for (uint8_t i = 0; i < 8; ++i)
+            assert(db.GetCoin(MakeOutPoint(static_cast<uint8_t>(0x50 + i), 0))->Value() == 500u + i);
+        std::filesystem::remove_all(path, ec);
+    }
+
+    // A head-blocks marker left by an interrupted flush is reported for
+    // replay, and re-spending coins already removed is tolerated until the
+    // next flush completes.
+    {
+        leveldb::DB* raw = nullptr;
+        leveldb::Options opts;
+        auto status = leveldb::DB::Open(opts, temp.string() + ".ldb", &raw);
+        assert(status.ok());
+        std::string marker(64, '\0');
+        std::fill(marker.begin(), marker.begin() + 32, static_cast<char>(0x44));
+        std::fill(marker.begin() + 32, marker.end(), static_cast<char>(0x43));
+        status = raw->Put(leveldb::WriteOptions(), "H", marker);
+        assert(status.ok());
+        delete raw;
+    }
+    {
+        Chainstate cs(temp.string(), 1 << 20);
+        auto replay = cs.PendingReplay();
+        assert(replay);
+        assert(replay->from == MakeBlockHash(0x43));
+        assert(replay->to == MakeBlockHash(0x44));
+        cs.SpendUTXO(MakeOutPoint(0x32, 0));
+        cs.SetBestBlock(MakeBlockHash(0x44));
+        cs.Flush();
+        assert(!cs.PendingReplay());
+    }
+    {
+        Chainstate cs(temp.string(), 1 << 20);
+        assert(!cs.PendingReplay());
+        assert(cs.GetBestBlock() == MakeBlockHash(0x44));
+        bool threw = false;
+        try {
+            cs.SpendUTXO(MakeOutPoint(0x32, 0));
+        } catch (const std::exception&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+#endif
+
+    // Compact coins round-trip the 32-byte template, short scripts and
+    // long out-of-line scripts along with height and coinbase.
+    {
+        std::vector<std::vector<uint8_t>> scripts{std::vector<uint8_t>(32, 0x7E), {0x51}, {}, std::vector<uint8_t>(80, 0x6A)};
+        for (const auto& script : scripts) {
+            TxOut txo{};
+            txo.value = 0x123456789ULL;
+            txo.scriptPubKey = script;
+            txo.assetId = 2;
+            Coin coin(txo, 654321, true);
+            assert(coin.DynamicUsage() == (script.size() > Coin::kInlineScriptSize ? script.size() : 0));
+            std::string encoded;
+            EncodeCoin(coin, encoded);
+            if (script.size() == 32)
+                assert(encoded.size() == 3 + 5 + 1 + 1 + 32); // height, value, asset, template tag, key
+            Coin decoded;
+            assert(DecodeCoin(reinterpret_cast<const uint8_t*>(encoded.data()), encoded.size(), decoded));
+            assert(decoded.Value() == txo.value);
+            assert(decoded.Asset() == 2);
+            assert(decoded.Height() == 654321);
+            assert(decoded.IsCoinBase());
+            assert(decoded.ToTxOut().scriptPubKey == script);
+            Coin copy = decoded;
+            Coin moved = std::move(decoded);
+            assert(copy.ToTxOut().scriptPubKey == moved.ToTxOut().scriptPubKey);
+            assert(!DecodeCoin(reinterpret_cast<const uint8_t*>(encoded.data()), encoded.size() - 1, decoded));
+        }
+    }
+
+    // Height and coinbase flag persist through the chainstate.
+    {
+        {
+            Chainstate cs(temp.string(), 1 << 20);
+            cs.AddCoin(MakeOutPoint(0x60, 0), Coin(MakeOutput(600, 0xD0), 42, true));
+        }
+        Chainstate cs(temp.string(), 1 << 20);
+        auto coin = cs.TryGetCoin(MakeOutPoint(0x60, 0));
+        assert(coin && coin->Height() == 42 && coin->IsCoinBase());
+        assert(cs.GetUTXO(MakeOutPoint(0x60, 0)).value == 600);
+        cs.SpendUTXO(MakeOutPoint(0x60, 0));
+    }
+
+#ifdef DRACHMA_HAVE_LEVELDB
+    // Databases written with the [asset][value][script] layout are upgraded
+    // in place on open.
+    {
+        const std::string base = temp.string() + ".legacy";
+        std::filesystem::remove_all(base + ".ldb", ec);
+        {
+            leveldb::DB* raw = nullptr;
+            leveldb::Options opts;
+            opts.create_if_missing = true;
+            auto status = leveldb::DB::Open(opts, base + ".ldb", &raw);
+            assert(status.ok());
+            for (uint8_t i = 0; i < 3; ++i) {
+                auto op = MakeOutPoint(static_cast<uint8_t>(0x70 + i), i);
+                std::string key(reinterpret_cast<const char*>(op.hash.data()), op.hash.size());
+                key.append(reinterpret_cast<const char*>(&op.index), sizeof(op.index));
+                const uint64_t value = 700 + i;
+                std::string val(1, static_cast<char>(i));
+                val.append(reinterpret_cast<const char*>(&value), sizeof(value));
+                val.append(i == 2 ? 1 : 32, static_cast<char>(0x51));
+                status = raw->Put(leveldb::WriteOptions(), key, val);
+                assert(status.ok());
+            }
+            delete raw;
+        }
+        for (int reopen = 0; reopen < 2; ++reopen) {
+            Chainstate cs(base, 1 << 20);
+            for (uint8_t i = 0; i < 3; ++i) {
+                auto out = cs.GetUTXO(MakeOutPoint(static_cast<uint8_t>(0x70 + i), i));
+                assert(out.value == 700u + i);
+                assert(out.assetId == i);
+                assert(out.scriptPubKey.size() == (i == 2 ? 1u : 32u));
+            }
+        }
+        std::filesystem::remove_all(base + ".ldb", ec);
+    }
+#endif
+
     std::filesystem::remove(temp, ec);
+    std::filesystem::remove_all(temp.string() + ".ldb", ec);
     return 0;
 }
@@ -0,0 +1,189 @@
+#include "../../layer1-core/chainstate/coins.h"
+#include "../../layer1-core/chainstate/snapshot.h"
+#include "../../layer1-core/consensus/params.h"
+#include "../test_util.h"
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+OutPoint MakeOutPoint(uint8_t seed, uint32_t index)
+{
+    OutPoint op{};
+    op.hash.fill(seed);
+    op.hash[0] = static_cast<uint8_t>(seed * 37);
+    op.index = index;
+    return op;
+}
+
+TxOut MakeOutput(uint64_t value, uint8_t tag, std::size_t scriptSize = 32)
+{
+    TxOut out{};
+    out.value = value;
+    out.scriptPubKey.assign(scriptSize, tag);
+    out.assetId = tag % 3;
+    return out;
+}
+
+uint256 MakeBlockHash(uint8_t seed)
+{
+    uint256 hash{};
+    hash.fill(seed);
+    return hash;
+}
+
+} // namespace
+
+int main()
+{
+    const auto dir = std::filesystem::temp_directory_path() / "drachma_snapshot_tests";
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    std::filesystem::create_directories(dir);
+    const std::string source = (dir / "source").string();
+    const std::string target = (dir / "target").string();
+    const std::string snapPath = (dir / "utxo.snapshot").string();
+
+    // Dump a chainstate with inline and overflow scripts, mixed heights.
+    SnapshotMetadata dumped;
+    {
+        Chainstate cs(source, 1 << 20);
+        for (uint8_t i = 1; i <= 200; ++i) {
+            const std::size_t scriptSize = (i % 10 == 0) ? 40 + i : 32;
+            cs.AddCoin(MakeOutPoint(i, i % 4), Coin(MakeOutput(1000 + i, i, scriptSize), i * 3u, i % 7 == 0));
+        }
+        cs.SpendCoin(MakeOutPoint(5, 1));
+        cs.SetBestBlock(MakeBlockHash(0x42));
+        dumped = cs.DumpSnapshot(snapPath);
+        assert(dumped.coinCount == 199);
+        assert(dumped.baseBlock == MakeBlockHash(0x42));
+    }
+    assert(std::filesystem::file_size(snapPath) > kSnapshotHeaderSize + 199 * kSnapshotRecordSize);
+
+    // The mapped snapshot is sorted and answers lookups in place.
+    {
+        UtxoSnapshot snap(snapPath);
+        assert(snap.Metadata().contentHash == dumped.contentHash);
+        assert(snap.GetBestBlock() == MakeBlockHash(0x42));
+        assert(snap.Size() == 199);
+        for (std::size_t i = 1; i < snap.Size(); ++i) {
+            const auto a = snap.At(i - 1).first;
+            const auto b = snap.At(i).first;
+            assert(a.hash < b.hash || (a.hash == b.hash && a.index < b.index));
+        }
+        auto coin = snap.GetCoin(MakeOutPoint(30, 2));
+        assert(coin && coin->Value() == 1030 && coin->Height() == 90);
+        assert(coin->ScriptSize() == 70 && coin->ScriptData()[69] == 30);
+        assert(snap.GetCoin(MakeOutPoint(14, 2))->IsCoinBase());
+        assert(!snap.GetCoin(MakeOutPoint(5, 1)));
+        assert(!snap.GetCoin(MakeOutPoint(6, 3)));
+    }
+
+    // Only snapshots pinned in the consensus parameters are trusted.
+    consensus::Params trusted = consensus::Testnet();
+    trusted.assumeUtxo[66] = consensus::AssumeUtxoData{dumped.baseBlock, dumped.setHash};
+    {
+        Chainstate cs(target, 1 << 20);
+        assert(Throws([&] { cs.LoadSnapshot(snapPath, consensus::Testnet()); }));
+        consensus::Params wrongHash = trusted;
+        wrongHash.assumeUtxo[66].setHash[0] ^= 1;
+        assert(Throws([&] { cs.LoadSnapshot(snapPath, wrongHash); }));
+        consensus::Params wrongBlock = trusted;
+        wrongBlock.assumeUtxo[66].baseBlock = MakeBlockHash(0x43);
+        assert(Throws([&] { cs.LoadSnapshot(snapPath, wrongBlock); }));
+        assert(cs.GetBestBlock() == uint256{} && !cs.HaveUTXO(MakeOutPoint(1, 1)));
+    }
+
+    // Loading reproduces the set and adopts the base block.
+    {
+        Chainstate cs(target, 1 << 20);
+        const auto loaded = cs.LoadSnapshot(snapPath, trusted);
+        assert(loaded.contentHash == dumped.contentHash);
+        assert(cs.GetBestBlock() == MakeBlockHash(0x42));
+        for (uint8_t i = 1; i <= 200; ++i) {
+            auto coin = cs.TryGetCoin(MakeOutPoint(i, i % 4));
+            if (i == 5) {
+                assert(!coin);
+                continue;
+            }
+            assert(coin && coin->Value() == 1000u + i && coin->Height() == i * 3u);
+            assert(coin->IsCoinBase() == (i % 7 == 0));
+            assert(coin->ScriptSize() == ((i % 10 == 0) ? 40u + i : 32u));
+        }
+        // A chainstate with a tip refuses a second import.
+        assert(Throws([&] { cs.LoadSnapshot(snapPath, trusted); }));
+    }
+    {
+        // The import persisted; a re-dump is byte-for-byte the same set.
+        Chainstate cs(target, 1 << 20);
+        assert(cs.GetBestBlock() == MakeBlockHash(0x42));
+        assert(cs.HaveUTXO(MakeOutPoint(200, 0)));
+        const auto again = cs.DumpSnapshot(snapPath + ".2");
+        assert(again.contentHash == dumped.contentHash);
+    }
+
+    // Corruption and truncation are caught before anything is imported.
+    {
+        const std::string bad = snapPath + ".bad";
+        std::filesystem::copy_file(snapPath, bad, std::filesystem::copy_options::overwrite_existing);
+        {
+            std::fstream f(bad, std::ios::in | std::ios::out | std::ios::binary);
+            f.seekp(kSnapshotHeaderSize + 3 * kSnapshotRecordSize + 40);
+            f.put('\x7f');
+        }
+        assert(Throws([&] { UtxoSnapshot snap(bad); }));
+        Chainstate cs((dir / "fresh").string(), 1 << 20);
+        assert(Throws([&] { cs.LoadSnapshot(bad, trusted, true); }));
+        assert(cs.GetBestBlock() == uint256{});
+        assert(!cs.HaveUTXO(MakeOutPoint(1, 1)));
+
+        std::filesystem::copy_file(snapPath, bad, std::filesystem::copy_options::overwrite_existing);
+        std::filesystem::resize_file(bad, std::filesystem::file_size(bad) - 1);
+        assert(Throws([&] { UtxoSnapshot snap(bad); }));
+        assert(Throws([&] { UtxoSnapshot snap((dir / "missing").string()); }));
+    }
+
+    // Outputs of one txid come out in numeric index order even though the
+    // backend may store the index in a different byte order.
+    {
+        const std::string multi = (dir / "multi").string();
+        Chainstate cs(multi, 1 << 20);
+        for (uint32_t index : {256u, 1u, 65536u, 2u})
+            cs.AddCoin(MakeOutPoint(9, index), Coin(MakeOutput(index, 9), 1, false));
+        cs.SetBestBlock(MakeBlockHash(0x43));
+        const auto meta = cs.DumpSnapshot(snapPath + ".multi");
+        UtxoSnapshot snap(snapPath + ".multi");
+        assert(meta.coinCount == 4);
+        assert(snap.At(0).first.index == 1 && snap.At(1).first.index == 2);
+        assert(snap.At(2).first.index == 256 && snap.At(3).first.index == 65536);
+    }
+
+    // The streaming writer refuses unsorted input and cleans up after itself.
+    {
+        const std::string unsorted = snapPath + ".unsorted";
+        {
+            UtxoSnapshotWriter writer(unsorted, MakeBlockHash(8));
+            writer.Add(MakeOutPoint(3, 2), Coin(MakeOutput(1, 3), 1, false));
+            assert(Throws([&] { writer.Add(MakeOutPoint(3, 1), Coin(MakeOutput(1, 3), 1, false)); }));
+            assert(Throws([&] { writer.Add(MakeOutPoint(3, 2), Coin(MakeOutput(1, 3), 1, false)); }));
+        }
+        assert(!std::filesystem::exists(unsorted));
+        assert(!std::filesystem::exists(unsorted + ".tmp"));
+        assert(!std::filesystem::exists(unsorted + ".overflow.tmp"));
+    }
+
+    // An empty set round-trips too.
+    {
+        const auto meta = WriteUtxoSnapshot(snapPath + ".empty", MakeBlockHash(7), {});
+        UtxoSnapshot snap(snapPath + ".empty");
+        assert(snap.Size() == 0 && meta.coinCount == 0);
+        assert(snap.GetBestBlock() == MakeBlockHash(7));
+        assert(!snap.GetCoin(MakeOutPoint(1, 1)));
+    }
+
+    std::filesystem::remove_all(dir, ec);
+    return 0;
+}
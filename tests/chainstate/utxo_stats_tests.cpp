@@ -0,0 +1,169 @@
+#include "../../layer1-core/chainstate/coins.h"
+#include "../../layer1-core/chainstate/utxo_stats.h"
+#include "../../layer1-core/consensus/params.h"
+#include <cassert>
+#include <filesystem>
+#include <string>
+
+#ifdef DRACHMA_HAVE_LEVELDB
+#include <leveldb/db.h>
+#endif
+
+namespace {
+
+OutPoint MakeOutPoint(uint8_t seed, uint32_t index)
+{
+    OutPoint op{};
+    op.hash.fill(seed);
+    op.index = index;
+    return op;
+}
+
+Coin MakeCoin(uint64_t value, uint8_t asset, uint32_t height = 1)
+{
+    TxOut out{};
+    out.value = value;
+    out.assetId = asset;
+    out.scriptPubKey.assign(32, static_cast<uint8_t>(value));
+    return Coin(out, height, false);
+}
+
+uint256 MakeBlockHash(uint8_t seed)
+{
+    uint256 hash{};
+    hash.fill(seed);
+    return hash;
+}
+
+void Insert(MuHash3072& h, const std::string& s)
+{
+    h.Insert(reinterpret_cast<const uint8_t*>(s.data()), s.size());
+}
+
+void Remove(MuHash3072& h, const std::string& s)
+{
+    h.Remove(reinterpret_cast<const uint8_t*>(s.data()), s.size());
+}
+
+} // namespace
+
+int main()
+{
+    // The multiset hash ignores order, cancels removals and combines.
+    {
+        MuHash3072 empty, ab, ba, abc;
+        Insert(ab, "a");
+        Insert(ab, "b");
+        Insert(ba, "b");
+        Insert(ba, "a");
+        assert(ab.Finalize() == ba.Finalize());
+        assert(ab.Finalize() != empty.Finalize());
+
+        Insert(abc, "a");
+        Insert(abc, "c");
+        Insert(abc, "b");
+        Remove(abc, "c");
+        assert(abc.Finalize() == ab.Finalize());
+
+        MuHash3072 a, b;
+        Insert(a, "a");
+        Insert(b, "b");
+        a.Combine(b);
+        assert(a.Finalize() == ab.Finalize());
+
+        const auto blob = abc.Serialize();
+        MuHash3072 restored;
+        assert(restored.Deserialize(reinterpret_cast<const uint8_t*>(blob.data()), blob.size()));
+        assert(restored.Finalize() == ab.Finalize());
+        assert(!restored.Deserialize(reinterpret_cast<const uint8_t*>(blob.data()), blob.size() - 1));
+    }
+
+    const auto temp = std::filesystem::temp_directory_path() / "drachma_utxo_stats";
+    std::error_code ec;
+    std::filesystem::remove_all(temp, ec);
+    std::filesystem::create_directories(temp);
+    const std::string path = (temp / "chainstate").string();
+
+    // Counts, supply and hash follow adds, overwrites, spends and rollbacks.
+    uint256 expectedHash{};
+    {
+        Chainstate cs(path, 1 << 20);
+        const auto empty = cs.GetUtxoSetStats();
+        assert(empty.coins == 0);
+
+        cs.AddCoin(MakeOutPoint(1, 0), MakeCoin(100, 0));
+        cs.AddCoin(MakeOutPoint(2, 0), MakeCoin(250, 1));
+        cs.AddCoin(MakeOutPoint(3, 0), MakeCoin(7, 2));
+        cs.AddCoin(MakeOutPoint(3, 0), MakeCoin(9, 2)); // overwrite
+        assert(cs.SpendCoin(MakeOutPoint(1, 0)));
+        cs.AddCoin(MakeOutPoint(4, 1), MakeCoin(40, 1), false);
+
+        cs.BeginTransaction();
+        cs.AddCoin(MakeOutPoint(5, 0), MakeCoin(1000, 0), false);
+        cs.SpendUTXO(MakeOutPoint(2, 0));
+        assert(cs.GetUtxoSetStats().coins == 3); // staged changes are not reported
+        cs.Rollback();
+
+        auto stats = cs.GetUtxoSetStats();
+        assert(stats.coins == 3);
+        assert(stats.assets[0].coins == 0 && stats.assets[0].amount == 0);
+        assert(stats.assets[1].coins == 2 && stats.assets[1].amount == 290);
+        assert(stats.assets[2].coins == 1 && stats.assets[2].amount == 9);
+
+        // The running hash equals the hash of the same set built from scratch.
+        UtxoStatsTracker fresh;
+        fresh.AddCoin(MakeOutPoint(4, 1), MakeCoin(40, 1));
+        fresh.AddCoin(MakeOutPoint(3, 0), MakeCoin(9, 2));
+        fresh.AddCoin(MakeOutPoint(2, 0), MakeCoin(250, 1));
+        assert(stats.setHash == fresh.SetHash());
+        expectedHash = stats.setHash;
+
+        cs.BeginTransaction();
+        cs.SpendUTXO(MakeOutPoint(2, 0));
+        cs.AddCoin(MakeOutPoint(6, 0), MakeCoin(250, 1), false);
+        cs.SetBestBlock(MakeBlockHash(0x61));
+        cs.Commit();
+        stats = cs.GetUtxoSetStats();
+        assert(stats.bestBlock == MakeBlockHash(0x61));
+        assert(stats.coins == 3 && stats.assets[1].amount == 290);
+        assert(stats.setHash != expectedHash);
+        expectedHash = stats.setHash;
+    }
+
+    // Stats are persisted with the flush on shutdown.
+    {
+        Chainstate cs(path, 1 << 20);
+        const auto stats = cs.GetUtxoSetStats();
+        assert(stats.coins == 3);
+        assert(stats.setHash == expectedHash);
+
+        // A snapshot carries the same set hash.
+        const auto meta = cs.DumpSnapshot((temp / "snap").string());
+        assert(meta.setHash == expectedHash);
+        Chainstate loaded((temp / "loaded").string(), 1 << 20);
+        loaded.LoadSnapshot((temp / "snap").string(), consensus::Testnet(), true);
+        assert(loaded.GetUtxoSetStats().setHash == expectedHash);
+        assert(loaded.GetUtxoSetStats().assets[2].amount == 9);
+    }
+
+#ifdef DRACHMA_HAVE_LEVELDB
+    // Stores without saved stats are rebuilt from the coins.
+    {
+        leveldb::DB* raw = nullptr;
+        leveldb::Options opts;
+        auto status = leveldb::DB::Open(opts, path + ".ldb", &raw);
+        assert(status.ok());
+        status = raw->Delete(leveldb::WriteOptions(), "S");
+        assert(status.ok());
+        delete raw;
+
+        Chainstate cs(path, 1 << 20);
+        const auto stats = cs.GetUtxoSetStats();
+        assert(stats.coins == 3);
+        assert(stats.setHash == expectedHash);
+    }
+#endif
+
+    std::filesystem::remove_all(temp, ec);
+    return 0;
+}
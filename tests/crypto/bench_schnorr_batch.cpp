@@ -0,0 +1,74 @@
+// Throughput of individual BIP-340 verification against schnorr_batch_verify
+// for the batch sizes block validation produces. Not part of the test suite;
+// build with -DDRACHMA_BUILD_BENCH=ON and run bench_schnorr_batch.
+#include "../../layer1-core/crypto/schnorr.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+// BIP-340 test vector 0: secret key 3 and its x-only public key.
+const std::array<uint8_t, 33> kPubKey = {
+    0x02, 0xF9, 0x30, 0x8A, 0x01, 0x92, 0x58, 0xC3, 0x10, 0x49, 0x34, 0x4F, 0x85, 0xF8, 0x9D, 0x52, 0x29,
+    0xB5, 0x31, 0xC8, 0x45, 0x83, 0x6F, 0x99, 0xB0, 0x86, 0x01, 0xF1, 0x13, 0xBC, 0xE0, 0x36, 0xF9};
+
+double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    // Optional argument: minimum number of signatures verified per size.
+    const size_t minSigs = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 8192;
+
+    std::array<uint8_t, 32> secret{};
+    secret[31] = 3;
+    const size_t maxBatch = 4096;
+    std::vector<std::array<uint8_t, 33>> pubkeys(maxBatch, kPubKey);
+    std::vector<std::array<uint8_t, 32>> msgs(maxBatch);
+    std::vector<std::array<uint8_t, 64>> sigs(maxBatch);
+    for (size_t i = 0; i < maxBatch; ++i) {
+        for (size_t b = 0; b < 32; ++b)
+            msgs[i][b] = static_cast<uint8_t>((i >> (8 * (b % 4))) ^ b);
+        if (!schnorr_sign(secret.data(), msgs[i].data(), sigs[i].data())) {
+            std::fprintf(stderr, "signing failed\n");
+            return 1;
+        }
+    }
+
+    std::printf("%8s %14s %14s %8s\n", "batch", "single sig/s", "batch sig/s", "speedup");
+    for (size_t size = 16; size <= maxBatch; size *= 4) {
+        const size_t rounds = std::max<size_t>(1, minSigs / size);
+        std::vector<std::array<uint8_t, 33>> pk(pubkeys.begin(), pubkeys.begin() + size);
+        std::vector<std::array<uint8_t, 32>> msg(msgs.begin(), msgs.begin() + size);
+        std::vector<std::array<uint8_t, 64>> sig(sigs.begin(), sigs.begin() + size);
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < rounds; ++r) {
+            for (size_t i = 0; i < size; ++i) {
+                if (!schnorr_verify(pk[i].data(), msg[i].data(), sig[i].data())) {
+                    std::fprintf(stderr, "single verification failed\n");
+                    return 1;
+                }
+            }
+        }
+        const double single = static_cast<double>(rounds * size) / Seconds(start);
+
+        start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < rounds; ++r) {
+            if (!schnorr_batch_verify(pk, msg, sig)) {
+                std::fprintf(stderr, "batch verification failed\n");
+                return 1;
+            }
+        }
+        const double batch = static_cast<double>(rounds * size) / Seconds(start);
+        std::printf("%8zu %14.0f %14.0f %7.2fx\n", size, single, batch, batch / single);
+    }
+    return 0;
+}
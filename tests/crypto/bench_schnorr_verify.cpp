@@ -0,0 +1,154 @@
+// Single-signature BIP-340 verification rate per core, through the reused
+// thread-local context and through a baseline that repeats the setup
+// schnorr_verify used to do on every call, with one thread and with every
+// core busy. Not part of the test suite; build with -DDRACHMA_BUILD_BENCH=ON
+// and run bench_schnorr_verify.
+#include "../../layer1-core/crypto/schnorr.h"
+#include "../../layer1-core/crypto/tagged_hash.h"
+#include <openssl/bn.h>
+#include <openssl/crypto.h>
+#include <openssl/ec.h>
+#include <openssl/obj_mac.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// BIP-340 test vector 0: secret key 3 and its x-only public key.
+const std::array<uint8_t, 33> kPubKey = {
+    0x02, 0xF9, 0x30, 0x8A, 0x01, 0x92, 0x58, 0xC3, 0x10, 0x49, 0x34, 0x4F, 0x85, 0xF8, 0x9D, 0x52, 0x29,
+    0xB5, 0x31, 0xC8, 0x45, 0x83, 0x6F, 0x99, 0xB0, 0x86, 0x01, 0xF1, 0x13, 0xBC, 0xE0, 0x36, 0xF9};
+
+constexpr size_t kSignatures = 256;
+
+// schnorr_verify as it was before contexts: a fresh group and BN_CTX, the
+// curve constants read back, the challenge through tagged_hash, and generic
+// point multiplication for both s*G and e*P.
+bool VerifyWithFreshSetup(const uint8_t* pub33, const uint8_t* msg, const uint8_t* sig)
+{
+    EC_GROUP* group = EC_GROUP_new_by_curve_name(NID_secp256k1);
+    BN_CTX* ctx = BN_CTX_new();
+    BIGNUM* order = BN_new();
+    BIGNUM* p = BN_new();
+    BIGNUM* r = BN_bin2bn(sig, 32, nullptr);
+    BIGNUM* s = BN_bin2bn(sig + 32, 32, nullptr);
+    BIGNUM* e = nullptr;
+    BIGNUM* x = BN_new();
+    BIGNUM* y = BN_new();
+    EC_POINT* pub = group ? EC_POINT_new(group) : nullptr;
+    EC_POINT* sG = group ? EC_POINT_new(group) : nullptr;
+    EC_POINT* eP = group ? EC_POINT_new(group) : nullptr;
+    bool ok = group && ctx && order && p && r && s && x && y && pub && sG && eP &&
+              EC_GROUP_get_order(group, order, ctx) == 1 &&
+              EC_GROUP_get_curve(group, p, nullptr, nullptr, ctx) == 1 && BN_cmp(r, p) < 0 &&
+              BN_cmp(s, order) < 0 && EC_POINT_oct2point(group, pub, pub33, 33, ctx) == 1 &&
+              EC_POINT_is_on_curve(group, pub, ctx) == 1;
+    if (ok) {
+        uint8_t preimage[96];
+        std::copy(sig, sig + 32, preimage);
+        std::copy(pub33 + 1, pub33 + 33, preimage + 32);
+        std::copy(msg, msg + 32, preimage + 64);
+        const auto challenge = tagged_hash("BIP0340/challenge", preimage, sizeof(preimage));
+        e = BN_bin2bn(challenge.data(), static_cast<int>(challenge.size()), nullptr);
+        ok = e && BN_mod(e, e, order, ctx) == 1 && EC_POINT_mul(group, sG, s, nullptr, nullptr, ctx) == 1 &&
+             EC_POINT_mul(group, eP, nullptr, pub, e, ctx) == 1 && EC_POINT_invert(group, eP, ctx) == 1 &&
+             EC_POINT_add(group, sG, sG, eP, ctx) == 1 && EC_POINT_is_at_infinity(group, sG) == 0 &&
+             EC_POINT_get_affine_coordinates(group, sG, x, y, ctx) == 1;
+    }
+    if (ok) {
+        uint8_t rx[32];
+        ok = BN_bn2binpad(x, rx, 32) == 32 && !BN_is_odd(y) && CRYPTO_memcmp(rx, sig, 32) == 0;
+    }
+    EC_POINT_free(eP);
+    EC_POINT_free(sG);
+    EC_POINT_free(pub);
+    BN_free(y);
+    BN_free(x);
+    BN_free(e);
+    BN_free(s);
+    BN_free(r);
+    BN_free(p);
+    BN_free(order);
+    BN_CTX_free(ctx);
+    EC_GROUP_free(group);
+    return ok;
+}
+
+struct Inputs {
+    std::vector<std::array<uint8_t, 32>> msgs;
+    std::vector<std::array<uint8_t, 64>> sigs;
+};
+
+// Verifications per second per thread with `threads` threads each checking
+// `perThread` signatures.
+template <typename Verify>
+double Rate(const Inputs& in, unsigned threads, size_t perThread, Verify verify)
+{
+    std::atomic<bool> failed{false};
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (size_t i = 0; i < perThread; ++i) {
+                const size_t k = i % kSignatures;
+                if (!verify(in.msgs[k].data(), in.sigs[k].data()))
+                    failed = true;
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    if (failed) {
+        std::fprintf(stderr, "verification failed\n");
+        std::exit(1);
+    }
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return static_cast<double>(perThread) / secs;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    // Optional argument: signatures verified per thread for each measurement.
+    const size_t perThread = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+    std::array<uint8_t, 32> secret{};
+    secret[31] = 3;
+    Inputs in;
+    in.msgs.resize(kSignatures);
+    in.sigs.resize(kSignatures);
+    for (size_t i = 0; i < kSignatures; ++i) {
+        for (size_t b = 0; b < 32; ++b)
+            in.msgs[i][b] = static_cast<uint8_t>(i * 31 + b);
+        if (!schnorr_sign(secret.data(), in.msgs[i].data(), in.sigs[i].data())) {
+            std::fprintf(stderr, "signing failed\n");
+            return 1;
+        }
+    }
+
+    auto threadCtx = [](const uint8_t* msg, const uint8_t* sig) {
+        return schnorr_verify(kPubKey.data(), msg, sig);
+    };
+    auto freshSetup = [](const uint8_t* msg, const uint8_t* sig) {
+        return VerifyWithFreshSetup(kPubKey.data(), msg, sig);
+    };
+
+    std::printf("%-18s %8s %16s %10s\n", "mode", "threads", "verify/s/core", "speedup");
+    std::vector<unsigned> threadCounts{1};
+    if (cores > 1)
+        threadCounts.push_back(cores);
+    for (unsigned threads : threadCounts) {
+        const double before = Rate(in, threads, perThread, freshSetup);
+        const double after = Rate(in, threads, perThread, threadCtx);
+        std::printf("%-18s %8u %16.0f %10s\n", "per-call setup", threads, before, "-");
+        std::printf("%-18s %8u %16.0f %9.2fx\n", "thread context", threads, after, after / before);
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include "../../layer1-core/crypto/crc32c.h"
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Bit-at-a-time reference.
+uint32_t Reference(const uint8_t* data, size_t size)
+{
+    uint32_t crc = 0xffffffffu;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; ++b)
+            crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78u : 0);
+    }
+    return ~crc;
+}
+
+} // namespace
+
+int main()
+{
+    // RFC 3720 (iSCSI) test vectors.
+    const char* check = "123456789";
+    assert(Crc32c(reinterpret_cast<const uint8_t*>(check), std::strlen(check)) == 0xE3069283u);
+    std::vector<uint8_t> buf(32, 0x00);
+    assert(Crc32c(buf.data(), buf.size()) == 0x8A9136AAu);
+    buf.assign(32, 0xff);
+    assert(Crc32c(buf.data(), buf.size()) == 0x62A8AB43u);
+    for (uint8_t i = 0; i < 32; ++i)
+        buf[i] = i;
+    assert(Crc32c(buf.data(), buf.size()) == 0x46DD794Eu);
+    assert(Crc32c(nullptr, 0) == 0);
+
+    // Every implementation, not just the one this CPU selects, agrees with
+    // the reference at every length and alignment, and a CRC can be
+    // continued across calls.
+    std::vector<uint32_t (*)(const uint8_t*, size_t, uint32_t)> impls = {Crc32c, crc32c_detail::Software};
+    if (Crc32cHardwareAvailable())
+        impls.push_back(crc32c_detail::Hardware);
+    std::vector<uint8_t> data(1024 + 16);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<uint8_t>(i * 131 + 7);
+    for (auto crc : impls) {
+        assert(crc(reinterpret_cast<const uint8_t*>(check), std::strlen(check), 0) == 0xE3069283u);
+        for (size_t offset = 0; offset < 8; ++offset) {
+            for (size_t size = 0; size <= 1024; size += (size < 64 ? 1 : 61)) {
+                const uint8_t* p = data.data() + offset;
+                const uint32_t expected = Reference(p, size);
+                assert(crc(p, size, 0) == expected);
+                const size_t split = size / 3;
+                assert(crc(p + split, size - split, crc(p, split, 0)) == expected);
+            }
+        }
+    }
+    return 0;
+}
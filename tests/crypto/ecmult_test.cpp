@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include "../../layer1-core/crypto/ecmult.h"
+#include "../../layer1-core/crypto/schnorr.h"
+#include <openssl/rand.h>
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+using point_ptr = std::unique_ptr<EC_POINT, decltype(&EC_POINT_free)>;
+using bn_ptr = std::unique_ptr<BIGNUM, decltype(&BN_clear_free)>;
+using ctx_ptr = std::unique_ptr<BN_CTX, decltype(&BN_CTX_free)>;
+
+bn_ptr RandomScalar(const secp256k1_curve& curve, BN_CTX* ctx)
+{
+    bn_ptr k(BN_new(), &BN_clear_free);
+    EXPECT_EQ(BN_rand_range(k.get(), curve.order), 1);
+    (void)ctx;
+    return k;
+}
+
+point_ptr NewPoint(const secp256k1_curve& curve)
+{
+    return point_ptr(EC_POINT_new(curve.group), &EC_POINT_free);
+}
+
+// Reference result: one EC_POINT_mul per term.
+point_ptr NaiveSum(const secp256k1_curve& curve, const std::vector<point_ptr>& points,
+                   const std::vector<bn_ptr>& scalars, BN_CTX* ctx)
+{
+    auto sum = NewPoint(curve);
+    auto term = NewPoint(curve);
+    EC_POINT_set_to_infinity(curve.group, sum.get());
+    for (size_t i = 0; i < points.size(); ++i) {
+        EXPECT_EQ(EC_POINT_mul(curve.group, term.get(), nullptr, points[i].get(), scalars[i].get(), ctx), 1);
+        EXPECT_EQ(EC_POINT_add(curve.group, sum.get(), sum.get(), term.get(), ctx), 1);
+    }
+    return sum;
+}
+
+} // namespace
+
+TEST(Ecmult, GeneratorTableMatchesOpenSsl)
+{
+    const secp256k1_curve* curve = secp256k1_curve_get();
+    ASSERT_NE(curve, nullptr);
+    ctx_ptr ctx(BN_CTX_new(), &BN_CTX_free);
+    auto expected = NewPoint(*curve);
+    auto actual = NewPoint(*curve);
+
+    bn_ptr k(BN_new(), &BN_clear_free);
+    BN_zero(k.get());
+    ASSERT_TRUE(ecmult_gen(*curve, actual.get(), k.get(), ctx.get()));
+    EXPECT_EQ(EC_POINT_is_at_infinity(curve->group, actual.get()), 1);
+
+    // order - 1 exercises every nibble of the table.
+    ASSERT_EQ(BN_sub(k.get(), curve->order, BN_value_one()), 1);
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_EQ(EC_POINT_mul(curve->group, expected.get(), k.get(), nullptr, nullptr, ctx.get()), 1);
+        ASSERT_TRUE(ecmult_gen(*curve, actual.get(), k.get(), ctx.get()));
+        EXPECT_EQ(EC_POINT_cmp(curve->group, expected.get(), actual.get(), ctx.get()), 0);
+        k = RandomScalar(*curve, ctx.get());
+    }
+}
+
+TEST(Ecmult, StraussAndPippengerMatchNaiveSum)
+{
+    const secp256k1_curve* curve = secp256k1_curve_get();
+    ASSERT_NE(curve, nullptr);
+    ctx_ptr ctx(BN_CTX_new(), &BN_CTX_free);
+
+    for (size_t n : {1u, 2u, 7u, 40u, 300u}) {
+        std::vector<point_ptr> points;
+        std::vector<bn_ptr> scalars;
+        for (size_t i = 0; i < n; ++i) {
+            auto secret = RandomScalar(*curve, ctx.get());
+            points.push_back(NewPoint(*curve));
+            ASSERT_EQ(EC_POINT_mul(curve->group, points.back().get(), secret.get(), nullptr, nullptr, ctx.get()), 1);
+            scalars.push_back(RandomScalar(*curve, ctx.get()));
+        }
+        // Edge scalars: zero, one, order - 1 and a short 128-bit value.
+        BN_zero(scalars[0].get());
+        if (n > 2) {
+            BN_one(scalars[1].get());
+            BN_sub(scalars[2].get(), curve->order, BN_value_one());
+        }
+        if (n > 3) {
+            BN_rand(scalars[3].get(), 128, BN_RAND_TOP_ANY, BN_RAND_BOTTOM_ANY);
+        }
+        // Repeated points land in the same Pippenger buckets.
+        if (n > 5) {
+            EC_POINT_copy(points[5].get(), points[4].get());
+        }
+
+        std::vector<const EC_POINT*> pointRefs;
+        std::vector<const BIGNUM*> scalarRefs;
+        for (size_t i = 0; i < n; ++i) {
+            pointRefs.push_back(points[i].get());
+            scalarRefs.push_back(scalars[i].get());
+        }
+
+        auto expected = NaiveSum(*curve, points, scalars, ctx.get());
+        auto strauss = NewPoint(*curve);
+        auto pippenger = NewPoint(*curve);
+        auto chosen = NewPoint(*curve);
+        ASSERT_TRUE(ecmult_multi_strauss(*curve, strauss.get(), pointRefs, scalarRefs, ctx.get()));
+        ASSERT_TRUE(ecmult_multi_pippenger(*curve, pippenger.get(), pointRefs, scalarRefs, ctx.get()));
+        ASSERT_TRUE(ecmult_multi(*curve, chosen.get(), pointRefs, scalarRefs, ctx.get()));
+        EXPECT_EQ(EC_POINT_cmp(curve->group, expected.get(), strauss.get(), ctx.get()), 0) << n;
+        EXPECT_EQ(EC_POINT_cmp(curve->group, expected.get(), pippenger.get(), ctx.get()), 0) << n;
+        EXPECT_EQ(EC_POINT_cmp(curve->group, expected.get(), chosen.get(), ctx.get()), 0) << n;
+    }
+
+    // Mismatched inputs are rejected.
+    auto out = NewPoint(*curve);
+    std::vector<const EC_POINT*> onePoint{EC_GROUP_get0_generator(curve->group)};
+    EXPECT_FALSE(ecmult_multi(*curve, out.get(), onePoint, {}, ctx.get()));
+}
+
+TEST(Ecmult, BatchVerifyLargeBatch)
+{
+    // Large enough that the batch runs through Pippenger.
+    std::array<uint8_t, 32> secret{};
+    secret[31] = 3;
+    std::array<uint8_t, 33> pub = {0x02, 0xF9, 0x30, 0x8A, 0x01, 0x92, 0x58, 0xC3, 0x10, 0x49, 0x34, 0x4F,
+                                   0x85, 0xF8, 0x9D, 0x52, 0x29, 0xB5, 0x31, 0xC8, 0x45, 0x83, 0x6F, 0x99,
+                                   0xB0, 0x86, 0x01, 0xF1, 0x13, 0xBC, 0xE0, 0x36, 0xF9};
+    constexpr size_t kCount = 200;
+    std::vector<std::array<uint8_t, 33>> pubs(kCount, pub);
+    std::vector<std::array<uint8_t, 32>> msgs(kCount);
+    std::vector<std::array<uint8_t, 64>> sigs(kCount);
+    for (size_t i = 0; i < kCount; ++i) {
+        ASSERT_EQ(RAND_bytes(msgs[i].data(), 32), 1);
+        ASSERT_TRUE(schnorr_sign(secret.data(), msgs[i].data(), sigs[i].data()));
+    }
+    EXPECT_TRUE(schnorr_batch_verify(pubs, msgs, sigs));
+    sigs[kCount - 1][40] ^= 0x01;
+    EXPECT_FALSE(schnorr_batch_verify(pubs, msgs, sigs));
+}
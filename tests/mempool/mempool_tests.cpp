@@ -2,6 +2,7 @@
 #include "../../layer2-services/policy/policy.h"
 #include <cassert>
 #include <cstdint>
+#include <optional>
 #include <vector>
 
 namespace {
@@ -91,5 +92,47 @@ int main()
     assert(tight.Snapshot().empty());
     assert(tight.EstimateFeeRate(10) == tightPolicy.MinFeeRate());
 
+    // Entries are shared with callers and the on-accept hook, not copied.
+    {
+        policy::FeePolicy pagePolicy(1, 100000, 50);
+        mempool::Mempool paged(pagePolicy);
+        TransactionRef relayed;
+        paged.SetOnAccept([&relayed](const TransactionRef& tx) { relayed = tx; });
+        auto first = MakeTransactionRef(MakeTx(40));
+        assert(first->Bytes() == Serialize(first->Tx()) && first->GetHash() == first->Tx().GetHash());
+        assert(paged.Accept(first, 1000));
+        assert(relayed == first && paged.Get(first->GetHash()) == first);
+        assert(!paged.Get(MakeTx(41).GetHash()));
+
+        // A wire-encoded transaction keeps its bytes and hashes them directly.
+        auto wire = MakeTransactionRef(Serialize(MakeTx(41)));
+        assert(wire->GetHash() == MakeTx(41).GetHash());
+        assert(paged.Accept(wire, 1000));
+        for (uint8_t seed = 42; seed < 50; ++seed)
+            assert(paged.Accept(MakeTx(seed), 1000));
+
+        // Paging visits every entry once, in txid order, at one epoch.
+        const uint64_t epoch = paged.Epoch();
+        std::vector<TransactionRef> walked;
+        std::optional<uint256> cursor;
+        do {
+            auto page = paged.GetPage(cursor, 3);
+            assert(page.epoch == epoch && page.txs.size() <= 3);
+            walked.insert(walked.end(), page.txs.begin(), page.txs.end());
+            cursor = page.next;
+        } while (cursor);
+        assert(walked == paged.Snapshot() && walked.size() == 10);
+        for (size_t i = 1; i < walked.size(); ++i)
+            assert(walked[i - 1]->GetHash() < walked[i]->GetHash());
+
+        // Changes move the epoch; an entry removed mid-walk is just skipped.
+        auto page = paged.GetPage(std::nullopt, 4);
+        paged.Remove({walked[5]->GetHash()});
+        assert(paged.Epoch() != epoch);
+        auto rest = paged.GetPage(page.next, 100);
+        assert(rest.epoch != page.epoch && rest.txs.size() == 5 && !rest.next);
+        assert(paged.GetPage(std::nullopt, 0).txs.size() == 1);
+    }
+
     return 0;
 }
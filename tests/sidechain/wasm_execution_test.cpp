@@ -34,7 +34,7 @@ using sidechain::wasm::kAssetTln;
 namespace {
 // Well-known hash mixing constant derived from the golden ratio fraction.
 constexpr std::size_t kHashMagic = 0x9e3779b97f4a7c15ULL;
-constexpr std::size_t kTestCacheEntries = 8;
+constexpr std::size_t kTestCacheBytes = 64 * 1024;
 constexpr uint8_t kInvalidOpcode = 0xFF;
 
 std::size_t DigestUtxos(const Chainstate& chain,
@@ -260,7 +260,7 @@ TEST(WasmIsolation, Layer1UntouchedByNftLifecycle) {
                    .string();
     TempPathGuard guard(tmp);
 
-    Chainstate chain(guard.base_path, kTestCacheEntries);
+    Chainstate chain(guard.base_path, kTestCacheBytes);
     OutPoint op1{};
     op1.hash.fill(0xAA);
     op1.index = 0;
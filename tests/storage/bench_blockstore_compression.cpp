@@ -0,0 +1,114 @@
+// BlockStore write and read throughput with and without record compression,
+// and the ratio achieved on synthetic blocks (random hashes, keys and
+// signatures in the usual fixed layout). Not part of the test suite; build
+// with -DDRACHMA_BUILD_BENCH=ON and run bench_blockstore_compression.
+#include "../../layer1-core/storage/blockstore.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+namespace {
+
+double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+Block MakeBlock(std::mt19937_64& rng, uint32_t height, std::size_t txs)
+{
+    auto fill = [&](uint8_t* p, std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+            p[i] = static_cast<uint8_t>(rng());
+    };
+    Block block{};
+    block.header.version = 1;
+    block.header.time = 1700000000 + height * 60;
+    block.header.bits = 0x1d00ffff;
+    fill(block.header.prevBlockHash.data(), block.header.prevBlockHash.size());
+    fill(block.header.merkleRoot.data(), block.header.merkleRoot.size());
+    block.header.nonce = static_cast<uint32_t>(rng());
+    for (std::size_t t = 0; t < txs; ++t) {
+        Transaction tx;
+        tx.version = 1;
+        for (int i = 0; i < 2; ++i) {
+            TxIn in{};
+            fill(in.prevout.hash.data(), in.prevout.hash.size());
+            in.prevout.index = static_cast<uint32_t>(rng() % 4);
+            in.scriptSig.resize(64);
+            fill(in.scriptSig.data(), in.scriptSig.size());
+            in.sequence = 0xffffffff;
+            tx.vin.push_back(in);
+        }
+        for (int o = 0; o < 2; ++o) {
+            TxOut out{};
+            out.value = rng() % 100000000;
+            out.scriptPubKey.resize(33);
+            out.scriptPubKey[0] = 0x02;
+            fill(out.scriptPubKey.data() + 1, 32);
+            tx.vout.push_back(out);
+        }
+        block.transactions.push_back(tx);
+    }
+    return block;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    // Optional arguments: number of blocks and transactions per block.
+    const uint32_t blocks = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 500;
+    const std::size_t txs = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+
+    std::mt19937_64 rng(42);
+    std::vector<Block> chain;
+    chain.reserve(blocks);
+    for (uint32_t h = 0; h < blocks; ++h)
+        chain.push_back(MakeBlock(rng, h, txs));
+
+    const auto temp = std::filesystem::temp_directory_path() / "drachma_bench_blockstore";
+    std::error_code ec;
+    std::filesystem::remove_all(temp, ec);
+
+    if (!CompressionAvailable())
+        std::printf("built without zlib; only the uncompressed mode is measured\n");
+    std::printf("%-18s %12s %12s %8s\n", "mode", "write MB/s", "read MB/s", "ratio");
+    const char* modes[] = {"plain", "deflate", "deflate+dict"};
+    for (int mode = 0; mode < 3; ++mode) {
+        if (mode > 0 && !CompressionAvailable())
+            break;
+        const std::string dir = (temp / modes[mode]).string();
+        if (mode == 2) {
+            // Train on a separate store so the measured one starts empty.
+            BlockStore trainer(dir, BlockStore::kDefaultMaxFileSize, 0);
+            for (uint32_t h = 0; h < std::min<uint32_t>(blocks, 64); ++h)
+                trainer.WriteBlock(h, chain[h]);
+            trainer.TrainCompressionDictionary();
+        }
+
+        BlockStore store(dir, BlockStore::kDefaultMaxFileSize, 0);
+        store.SetCompression(mode > 0);
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t h = 0; h < blocks; ++h)
+            store.WriteBlock(h, chain[h]);
+        store.Sync();
+        const double writeSecs = Seconds(start);
+        const auto stats = store.GetCompressionStats();
+
+        uint64_t bytes = 0;
+        start = std::chrono::steady_clock::now();
+        for (uint32_t h = 0; h < blocks; ++h)
+            bytes += store.GetBlock(h)->raw.size();
+        const double readSecs = Seconds(start);
+
+        const double mb = static_cast<double>(bytes) / (1 << 20);
+        std::printf("%-18s %12.1f %12.1f %7.2fx\n", modes[mode], mb / writeSecs, mb / readSecs, stats.Ratio());
+    }
+
+    std::filesystem::remove_all(temp, ec);
+    return 0;
+}
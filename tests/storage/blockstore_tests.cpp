@@ -0,0 +1,443 @@
+#include "../../layer1-core/storage/block_scrubber.h"
+#include "../../layer1-core/storage/blockstore.h"
+#include "../test_util.h"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+Block MakeBlock(uint32_t seed, std::size_t scriptSize = 300)
+{
+    Transaction tx;
+    TxIn in{};
+    in.prevout.hash.fill(static_cast<uint8_t>(seed));
+    in.prevout.index = seed;
+    in.scriptSig.assign(8, static_cast<uint8_t>(seed));
+    tx.vin.push_back(in);
+    TxOut out{};
+    out.value = 1000 + seed;
+    out.scriptPubKey.assign(scriptSize, static_cast<uint8_t>(seed * 7));
+    tx.vout.push_back(out);
+
+    Block block{};
+    block.header.version = 1;
+    block.header.time = seed;
+    block.header.nonce = seed * 13;
+    block.transactions.push_back(tx);
+    return block;
+}
+
+bool SameBlock(const Block& a, const Block& b)
+{
+    return BlockHash(a.header) == BlockHash(b.header) && a.transactions.size() == b.transactions.size() &&
+           Serialize(a.transactions[0]) == Serialize(b.transactions[0]);
+}
+
+} // namespace
+
+int main()
+{
+    const auto temp = std::filesystem::temp_directory_path() / "drachma_blockstore";
+    std::error_code ec;
+    std::filesystem::remove_all(temp, ec);
+    const std::string dir = (temp / "blocks").string();
+    constexpr uint64_t kMaxFile = 4096;
+
+    // Records fill numbered files up to the size limit and then roll over.
+    BlockPos last{};
+    {
+        BlockStore store(dir, kMaxFile);
+        for (uint32_t h = 1; h <= 38; ++h) {
+            store.WriteBlock(h, MakeBlock(h));
+            BlockUndo undo;
+            undo.spent.push_back({OutPoint{MakeBlock(h).transactions[0].GetHash(), 0},
+                                  Coin(MakeBlock(h).transactions[0].vout[0], h, false)});
+            store.WriteUndo(h, undo);
+        }
+        last = *store.GetBlockPos(38);
+        assert(last.file > 1);
+        assert(store.GetBlockPos(1)->file == 0 && store.GetBlockPos(1)->offset == 0);
+        assert(!store.GetBlockPos(39));
+
+        // The file being written is reserved ahead of its logical end.
+        assert(std::filesystem::file_size(store.BlockFilePath(last.file)) >= last.offset + last.length);
+
+        for (uint32_t h = 1; h <= 38; ++h) {
+            assert(SameBlock(store.ReadBlock(h), MakeBlock(h)));
+            const auto pos = *store.GetBlockPos(h);
+            assert(pos.offset + pos.length <= kMaxFile);
+        }
+        assert(store.ReadUndo(7).spent.size() == 1 && store.ReadUndo(7).spent[0].coin.Height() == 7);
+        assert(Throws([&] { store.ReadBlock(39); }));
+    }
+
+    // Closing cuts the preallocated tail; finished files end at their last record.
+    assert(std::filesystem::file_size(temp / "blocks" / "blk00000.dat") <= kMaxFile);
+    char name[32];
+    std::snprintf(name, sizeof(name), "blk%05u.dat", last.file);
+    assert(std::filesystem::file_size(temp / "blocks" / name) == last.offset + last.length);
+
+    // Reopening resumes after the last indexed record.
+    {
+        BlockStore store(dir, kMaxFile);
+        assert(SameBlock(store.ReadBlock(38), MakeBlock(38)));
+        assert(store.HasUndo(38) && !store.HasUndo(39));
+        store.WriteBlock(39, MakeBlock(39));
+        const auto pos = *store.GetBlockPos(39);
+        assert(pos.file == last.file && pos.offset == last.offset + last.length);
+
+        // A record above the limit gets a file of its own.
+        store.WriteBlock(40, MakeBlock(40, 3 * kMaxFile));
+        const auto big = *store.GetBlockPos(40);
+        assert(big.file == last.file + 1 && big.offset == 0 && big.length > kMaxFile);
+        store.WriteBlock(41, MakeBlock(41));
+        assert(store.GetBlockPos(41)->file == last.file + 2);
+        assert(SameBlock(store.ReadBlock(40), MakeBlock(40, 3 * kMaxFile)));
+    }
+
+    // Readers run concurrently with each other and with the writer, across
+    // more files than the descriptor cache holds.
+    {
+        BlockStore store(dir, kMaxFile);
+        std::atomic<uint32_t> written{41};
+        std::atomic<bool> failed{false};
+        std::vector<std::thread> readers;
+        for (uint32_t t = 0; t < 4; ++t) {
+            readers.emplace_back([&, t] {
+                for (uint32_t i = 0; i < 400; ++i) {
+                    const uint32_t h = 1 + (i * 7 + t * 13) % written.load();
+                    if (h == 40)
+                        continue;
+                    if (!SameBlock(store.ReadBlock(h), MakeBlock(h)))
+                        failed = true;
+                }
+            });
+        }
+        for (uint32_t h = 42; h <= 160; ++h) {
+            store.WriteBlock(h, MakeBlock(h));
+            written = h;
+        }
+        for (auto& r : readers)
+            r.join();
+        assert(!failed);
+        assert(store.GetBlockPos(160)->file > 16);
+    }
+
+    // Corrupt data is detected on read.
+    {
+        const auto pos = [&] {
+            BlockStore store(dir, kMaxFile);
+            return *store.GetBlockPos(5);
+        }();
+        std::snprintf(name, sizeof(name), "blk%05u.dat", pos.file);
+        {
+            std::fstream f(temp / "blocks" / name, std::ios::in | std::ios::out | std::ios::binary);
+            f.seekp(static_cast<std::streamoff>(pos.offset + pos.length - 1));
+            f.put('\x55');
+        }
+        BlockStore store(dir, kMaxFile);
+        assert(Throws([&] { store.ReadBlock(5); }));
+        assert(SameBlock(store.ReadBlock(6), MakeBlock(6)));
+    }
+
+    // Recent blocks are served from memory; the budget bounds the cache.
+    {
+        BlockStore store((temp / "cached").string(), kMaxFile, 64 << 10);
+        for (uint32_t h = 1; h <= 10; ++h)
+            store.WriteBlock(h, MakeBlock(h));
+        auto entry = store.GetBlock(10);
+        assert(SameBlock(entry->block, MakeBlock(10)));
+        assert(store.GetBlock(10) == entry);
+        assert(store.ReadRawBlock(10) == entry->raw);
+        auto stats = store.CacheStats();
+        assert(stats.hits == 3 && stats.misses == 0 && stats.entries == 10);
+        assert(stats.bytes <= stats.maxBytes && stats.bytes >= 10 * entry->raw.size());
+
+        // Replacing a height replaces its cached entry.
+        store.WriteBlock(10, MakeBlock(99));
+        assert(SameBlock(store.ReadBlock(10), MakeBlock(99)));
+
+        // Large blocks push the oldest entries out.
+        for (uint32_t h = 11; h <= 14; ++h)
+            store.WriteBlock(h, MakeBlock(h, 20000));
+        stats = store.CacheStats();
+        assert(stats.bytes <= stats.maxBytes && stats.entries < 14);
+        const uint64_t misses = stats.misses;
+        assert(SameBlock(store.ReadBlock(1), MakeBlock(1)));
+        assert(store.CacheStats().misses == misses + 1);
+        assert(SameBlock(store.ReadBlock(1), MakeBlock(1)));
+        assert(store.CacheStats().misses == misses + 1);
+    }
+    {
+        BlockStore store((temp / "cached").string(), kMaxFile, 0);
+        assert(SameBlock(store.ReadBlock(3), MakeBlock(3)));
+        assert(SameBlock(store.ReadBlock(3), MakeBlock(3)));
+        const auto stats = store.CacheStats();
+        assert(stats.hits == 0 && stats.misses == 2 && stats.entries == 0);
+    }
+
+#ifdef DRACHMA_HAVE_ZLIB
+    // Compressed and plain records share files and read back the same.
+    {
+        const std::string cdir = (temp / "compressed").string();
+        {
+            BlockStore store(cdir, kMaxFile, 0);
+            for (uint32_t h = 1; h <= 5; ++h)
+                store.WriteBlock(h, MakeBlock(h));
+            store.SetCompression(true);
+            for (uint32_t h = 6; h <= 10; ++h)
+                store.WriteBlock(h, MakeBlock(h));
+            auto stats = store.GetCompressionStats();
+            assert(stats.enabled && stats.records == 10 && stats.compressedRecords == 5);
+            assert(stats.Ratio() > 1.0);
+            assert(store.GetBlockPos(6)->length < store.GetBlockPos(5)->length);
+
+            // A trained dictionary is kept once and used for later records.
+            assert(store.TrainCompressionDictionary());
+            assert(!store.TrainCompressionDictionary());
+            stats = store.GetCompressionStats();
+            assert(stats.dictionaryId != 0 && stats.dictionaryBytes > 0);
+            for (uint32_t h = 11; h <= 15; ++h)
+                store.WriteBlock(h, MakeBlock(h));
+            assert(store.GetCompressionStats().compressedRecords == 10);
+        }
+        {
+            BlockStore store(cdir, kMaxFile, 0);
+            assert(!store.GetCompressionStats().enabled);
+            assert(store.GetCompressionStats().dictionaryId != 0);
+            for (uint32_t h = 1; h <= 15; ++h)
+                assert(SameBlock(store.ReadBlock(h), MakeBlock(h)));
+            store.WriteBlock(16, MakeBlock(16));
+            assert(SameBlock(store.ReadBlock(16), MakeBlock(16)));
+        }
+
+        // Records that need the dictionary fail cleanly without it.
+        std::filesystem::remove(temp / "compressed" / "blk.dict");
+        {
+            BlockStore store(cdir, kMaxFile, 0);
+            assert(SameBlock(store.ReadBlock(7), MakeBlock(7)));
+            assert(Throws([&] { store.ReadBlock(12); }));
+        }
+
+        // The codec rejects damaged or truncated input.
+        const auto raw = Serialize(MakeBlock(3).transactions[0]);
+        const auto dict = CompressionDictionary::Train({raw});
+        auto packed = CompressRecord(raw, dict);
+        assert(!packed.empty() && packed.size() < raw.size());
+        assert(DecompressRecord(packed, dict) == raw);
+        assert(Throws([&] { DecompressRecord(packed, CompressionDictionary{}); }));
+        packed.resize(packed.size() - 2);
+        assert(Throws([&] { DecompressRecord(packed, dict); }));
+        assert(CompressRecord({1, 2, 3}, CompressionDictionary{}).empty());
+    }
+#else
+    assert(Throws([&] { BlockStore((temp / "compressed").string()).SetCompression(true); }));
+#endif
+
+    // Legacy SHA-256 records and CRC-32C records are read alike, and the
+    // scrubber verifies every record of both files.
+    {
+        const std::string sdir = (temp / "scrub").string();
+        BlockPos damaged{};
+        {
+            BlockStore store(sdir, kMaxFile);
+            store.SetRecordChecksum(RecordChecksum::Sha256);
+            for (uint32_t h = 1; h <= 10; ++h)
+                store.WriteBlock(h, MakeBlock(h));
+            store.SetRecordChecksum(RecordChecksum::Crc32c);
+            for (uint32_t h = 11; h <= 20; ++h) {
+                store.WriteBlock(h, MakeBlock(h));
+                BlockUndo undo;
+                undo.spent.push_back({OutPoint{MakeBlock(h).transactions[0].GetHash(), 0},
+                                      Coin(MakeBlock(h).transactions[0].vout[0], h, false)});
+                store.WriteUndo(h, undo);
+            }
+            assert(store.GetBlockPos(1)->length == store.GetBlockPos(11)->length + 28);
+            damaged = *store.GetBlockPos(14);
+        }
+        BlockStore store(sdir, kMaxFile, 0);
+        for (uint32_t h = 1; h <= 20; ++h)
+            assert(SameBlock(store.ReadBlock(h), MakeBlock(h)));
+
+        BlockScrubber clean(store, 0, [](const BlockScrubber::Corruption&) { assert(false); });
+        assert(clean.RunPass());
+        auto stats = clean.GetStats();
+        assert(stats.passes == 1 && stats.records == 30 && stats.corrupt == 0);
+
+        {
+            std::fstream f(store.BlockFilePath(damaged.file), std::ios::in | std::ios::out | std::ios::binary);
+            f.seekp(static_cast<std::streamoff>(damaged.offset + damaged.length - 3));
+            f.put('\x5a');
+        }
+        std::vector<BlockScrubber::Corruption> found;
+        BlockScrubber scrubber(store, 0, [&](const BlockScrubber::Corruption& c) { found.push_back(c); });
+        assert(scrubber.RunPass());
+        stats = scrubber.GetStats();
+        assert(stats.records == 30 && stats.corrupt == 1);
+        assert(found.size() == 1 && !found[0].undo);
+        assert(found[0].pos.file == damaged.file && found[0].pos.offset == damaged.offset);
+        assert(Throws([&] { store.ReadBlock(14); }));
+
+        // The background thread is throttled and stops promptly.
+        BlockScrubber slow(store, 1024, [](const BlockScrubber::Corruption&) {});
+        slow.Start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        slow.Stop();
+        assert(slow.GetStats().passes == 0 && slow.GetStats().bytes < 4096);
+    }
+
+    // Blocks are found by hash, including side branches and blocks whose
+    // height was taken over by a reorganization.
+    {
+        const std::string hdir = (temp / "byhash").string();
+        const Block main5 = MakeBlock(5), side5 = MakeBlock(105), side6 = MakeBlock(106);
+        {
+            BlockStore store(hdir, kMaxFile);
+            for (uint32_t h = 1; h <= 8; ++h)
+                store.WriteBlock(h, MakeBlock(h));
+            store.WriteSideBlock(5, side5);
+            store.WriteSideBlock(6, side6);
+            assert(SameBlock(store.ReadBlock(5), main5)); // the height slot is untouched
+
+            const auto loc = store.LookupBlock(BlockHash(side6.header));
+            assert(loc && loc->height == 6);
+            assert(SameBlock(store.GetBlockByHash(BlockHash(side6.header))->block, side6));
+            assert(store.GetBlockByHash(BlockHash(main5.header)) == store.GetBlock(5));
+            assert(!store.GetBlockByHash(BlockHash(MakeBlock(77).header)));
+
+            // A reorganization onto the side branch keeps the old block reachable.
+            store.WriteBlock(5, side5);
+            assert(SameBlock(store.ReadBlock(5), side5));
+            assert(SameBlock(store.GetBlockByHash(BlockHash(main5.header))->block, main5));
+        }
+        {
+            // Appends resume after side-branch records, which have no height slot.
+            BlockStore store(hdir, kMaxFile);
+            store.WriteBlock(9, MakeBlock(9));
+            assert(SameBlock(store.GetBlockByHash(BlockHash(side6.header))->block, side6));
+            assert(SameBlock(store.GetBlockByHash(BlockHash(MakeBlock(9).header))->block, MakeBlock(9)));
+        }
+    }
+
+    // Pruning deletes the oldest files down to the target but keeps the
+    // most recent blocks and their undo data.
+    {
+        const std::string pdir = (temp / "pruned").string();
+        constexpr uint32_t kKeep = 12;
+        uint64_t target = 0;
+        {
+            BlockStore store(pdir, kMaxFile, 1 << 20);
+            for (uint32_t h = 0; h < 60; ++h) {
+                store.WriteBlock(h, MakeBlock(h));
+                BlockUndo undo;
+                undo.spent.push_back({OutPoint{MakeBlock(h).transactions[0].GetHash(), 0},
+                                      Coin(MakeBlock(h).transactions[0].vout[0], h, false)});
+                store.WriteUndo(h, undo);
+                if (h == 2)
+                    store.WriteSideBlock(2, MakeBlock(202));
+            }
+            assert(store.PrunedHeight() == 0);
+            assert(store.GetBlockByHash(BlockHash(MakeBlock(202).header)));
+            const uint64_t before = store.DiskUsage();
+            target = before / 2;
+            store.SetPruneTarget(target, kKeep);
+            assert(store.Prune() > 0);
+            assert(store.DiskUsage() <= target);
+            assert(!std::filesystem::exists(store.BlockFilePath(0)));
+
+            const uint32_t pruned = store.PrunedHeight();
+            assert(pruned > 0 && pruned <= 60 - kKeep);
+            assert(!store.GetBlockPos(0));
+            try {
+                store.ReadBlock(0);
+                assert(false);
+            } catch (const std::runtime_error& e) {
+                assert(std::string(e.what()) == "block pruned");
+            }
+            assert(Throws([&] { store.ReadUndo(0); }));
+            assert(!store.GetBlockByHash(BlockHash(MakeBlock(202).header)));
+            assert(!store.LookupBlock(BlockHash(MakeBlock(0).header)));
+            for (uint32_t h = 60 - kKeep; h < 60; ++h) {
+                assert(SameBlock(store.ReadBlock(h), MakeBlock(h)));
+                assert(store.HasUndo(h));
+            }
+            assert(store.Prune() == 0); // already under the target
+
+            // Further writes prune as files fill up, never below the kept depth.
+            for (uint32_t h = 60; h < 120; ++h)
+                store.WriteBlock(h, MakeBlock(h));
+            assert(store.PrunedHeight() > pruned);
+            for (uint32_t h = 120 - kKeep; h < 120; ++h)
+                assert(SameBlock(store.ReadBlock(h), MakeBlock(h)));
+        }
+        {
+            // The pruned height survives a restart.
+            BlockStore store(pdir, kMaxFile);
+            assert(store.PrunedHeight() > 0);
+            assert(Throws([&] { store.ReadBlock(1); }));
+            assert(SameBlock(store.ReadBlock(119), MakeBlock(119)));
+            assert(Throws([&] { store.ReadBlock(500); }));
+
+            // Re-enabling pruning after a restart picks up what the older
+            // files hold, side branches included.
+            store.WriteSideBlock(121, MakeBlock(321));
+            store.SetPruneTarget(1, kKeep);
+            for (uint32_t h = 120; h < 180; ++h)
+                store.WriteBlock(h, MakeBlock(h));
+            assert(store.PrunedHeight() > 121);
+            assert(!store.GetBlockByHash(BlockHash(MakeBlock(321).header)));
+            assert(!store.LookupBlock(BlockHash(MakeBlock(119).header)));
+            for (uint32_t h = 180 - kKeep; h < 180; ++h)
+                assert(SameBlock(store.ReadBlock(h), MakeBlock(h)));
+        }
+    }
+
+    // The height index is a flat slot table; slots past the synced count are
+    // dropped on reopen.
+    {
+        const std::string idxPath = (temp / "heights.idx").string();
+        {
+            BlockHeightIndex idx(idxPath);
+            idx.Set(0, BlockPos{0, 0, 100});
+            idx.Set(3, BlockPos{1, 200, 50});
+            assert(idx.Size() == 4);
+            assert(!idx.Get(1) && !idx.Get(4));
+            assert(idx.Get(3)->file == 1 && idx.Get(3)->offset == 200 && idx.Get(3)->length == 50);
+            idx.Sync();
+            idx.Set(3, BlockPos{2, 0, 60}); // overwrite in place
+            idx.Set(9, BlockPos{2, 60, 70});
+            assert(idx.End().file == 2 && idx.End().offset == 130);
+            // Growing past the first chunk keeps earlier slots.
+            idx.Set(BlockHeightIndex::kGrowSlots + 5, BlockPos{3, 0, 10});
+            assert(idx.Get(0)->length == 100);
+        }
+        {
+            BlockHeightIndex idx(idxPath);
+            assert(idx.Size() == 4);
+            assert(idx.Get(0)->length == 100 && !idx.Get(9));
+            idx.Set(5, BlockPos{0, 100, 10});
+            assert(!idx.Get(4) && idx.Get(5));
+            idx.Sync();
+        }
+        assert(BlockHeightIndex(idxPath).Size() == 6);
+
+        std::ofstream((temp / "bad.idx").string()) << "not an index";
+        assert(Throws([&] { BlockHeightIndex idx((temp / "bad.idx").string()); }));
+    }
+
+    // The old single-file layout is refused rather than misread.
+    {
+        std::ofstream((temp / "legacy.dat").string()) << "x";
+        assert(Throws([&] { BlockStore store((temp / "legacy.dat").string()); }));
+    }
+
+    std::filesystem::remove_all(temp, ec);
+    return 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <exception>
+
+// True if calling f throws a std::exception; for assert-based tests.
+template <typename F>
+bool Throws(F&& f)
+{
+    try {
+        f();
+    } catch (const std::exception&) {
+        return true;
+    }
+    return false;
+}
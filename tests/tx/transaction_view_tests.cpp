@@ -0,0 +1,169 @@
+#include "../../layer1-core/block/block_view.h"
+#include "../../layer1-core/merkle/merkle.h"
+#include "../../layer1-core/tx/transaction_view.h"
+#include "../test_util.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+Transaction MakeTx(uint8_t seed, std::size_t inputs, std::size_t outputs)
+{
+    Transaction tx;
+    tx.version = 2;
+    tx.lockTime = 500u + seed;
+    for (std::size_t i = 0; i < inputs; ++i) {
+        TxIn in{};
+        in.prevout.hash.fill(static_cast<uint8_t>(seed + i));
+        in.prevout.index = static_cast<uint32_t>(i * 3);
+        in.scriptSig.assign(10 + i, static_cast<uint8_t>(seed ^ i));
+        in.sequence = 0xfffffff0u + static_cast<uint32_t>(i);
+        in.assetId = static_cast<uint8_t>(i % 3);
+        tx.vin.push_back(in);
+    }
+    for (std::size_t i = 0; i < outputs; ++i) {
+        TxOut out{};
+        out.value = 1000000ull * (seed + 1) + i;
+        out.scriptPubKey.assign(i == 0 ? 0 : 33, static_cast<uint8_t>(seed + 7 * i));
+        out.assetId = static_cast<uint8_t>((i + 1) % 3);
+        tx.vout.push_back(out);
+    }
+    return tx;
+}
+
+bool SameTx(const Transaction& a, const Transaction& b)
+{
+    return Serialize(a) == Serialize(b);
+}
+
+std::vector<uint8_t> BlockPayload(const BlockHeader& header, const std::vector<Transaction>& txs)
+{
+    std::vector<uint8_t> out(sizeof(BlockHeader));
+    std::memcpy(out.data(), &header, sizeof(BlockHeader));
+    const uint32_t count = static_cast<uint32_t>(txs.size());
+    out.insert(out.end(), reinterpret_cast<const uint8_t*>(&count), reinterpret_cast<const uint8_t*>(&count) + 4);
+    for (const auto& tx : txs) {
+        const auto ser = Serialize(tx);
+        const uint32_t size = static_cast<uint32_t>(ser.size());
+        out.insert(out.end(), reinterpret_cast<const uint8_t*>(&size), reinterpret_cast<const uint8_t*>(&size) + 4);
+        out.insert(out.end(), ser.begin(), ser.end());
+    }
+    return out;
+}
+
+} // namespace
+
+int main()
+{
+    // Fields decode in place and scripts point into the caller's buffer.
+    {
+        const Transaction tx = MakeTx(9, 3, 2);
+        const auto bytes = Serialize(tx);
+        const TransactionView view(bytes);
+        assert(view.Version() == 2 && view.LockTime() == 509);
+        assert(view.InputCount() == 3 && view.OutputCount() == 2);
+        for (std::size_t i = 0; i < 3; ++i) {
+            const auto in = view.Input(i);
+            assert(in.Prevout().hash == tx.vin[i].prevout.hash && in.prevoutIndex == tx.vin[i].prevout.index);
+            assert(in.assetId == tx.vin[i].assetId && in.sequence == tx.vin[i].sequence);
+            assert(in.scriptSig.ToVector() == tx.vin[i].scriptSig);
+            assert(in.scriptSig.data() > bytes.data() && in.scriptSig.end() <= bytes.data() + bytes.size());
+        }
+        assert(view.Output(0).scriptPubKey.empty());
+        assert(view.Output(1).value == tx.vout[1].value && view.Output(1).assetId == tx.vout[1].assetId);
+        assert(view.Output(1).scriptPubKey.ToVector() == tx.vout[1].scriptPubKey);
+        assert(view.Bytes().data() == bytes.data() && view.Bytes().size() == bytes.size());
+        assert(view.GetHash() == tx.GetHash());
+        assert(SameTx(view.ToTransaction(), tx));
+        assert(SameTx(DeserializeTransaction(bytes), tx));
+        assert(Throws([&] { view.Input(3); }));
+        assert(Throws([&] { view.Output(2); }));
+
+        const TransactionView empty(Serialize(MakeTx(1, 0, 0)));
+        assert(empty.InputCount() == 0 && empty.OutputCount() == 0);
+    }
+
+    // Malformed encodings are rejected up front.
+    {
+        auto bytes = Serialize(MakeTx(4, 2, 2));
+        for (std::size_t cut : {std::size_t{0}, std::size_t{3}, std::size_t{20}, bytes.size() - 1}) {
+            const std::vector<uint8_t> shorter(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(cut));
+            assert(Throws([&] { TransactionView v(shorter); }));
+        }
+        auto longer = bytes;
+        longer.push_back(0);
+        assert(Throws([&] { TransactionView v(longer); }));
+
+        // An absurd input count fails before anything is reserved for it.
+        auto huge = bytes;
+        huge[4] = huge[5] = huge[6] = huge[7] = 0xff;
+        assert(Throws([&] { TransactionView v(huge); }));
+
+        // A script length running past the end.
+        auto badScript = bytes;
+        badScript[8 + 37 + 3] = 0x7f;
+        assert(Throws([&] { TransactionView v(badScript); }));
+    }
+
+    // The size-only, buffer and hashing paths agree with Serialize.
+    {
+        auto big = MakeTx(5, 3, 2);
+        big.vin[1].scriptSig.assign(700, 0x42); // longer than the hash batch
+        for (const auto& tx : {MakeTx(6, 0, 0), MakeTx(7, 1, 1), MakeTx(8, 4, 5), big}) {
+            const auto bytes = Serialize(tx);
+            assert(GetSerializeSize(tx) == bytes.size());
+            assert(TransactionHash(tx) == tagged_hash("TX", bytes.data(), bytes.size()));
+
+            std::vector<uint8_t> buf(bytes.size() + 3, 0xee);
+            assert(SerializeInto(tx, buf.data(), buf.size()) == bytes.size());
+            assert(std::equal(bytes.begin(), bytes.end(), buf.begin()) && buf.back() == 0xee);
+            assert(Throws([&] { SerializeInto(tx, buf.data(), bytes.size() - 1); }));
+
+            std::vector<uint8_t> arena{1, 2};
+            SerializeAppend(tx, arena);
+            assert(arena.size() == 2 + bytes.size() && std::equal(bytes.begin(), bytes.end(), arena.begin() + 2));
+        }
+
+        // The signature-hash preimage is the encoding with blank scriptSigs.
+        auto blank = big;
+        for (auto& in : blank.vin)
+            in.scriptSig.clear();
+        auto preimage = Serialize(blank);
+        const uint32_t index = 2;
+        preimage.insert(preimage.end(), reinterpret_cast<const uint8_t*>(&index), reinterpret_cast<const uint8_t*>(&index) + 4);
+        std::array<uint8_t, 32> digest{};
+        SHA256(preimage.data(), preimage.size(), digest.data());
+        assert(ComputeInputDigest(big, index) == digest);
+    }
+
+    // Block payloads parse into views over each transaction.
+    {
+        BlockHeader header{};
+        header.version = 3;
+        header.time = 12345;
+        header.nonce = 99;
+        std::vector<Transaction> txs{MakeTx(1, 1, 1), MakeTx(2, 2, 3), MakeTx(3, 1, 2)};
+        const auto payload = BlockPayload(header, txs);
+        const BlockView view(payload);
+        assert(view.TransactionCount() == 3);
+        assert(BlockHash(view.Header()) == BlockHash(header));
+        assert(view.ComputeMerkleRoot() == ComputeMerkleRoot(txs));
+        assert(view.Tx(1).GetHash() == txs[1].GetHash());
+        const Block block = view.ToBlock();
+        assert(block.transactions.size() == 3 && SameTx(block.transactions[2], txs[2]));
+        assert(Throws([&] { view.Tx(3); }));
+
+        const std::vector<uint8_t> truncated(payload.begin(), payload.end() - 1);
+        assert(Throws([&] { BlockView v(truncated); }));
+        auto badCount = payload;
+        badCount[sizeof(BlockHeader)] = 0xff;
+        badCount[sizeof(BlockHeader) + 1] = 0xff;
+        assert(Throws([&] { BlockView v(badCount); }));
+        assert(BlockView(BlockPayload(header, {})).ComputeMerkleRoot() == uint256{});
+    }
+
+    return 0;
+}
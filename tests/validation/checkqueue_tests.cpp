@@ -0,0 +1,88 @@
+#include "../../layer1-core/validation/checkqueue.h"
+#include <atomic>
+#include <cassert>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+int main()
+{
+    CheckQueue queue(3);
+    assert(queue.WorkerThreads() == 3);
+
+    // Every check runs exactly once when all pass.
+    {
+        constexpr size_t kChecks = 10000;
+        std::vector<std::atomic<int>> hits(kChecks);
+        std::vector<CheckQueue::Check> checks;
+        for (size_t i = 0; i < kChecks; ++i)
+            checks.emplace_back([&hits, i] { ++hits[i]; return true; });
+        assert(queue.RunAll(checks));
+        for (const auto& h : hits)
+            assert(h.load() == 1);
+        // The pool is reusable across batches.
+        assert(queue.RunAll(checks));
+        assert(queue.RunAll({}));
+    }
+
+    // A failure is reported and stops outstanding work early.
+    {
+        constexpr size_t kChecks = 20000;
+        std::atomic<size_t> ran{0};
+        std::vector<CheckQueue::Check> checks;
+        checks.emplace_back([&ran] { ++ran; return false; });
+        for (size_t i = 1; i < kChecks; ++i)
+            checks.emplace_back([&ran] {
+                ++ran;
+                std::this_thread::sleep_for(std::chrono::microseconds(20));
+                return true;
+            });
+        assert(!queue.RunAll(checks));
+        assert(ran.load() < kChecks);
+    }
+
+    // Exceptions count as failures.
+    {
+        std::vector<CheckQueue::Check> checks(64, [] { return true; });
+        checks[40] = []() -> bool { throw std::runtime_error("bad input"); };
+        assert(!queue.RunAll(checks));
+    }
+
+    // Concurrent callers get correct results; one of them may run inline.
+    {
+        std::vector<CheckQueue::Check> good(512, [] { return true; });
+        std::vector<CheckQueue::Check> bad(512, [] { return true; });
+        bad[511] = [] { return false; };
+        std::atomic<int> wrong{0};
+        std::vector<std::thread> callers;
+        for (int t = 0; t < 4; ++t) {
+            callers.emplace_back([&, t] {
+                for (int i = 0; i < 50; ++i) {
+                    const bool expect = (t % 2) == 0;
+                    if (queue.RunAll(expect ? good : bad) != expect)
+                        ++wrong;
+                }
+            });
+        }
+        for (auto& c : callers)
+            c.join();
+        assert(wrong.load() == 0);
+    }
+
+    // Thread-count option: explicit, auto and serial settings.
+    {
+        SetScriptCheckThreads(4);
+        assert(GetScriptCheckThreads() == 4);
+        assert(GetScriptCheckQueue()->WorkerThreads() == 3);
+        SetScriptCheckThreads(1);
+        assert(GetScriptCheckQueue()->WorkerThreads() == 0);
+        SetScriptCheckThreads(0);
+        assert(GetScriptCheckThreads() >= 1);
+        SetScriptCheckThreads(-1000);
+        assert(GetScriptCheckThreads() == 1);
+        SetScriptCheckThreads(1000);
+        assert(GetScriptCheckThreads() == kMaxScriptCheckThreads);
+        SetScriptCheckThreads(0);
+    }
+    return 0;
+}
@@ -0,0 +1,427 @@
+#include "../../layer1-core/validation/validation.h"
+#include "../../layer1-core/chainstate/coins.h"
+#include "../../layer1-core/chainstate/undo.h"
+#include "../../layer1-core/consensus/fork_resolution.h"
+#include "../../layer1-core/consensus/params.h"
+#include "../../layer1-core/crypto/schnorr.h"
+#include "../../layer1-core/merkle/merkle.h"
+#include "../../layer1-core/pow/difficulty.h"
+#include "../../layer1-core/storage/blockstore.h"
+#include "../../layer1-core/validation/checkqueue.h"
+#include "../test_util.h"
+#include <cassert>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+#ifdef DRACHMA_HAVE_LEVELDB
+#include <leveldb/db.h>
+#endif
+
+namespace {
+
+// BIP-340 test vector 0: secret key 3 and its x-only public key.
+const std::array<uint8_t, 32> kSecret = [] {
+    std::array<uint8_t, 32> k{};
+    k[31] = 3;
+    return k;
+}();
+const std::vector<uint8_t> kPubKey = {
+    0xF9, 0x30, 0x8A, 0x01, 0x92, 0x58, 0xC3, 0x10, 0x49, 0x34, 0x4F, 0x85, 0xF8, 0x9D, 0x52, 0x29,
+    0xB5, 0x31, 0xC8, 0x45, 0x83, 0x6F, 0x99, 0xB0, 0x86, 0x01, 0xF1, 0x13, 0xBC, 0xE0, 0x36, 0xF9};
+
+constexpr uint8_t kAsset = static_cast<uint8_t>(AssetId::TALANTON);
+
+consensus::Params LooseParams()
+{
+    consensus::Params p = consensus::Testnet();
+    p.nGenesisBits = 0x207fffff;
+    p.fPowAllowMinDifficultyBlocks = true;
+    return p;
+}
+
+Transaction MakeCoinbase(const consensus::Params& params, uint32_t height, uint8_t tag)
+{
+    Transaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.hash.fill(0);
+    tx.vin[0].prevout.index = std::numeric_limits<uint32_t>::max();
+    tx.vin[0].scriptSig = {static_cast<uint8_t>(height), tag};
+    tx.vin[0].assetId = kAsset;
+    tx.vout.resize(1);
+    tx.vout[0].value = consensus::GetBlockSubsidy(height, params, kAsset);
+    tx.vout[0].scriptPubKey = kPubKey;
+    tx.vout[0].assetId = kAsset;
+    return tx;
+}
+
+Transaction MakeSpend(const OutPoint& prevout, uint64_t value)
+{
+    Transaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    tx.vin[0].assetId = kAsset;
+    tx.vout.resize(1);
+    tx.vout[0].value = value;
+    tx.vout[0].scriptPubKey = kPubKey;
+    tx.vout[0].assetId = kAsset;
+    auto digest = ComputeInputDigest(tx, 0);
+    tx.vin[0].scriptSig.resize(64);
+    bool signed_ = schnorr_sign(kSecret.data(), digest.data(), tx.vin[0].scriptSig.data());
+    assert(signed_);
+    (void)signed_;
+    return tx;
+}
+
+// Spend prevout into n equal outputs.
+Transaction MakeFanout(const OutPoint& prevout, uint64_t value, size_t n)
+{
+    Transaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    tx.vin[0].assetId = kAsset;
+    tx.vout.resize(n);
+    for (auto& out : tx.vout) {
+        out.value = value / n;
+        out.scriptPubKey = kPubKey;
+        out.assetId = kAsset;
+    }
+    auto digest = ComputeInputDigest(tx, 0);
+    tx.vin[0].scriptSig.resize(64);
+    bool signed_ = schnorr_sign(kSecret.data(), digest.data(), tx.vin[0].scriptSig.data());
+    assert(signed_);
+    (void)signed_;
+    return tx;
+}
+
+Block MakeBlock(const consensus::Params& params, const uint256& prev, uint32_t time, std::vector<Transaction> txs)
+{
+    Block block{};
+    block.header.version = 1;
+    block.header.prevBlockHash = prev;
+    block.header.time = time;
+    block.header.bits = params.nGenesisBits;
+    block.transactions = std::move(txs);
+    block.header.merkleRoot = ComputeMerkleRoot(block.transactions);
+    while (!powalgo::CheckProofOfWork(BlockHash(block.header), block.header.bits, params))
+        ++block.header.nonce;
+    return block;
+}
+
+BlockValidationOptions Opts(uint32_t mtp)
+{
+    BlockValidationOptions opts;
+    opts.medianTimePast = mtp;
+    return opts;
+}
+
+} // namespace
+
+int main()
+{
+    const auto params = LooseParams();
+    const auto temp = std::filesystem::temp_directory_path() / "drachma_connect_block";
+    std::error_code ec;
+    std::filesystem::remove_all(temp, ec);
+    std::filesystem::create_directories(temp);
+
+    {
+        Chainstate chain((temp / "chainstate").string());
+        BlockStore store((temp / "blocks").string());
+        consensus::ForkResolver resolver(100);
+
+        auto b1 = MakeBlock(params, uint256{}, 1000, {MakeCoinbase(params, 1, 0)});
+        const auto h1 = BlockHash(b1.header);
+        const OutPoint cb1{b1.transactions[0].GetHash(), 0};
+        BlockUndo undo1;
+        assert(ConnectBlock(b1, chain, params, 1, undo1, Opts(999)));
+        assert(undo1.spent.empty());
+        store.WriteBlock(1, b1);
+        store.WriteUndo(1, undo1);
+        auto coin = chain.TryGetCoin(cb1);
+        assert(coin && coin->Height() == 1 && coin->IsCoinBase());
+        assert(chain.GetBestBlock() == h1);
+
+        const uint64_t cbValue = b1.transactions[0].vout[0].value;
+        auto spend = MakeSpend(cb1, cbValue - 1000);
+        const OutPoint spent{spend.GetHash(), 0};
+        auto b2 = MakeBlock(params, h1, 1010, {MakeCoinbase(params, 2, 0), spend});
+        const auto h2 = BlockHash(b2.header);
+        BlockUndo undo2;
+        // Not built on the tip: rejected without touching the chainstate.
+        BlockUndo unused;
+        assert(!ConnectBlock(MakeBlock(params, h2, 1010, {MakeCoinbase(params, 2, 1)}), chain, params, 2, unused, Opts(1000)));
+        assert(ConnectBlock(b2, chain, params, 2, undo2, Opts(1000)));
+        store.WriteBlock(2, b2);
+        store.WriteUndo(2, undo2);
+        assert(!chain.HaveUTXO(cb1));
+        assert(chain.HaveUTXO(spent));
+
+        // Rev data round-trips through the block store and reverses the block.
+        auto readUndo = store.ReadUndo(2);
+        assert(readUndo.spent.size() == 1);
+        assert(readUndo.spent[0].coin.Value() == cbValue);
+        assert(DisconnectBlock(b2, chain, readUndo));
+        assert(chain.GetBestBlock() == h1);
+        assert(chain.HaveUTXO(cb1));
+        assert(!chain.HaveUTXO(spent));
+        coin = chain.TryGetCoin(cb1);
+        assert(coin && coin->Height() == 1 && coin->IsCoinBase());
+        // Disconnecting a block that is not the tip fails.
+        assert(!DisconnectBlock(b2, chain, readUndo));
+        assert(ConnectBlock(b2, chain, params, 2, undo2, Opts(1000)));
+
+        // A heavier branch from b1 replaces b2 by disconnecting just b2.
+        auto alt2 = MakeBlock(params, h1, 1011, {MakeCoinbase(params, 2, 7)});
+        auto alt3 = MakeBlock(params, BlockHash(alt2.header), 1020, {MakeCoinbase(params, 3, 7)});
+        const auto altH2 = BlockHash(alt2.header);
+        const auto altH3 = BlockHash(alt3.header);
+        assert(resolver.ConsiderHeader(b1.header, h1, uint256{}, 1, params));
+        assert(resolver.ConsiderHeader(b2.header, h2, h1, 2, params));
+        resolver.ConsiderHeader(alt2.header, altH2, h1, 2, params);
+        assert(resolver.ConsiderHeader(alt3.header, altH3, altH2, 3, params));
+
+        auto plan = resolver.PlanReorg(h2, altH3);
+        assert(plan);
+        assert(plan->fork == h1);
+        assert(plan->disconnect.size() == 1 && plan->disconnect[0].hash == h2);
+        assert(plan->connect.size() == 2 && plan->connect[0].hash == altH2);
+
+        std::map<uint256, Block> altBlocks{{altH2, alt2}, {altH3, alt3}};
+        BlockProvider provider = [&](const uint256& hash) -> std::optional<Block> {
+            auto it = altBlocks.find(hash);
+            if (it == altBlocks.end())
+                return std::nullopt;
+            return it->second;
+        };
+        assert(ApplyReorg(*plan, chain, store, params, provider));
+        assert(chain.GetBestBlock() == altH3);
+        assert(chain.HaveUTXO(cb1));
+        assert(!chain.HaveUTXO(spent));
+        assert(chain.HaveUTXO(OutPoint{alt3.transactions[0].GetHash(), 0}));
+        assert(BlockHash(store.ReadBlock(2).header) == altH2);
+        assert(store.HasUndo(3));
+
+        // A reorg that cannot complete restores the branch it started from.
+        auto back = resolver.PlanReorg(altH3, h2);
+        assert(back && back->disconnect.size() == 2 && back->connect.size() == 1);
+        const FlatFilePos blocksEnd = store.RecordsEnd(false);
+        const FlatFilePos undoEnd = store.RecordsEnd(true);
+        assert(!ApplyReorg(*back, chain, store, params, [](const uint256&) { return std::optional<Block>{}; }));
+        assert(chain.GetBestBlock() == altH3);
+        assert(chain.HaveUTXO(cb1));
+        assert(chain.HaveUTXO(OutPoint{alt2.transactions[0].GetHash(), 0}));
+        assert(BlockHash(store.ReadBlock(3).header) == altH3);
+        // Nothing was overwritten, so nothing was written back.
+        assert(store.RecordsEnd(false).offset == blocksEnd.offset && store.RecordsEnd(true).offset == undoEnd.offset);
+
+        // With the original block available the reverse reorg succeeds.
+        altBlocks.emplace(h2, b2);
+        assert(ApplyReorg(*back, chain, store, params, provider));
+        assert(chain.GetBestBlock() == h2);
+        assert(!chain.HaveUTXO(cb1));
+        assert(chain.HaveUTXO(spent));
+        assert(!chain.HaveUTXO(OutPoint{alt2.transactions[0].GetHash(), 0}));
+        assert(BlockHash(store.ReadBlock(2).header) == h2);
+        assert(Throws([&] { store.ReadBlock(3); }));
+        assert(!store.HasUndo(3) && store.HasUndo(2));
+        // The old branch is still served by hash.
+        assert(store.GetBlockByHash(altH3));
+    }
+    {
+        // The shorter chain is what the store reopens with.
+        BlockStore store((temp / "blocks").string());
+        assert(store.HasUndo(2) && !store.HasUndo(3));
+        assert(Throws([&] { store.ReadBlock(3); }));
+    }
+
+    // Wide blocks are applied in waves on the worker pool; spends of coins
+    // created earlier in the block wait for the wave that creates them.
+    {
+        SetScriptCheckThreads(4);
+        Chainstate chain((temp / "parallel").string());
+        auto b1 = MakeBlock(params, uint256{}, 1000, {MakeCoinbase(params, 1, 0)});
+        BlockUndo undo;
+        assert(ConnectBlock(b1, chain, params, 1, undo, Opts(999)));
+        const OutPoint cb1{b1.transactions[0].GetHash(), 0};
+        const uint64_t cbValue = b1.transactions[0].vout[0].value;
+
+        constexpr size_t kWidth = 48;
+        auto fanout = MakeFanout(cb1, cbValue - 1000, kWidth);
+        const uint64_t each = fanout.vout[0].value;
+        auto b2 = MakeBlock(params, BlockHash(b1.header), 1010, {MakeCoinbase(params, 2, 0), fanout});
+        assert(ConnectBlock(b2, chain, params, 2, undo, Opts(1000)));
+
+        std::vector<Transaction> txs{MakeCoinbase(params, 3, 0)};
+        for (size_t i = 0; i < kWidth; ++i)
+            txs.push_back(MakeSpend(OutPoint{fanout.GetHash(), static_cast<uint32_t>(i)}, each - 100));
+        // A chain of spends through the block's own outputs.
+        for (size_t i = 0; i < 8; ++i) {
+            const auto& prev = txs.back();
+            txs.push_back(MakeSpend(OutPoint{prev.GetHash(), 0}, prev.vout[0].value - 100));
+        }
+        auto b3 = MakeBlock(params, BlockHash(b2.header), 1020, txs);
+        BlockUndo undo3;
+        assert(ConnectBlock(b3, chain, params, 3, undo3, Opts(1010)));
+        assert(undo3.spent.size() == txs.size() - 1);
+        for (size_t i = 1; i < txs.size(); ++i)
+            assert(OutPointEq{}(undo3.spent[i - 1].prevout, txs[i].vin[0].prevout));
+        for (size_t i = 0; i < kWidth; ++i)
+            assert(!chain.HaveUTXO(OutPoint{fanout.GetHash(), static_cast<uint32_t>(i)}));
+        for (size_t i = 1; i + 1 < txs.size(); ++i)
+            assert(chain.HaveUTXO(OutPoint{txs[i].GetHash(), 0}) == (i < kWidth));
+        assert(chain.HaveUTXO(OutPoint{txs.back().GetHash(), 0}));
+
+        assert(DisconnectBlock(b3, chain, undo3));
+        for (size_t i = 0; i < kWidth; ++i)
+            assert(chain.HaveUTXO(OutPoint{fanout.GetHash(), static_cast<uint32_t>(i)}));
+        assert(!chain.HaveUTXO(OutPoint{txs.back().GetHash(), 0}));
+
+        // Spending an output of a later transaction fails as it would in
+        // block order, leaving the chainstate untouched.
+        std::swap(txs[kWidth + 1], txs[kWidth + 2]);
+        auto bad = MakeBlock(params, BlockHash(b2.header), 1020, txs);
+        BlockUndo badUndo;
+        assert(!ConnectBlock(bad, chain, params, 3, badUndo, Opts(1010)));
+        assert(chain.GetBestBlock() == BlockHash(b2.header));
+        assert(chain.HaveUTXO(OutPoint{fanout.GetHash(), 0}));
+        SetScriptCheckThreads(0);
+    }
+
+    // Prefetching pulls a block's inputs into a cold cache so validation
+    // finds them resident.
+    {
+        SetScriptCheckThreads(4);
+        const auto path = (temp / "prefetch").string();
+        constexpr size_t kWidth = 24;
+        Transaction fanout;
+        uint256 tip{};
+        {
+            Chainstate chain(path);
+            auto b1 = MakeBlock(params, uint256{}, 1000, {MakeCoinbase(params, 1, 0)});
+            BlockUndo undo;
+            assert(ConnectBlock(b1, chain, params, 1, undo, Opts(999)));
+            fanout = MakeFanout(OutPoint{b1.transactions[0].GetHash(), 0}, b1.transactions[0].vout[0].value, kWidth);
+            auto b2 = MakeBlock(params, BlockHash(b1.header), 1010, {MakeCoinbase(params, 2, 0), fanout});
+            assert(ConnectBlock(b2, chain, params, 2, undo, Opts(1000)));
+            tip = BlockHash(b2.header);
+        }
+
+        Chainstate cold(path);
+        assert(cold.CachedEntries() == 0);
+        std::vector<Transaction> txs{MakeCoinbase(params, 3, 0)};
+        for (size_t i = 0; i < kWidth; ++i)
+            txs.push_back(MakeSpend(OutPoint{fanout.GetHash(), static_cast<uint32_t>(i)}, fanout.vout[i].value - 10));
+        txs.push_back(MakeSpend(OutPoint{txs.back().GetHash(), 0}, txs.back().vout[0].value - 10));
+        auto b3 = MakeBlock(params, tip, 1020, txs);
+
+        assert(PrefetchBlockInputs(b3, cold) == kWidth);
+        assert(cold.CachedEntries() == kWidth);
+        const auto before = cold.CacheStats();
+        for (size_t i = 0; i < kWidth; ++i)
+            assert(cold.HaveUTXO(OutPoint{fanout.GetHash(), static_cast<uint32_t>(i)}));
+        const auto after = cold.CacheStats();
+        assert(after.misses == before.misses);
+        assert(after.hits == before.hits + kWidth);
+
+        BlockUndo undo;
+        assert(ConnectBlock(b3, cold, params, 3, undo, Opts(1010)));
+        assert(undo.spent.size() == kWidth + 1);
+        // New outputs go in without a backend read; only the coinbase checks
+        // for a repeated txid. The coin created and spent inside the block
+        // was FRESH and leaves no entry to write: the cache holds the spent
+        // inputs and the surviving outputs only.
+        assert(cold.CacheStats().misses == after.misses + 1);
+        assert(cold.CachedEntries() == 2 * kWidth + 1);
+        SetScriptCheckThreads(0);
+    }
+
+#ifdef DRACHMA_HAVE_LEVELDB
+    // A flush cut short in the middle of block 2 is finished by replaying the
+    // block, and the coins end up as if the flush had never been interrupted.
+    {
+        auto b1 = MakeBlock(params, uint256{}, 1000, {MakeCoinbase(params, 1, 3)});
+        const auto h1 = BlockHash(b1.header);
+        const OutPoint cb1{b1.transactions[0].GetHash(), 0};
+        auto fanout = MakeFanout(cb1, b1.transactions[0].vout[0].value - 1000, 4);
+        auto b2 = MakeBlock(params, h1, 1010, {MakeCoinbase(params, 2, 3), fanout});
+        const auto h2 = BlockHash(b2.header);
+        // Spends one output the interrupted flush wrote and one it did not.
+        auto b3 = MakeBlock(params, h2, 1020, {MakeCoinbase(params, 3, 3),
+                                               MakeSpend(OutPoint{fanout.GetHash(), 0}, fanout.vout[0].value - 10),
+                                               MakeSpend(OutPoint{fanout.GetHash(), 3}, fanout.vout[3].value - 10)});
+
+        SnapshotMetadata expected;
+        {
+            Chainstate ref((temp / "replay-ref").string());
+            BlockUndo undo;
+            assert(ConnectBlock(b1, ref, params, 1, undo, Opts(999)));
+            assert(ConnectBlock(b2, ref, params, 2, undo, Opts(1000)));
+            assert(ConnectBlock(b3, ref, params, 3, undo, Opts(1010)));
+            expected = ref.DumpSnapshot((temp / "replay-ref.snap").string());
+        }
+
+        const std::string path = (temp / "replay").string();
+        BlockStore store((temp / "replay-blocks").string());
+        {
+            Chainstate cs(path);
+            BlockUndo undo;
+            assert(ConnectBlock(b1, cs, params, 1, undo, Opts(999)));
+            cs.Flush();
+        }
+        store.WriteBlock(1, b1);
+        store.WriteBlock(2, b2);
+        {
+            // Block 2's flush, stopped after a few one-coin chunks.
+            CoinsViewDB db(path + ".ldb", 1);
+            CoinsMap partial;
+            partial[cb1].spent = true;
+            partial[cb1].flags = CoinsCacheEntry::DIRTY;
+            for (uint32_t i = 0; i < 2; ++i) {
+                auto& entry = partial[OutPoint{fanout.GetHash(), i}];
+                entry.coin = Coin(fanout.vout[i], 2, false);
+                entry.flags = CoinsCacheEntry::DIRTY;
+            }
+            db.BatchWrite(partial, uint256{});
+        }
+        {
+            leveldb::DB* raw = nullptr;
+            auto status = leveldb::DB::Open(leveldb::Options(), path + ".ldb", &raw);
+            assert(status.ok());
+            std::string marker(reinterpret_cast<const char*>(h2.data()), h2.size());
+            marker.append(reinterpret_cast<const char*>(h1.data()), h1.size());
+            status = raw->Put(leveldb::WriteOptions(), "H", marker);
+            assert(status.ok());
+            delete raw;
+        }
+        {
+            Chainstate cs(path);
+            auto replay = cs.PendingReplay();
+            assert(replay && replay->from == h1 && replay->to == h2);
+            BlockStore empty((temp / "replay-empty").string());
+            assert(!ReplayInterruptedFlush(cs, empty));
+            assert(cs.PendingReplay() && cs.GetBestBlock() == h1);
+
+            assert(ReplayInterruptedFlush(cs, store));
+            assert(!cs.PendingReplay());
+            assert(cs.GetBestBlock() == h2);
+            assert(cs.HaveUTXO(OutPoint{fanout.GetHash(), 3}) && !cs.HaveUTXO(cb1));
+            BlockUndo undo;
+            assert(ConnectBlock(b3, cs, params, 3, undo, Opts(1010)));
+        }
+        {
+            Chainstate cs(path);
+            // The flushed copy of a coin spent after the replay stays gone.
+            assert(!cs.HaveUTXO(OutPoint{fanout.GetHash(), 0}));
+            const auto stats = cs.GetUtxoSetStats();
+            assert(stats.coins == expected.coinCount && stats.setHash == expected.setHash);
+            const auto meta = cs.DumpSnapshot((temp / "replay.snap").string());
+            assert(meta.contentHash == expected.contentHash);
+        }
+    }
+#endif
+
+    std::filesystem::remove_all(temp, ec);
+    return 0;
+}
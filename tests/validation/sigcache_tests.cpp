@@ -0,0 +1,164 @@
+#include "../../layer1-core/validation/sigcache.h"
+#include "../../layer1-core/validation/validation.h"
+#include "../../layer1-core/crypto/schnorr.h"
+#include <cassert>
+#include <limits>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// BIP-340 test vector 0: secret key 3 and its x-only public key.
+const std::array<uint8_t, 32> kSecret = [] {
+    std::array<uint8_t, 32> k{};
+    k[31] = 3;
+    return k;
+}();
+const std::vector<uint8_t> kPubKey = {
+    0xF9, 0x30, 0x8A, 0x01, 0x92, 0x58, 0xC3, 0x10, 0x49, 0x34, 0x4F, 0x85, 0xF8, 0x9D, 0x52, 0x29,
+    0xB5, 0x31, 0xC8, 0x45, 0x83, 0x6F, 0x99, 0xB0, 0x86, 0x01, 0xF1, 0x13, 0xBC, 0xE0, 0x36, 0xF9};
+
+constexpr uint8_t kAsset = static_cast<uint8_t>(AssetId::TALANTON);
+constexpr uint64_t kPrevValue = 100000;
+
+SchnorrSigCheck MakeCheck(uint32_t n)
+{
+    SchnorrSigCheck c;
+    c.digest[0] = static_cast<uint8_t>(n);
+    c.digest[1] = static_cast<uint8_t>(n >> 8);
+    c.digest[2] = static_cast<uint8_t>(n >> 16);
+    return c;
+}
+
+TxOut PrevOut()
+{
+    TxOut out;
+    out.value = kPrevValue;
+    out.scriptPubKey = kPubKey;
+    out.assetId = kAsset;
+    return out;
+}
+
+Transaction MakeSpend(uint8_t seed)
+{
+    Transaction tx;
+    tx.vin.resize(2);
+    for (uint32_t i = 0; i < 2; ++i) {
+        tx.vin[i].prevout.hash.fill(seed);
+        tx.vin[i].prevout.index = i;
+        tx.vin[i].assetId = kAsset;
+    }
+    tx.vout.resize(1);
+    tx.vout[0].value = 2 * kPrevValue - 1000;
+    tx.vout[0].scriptPubKey = kPubKey;
+    tx.vout[0].assetId = kAsset;
+    for (size_t i = 0; i < 2; ++i) {
+        auto digest = ComputeInputDigest(tx, i);
+        tx.vin[i].scriptSig.resize(64);
+        bool signed_ = schnorr_sign(kSecret.data(), digest.data(), tx.vin[i].scriptSig.data());
+        assert(signed_);
+        (void)signed_;
+    }
+    return tx;
+}
+
+Transaction MakeCoinbase()
+{
+    Transaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.hash.fill(0);
+    tx.vin[0].prevout.index = std::numeric_limits<uint32_t>::max();
+    tx.vin[0].scriptSig = {1, 0};
+    tx.vin[0].assetId = kAsset;
+    tx.vout.resize(1);
+    tx.vout[0].value = 1000;
+    tx.vout[0].scriptPubKey = kPubKey;
+    tx.vout[0].assetId = kAsset;
+    return tx;
+}
+
+} // namespace
+
+int main()
+{
+    // Membership, duplicate inserts and the entry bound.
+    {
+        SignatureCache cache(64 * SignatureCache::kEntryBytes);
+        assert(cache.MaxEntries() == 64);
+        assert(!cache.Contains(MakeCheck(1)));
+        cache.Insert(MakeCheck(1));
+        cache.Insert(MakeCheck(1));
+        assert(cache.Contains(MakeCheck(1)));
+        assert(cache.Size() == 1);
+        auto other = MakeCheck(1);
+        other.sig[63] = 1;
+        assert(!cache.Contains(other));
+
+        for (uint32_t i = 2; i < 10000; ++i)
+            cache.Insert(MakeCheck(i));
+        assert(cache.Size() <= cache.MaxEntries());
+        // The newest entries survive eviction.
+        assert(cache.Contains(MakeCheck(9999)));
+    }
+
+    // Concurrent readers and writers.
+    {
+        SignatureCache cache(size_t{8} << 20);
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < 4; ++t) {
+            threads.emplace_back([&cache, t] {
+                for (uint32_t i = 0; i < 2000; ++i) {
+                    cache.Insert(MakeCheck(t * 2000 + i));
+                    bool found = cache.Contains(MakeCheck(t * 2000 + i));
+                    assert(found);
+                    (void)found;
+                }
+            });
+        }
+        for (auto& th : threads)
+            th.join();
+        assert(cache.Size() == 8000);
+    }
+
+    const auto params = consensus::Testnet();
+    const UTXOLookup lookup = [](const OutPoint&) -> std::optional<TxOut> { return PrevOut(); };
+
+    // Mempool acceptance fills the shared cache; block validation reads it.
+    {
+        SetSignatureCacheBytes(kDefaultSignatureCacheBytes);
+        auto tx = MakeSpend(7);
+        assert(ValidateTransaction(tx, params, lookup));
+        auto cache = GetSignatureCache();
+        assert(cache && cache->Size() == 2);
+        SchnorrSigCheck check;
+        assert(ExtractSchnorrCheck(tx, 1, PrevOut(), check));
+        assert(cache->Contains(check));
+
+        // Overspending and malformed transactions are rejected and cache nothing.
+        auto bad = MakeSpend(8);
+        bad.vout[0].value = 3 * kPrevValue;
+        assert(!ValidateTransaction(bad, params, lookup));
+        bad = MakeSpend(9);
+        bad.vin[0].scriptSig[0] ^= 1;
+        assert(!ValidateTransaction(bad, params, lookup));
+        assert(cache->Size() == 2);
+
+        // A cached entry is trusted: plant one for an invalid signature and
+        // the block passes; without the cache it fails.
+        assert(ExtractSchnorrCheck(bad, 0, PrevOut(), check));
+        cache->Insert(check);
+        assert(ExtractSchnorrCheck(bad, 1, PrevOut(), check));
+        cache->Insert(check);
+        const std::vector<Transaction> block{MakeCoinbase(), tx, bad};
+        assert(ValidateTransactions(block, params, 1, lookup, true));
+
+        SetSignatureCacheBytes(0);
+        assert(!GetSignatureCache());
+        std::optional<ScriptFailure> failure;
+        assert(!ValidateTransactions(block, params, 1, lookup, true, &failure));
+        assert(failure && failure->txIndex == 2 && failure->inputIndex == 0);
+        assert(ValidateTransaction(tx, params, lookup));
+    }
+    SetSignatureCacheBytes(kDefaultSignatureCacheBytes);
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "../../layer1-core/validation/validation.h"
+#include "../../layer1-core/crypto/schnorr.h"
+#include "../../layer1-core/script/interpreter.h"
+#include "../../layer1-core/validation/checkqueue.h"
+#include <cassert>
+#include <limits>
+#include <map>
+
+namespace {
+
+// BIP-340 test vector 0: secret key 3 and its x-only public key.
+const std::array<uint8_t, 32> kSecret = [] {
+    std::array<uint8_t, 32> k{};
+    k[31] = 3;
+    return k;
+}();
+const std::vector<uint8_t> kPubKey = {
+    0xF9, 0x30, 0x8A, 0x01, 0x92, 0x58, 0xC3, 0x10, 0x49, 0x34, 0x4F, 0x85, 0xF8, 0x9D, 0x52, 0x29,
+    0xB5, 0x31, 0xC8, 0x45, 0x83, 0x6F, 0x99, 0xB0, 0x86, 0x01, 0xF1, 0x13, 0xBC, 0xE0, 0x36, 0xF9};
+
+constexpr uint8_t kAsset = static_cast<uint8_t>(AssetId::TALANTON);
+constexpr uint64_t kPrevValue = 100000;
+
+Transaction MakeCoinbase()
+{
+    Transaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.hash.fill(0);
+    tx.vin[0].prevout.index = std::numeric_limits<uint32_t>::max();
+    tx.vin[0].scriptSig = {1, 0};
+    tx.vin[0].assetId = kAsset;
+    tx.vout.resize(1);
+    tx.vout[0].value = 1000;
+    tx.vout[0].scriptPubKey = kPubKey;
+    tx.vout[0].assetId = kAsset;
+    return tx;
+}
+
+// A transaction spending `inputs` previous outputs, each signed separately.
+Transaction MakeSpend(uint32_t seed, size_t inputs)
+{
+    Transaction tx;
+    tx.vin.resize(inputs);
+    for (size_t i = 0; i < inputs; ++i) {
+        tx.vin[i].prevout.hash.fill(static_cast<uint8_t>(seed));
+        tx.vin[i].prevout.hash[0] = static_cast<uint8_t>(seed >> 8);
+        tx.vin[i].prevout.index = static_cast<uint32_t>(i);
+        tx.vin[i].assetId = kAsset;
+    }
+    tx.vout.resize(1);
+    tx.vout[0].value = kPrevValue * inputs - 1000;
+    tx.vout[0].scriptPubKey = kPubKey;
+    tx.vout[0].assetId = kAsset;
+    for (size_t i = 0; i < inputs; ++i) {
+        auto digest = ComputeInputDigest(tx, i);
+        tx.vin[i].scriptSig.resize(64);
+        bool signed_ = schnorr_sign(kSecret.data(), digest.data(), tx.vin[i].scriptSig.data());
+        assert(signed_);
+        (void)signed_;
+    }
+    return tx;
+}
+
+bool Validate(const std::vector<Transaction>& txs, bool batch, std::optional<ScriptFailure>* failure)
+{
+    const auto params = consensus::Testnet();
+    UTXOLookup lookup = [](const OutPoint&) -> std::optional<TxOut> {
+        TxOut out;
+        out.value = kPrevValue;
+        out.scriptPubKey = kPubKey;
+        out.assetId = kAsset;
+        return out;
+    };
+    return ValidateTransactions(txs, params, 1, lookup, batch, failure);
+}
+
+} // namespace
+
+int main()
+{
+    for (int threads : {1, 4}) {
+        SetScriptCheckThreads(threads);
+
+        std::vector<Transaction> txs{MakeCoinbase()};
+        for (uint32_t i = 1; i <= 40; ++i)
+            txs.push_back(MakeSpend(i, 1 + i % 3));
+
+        // The extracted check matches what VerifyScript verifies.
+        SchnorrSigCheck check;
+        TxOut prev;
+        prev.value = kPrevValue;
+        prev.scriptPubKey = kPubKey;
+        prev.assetId = kAsset;
+        assert(ExtractSchnorrCheck(txs[1], 0, prev, check));
+        assert(check.digest == ComputeInputDigest(txs[1], 0));
+        assert(std::equal(check.pubkey.begin(), check.pubkey.end(), kPubKey.begin()));
+
+        std::optional<ScriptFailure> failure;
+        assert(Validate(txs, true, &failure));
+        assert(!failure);
+        assert(Validate(txs, false, &failure));
+        assert(!failure);
+
+        // One corrupted signature fails the batch, and the fallback names it.
+        txs[23].vin[1].scriptSig[5] ^= 0x01;
+        for (bool batch : {true, false}) {
+            failure.reset();
+            assert(!Validate(txs, batch, &failure));
+            assert(failure && failure->txIndex == 23 && failure->inputIndex == 1);
+        }
+
+        // Malformed signatures are caught before any batch is formed.
+        txs[23].vin[1].scriptSig[5] ^= 0x01;
+        txs[9].vin[0].scriptSig.resize(63);
+        failure.reset();
+        assert(!Validate(txs, true, &failure));
+        assert(failure && failure->txIndex == 9 && failure->inputIndex == 0);
+    }
+    SetScriptCheckThreads(0);
+    return 0;
+}
@@ -257,6 +257,47 @@ int main()
         assert(digestThrew);
     }
 
+    // Precomputed sighash state matches hashing the whole transaction per input.
+    {
+        Transaction tx;
+        for (uint8_t i = 0; i < 50; ++i) {
+            TxIn in;
+            in.prevout = MakeOutPoint(i, i);
+            in.scriptSig.assign(64, i);
+            in.sequence = 0xfffffffe - i;
+            tx.vin.push_back(in);
+        }
+        tx.vout.push_back(MakeTxOut(1234));
+        tx.lockTime = 77;
+
+        Transaction unsigned_ = tx;
+        for (auto& in : unsigned_.vin)
+            in.scriptSig.clear();
+        const auto prefix = Serialize(unsigned_);
+
+        const PrecomputedTransactionData txdata(tx);
+        assert(txdata.InputCount() == tx.vin.size());
+        for (uint32_t i = 0; i < tx.vin.size(); ++i) {
+            std::array<uint8_t, 32> expected{};
+            SHA256_CTX ctx;
+            SHA256_Init(&ctx);
+            SHA256_Update(&ctx, prefix.data(), prefix.size());
+            SHA256_Update(&ctx, &i, sizeof(i));
+            SHA256_Final(expected.data(), &ctx);
+            assert(txdata.InputDigest(i) == expected);
+            assert(ComputeInputDigest(tx, i) == expected);
+        }
+        assert(txdata.InputDigest(0) != txdata.InputDigest(1));
+
+        bool threw = false;
+        try {
+            txdata.InputDigest(tx.vin.size());
+        } catch (const std::exception&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+
     // Empty transaction set is invalid.
     {
         std::vector<Transaction> txs;